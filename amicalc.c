@@ -7,10 +7,34 @@
 #include <clib/exec_protos.h>
 #include <clib/intuition_protos.h>
 #include <clib/graphics_protos.h>
+#include <clib/alib_protos.h>
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+#include "calcmath.h"
+#include "ddreal.h"
+#include "ratio.h"
+#include "combi.h"
+#include "gamma.h"
+#include "power.h"
+#include "fexpr.h"
+#include "solve.h"
+#include "integ.h"
+#include "series.h"
+#include "poly.h"
+#include "cplx.h"
+#include "stats.h"
+#include "rng.h"
+#include "mcarlo.h"
+#include "sheet.h"
+#include "symtab.h"
+#include "macro.h"
+#include "compute.h"
+#include "session.h"
+#include "history.h"
 
 struct IntuitionBase *IntuitionBase = NULL;
 struct GfxBase *GfxBase = NULL;
@@ -20,43 +44,129 @@ struct GfxBase *GfxBase = NULL;
 
 #define DISP_X 10
 #define DISP_Y 8
-#define DISP_W (WIN_W - (2 * DISP_X))
 #define DISP_H 20
+#define DISP_CHARS 34
 
+/* Smallest button; the layout grows them with the window and the font. */
 #define BTN_W 40
 #define BTN_H 20
 #define BTN_X_SP 5
 #define BTN_Y_SP 5
 #define GAP_X 10
+#define DISP_GAP 12
 
 #define FUNC_COLS 2
-#define FUNC_X 10
-#define FUNC_Y 40
-#define KEY_X (FUNC_X + (FUNC_COLS * BTN_W) + ((FUNC_COLS - 1) * BTN_X_SP) + GAP_X)
-#define KEY_Y FUNC_Y
+#define KEY_COLS 4
+#define GRID_COLS (FUNC_COLS + KEY_COLS)
+#define GRID_ROWS 6
 
 #define MAX_ENTRY 64
 #define MAX_EXPR 256
 #define EXPR_TMP (MAX_EXPR + 64)
 #define MAX_PAREN_DEPTH 8
-
-#define CONST_PI 3.141592653589793
-#define CONST_E 2.718281828459045
+/* n from which n!, nPr and nCr go to the compute task. */
+#define COMBI_JOB_MIN 1000UL
+
+/* Data file read by Estadistica -> Importar. */
+#define STAT_FILE "RAM:amicalc.dat"
+/* Macros kept by Macros -> Guardar and read back by Cargar. */
+#define MACRO_FILE "S:amicalc.mac"
+/* The session left on exit; Kickstart 1.3 has no ENVARC:. */
+#define SESSION_FILE "S:amicalc.ses"
+#define WIN_LEFT 50
+#define WIN_TOP 50
+#define WIN_STEP 16
+#define MAX_WINDOWS 4
+#define WIN_IDCMP (CLOSEWINDOW | MOUSEBUTTONS | REFRESHWINDOW | MENUPICK | VANILLAKEY | \
+                   INTUITICKS | ACTIVEWINDOW | NEWSIZE)
+
+#define CONST_PI REAL_C(3.141592653589793)
+#define CONST_E REAL_C(2.718281828459045)
 #define ROOT_W 12
 #define ROOT_H 8
 
 #define MENU_CONST 0
 #define MENU_MODE 1
 #define MENU_VIEW 2
+#define MENU_ARITH 3
+#define MENU_CALC 4
+#define MENU_POLY 5
+#define MENU_STAT 6
+#define MENU_SHEET 7
+#define MENU_VARS 8
+#define MENU_MACRO 9
 #define ITEM_PI 0
 #define ITEM_E 1
 #define ITEM_RAD 0
 #define ITEM_DEG 1
 #define ITEM_EXPR 0
+#define ITEM_DECIMAL 1
+#define ITEM_NEW_WINDOW 2
+#define ITEM_HISTORY 3
+#define ITEM_SEARCH 4
+#define ITEM_ARITH_REAL 0
+#define ITEM_ARITH_DD 1
+#define ITEM_ARITH_FRAC 2
+#define ITEM_ARITH_CPLX 3
+#define ITEM_SOLVE 0
+#define ITEM_INT_FROM 1
+#define ITEM_INT_TO 2
+#define ITEM_INT_TO_INF 3
+#define ITEM_INTEGRATE 4
+#define ITEM_SUM 5
+#define ITEM_PRODUCT 6
+#define ITEM_MC_UNIFORM 7
+#define ITEM_MC_NORMAL 8
+#define ITEM_POLY_COEF 0
+#define ITEM_POLY_EVAL 1
+#define ITEM_POLY_ROOTS 2
+#define ITEM_POLY_CLEAR 3
+#define ITEM_STAT_X 0
+#define ITEM_STAT_N 1
+#define ITEM_STAT_MEAN 2
+#define ITEM_STAT_SDEV 3
+#define ITEM_STAT_MIN 4
+#define ITEM_STAT_MAX 5
+#define ITEM_STAT_SLOPE 6
+#define ITEM_STAT_INTERCEPT 7
+#define ITEM_STAT_CORR 8
+#define ITEM_STAT_IMPORT 9
+#define ITEM_STAT_CLEAR 10
+#define ITEM_SHEET_CELL 0
+#define ITEM_SHEET_REF 1
+#define ITEM_SHEET_DEFINE 2
+#define ITEM_SHEET_CLEAR 3
+#define ITEM_VAR_STO 0
+#define ITEM_VAR_RCL 1
+#define ITEM_VAR_DEFINE 2
+#define ITEM_VAR_APPLY 3
+#define ITEM_VAR_CLEAR 4
+#define ITEM_MACRO_RECORD 0
+#define ITEM_MACRO_1 1
+#define ITEM_MACRO_SAVE 5
+#define ITEM_MACRO_LOAD 6
+
+#define NAME_NONE 0
+#define NAME_STO 1
+#define NAME_RCL 2
+#define NAME_DEFINE 3
+#define NAME_APPLY 4
+#define NAME_SEARCH 5
 
 #define ANGLE_RAD 0
 #define ANGLE_DEG 1
 
+#define ARITH_REAL 0
+#define ARITH_DD 1
+#define ARITH_FRAC 2
+#define ARITH_CPLX 3
+
+#define NUM_INT 0
+#define NUM_REAL 1
+#define NUM_DD 2
+#define NUM_RAT 3
+#define NUM_CPLX 4
+
 struct Button {
     const char *label;
     const char *alt_label;
@@ -71,15 +181,42 @@ static const struct Button buttons[] = {
     {"tan", "atan", 'T', 0, 1, 0}, {"ln", "exp", 'L', 0, 1, 1},
     {"log", "10^x", 'G', 0, 2, 0}, {"sqrt", "x^2", 'Q', 0, 2, 1},
     {"x^y", NULL, 'P', 0, 3, 0}, {"e^x", "ln", 'X', 0, 3, 1},
-    {"Inv", "Inv*", 'I', 0, 4, 0}, {"Exp", NULL, 'E', 0, 4, 1},
+    {"Inv", "Inv*", 'I', 0, 4, 0}, {"Exp", "x", 'E', 0, 4, 1},
     {"(", NULL, '(', 0, 5, 0}, {")", NULL, ')', 0, 5, 1},
 
     {"7", NULL, '7', 1, 0, 0}, {"8", NULL, '8', 1, 0, 1}, {"9", NULL, '9', 1, 0, 2}, {"/", NULL, '/', 1, 0, 3},
     {"4", NULL, '4', 1, 1, 0}, {"5", NULL, '5', 1, 1, 1}, {"6", NULL, '6', 1, 1, 2}, {"*", NULL, '*', 1, 1, 3},
     {"1", NULL, '1', 1, 2, 0}, {"2", NULL, '2', 1, 2, 1}, {"3", NULL, '3', 1, 2, 2}, {"-", NULL, '-', 1, 2, 3},
-    {"0", NULL, '0', 1, 3, 0}, {".", NULL, '.', 1, 3, 1}, {"+/-", NULL, 'S', 1, 3, 2}, {"+", NULL, '+', 1, 3, 3},
-    {"C", NULL, 'C', 1, 4, 0}, {"%", NULL, '%', 1, 4, 1}, {"n!", NULL, 'F', 1, 4, 2}, {"=", NULL, '=', 1, 4, 3},
-    {"<-", NULL, 'B', 1, 5, 0}
+    {"0", NULL, '0', 1, 3, 0}, {".", "i", '.', 1, 3, 1}, {"+/-", "n", 'S', 1, 3, 2}, {"+", NULL, '+', 1, 3, 3},
+    {"C", NULL, 'C', 1, 4, 0}, {"%", NULL, '%', 1, 4, 1}, {"n!", "lnx!", 'F', 1, 4, 2}, {"=", NULL, '=', 1, 4, 3},
+    {"<-", "Hst", 'B', 1, 5, 0}, {"nCr", "nPr", 'K', 1, 5, 1}, {"S+", "S-", 'W', 1, 5, 2},
+    {"Rnd", "Nrm", 'U', 1, 5, 3}
+};
+
+/* Filled once by measure_labels; every window uses the same font. */
+static WORD label_width[sizeof(buttons) / sizeof(buttons[0])][2];
+
+/* Index in buttons[] of the key in each grid cell, or -1. */
+static BYTE grid_button[GRID_ROWS][GRID_COLS];
+
+/*
+ * Geometry of one window, worked out by compute_layout when the window
+ * opens or changes size and kept in its UserData. The function keys take
+ * the first FUNC_COLS columns, the keypad the rest after a GAP_X gap.
+ */
+struct Layout {
+    WORD disp_x;
+    WORD disp_y;
+    WORD disp_w;
+    WORD disp_h;
+    WORD btn_w;
+    WORD btn_h;
+    WORD pitch_x;
+    WORD pitch_y;
+    WORD col_x[GRID_COLS];
+    WORD row_y[GRID_ROWS];
+    WORD min_w;
+    WORD min_h;
 };
 
 static const char MENU_TITLE[] = "Constantes";
@@ -90,46 +227,296 @@ static const char MENU_RAD_LABEL[] = "RAD";
 static const char MENU_DEG_LABEL[] = "GRA";
 static const char MENU_VIEW_TITLE[] = "Vista";
 static const char MENU_EXPR_LABEL[] = "Expresion";
+static const char MENU_DECIMAL_LABEL[] = "Decimal";
+static const char MENU_NEW_WINDOW_LABEL[] = "Nueva ventana";
+static const char MENU_HISTORY_LABEL[] = "Historial";
+static const char MENU_SEARCH_LABEL[] = "Buscar";
+static const char MENU_ARITH_TITLE[] = "Numero";
+static const char MENU_ARITH_REAL_LABEL[] = "Real";
+static const char MENU_ARITH_DD_LABEL[] = "Doble-doble";
+static const char MENU_ARITH_FRAC_LABEL[] = "Fraccion";
+static const char MENU_ARITH_CPLX_LABEL[] = "Complejo";
+static const char MENU_CALC_TITLE[] = "Calculo";
+static const char MENU_SOLVE_LABEL[] = "Resolver";
+static const char MENU_INT_FROM_LABEL[] = "Desde";
+static const char MENU_INT_TO_LABEL[] = "Hasta";
+static const char MENU_INT_TO_INF_LABEL[] = "Hasta inf.";
+static const char MENU_INTEGRATE_LABEL[] = "Integrar";
+static const char MENU_SUM_LABEL[] = "Suma";
+static const char MENU_PRODUCT_LABEL[] = "Producto";
+static const char MENU_MC_UNIFORM_LABEL[] = "Monte Carlo";
+static const char MENU_MC_NORMAL_LABEL[] = "MC normal";
+static const char MENU_POLY_TITLE[] = "Polinomio";
+static const char MENU_POLY_COEF_LABEL[] = "Coeficiente";
+static const char MENU_POLY_EVAL_LABEL[] = "Evaluar";
+static const char MENU_POLY_ROOTS_LABEL[] = "Raices";
+static const char MENU_POLY_CLEAR_LABEL[] = "Borrar";
+static const char MENU_STAT_TITLE[] = "Estadistica";
+static const char MENU_STAT_X_LABEL[] = "Dato x";
+static const char MENU_STAT_N_LABEL[] = "Cuenta";
+static const char MENU_STAT_MEAN_LABEL[] = "Media";
+static const char MENU_STAT_SDEV_LABEL[] = "Desviacion";
+static const char MENU_STAT_MIN_LABEL[] = "Minimo";
+static const char MENU_STAT_MAX_LABEL[] = "Maximo";
+static const char MENU_STAT_SLOPE_LABEL[] = "Pendiente";
+static const char MENU_STAT_INTERCEPT_LABEL[] = "Ordenada";
+static const char MENU_STAT_CORR_LABEL[] = "Correlacion";
+static const char MENU_STAT_IMPORT_LABEL[] = "Importar";
+static const char MENU_STAT_CLEAR_LABEL[] = "Borrar";
+static const char MENU_SHEET_TITLE[] = "Hoja";
+static const char MENU_SHEET_CELL_LABEL[] = "Celda";
+static const char MENU_SHEET_REF_LABEL[] = "Referencia";
+static const char MENU_SHEET_DEFINE_LABEL[] = "Definir";
+static const char MENU_SHEET_CLEAR_LABEL[] = "Borrar";
+static const char MENU_VARS_TITLE[] = "Variables";
+static const char MENU_VAR_STO_LABEL[] = "STO";
+static const char MENU_VAR_RCL_LABEL[] = "RCL";
+static const char MENU_VAR_DEFINE_LABEL[] = "Definir f(x)";
+static const char MENU_VAR_APPLY_LABEL[] = "Aplicar f";
+static const char MENU_VAR_CLEAR_LABEL[] = "Borrar";
+static const char MENU_MACRO_TITLE[] = "Macros";
+static const char MENU_MACRO_RECORD_LABEL[] = "Grabar";
+static const char MENU_MACRO_1_LABEL[] = "Macro 1";
+static const char MENU_MACRO_2_LABEL[] = "Macro 2";
+static const char MENU_MACRO_3_LABEL[] = "Macro 3";
+static const char MENU_MACRO_4_LABEL[] = "Macro 4";
+static const char MENU_MACRO_SAVE_LABEL[] = "Guardar";
+static const char MENU_MACRO_LOAD_LABEL[] = "Cargar";
 
 static struct Menu menu_constants;
 static struct Menu menu_mode;
 static struct Menu menu_view;
+static struct Menu menu_arith;
+static struct Menu menu_calc;
+static struct Menu menu_poly;
+static struct Menu menu_stat;
+static struct Menu menu_sheet;
+static struct Menu menu_vars;
+static struct Menu menu_macro;
 static struct MenuItem menu_item_pi;
 static struct MenuItem menu_item_e;
 static struct MenuItem menu_item_rad;
 static struct MenuItem menu_item_deg;
 static struct MenuItem menu_item_expr;
+static struct MenuItem menu_item_decimal;
+static struct MenuItem menu_item_new_window;
+static struct MenuItem menu_item_history;
+static struct MenuItem menu_item_search;
+static struct MenuItem menu_item_arith_real;
+static struct MenuItem menu_item_arith_dd;
+static struct MenuItem menu_item_arith_frac;
+static struct MenuItem menu_item_arith_cplx;
+static struct MenuItem menu_item_solve;
+static struct MenuItem menu_item_int_from;
+static struct MenuItem menu_item_int_to;
+static struct MenuItem menu_item_int_to_inf;
+static struct MenuItem menu_item_integrate;
+static struct MenuItem menu_item_sum;
+static struct MenuItem menu_item_product;
+static struct MenuItem menu_item_mc_uniform;
+static struct MenuItem menu_item_mc_normal;
+static struct MenuItem menu_item_poly_coef;
+static struct MenuItem menu_item_poly_eval;
+static struct MenuItem menu_item_poly_roots;
+static struct MenuItem menu_item_poly_clear;
+static struct MenuItem menu_item_stat_x;
+static struct MenuItem menu_item_stat_n;
+static struct MenuItem menu_item_stat_mean;
+static struct MenuItem menu_item_stat_sdev;
+static struct MenuItem menu_item_stat_min;
+static struct MenuItem menu_item_stat_max;
+static struct MenuItem menu_item_stat_slope;
+static struct MenuItem menu_item_stat_intercept;
+static struct MenuItem menu_item_stat_corr;
+static struct MenuItem menu_item_stat_import;
+static struct MenuItem menu_item_stat_clear;
+static struct MenuItem menu_item_sheet_cell;
+static struct MenuItem menu_item_sheet_ref;
+static struct MenuItem menu_item_sheet_define;
+static struct MenuItem menu_item_sheet_clear;
+static struct MenuItem menu_item_var_sto;
+static struct MenuItem menu_item_var_rcl;
+static struct MenuItem menu_item_var_define;
+static struct MenuItem menu_item_var_apply;
+static struct MenuItem menu_item_var_clear;
+static struct MenuItem menu_item_macro_record;
+static struct MenuItem menu_item_macro_1;
+static struct MenuItem menu_item_macro_2;
+static struct MenuItem menu_item_macro_3;
+static struct MenuItem menu_item_macro_4;
+static struct MenuItem menu_item_macro_save;
+static struct MenuItem menu_item_macro_load;
 static struct IntuiText menu_text_pi;
 static struct IntuiText menu_text_e;
 static struct IntuiText menu_text_rad;
 static struct IntuiText menu_text_deg;
 static struct IntuiText menu_text_expr;
+static struct IntuiText menu_text_decimal;
+static struct IntuiText menu_text_new_window;
+static struct IntuiText menu_text_history;
+static struct IntuiText menu_text_search;
+static struct IntuiText menu_text_arith_real;
+static struct IntuiText menu_text_arith_dd;
+static struct IntuiText menu_text_arith_frac;
+static struct IntuiText menu_text_arith_cplx;
+static struct IntuiText menu_text_solve;
+static struct IntuiText menu_text_int_from;
+static struct IntuiText menu_text_int_to;
+static struct IntuiText menu_text_int_to_inf;
+static struct IntuiText menu_text_integrate;
+static struct IntuiText menu_text_sum;
+static struct IntuiText menu_text_product;
+static struct IntuiText menu_text_mc_uniform;
+static struct IntuiText menu_text_mc_normal;
+static struct IntuiText menu_text_poly_coef;
+static struct IntuiText menu_text_poly_eval;
+static struct IntuiText menu_text_poly_roots;
+static struct IntuiText menu_text_poly_clear;
+static struct IntuiText menu_text_stat_x;
+static struct IntuiText menu_text_stat_n;
+static struct IntuiText menu_text_stat_mean;
+static struct IntuiText menu_text_stat_sdev;
+static struct IntuiText menu_text_stat_min;
+static struct IntuiText menu_text_stat_max;
+static struct IntuiText menu_text_stat_slope;
+static struct IntuiText menu_text_stat_intercept;
+static struct IntuiText menu_text_stat_corr;
+static struct IntuiText menu_text_stat_import;
+static struct IntuiText menu_text_stat_clear;
+static struct IntuiText menu_text_sheet_cell;
+static struct IntuiText menu_text_sheet_ref;
+static struct IntuiText menu_text_sheet_define;
+static struct IntuiText menu_text_sheet_clear;
+static struct IntuiText menu_text_var_sto;
+static struct IntuiText menu_text_var_rcl;
+static struct IntuiText menu_text_var_define;
+static struct IntuiText menu_text_var_apply;
+static struct IntuiText menu_text_var_clear;
+static struct IntuiText menu_text_macro_record;
+static struct IntuiText menu_text_macro_1;
+static struct IntuiText menu_text_macro_2;
+static struct IntuiText menu_text_macro_3;
+static struct IntuiText menu_text_macro_4;
+static struct IntuiText menu_text_macro_save;
+static struct IntuiText menu_text_macro_load;
+
+/*
+ * Operand as seen by compute_num. Only the member selected by kind is
+ * valid: integer chains stay in ival and never touch the soft-float
+ * library, NUM_DD values carry the full double-double in dd and NUM_RAT
+ * values the exact fraction in rat and NUM_CPLX values real + i imag. A
+ * nonzero long_id marks a value whose exact digits are in long_digits.
+ */
+struct CalcNum {
+    int kind;
+    calc_int ival;
+    calc_real real;
+    calc_real imag;
+    struct DDReal dd;
+    struct Ratio rat;
+    long long_id;
+};
+
+/*
+ * Digits of the last exact integer too long for the entry (n!, nCr, nPr).
+ * Only the value tagged with the current long_serial may show them.
+ */
+static char *long_digits = NULL;
+
+/* Polynomial coefficients, leading first, and the roots last found. */
+static calc_real poly_coef[POLY_MAX_DEGREE + 1];
+static int poly_len = 0;
+static struct PolyRoot poly_root_list[POLY_MAX_DEGREE];
+static int poly_root_count = 0;
+
+/* Statistics registers, and the x given with Dato x for the next point. */
+static struct Stats stat_data;
+static calc_real stat_x;
+static int stat_x_set = 0;
+
+/* Generator of the Rnd key, and a jumped copy for the Monte Carlo runs. */
+static struct Rng rng_key;
+static struct Rng rng_mc;
+
+/*
+ * Resolver, Integrar, the series, Monte Carlo and large n!, nPr and nCr,
+ * while job_busy on the compute task. job_key is the key that posted an
+ * n!, nPr or nCr job, pressed again with job_combi_ready once it is back.
+ */
+static struct Job job;
+static int job_busy = 0;
+static struct CalcState *job_owner = NULL;
+static char job_key;
+static int job_combi_ready = 0;
+
+/* Set by Vista -> Nueva ventana; the main loop opens the window. */
+static int window_wanted = 0;
+
+/* Worksheet cell last picked with Hoja -> Celda, which Definir writes. */
+static int sheet_cur = -1;
+static long long_len = 0;
+static long long_serial = 0;
 
 struct CalcState {
     char entry[MAX_ENTRY + 1];
     int entry_len;
-    double accum;
+    int accum_kind;
+    calc_real accum;
+    calc_real accum_im;
+    calc_int accum_int;
+    struct DDReal accum_dd;
+    struct Ratio accum_rat;
+    long accum_long_id;
     int accum_set;
     char op;
     int error;
     int just_result;
     int inv;
     int angle_mode;
+    int arith_mode;
     int paren_depth;
-    double paren_accum[MAX_PAREN_DEPTH];
+    int paren_accum_kind[MAX_PAREN_DEPTH];
+    calc_real paren_accum[MAX_PAREN_DEPTH];
+    calc_real paren_accum_im[MAX_PAREN_DEPTH];
+    calc_int paren_accum_int[MAX_PAREN_DEPTH];
+    struct DDReal paren_accum_dd[MAX_PAREN_DEPTH];
+    struct Ratio paren_accum_rat[MAX_PAREN_DEPTH];
     int paren_accum_set[MAX_PAREN_DEPTH];
     char paren_op[MAX_PAREN_DEPTH];
     char expr[MAX_EXPR + 1];
     int expr_len;
     int expr_entry_start;
     int show_expr;
+    int show_decimal;
+    struct CalcNum entry_num;
+    char entry_num_text[MAX_ENTRY + 1];
+    int entry_num_valid;
+    long long_pos;
+    calc_real var_x;
+    calc_real int_from;
+    calc_real int_to;
+    int int_to_inf;
+    int root_pos;
+    int cell_pos;
+    long hist_pos;
+    char hist_query[HIST_QUERY + 1];
+    int name_mode;
+    char name[HIST_QUERY + 1];
+    int name_len;
+    calc_real preview_re;
+    calc_real preview_im;
+    char preview_text[32];
+    char status[24];
 };
 
 static void clear_state(struct CalcState *state)
 {
     state->entry[0] = '\0';
     state->entry_len = 0;
-    state->accum = 0.0;
+    state->accum_kind = NUM_INT;
+    state->accum = REAL_C(0.0);
+    state->accum_im = REAL_C(0.0);
+    state->accum_int = 0;
     state->accum_set = 0;
     state->op = 0;
     state->error = 0;
@@ -138,6 +525,431 @@ static void clear_state(struct CalcState *state)
     state->expr[0] = '\0';
     state->expr_len = 0;
     state->expr_entry_start = -1;
+    state->entry_num_valid = 0;
+    state->accum_long_id = 0;
+    state->long_pos = -1;
+    state->status[0] = '\0';
+    state->root_pos = -1;
+    state->cell_pos = -1;
+    state->hist_pos = -1;
+    state->hist_query[0] = '\0';
+    state->name_mode = NAME_NONE;
+    state->preview_text[0] = '\0';
+}
+
+static void format_int(calc_int value, char *out)
+{
+    char digits[24];
+    calc_uint mag;
+    int len = 0;
+
+    if (value < 0) {
+        *out++ = '-';
+        mag = (calc_uint)0 - (calc_uint)value;
+    } else {
+        mag = (calc_uint)value;
+    }
+    do {
+        digits[len++] = (char)('0' + (int)(mag % 10));
+        mag /= 10;
+    } while (mag != 0);
+    while (len > 0) {
+        *out++ = digits[--len];
+    }
+    *out = '\0';
+}
+
+static int parse_int_entry(const char *entry, calc_int *out)
+{
+    calc_int value = 0;
+    int neg = 0;
+    int digits = 0;
+
+    if (*entry == '-') {
+        neg = 1;
+        ++entry;
+    }
+    if (*entry == '\0') {
+        return 0;
+    }
+    while (*entry == '0') {
+        ++entry;
+    }
+    while (*entry >= '0' && *entry <= '9') {
+        if (++digits > CALC_INT_DIGITS) {
+            return 0;
+        }
+        value = value * 10 + (*entry - '0');
+        ++entry;
+    }
+    if (*entry != '\0') {
+        return 0;
+    }
+    *out = neg ? -value : value;
+    return 1;
+}
+
+/*
+ * Double-double results are written with as many of their 31 digits as
+ * the display can show, so the entry string never loses visible digits.
+ */
+static void format_dd(struct DDReal value, char *out)
+{
+    int digits;
+
+    for (digits = DD_DIGITS; digits > CALC_REAL_DIGITS; --digits) {
+        dd_format(value, digits, out);
+        if ((int)strlen(out) <= DISP_CHARS) {
+            return;
+        }
+    }
+    dd_format(value, digits, out);
+}
+
+/*
+ * long_digits as they are when they fit the display, otherwise in
+ * scientific form with as many mantissa digits as fit, rounded half up.
+ */
+static void format_long(char *out)
+{
+    char exp_buf[24];
+    int mant;
+    int exp_len;
+    int carry;
+    int i;
+
+    if (long_len <= DISP_CHARS) {
+        strcpy(out, long_digits);
+        return;
+    }
+    sprintf(exp_buf, "e+%ld", long_len - 1);
+    exp_len = (int)strlen(exp_buf);
+    mant = DISP_CHARS - 1 - exp_len;
+    if (mant > DD_DIGITS) {
+        mant = DD_DIGITS;
+    }
+    if ((long)mant > long_len) {
+        mant = (int)long_len;
+    }
+    carry = (long_len > mant && long_digits[mant] >= '5');
+    for (i = mant - 1; i >= 0; --i) {
+        int digit = long_digits[i] - '0' + carry;
+
+        carry = (digit > 9);
+        out[i + (i > 0)] = (char)('0' + (carry ? 0 : digit));
+    }
+    if (carry) {
+        /* 9.99... rounded up: one more decade. */
+        out[0] = '1';
+        sprintf(exp_buf, "e+%ld", long_len);
+    }
+    out[1] = '.';
+    strcpy(out + mant + 1, exp_buf);
+}
+
+/* The modes whose inexact results are double-doubles. */
+static int mode_uses_dd(int mode)
+{
+    return mode == ARITH_DD || mode == ARITH_FRAC;
+}
+
+/*
+ * Exact integer results come back from combi as limbs (freed here). The
+ * ones beyond calc_int keep their digits in long_digits and enter the
+ * calculation as the mode's nearest kind: a fraction in ARITH_FRAC when
+ * it fits, otherwise the digits rounded to a double or double-double.
+ */
+static int num_from_limbs(int mode, bn_limb *limbs, long len, struct CalcNum *out)
+{
+    unsigned long long value;
+    char *digits;
+
+    out->long_id = 0;
+    if (bn_to_uint(limbs, len, &value) && value <= (calc_uint)CALC_INT_MAX) {
+        free(limbs);
+        out->ival = (calc_int)value;
+        out->kind = NUM_INT;
+        return 1;
+    }
+    digits = (char *)malloc((size_t)len * BN_DIGITS + 1);
+    if (!digits) {
+        free(limbs);
+        return 0;
+    }
+    long_len = bn_to_string(digits, limbs, len);
+    free(limbs);
+    free(long_digits);
+    long_digits = digits;
+    out->long_id = ++long_serial;
+    if (mode == ARITH_FRAC && len <= RAT_LIMBS && ratio_from_string(digits, &out->rat)) {
+        out->kind = NUM_RAT;
+        return 1;
+    }
+    if (!mode_uses_dd(mode)) {
+        out->real = (calc_real)strtod(digits, NULL);
+        out->kind = NUM_REAL;
+    } else {
+        dd_from_string(digits, &out->dd);
+        out->kind = NUM_DD;
+    }
+    return 1;
+}
+
+/* The worksheet cell named by an entry "#12" or "-#12", or -1. */
+static int entry_cell(const char *entry)
+{
+    if (entry[0] == '-') {
+        ++entry;
+    }
+    if (entry[0] != '#' || entry[1] < '0' || entry[1] > '9') {
+        return -1;
+    }
+    return atoi(entry + 1);
+}
+
+/* The named variable of an entry "@RATE" or "-@RATE", or -1. */
+static int entry_symbol(const char *entry)
+{
+    if (entry[0] == '-') {
+        ++entry;
+    }
+    return (entry[0] == '@') ? sym_find(entry + 1) : -1;
+}
+
+/*
+ * The entry "x", "n", a cell "#12", a name "@RATE" or their negations
+ * stand for a variable instead of digits.
+ */
+static int entry_is_var(const char *entry)
+{
+    if (entry_cell(entry) >= 0 || entry_symbol(entry) >= 0) {
+        return 1;
+    }
+    if (entry[0] == '-') {
+        ++entry;
+    }
+    return (entry[0] == 'x' || entry[0] == 'n') && entry[1] == '\0';
+}
+
+/*
+ * A complex entry: "4i", "-i" or "2e-3i" as typed, "(re+imi)" or "imi" as
+ * written by format_cplx. The imaginary part starts at the last sign that
+ * is neither the first character nor an exponent's; a bare sign is +-1.
+ */
+static void parse_cplx_entry(const char *entry, struct Cplx *out)
+{
+    char buf[MAX_ENTRY + 1];
+    char *split = buf;
+    char *p;
+    int len;
+
+    if (*entry == '(') {
+        ++entry;
+    }
+    strcpy(buf, entry);
+    len = (int)strlen(buf);
+    if (len > 0 && buf[len - 1] == ')') {
+        buf[--len] = '\0';
+    }
+    if (len > 0 && buf[len - 1] == 'i') {
+        buf[--len] = '\0';
+    }
+    for (p = buf + 1; p < buf + len; ++p) {
+        if ((*p == '+' || *p == '-') && p[-1] != 'e' && p[-1] != 'E') {
+            split = p;
+        }
+    }
+    out->re = (split == buf) ? REAL_C(0.0) : (calc_real)strtod(buf, NULL);
+    if (split[0] == '\0' || ((split[0] == '+' || split[0] == '-') && split[1] == '\0')) {
+        out->im = (split[0] == '-') ? REAL_C(-1.0) : REAL_C(1.0);
+    } else {
+        out->im = (calc_real)strtod(split, NULL);
+    }
+}
+
+/* A zero imaginary part leaves an ordinary real. */
+static void num_set_cplx(struct CalcNum *num, const struct Cplx *z)
+{
+    num->real = z->re;
+    num->imag = z->im;
+    num->kind = (z->im == REAL_C(0.0)) ? NUM_REAL : NUM_CPLX;
+}
+
+/*
+ * A result whose text is not exact (a fraction shown as a decimal, a
+ * double-double cut to the display width) is read back from entry_num
+ * for as long as the entry still holds that text.
+ */
+static void num_from_entry(const struct CalcState *state, struct CalcNum *num)
+{
+    num->long_id = 0;
+    if (state->entry_num_valid && state->just_result &&
+        strcmp(state->entry, state->entry_num_text) == 0) {
+        *num = state->entry_num;
+    } else if (entry_is_var(state->entry)) {
+        /* n shows the first term of a series; an error cell reads as 0. */
+        calc_real value = strchr(state->entry, 'x') ? state->var_x : state->int_from;
+
+        if (entry_cell(state->entry) >= 0 && !sheet_get(entry_cell(state->entry), &value)) {
+            value = REAL_C(0.0);
+        }
+        if (entry_symbol(state->entry) >= 0 && !sym_value(entry_symbol(state->entry), &value)) {
+            value = REAL_C(0.0);
+        }
+
+        num->real = (state->entry[0] == '-') ? -value : value;
+        num->kind = NUM_REAL;
+    } else if (strchr(state->entry, 'i')) {
+        /* Outside the complex mode only the real part counts. */
+        struct Cplx z;
+
+        parse_cplx_entry(state->entry, &z);
+        if (state->arith_mode != ARITH_CPLX) {
+            z.im = REAL_C(0.0);
+        }
+        num_set_cplx(num, &z);
+    } else if (parse_int_entry(state->entry, &num->ival)) {
+        num->kind = NUM_INT;
+    } else if (state->arith_mode == ARITH_FRAC && ratio_from_string(state->entry, &num->rat)) {
+        num->kind = NUM_RAT;
+    } else if (mode_uses_dd(state->arith_mode)) {
+        dd_from_string(state->entry, &num->dd);
+        num->kind = NUM_DD;
+    } else {
+        num->real = (calc_real)strtod(state->entry, NULL);
+        num->kind = NUM_REAL;
+    }
+}
+
+static void num_from_accum(const struct CalcState *state, struct CalcNum *num)
+{
+    num->kind = state->accum_kind;
+    num->ival = state->accum_int;
+    num->real = state->accum;
+    num->imag = state->accum_im;
+    num->dd = state->accum_dd;
+    num->rat = state->accum_rat;
+    num->long_id = state->accum_long_id;
+}
+
+static calc_real num_real(const struct CalcNum *num)
+{
+    if (num->kind == NUM_INT) {
+        return (calc_real)num->ival;
+    }
+    if (num->kind == NUM_DD) {
+        return (calc_real)num->dd.hi;
+    }
+    if (num->kind == NUM_RAT) {
+        return (calc_real)ratio_to_dd(&num->rat).hi;
+    }
+    return num->real;
+}
+
+static void num_cplx(const struct CalcNum *num, struct Cplx *out)
+{
+    out->re = num_real(num);
+    out->im = (num->kind == NUM_CPLX) ? num->imag : REAL_C(0.0);
+}
+
+static struct DDReal num_dd(const struct CalcNum *num)
+{
+    if (num->kind == NUM_INT) {
+        return dd_from_int(num->ival);
+    }
+    if (num->kind == NUM_DD) {
+        return num->dd;
+    }
+    if (num->kind == NUM_RAT) {
+        return ratio_to_dd(&num->rat);
+    }
+    return dd_from_double((double)num->real);
+}
+
+static int num_rat(const struct CalcNum *num, struct Ratio *out)
+{
+    if (num->kind == NUM_INT) {
+        ratio_from_int(out, num->ival);
+        return 1;
+    }
+    if (num->kind == NUM_RAT) {
+        *out = num->rat;
+        return 1;
+    }
+    return 0;
+}
+
+static void num_set_rat(struct CalcNum *num, const struct Ratio *rat)
+{
+    if (ratio_to_int(rat, &num->ival)) {
+        num->kind = NUM_INT;
+    } else {
+        num->rat = *rat;
+        num->kind = NUM_RAT;
+    }
+}
+
+/* "(re+imi)", or "imi" without a real part, in as many digits as fit the display. */
+static void format_cplx(calc_real re, calc_real im, char *out)
+{
+    int digits;
+
+    for (digits = CALC_REAL_DIGITS; digits > 3; --digits) {
+        if (re == REAL_C(0.0)) {
+            sprintf(out, "%.*gi", digits, (double)im);
+        } else {
+            sprintf(out, "(%.*g%+.*gi)", digits, (double)re, digits, (double)im);
+        }
+        if ((int)strlen(out) <= DISP_CHARS) {
+            return;
+        }
+    }
+}
+
+static void format_num(const struct CalcState *state, const struct CalcNum *num, char *out)
+{
+    if (num->long_id != 0 && num->long_id == long_serial) {
+        format_long(out);
+    } else if (num->kind == NUM_INT) {
+        format_int(num->ival, out);
+    } else if (num->kind == NUM_DD) {
+        format_dd(num->dd, out);
+    } else if (num->kind == NUM_RAT) {
+        struct Ratio rat = num->rat;
+
+        if (state->show_decimal || !ratio_format(&rat, out, DISP_CHARS)) {
+            format_dd(ratio_to_dd(&rat), out);
+        }
+    } else if (num->kind == NUM_CPLX) {
+        format_cplx(num->real, num->imag, out);
+    } else {
+        sprintf(out, CALC_REAL_FMT, num->real);
+    }
+}
+
+static void set_accum(struct CalcState *state, const struct CalcNum *num)
+{
+    state->accum_kind = num->kind;
+    state->accum_long_id = num->long_id;
+    if (num->kind == NUM_INT) {
+        state->accum_int = num->ival;
+    } else if (num->kind == NUM_DD) {
+        state->accum_dd = num->dd;
+    } else if (num->kind == NUM_RAT) {
+        state->accum_rat = num->rat;
+    } else if (num->kind == NUM_CPLX) {
+        state->accum = num->real;
+        state->accum_im = num->imag;
+    } else {
+        state->accum = num->real;
+    }
+}
+
+static void set_accum_zero(struct CalcState *state)
+{
+    state->accum_int = 0;
+    state->accum_kind = NUM_INT;
+    state->accum_long_id = 0;
 }
 
 static void expr_reset(struct CalcState *state)
@@ -234,7 +1046,8 @@ static void expr_update_entry(struct CalcState *state)
 
 static int expr_is_operator(char ch)
 {
-    return ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '^' || ch == 'r';
+    return ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '^' || ch == 'r' ||
+           ch == 'C' || ch == 'P';
 }
 
 static int expr_find_last_value_span(const struct CalcState *state, int *start, int *end)
@@ -281,7 +1094,8 @@ static int expr_find_last_value_span(const struct CalcState *state, int *start,
     i = state->expr_len - 1;
     while (i >= 0) {
         char c = state->expr[i];
-        if (c == '+' || c == '*' || c == '/' || c == '^' || c == 'r' || c == '(' || c == ')') {
+        if (c == '+' || c == '*' || c == '/' || c == '^' || c == 'r' || c == '(' || c == ')' ||
+            c == 'C' || c == 'P') {
             break;
         }
         if (c == '-') {
@@ -296,6 +1110,7 @@ static int expr_find_last_value_span(const struct CalcState *state, int *start,
             if (state->expr[i - 1] == '+' || state->expr[i - 1] == '-' ||
                 state->expr[i - 1] == '*' || state->expr[i - 1] == '/' ||
                 state->expr[i - 1] == '^' || state->expr[i - 1] == 'r' ||
+                state->expr[i - 1] == 'C' || state->expr[i - 1] == 'P' ||
                 state->expr[i - 1] == '(') {
                 i--;
             }
@@ -415,18 +1230,27 @@ static void expr_add_paren_close(struct CalcState *state)
     state->expr_entry_start = -1;
 }
 
-static void expr_apply_unary(struct CalcState *state, char action)
+/* Wraps the value a unary function applies to in prefix and suffix. */
+static void expr_apply_prefix(struct CalcState *state, const char *prefix, const char *suffix)
 {
-    const char *prefix = NULL;
-    const char *suffix = NULL;
     char value_buf[64];
 
     if (state->entry_len > 0 && (state->expr_entry_start >= 0 || state->expr_len == 0)) {
         expr_update_entry(state);
     } else if (state->expr_len == 0 && state->accum_set) {
-        sprintf(value_buf, "%.15g", state->accum);
+        struct CalcNum accum;
+
+        num_from_accum(state, &accum);
+        format_num(state, &accum, value_buf);
         expr_set(state, value_buf);
     }
+    expr_wrap_last_value(state, prefix, suffix);
+}
+
+static void expr_apply_unary(struct CalcState *state, char action)
+{
+    const char *prefix = NULL;
+    const char *suffix = NULL;
 
     switch (action) {
         case 'N':
@@ -462,8 +1286,8 @@ static void expr_apply_unary(struct CalcState *state, char action)
             suffix = "%";
             break;
         case 'F':
-            prefix = "";
-            suffix = "!";
+            prefix = state->inv ? "ln(" : "";
+            suffix = state->inv ? "!)" : "!";
             break;
         default:
             break;
@@ -472,599 +1296,2308 @@ static void expr_apply_unary(struct CalcState *state, char action)
     if (!prefix || !suffix) {
         return;
     }
-    expr_wrap_last_value(state, prefix, suffix);
+    expr_apply_prefix(state, prefix, suffix);
 }
-static int compute_op(double lhs, char op, double rhs, double *out)
+static int compute_op(calc_real lhs, char op, calc_real rhs, calc_real *out)
 {
     switch (op) {
         case '+':
-            *out = lhs + rhs;
+            calc_math->add(out, lhs, rhs);
             return 1;
         case '-':
-            *out = lhs - rhs;
+            calc_math->sub(out, lhs, rhs);
             return 1;
         case '*':
-            *out = lhs * rhs;
+            calc_math->mul(out, lhs, rhs);
             return 1;
         case '/':
-            if (rhs == 0.0) {
+            if (rhs == REAL_C(0.0)) {
                 return 0;
             }
-            *out = lhs / rhs;
+            calc_math->div(out, lhs, rhs);
             return 1;
         case '^':
-            *out = pow(lhs, rhs);
-            if (*out != *out) {
-                return 0;
-            }
-            return 1;
+            return calc_pow(lhs, rhs, out);
         case 'r':
-            if (rhs == 0.0) {
-                return 0;
-            }
-            *out = pow(lhs, 1.0 / rhs);
-            if (*out != *out) {
-                return 0;
-            }
-            return 1;
+            return calc_root(lhs, rhs, out);
         default:
             break;
     }
     return 0;
 }
 
-static void handle_digit(struct CalcState *state, char digit)
+static int mul_int(calc_int lhs, calc_int rhs, calc_int *out)
 {
-    if (state->error) {
-        return;
+    calc_uint a;
+    calc_uint b;
+    calc_uint limit;
+
+    if (lhs >= -CALC_INT_SMALL && lhs <= CALC_INT_SMALL &&
+        rhs >= -CALC_INT_SMALL && rhs <= CALC_INT_SMALL) {
+        *out = lhs * rhs;
+        return 1;
     }
-    if (state->just_result) {
-        state->entry_len = 0;
-        state->entry[0] = '\0';
-        state->just_result = 0;
+    if (lhs == 0 || rhs == 0) {
+        *out = 0;
+        return 1;
     }
-    if (state->entry_len >= MAX_ENTRY) {
-        return;
+    a = (lhs < 0) ? (calc_uint)0 - (calc_uint)lhs : (calc_uint)lhs;
+    b = (rhs < 0) ? (calc_uint)0 - (calc_uint)rhs : (calc_uint)rhs;
+    limit = (calc_uint)CALC_INT_MAX;
+    if ((lhs < 0) != (rhs < 0)) {
+        limit++;
     }
-    state->entry[state->entry_len++] = digit;
-    state->entry[state->entry_len] = '\0';
-}
-
-static void insert_constant(struct CalcState *state, double value)
-{
-    if (state->error) {
-        return;
+    if (a > limit / b) {
+        return 0;
     }
-    sprintf(state->entry, "%.15g", value);
-    state->entry_len = (int)strlen(state->entry);
-    state->just_result = 0;
-}
-
-static double deg_to_rad(double value)
-{
-    return value * (CONST_PI / 180.0);
+    a *= b;
+    *out = ((lhs < 0) != (rhs < 0)) ? (calc_int)((calc_uint)0 - a) : (calc_int)a;
+    return 1;
 }
 
-static double rad_to_deg(double value)
+static int pow_int(calc_int base, calc_int exp, calc_int *out)
 {
-    return value * (180.0 / CONST_PI);
-}
+    calc_int result = 1;
 
-static int get_current_value(struct CalcState *state, double *out, int *from_accum)
-{
-    if (state->entry_len > 0) {
-        *out = strtod(state->entry, NULL);
-        *from_accum = 0;
-        return 1;
+    if (exp < 0) {
+        if (base == 1 || base == -1) {
+            *out = (base == -1 && (exp & 1)) ? -1 : 1;
+            return 1;
+        }
+        return 0;
     }
-    if (state->accum_set && state->op == 0) {
-        *out = state->accum;
-        *from_accum = 1;
-        return 1;
+    while (exp > 0) {
+        if (exp & 1) {
+            if (!mul_int(result, base, &result)) {
+                return 0;
+            }
+        }
+        exp >>= 1;
+        if (exp > 0 && !mul_int(base, base, &base)) {
+            return 0;
+        }
     }
-    return 0;
-}
-
-static void set_result(struct CalcState *state, double value)
-{
-    sprintf(state->entry, "%.15g", value);
-    state->entry_len = (int)strlen(state->entry);
-    state->just_result = 1;
+    *out = result;
+    return 1;
 }
 
-static void handle_unary(struct CalcState *state, char action)
+/*
+ * The n-th root of value when it is a perfect n-th power. Integer Newton
+ * from just above the floating point estimate converges down to the
+ * floor of the root in a step or two even for a float estimate.
+ */
+static int int_root(calc_int value, calc_int n, calc_int *out)
 {
-    double value;
-    double result;
-    double angle;
-    int from_accum = 0;
+    calc_real est;
+    calc_int x;
+    calc_int y;
+    calc_int p;
+    int neg = 0;
 
-    if (state->error) {
-        return;
+    if (n < 1 || value == CALC_INT_MIN) {
+        return 0;
     }
-    if (!get_current_value(state, &value, &from_accum)) {
-        return;
+    if (n == 1 || value == 0 || value == 1) {
+        *out = value;
+        return 1;
     }
-
-    switch (action) {
-        case 'L':
-            if (state->inv) {
-                result = exp(value);
-            } else {
-                if (value <= 0.0) {
-                    state->error = 1;
-                    return;
-                }
-                result = log(value);
-            }
+    if (value < 0) {
+        if ((n & 1) == 0) {
+            return 0;
+        }
+        value = -value;
+        neg = 1;
+    }
+    if (n > 62) {
+        return 0;
+    }
+    calc_math->pow_f(&est, (calc_real)value, REAL_C(1.0) / (calc_real)n);
+    x = (calc_int)(est * REAL_C(1.000001)) + 1;
+    for (;;) {
+        if (!pow_int(x, n - 1, &p)) {
+            return 0;
+        }
+        y = ((n - 1) * x + value / p) / n;
+        if (y >= x) {
             break;
-        case 'G':
-            if (state->inv) {
-                result = pow(10.0, value);
+        }
+        x = y;
+    }
+    if (!pow_int(x, n, &p) || p != value) {
+        return 0;
+    }
+    *out = neg ? -x : x;
+    return 1;
+}
+
+/*
+ * Exact integer counterpart of compute_op. Returns 0 whenever the result
+ * is not a representable integer (overflow, fraction, division by zero)
+ * so the caller can redo the operation in floating point and report errors there.
+ */
+static int compute_op_int(calc_int lhs, char op, calc_int rhs, calc_int *out)
+{
+    switch (op) {
+        case '+':
+            if ((rhs > 0 && lhs > CALC_INT_MAX - rhs) ||
+                (rhs < 0 && lhs < CALC_INT_MIN - rhs)) {
+                return 0;
+            }
+            *out = lhs + rhs;
+            return 1;
+        case '-':
+            if ((rhs < 0 && lhs > CALC_INT_MAX + rhs) ||
+                (rhs > 0 && lhs < CALC_INT_MIN + rhs)) {
+                return 0;
+            }
+            *out = lhs - rhs;
+            return 1;
+        case '*':
+            return mul_int(lhs, rhs, out);
+        case '/':
+            if (rhs == 0 || (lhs == CALC_INT_MIN && rhs == -1)) {
+                return 0;
+            }
+            if (lhs % rhs != 0) {
+                return 0;
+            }
+            *out = lhs / rhs;
+            return 1;
+        case '^':
+            return pow_int(lhs, rhs, out);
+        case 'r':
+            return int_root(lhs, rhs, out);
+        default:
+            break;
+    }
+    return 0;
+}
+
+/* n when value is 1/n for an integer |n| >= 2, up to double-double rounding. */
+static int dd_unit_fraction(struct DDReal value, long *n)
+{
+    struct DDReal q;
+    double k;
+
+    if (value.hi == 0.0) {
+        return 0;
+    }
+    q = dd_div(dd_from_double(1.0), value);
+    k = floor(q.hi + 0.5);
+    if (fabs(k) < 2.0 || fabs(k) > 2147483647.0 ||
+        fabs(dd_sub(q, dd_from_double(k)).hi) > fabs(k) * 1e-28) {
+        return 0;
+    }
+    *n = (long)k;
+    return 1;
+}
+
+static int compute_op_dd(struct DDReal lhs, char op, struct DDReal rhs, struct DDReal *out)
+{
+    long n;
+
+    switch (op) {
+        case '+':
+            *out = dd_add(lhs, rhs);
+            break;
+        case '-':
+            *out = dd_sub(lhs, rhs);
+            break;
+        case '*':
+            *out = dd_mul(lhs, rhs);
+            break;
+        case '/':
+            if (rhs.hi == 0.0) {
+                return 0;
+            }
+            *out = dd_div(lhs, rhs);
+            break;
+        case '^':
+            if (!dd_is_integer(rhs) && dd_unit_fraction(rhs, &n)) {
+                *out = dd_root(lhs, n);
             } else {
-                if (value <= 0.0) {
-                    state->error = 1;
-                    return;
+                *out = dd_pow(lhs, rhs);
+            }
+            break;
+        case 'r':
+            if (rhs.hi == 0.0) {
+                return 0;
+            }
+            if (dd_is_integer(rhs) && fabs(rhs.hi) < 2147483647.0) {
+                *out = dd_root(lhs, (long)rhs.hi);
+            } else {
+                *out = dd_pow(lhs, dd_div(dd_from_double(1.0), rhs));
+            }
+            break;
+        default:
+            return 0;
+    }
+    return !dd_isnan(*out);
+}
+
+/* The n-th root of a fraction whose reduced terms are both perfect n-th powers. */
+static int rat_root(const struct Ratio *value, calc_int n, struct Ratio *out)
+{
+    struct Ratio v = *value;
+    struct Ratio d;
+    calc_int num;
+    calc_int den;
+
+    ratio_reduce(&v);
+    if (v.big || !int_root(v.num, n < 0 ? -n : n, &num) ||
+        !int_root(v.den, n < 0 ? -n : n, &den)) {
+        return 0;
+    }
+    if (n < 0) {
+        calc_int t = num;
+
+        num = den;
+        den = t;
+    }
+    ratio_from_int(out, num);
+    ratio_from_int(&d, den);
+    return ratio_div(out, &d, out);
+}
+
+/*
+ * Exact fraction counterpart of compute_op. Roots and fractional powers
+ * are rational only when the terms are perfect powers; otherwise, like a
+ * capacity overflow, they return 0 so compute_num falls back to
+ * double-double.
+ */
+static int compute_op_rat(const struct Ratio *lhs, char op, const struct Ratio *rhs,
+                          struct Ratio *out)
+{
+    struct Ratio e;
+    calc_int exp;
+
+    switch (op) {
+        case '+':
+            return ratio_add(lhs, rhs, out);
+        case '-':
+            return ratio_sub(lhs, rhs, out);
+        case '*':
+            return ratio_mul(lhs, rhs, out);
+        case '/':
+            return ratio_div(lhs, rhs, out);
+        case '^':
+            if (!ratio_to_int(rhs, &exp)) {
+                /* p/q: the q-th root, then the p-th power. */
+                e = *rhs;
+                ratio_reduce(&e);
+                if (e.big || !rat_root(lhs, e.den, out)) {
+                    return 0;
                 }
-                result = log(value) / log(10.0);
+                lhs = out;
+                exp = e.num;
             }
+            if (exp < -0x7FFFFFFFL || exp > 0x7FFFFFFFL) {
+                return 0;
+            }
+            return ratio_pow_int(lhs, (long)exp, out);
+        case 'r':
+            return ratio_to_int(rhs, &exp) && rat_root(lhs, exp, out);
+        default:
             break;
-        case 'X':
+    }
+    return 0;
+}
+
+/* Non-negative integer value of num, whatever its kind, up to COMBI_MAX_N. */
+static int num_count(const struct CalcNum *num, unsigned long *out)
+{
+    calc_real real;
+
+    if (num->kind == NUM_CPLX) {
+        return 0;
+    }
+    if (num->kind == NUM_INT) {
+        if (num->ival < 0 || num->ival > (calc_int)COMBI_MAX_N) {
+            return 0;
+        }
+        *out = (unsigned long)num->ival;
+        return 1;
+    }
+    if (num->kind == NUM_RAT || num->kind == NUM_DD) {
+        struct DDReal dd = num_dd(num);
+
+        if (!dd_is_integer(dd) || dd.hi < 0.0 || dd.hi > (double)COMBI_MAX_N) {
+            return 0;
+        }
+        *out = (unsigned long)dd.hi;
+        return 1;
+    }
+    real = num->real;
+    if (real < REAL_C(0.0) || real > (calc_real)COMBI_MAX_N || real != (calc_real)(long)real) {
+        return 0;
+    }
+    *out = (unsigned long)real;
+    return 1;
+}
+
+/* n P r or n C r: the digits the compute task has just made, or made here. */
+static long combi_limbs(char op, unsigned long n, unsigned long r, bn_limb **out)
+{
+    if (job_combi_ready && job.flag == op && (unsigned long)job.first == n &&
+        (unsigned long)job.last == r) {
+        *out = job.limbs;
+        job.limbs = NULL;
+        job_combi_ready = 0;
+        return job.len;
+    }
+    if (op == 'C') {
+        return combi_binomial(n, r, out, NULL);
+    }
+    return combi_permutations(n, r, out, NULL);
+}
+
+static int compute_combi(int mode, const struct CalcNum *lhs, char op,
+                         const struct CalcNum *rhs, struct CalcNum *out)
+{
+    bn_limb *limbs;
+    unsigned long n;
+    unsigned long r;
+    long len;
+
+    if (!num_count(lhs, &n) || !num_count(rhs, &r) || r > n) {
+        return 0;
+    }
+    len = combi_limbs(op, n, r, &limbs);
+    if (len < 0) {
+        return 0;
+    }
+    return num_from_limbs(mode, limbs, len, out);
+}
+
+/* The complex mode's arithmetic, for operands of any kind. */
+static int compute_cplx(const struct CalcNum *lhs, char op, const struct CalcNum *rhs,
+                        struct CalcNum *out)
+{
+    struct Cplx a;
+    struct Cplx b;
+    struct Cplx r;
+    int ok = 1;
+
+    num_cplx(lhs, &a);
+    num_cplx(rhs, &b);
+    switch (op) {
+        case '+':
+            r.re = a.re + b.re;
+            r.im = a.im + b.im;
+            break;
+        case '-':
+            r.re = a.re - b.re;
+            r.im = a.im - b.im;
+            break;
+        case '*':
+            ok = cplx_mul(&a, &b, &r);
+            break;
+        case '/':
+            ok = cplx_div(&a, &b, &r);
+            break;
+        case '^':
+            ok = cplx_pow(&a, &b, &r);
+            break;
+        case 'r':
+            ok = cplx_root(&a, &b, &r);
+            break;
+        default:
+            ok = 0;
+            break;
+    }
+    if (!ok) {
+        return 0;
+    }
+    num_set_cplx(out, &r);
+    return 1;
+}
+
+static int compute_num(int mode, const struct CalcNum *lhs, char op,
+                       const struct CalcNum *rhs, struct CalcNum *out)
+{
+    calc_real real;
+    struct DDReal dd;
+    struct Ratio lrat;
+    struct Ratio rrat;
+
+    if (op == 'C' || op == 'P') {
+        return compute_combi(mode, lhs, op, rhs, out);
+    }
+    out->long_id = 0;
+    if (lhs->kind == NUM_INT && rhs->kind == NUM_INT &&
+        compute_op_int(lhs->ival, op, rhs->ival, &out->ival)) {
+        out->kind = NUM_INT;
+        return 1;
+    }
+    if (mode == ARITH_CPLX && (lhs->kind == NUM_CPLX || rhs->kind == NUM_CPLX)) {
+        return compute_cplx(lhs, op, rhs, out);
+    }
+    if (mode == ARITH_FRAC && num_rat(lhs, &lrat) && num_rat(rhs, &rrat) &&
+        compute_op_rat(&lrat, op, &rrat, &lrat)) {
+        num_set_rat(out, &lrat);
+        return 1;
+    }
+    if (mode_uses_dd(mode) || lhs->kind == NUM_DD || rhs->kind == NUM_DD ||
+        lhs->kind == NUM_RAT || rhs->kind == NUM_RAT) {
+        if (!compute_op_dd(num_dd(lhs), op, num_dd(rhs), &dd)) {
+            return 0;
+        }
+        out->dd = dd;
+        out->kind = NUM_DD;
+        return 1;
+    }
+    if (!compute_op(num_real(lhs), op, num_real(rhs), &real)) {
+        /* Even roots of negatives and their powers have complex values. */
+        return mode == ARITH_CPLX && compute_cplx(lhs, op, rhs, out);
+    }
+    out->real = real;
+    out->kind = NUM_REAL;
+    return 1;
+}
+
+static int entry_accepts_digit(const struct CalcState *state, char digit)
+{
+    const char *p;
+    int sig = 0;
+    int exp_digits = 0;
+    int in_exp = 0;
+    int frac = 0;
+
+    for (p = state->entry; *p != '\0'; ++p) {
+        if (*p == 'e' || *p == 'E') {
+            in_exp = 1;
+        } else if (*p == '.') {
+            frac = 1;
+        } else if (*p >= '0' && *p <= '9') {
+            if (in_exp) {
+                exp_digits++;
+            } else if (sig > 0 || *p != '0') {
+                sig++;
+            }
+        }
+    }
+    if (strchr(state->entry, 'i')) {
+        return 0;
+    }
+    if (mode_uses_dd(state->arith_mode)) {
+        return in_exp ? exp_digits < 3 : (sig < DD_DIGITS + 1 || (sig == 0 && digit == '0'));
+    }
+    if (in_exp) {
+        return exp_digits < CALC_REAL_EXP_DIGITS;
+    }
+    if (sig == 0 && digit == '0') {
+        return 1;
+    }
+    return sig < (frac ? CALC_REAL_SIG_DIGITS : CALC_INT_DIGITS);
+}
+
+static void handle_digit(struct CalcState *state, char digit)
+{
+    if (state->error) {
+        return;
+    }
+    if (state->just_result || entry_is_var(state->entry)) {
+        state->entry_len = 0;
+        state->entry[0] = '\0';
+        state->just_result = 0;
+    }
+    if (state->entry_len >= MAX_ENTRY || !entry_accepts_digit(state, digit)) {
+        return;
+    }
+    state->entry[state->entry_len++] = digit;
+    state->entry[state->entry_len] = '\0';
+}
+
+static void insert_constant(struct CalcState *state, calc_real value, struct DDReal dd)
+{
+    if (state->error) {
+        return;
+    }
+    if (mode_uses_dd(state->arith_mode)) {
+        format_dd(dd, state->entry);
+    } else {
+        sprintf(state->entry, CALC_REAL_FMT, value);
+    }
+    state->entry_len = (int)strlen(state->entry);
+    state->just_result = 0;
+}
+
+/* Rnd: uniform in [0, 1); Inv (Nrm): standard normal. */
+static void handle_random(struct CalcState *state, int normal)
+{
+    calc_real value;
+
+    if (state->error) {
+        return;
+    }
+    value = normal ? rng_normal(&rng_key) : rng_uniform(&rng_key);
+    if (state->just_result) {
+        expr_reset(state);
+    }
+    insert_constant(state, value, dd_from_double((double)value));
+    expr_update_entry(state);
+}
+
+static calc_real deg_to_rad(calc_real value)
+{
+    calc_real out;
+
+    calc_math->mul(&out, value, CONST_PI / REAL_C(180.0));
+    return out;
+}
+
+static calc_real rad_to_deg(calc_real value)
+{
+    calc_real out;
+
+    calc_math->mul(&out, value, REAL_C(180.0) / CONST_PI);
+    return out;
+}
+
+static int get_current_num(struct CalcState *state, struct CalcNum *out, int *from_accum)
+{
+    if (state->entry_len > 0) {
+        num_from_entry(state, out);
+        *from_accum = 0;
+        return 1;
+    }
+    if (state->accum_set && state->op == 0) {
+        num_from_accum(state, out);
+        *from_accum = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static void set_result(struct CalcState *state, calc_real value)
+{
+    sprintf(state->entry, CALC_REAL_FMT, value);
+    state->entry_len = (int)strlen(state->entry);
+    state->just_result = 1;
+    state->entry_num_valid = 0;
+}
+
+static void set_result_num(struct CalcState *state, const struct CalcNum *num)
+{
+    format_num(state, num, state->entry);
+    state->entry_len = (int)strlen(state->entry);
+    state->just_result = 1;
+    state->long_pos = -1;
+    state->entry_num_valid = (num->kind == NUM_RAT || num->kind == NUM_DD ||
+                              num->kind == NUM_CPLX || num->long_id != 0);
+    if (state->entry_num_valid) {
+        state->entry_num = *num;
+        strcpy(state->entry_num_text, state->entry);
+    }
+}
+
+static int unary_dd(const struct CalcState *state, char action, struct DDReal value,
+                    struct DDReal *out)
+{
+    struct DDReal deg = dd_div(dd_pi, dd_from_double(180.0));
+    int sign = dd_sign(value);
+
+    switch (action) {
+        case 'L':
             if (state->inv) {
-                if (value <= 0.0) {
-                    state->error = 1;
-                    return;
-                }
-                result = log(value);
+                *out = dd_exp(value);
             } else {
-                result = exp(value);
+                if (sign <= 0) {
+                    return 0;
+                }
+                *out = dd_log(value);
             }
             break;
-        case 'Q':
+        case 'G':
             if (state->inv) {
-                result = value * value;
+                *out = dd_pow(dd_from_double(10.0), value);
             } else {
-                if (value < 0.0) {
-                    state->error = 1;
-                    return;
+                if (sign <= 0) {
+                    return 0;
                 }
-                result = sqrt(value);
+                *out = dd_log10(value);
             }
             break;
-        case '%':
-            result = value / 100.0;
+        case 'X':
+            if (state->inv) {
+                if (sign <= 0) {
+                    return 0;
+                }
+                *out = dd_log(value);
+            } else {
+                *out = dd_exp(value);
+            }
+            break;
+        case 'Q':
+            if (state->inv) {
+                *out = dd_sqr(value);
+            } else {
+                if (sign < 0) {
+                    return 0;
+                }
+                *out = dd_sqrt(value);
+            }
+            break;
+        case '%':
+            *out = dd_div(value, dd_from_double(100.0));
+            break;
+        case 'F':
+            value = dd_add(value, dd_from_double(1.0));
+            *out = state->inv ? dd_lgamma(value) : dd_gamma(value);
+            break;
+        case 'N':
+        case 'O':
+        case 'T':
+            if (state->inv) {
+                if (action == 'T') {
+                    *out = dd_atan(value);
+                } else {
+                    if (value.hi < -1.0 || value.hi > 1.0) {
+                        return 0;
+                    }
+                    *out = (action == 'N') ? dd_asin(value) : dd_acos(value);
+                }
+                if (state->angle_mode == ANGLE_DEG) {
+                    *out = dd_div(*out, deg);
+                }
+            } else {
+                if (state->angle_mode == ANGLE_DEG) {
+                    value = dd_mul(value, deg);
+                }
+                if (action == 'N') {
+                    *out = dd_sin(value);
+                } else if (action == 'O') {
+                    *out = dd_cos(value);
+                } else {
+                    *out = dd_tan(value);
+                }
+            }
+            break;
+        default:
+            return 0;
+    }
+    return !dd_isnan(*out);
+}
+
+/* Real arguments outside the domain of the real function but not of the complex one. */
+static int needs_complex(const struct CalcState *state, char action, calc_real value)
+{
+    switch (action) {
+        case 'L':
+        case 'G':
+            return !state->inv && value < REAL_C(0.0);
+        case 'X':
+            return state->inv && value < REAL_C(0.0);
+        case 'Q':
+            return !state->inv && value < REAL_C(0.0);
+        case 'N':
+        case 'O':
+            return state->inv && (value < REAL_C(-1.0) || value > REAL_C(1.0));
+        default:
+            break;
+    }
+    return 0;
+}
+
+static int unary_cplx(const struct CalcState *state, char action, struct Cplx z,
+                      struct Cplx *out)
+{
+    calc_real scale = CONST_PI / REAL_C(180.0);
+    int ok;
+
+    switch (action) {
+        case 'L':
+            return state->inv ? cplx_exp(&z, out) : cplx_log(&z, out);
+        case 'G':
+            return state->inv ? cplx_exp10(&z, out) : cplx_log10(&z, out);
+        case 'X':
+            return state->inv ? cplx_log(&z, out) : cplx_exp(&z, out);
+        case 'Q':
+            return state->inv ? cplx_mul(&z, &z, out) : cplx_sqrt(&z, out);
+        case '%':
+            out->re = z.re / REAL_C(100.0);
+            out->im = z.im / REAL_C(100.0);
+            return 1;
+        case 'F':
+            z.re += REAL_C(1.0);
+            if (!calc_cgamma(&z, out)) {
+                return 0;
+            }
+            if (state->inv) {
+                z = *out;
+                return cplx_log(&z, out);
+            }
+            return 1;
+        case 'N':
+        case 'O':
+        case 'T':
+            if (state->inv) {
+                if (action == 'N') {
+                    ok = cplx_asin(&z, out);
+                } else if (action == 'O') {
+                    ok = cplx_acos(&z, out);
+                } else {
+                    ok = cplx_atan(&z, out);
+                }
+                if (ok && state->angle_mode == ANGLE_DEG) {
+                    out->re /= scale;
+                    out->im /= scale;
+                }
+                return ok;
+            }
+            if (state->angle_mode == ANGLE_DEG) {
+                z.re *= scale;
+                z.im *= scale;
+            }
+            if (action == 'N') {
+                return cplx_sin(&z, out);
+            }
+            return (action == 'O') ? cplx_cos(&z, out) : cplx_tan(&z, out);
+        default:
+            break;
+    }
+    return 0;
+}
+
+static void handle_unary(struct CalcState *state, char action)
+{
+    struct CalcNum num;
+    struct Ratio rat;
+    unsigned long count;
+    int ok;
+    calc_real value;
+    calc_real result;
+    calc_real angle;
+    int from_accum = 0;
+
+    if (state->error) {
+        return;
+    }
+    if (!get_current_num(state, &num, &from_accum)) {
+        return;
+    }
+    num.long_id = 0;
+    if (action == 'F' && !state->inv && num_count(&num, &count) &&
+        (mode_uses_dd(state->arith_mode) || count > CALC_REAL_MAX_FACT)) {
+        bn_limb *limbs;
+        long len = combi_limbs('P', count, count, &limbs);
+
+        if (len < 0 || !num_from_limbs(state->arith_mode, limbs, len, &num)) {
+            state->error = 1;
+            return;
+        }
+        set_result_num(state, &num);
+        if (from_accum) {
+            set_accum(state, &num);
+            state->accum_set = 1;
+        }
+        return;
+    }
+    if (state->arith_mode == ARITH_FRAC && (action == '%' || (action == 'Q' && state->inv)) &&
+        num_rat(&num, &rat)) {
+        struct Ratio scale;
+
+        if (action == '%') {
+            ratio_from_int(&scale, 100);
+            ok = ratio_div(&rat, &scale, &rat);
+        } else {
+            ok = ratio_mul(&rat, &rat, &rat);
+        }
+        if (ok) {
+            num_set_rat(&num, &rat);
+            set_result_num(state, &num);
+            if (from_accum) {
+                set_accum(state, &num);
+                state->accum_set = 1;
+            }
+            return;
+        }
+    }
+    if (state->arith_mode == ARITH_CPLX &&
+        (num.kind == NUM_CPLX || needs_complex(state, action, num_real(&num)))) {
+        struct Cplx z;
+
+        num_cplx(&num, &z);
+        if (!unary_cplx(state, action, z, &z)) {
+            state->error = 1;
+            return;
+        }
+        num_set_cplx(&num, &z);
+        set_result_num(state, &num);
+        if (from_accum) {
+            set_accum(state, &num);
+            state->accum_set = 1;
+        }
+        return;
+    }
+    if (mode_uses_dd(state->arith_mode)) {
+        if (!unary_dd(state, action, num_dd(&num), &num.dd)) {
+            state->error = 1;
+            return;
+        }
+        num.kind = NUM_DD;
+        set_result_num(state, &num);
+        if (from_accum) {
+            set_accum(state, &num);
+            state->accum_set = 1;
+        }
+        return;
+    }
+    value = num_real(&num);
+
+    switch (action) {
+        case 'L':
+            if (state->inv) {
+                calc_math->exp_f(&result, value);
+            } else {
+                if (value <= REAL_C(0.0)) {
+                    state->error = 1;
+                    return;
+                }
+                calc_math->log_f(&result, value);
+            }
+            break;
+        case 'G':
+            if (state->inv) {
+                calc_math->pow_f(&result, REAL_C(10.0), value);
+            } else {
+                if (value <= REAL_C(0.0)) {
+                    state->error = 1;
+                    return;
+                }
+                calc_math->log10_f(&result, value);
+            }
+            break;
+        case 'X':
+            if (state->inv) {
+                if (value <= REAL_C(0.0)) {
+                    state->error = 1;
+                    return;
+                }
+                calc_math->log_f(&result, value);
+            } else {
+                calc_math->exp_f(&result, value);
+            }
+            break;
+        case 'Q':
+            if (state->inv) {
+                calc_math->mul(&result, value, value);
+            } else {
+                if (value < REAL_C(0.0)) {
+                    state->error = 1;
+                    return;
+                }
+                calc_math->sqrt_f(&result, value);
+            }
+            break;
+        case '%':
+            calc_math->div(&result, value, REAL_C(100.0));
+            break;
+        case 'F':
+            if (state->inv) {
+                ok = calc_lgamma(value + REAL_C(1.0), &result);
+            } else if (value >= REAL_C(0.0) && value <= (calc_real)CALC_REAL_MAX_FACT &&
+                       value == (calc_real)(long)value) {
+                result = calc_fact_table[(long)value];
+                ok = 1;
+            } else {
+                ok = calc_gamma(value + REAL_C(1.0), &result);
+            }
+            if (!ok) {
+                state->error = 1;
+                return;
+            }
+            break;
+        case 'N':
+            if (state->inv) {
+                if (value < -REAL_C(1.0) || value > REAL_C(1.0)) {
+                    state->error = 1;
+                    return;
+                }
+                calc_math->asin_f(&result, value);
+                if (state->angle_mode == ANGLE_DEG) {
+                    result = rad_to_deg(result);
+                }
+            } else {
+                angle = value;
+                if (state->angle_mode == ANGLE_DEG) {
+                    angle = deg_to_rad(angle);
+                }
+                calc_math->sin_f(&result, angle);
+            }
+            break;
+        case 'O':
+            if (state->inv) {
+                if (value < -REAL_C(1.0) || value > REAL_C(1.0)) {
+                    state->error = 1;
+                    return;
+                }
+                calc_math->acos_f(&result, value);
+                if (state->angle_mode == ANGLE_DEG) {
+                    result = rad_to_deg(result);
+                }
+            } else {
+                angle = value;
+                if (state->angle_mode == ANGLE_DEG) {
+                    angle = deg_to_rad(angle);
+                }
+                calc_math->cos_f(&result, angle);
+            }
+            break;
+        case 'T':
+            if (state->inv) {
+                calc_math->atan_f(&result, value);
+                if (state->angle_mode == ANGLE_DEG) {
+                    result = rad_to_deg(result);
+                }
+            } else {
+                angle = value;
+                if (state->angle_mode == ANGLE_DEG) {
+                    angle = deg_to_rad(angle);
+                }
+                calc_math->tan_f(&result, angle);
+            }
+            break;
+        default:
+            return;
+    }
+
+    if (result != result) {
+        state->error = 1;
+        return;
+    }
+    set_result(state, result);
+    if (from_accum) {
+        state->accum = result;
+        state->accum_kind = NUM_REAL;
+        state->accum_set = 1;
+    }
+}
+
+static char *find_exp(char *entry)
+{
+    char *pos = strchr(entry, 'e');
+    if (!pos) {
+        pos = strchr(entry, 'E');
+    }
+    return pos;
+}
+
+static int entry_has_exp(const char *entry)
+{
+    return strchr(entry, 'e') != NULL || strchr(entry, 'E') != NULL;
+}
+
+static int entry_has_decimal(const char *entry)
+{
+    const char *p = entry;
+
+    while (*p != '\0' && *p != 'e' && *p != 'E') {
+        if (*p == '.') {
+            return 1;
+        }
+        ++p;
+    }
+    return 0;
+}
+
+static int insert_char(struct CalcState *state, int pos, char ch)
+{
+    if (pos < 0 || pos > state->entry_len) {
+        return 0;
+    }
+    if (state->entry_len >= MAX_ENTRY) {
+        return 0;
+    }
+    memmove(state->entry + pos + 1, state->entry + pos,
+            (size_t)(state->entry_len - pos + 1));
+    state->entry[pos] = ch;
+    state->entry_len++;
+    return 1;
+}
+
+static void remove_char(struct CalcState *state, int pos)
+{
+    if (pos < 0 || pos >= state->entry_len) {
+        return;
+    }
+    memmove(state->entry + pos, state->entry + pos + 1,
+            (size_t)(state->entry_len - pos));
+    state->entry_len--;
+}
+
+static void handle_decimal(struct CalcState *state)
+{
+    if (state->error) {
+        return;
+    }
+    if (state->just_result || entry_is_var(state->entry)) {
+        state->entry_len = 0;
+        state->entry[0] = '\0';
+        state->just_result = 0;
+    }
+    if (entry_has_exp(state->entry) || entry_has_decimal(state->entry) ||
+        strchr(state->entry, 'i')) {
+        return;
+    }
+    if (state->entry_len == 0) {
+        if (MAX_ENTRY < 2) {
+            return;
+        }
+        state->entry[0] = '0';
+        state->entry[1] = '.';
+        state->entry[2] = '\0';
+        state->entry_len = 2;
+        return;
+    }
+    if (state->entry_len == 1 && state->entry[0] == '-') {
+        if (MAX_ENTRY < 3) {
+            return;
+        }
+        state->entry[1] = '0';
+        state->entry[2] = '.';
+        state->entry[3] = '\0';
+        state->entry_len = 3;
+        return;
+    }
+    if (state->entry_len >= MAX_ENTRY) {
+        return;
+    }
+    state->entry[state->entry_len++] = '.';
+    state->entry[state->entry_len] = '\0';
+}
+
+static void handle_exp(struct CalcState *state)
+{
+    if (state->error) {
+        return;
+    }
+    if (state->just_result) {
+        state->just_result = 0;
+    }
+    if (entry_has_exp(state->entry) || entry_is_var(state->entry) ||
+        strchr(state->entry, 'i')) {
+        return;
+    }
+    if (state->entry_len == 0) {
+        state->entry[0] = '0';
+        state->entry[1] = '\0';
+        state->entry_len = 1;
+    } else if (state->entry_len == 1 && state->entry[0] == '-') {
+        if (state->entry_len < MAX_ENTRY) {
+            state->entry[state->entry_len++] = '0';
+            state->entry[state->entry_len] = '\0';
+        }
+    }
+    if (state->entry_len >= MAX_ENTRY) {
+        return;
+    }
+    state->entry[state->entry_len++] = 'e';
+    state->entry[state->entry_len] = '\0';
+}
+
+static void handle_var(struct CalcState *state, char var)
+{
+    if (state->error) {
+        return;
+    }
+    state->entry[0] = var;
+    state->entry[1] = '\0';
+    state->entry_len = 1;
+    state->just_result = 0;
+}
+
+/*
+ * Inv + "." appends the imaginary unit to the entry in the complex mode;
+ * alone or after a sign it stands for +-i.
+ */
+static void handle_imag(struct CalcState *state)
+{
+    char last;
+
+    if (state->error || state->arith_mode != ARITH_CPLX) {
+        return;
+    }
+    if (state->just_result || entry_is_var(state->entry)) {
+        state->entry_len = 0;
+        state->entry[0] = '\0';
+        state->just_result = 0;
+    }
+    last = (state->entry_len > 0) ? state->entry[state->entry_len - 1] : '\0';
+    if (strchr(state->entry, 'i') || last == 'e' || last == 'E' ||
+        (last == '-' && state->entry_len > 1) || state->entry_len >= MAX_ENTRY) {
+        return;
+    }
+    state->entry[state->entry_len++] = 'i';
+    state->entry[state->entry_len] = '\0';
+}
+
+static void handle_sign(struct CalcState *state)
+{
+    char *exp_pos;
+
+    if (state->error) {
+        return;
+    }
+    if (state->just_result) {
+        state->just_result = 0;
+    }
+    if (state->entry_len == 0) {
+        state->entry[0] = '-';
+        state->entry[1] = '\0';
+        state->entry_len = 1;
+        return;
+    }
+    if (state->entry[0] == '(') {
+        /* A complex result: negate both parts. */
+        struct Cplx z;
+
+        parse_cplx_entry(state->entry, &z);
+        format_cplx(-z.re, -z.im, state->entry);
+        state->entry_len = (int)strlen(state->entry);
+        return;
+    }
+
+    exp_pos = find_exp(state->entry);
+    if (exp_pos) {
+        int sign_idx = (int)(exp_pos - state->entry) + 1;
+        if (sign_idx < state->entry_len &&
+            (state->entry[sign_idx] == '+' || state->entry[sign_idx] == '-')) {
+            if (state->entry[sign_idx] == '-') {
+                remove_char(state, sign_idx);
+            } else {
+                state->entry[sign_idx] = '-';
+            }
+        } else {
+            insert_char(state, sign_idx, '-');
+        }
+        return;
+    }
+
+    if (state->entry[0] == '-') {
+        remove_char(state, 0);
+    } else {
+        insert_char(state, 0, '-');
+    }
+}
+
+static void handle_backspace(struct CalcState *state)
+{
+    if (state->error) {
+        return;
+    }
+    if (state->entry_len <= 0) {
+        return;
+    }
+    state->entry_len--;
+    state->entry[state->entry_len] = '\0';
+    state->just_result = 0;
+    if (state->expr_entry_start >= 0 || state->expr_len == 0) {
+        if (state->entry_len > 0) {
+            expr_update_entry(state);
+        } else if (state->expr_entry_start >= 0) {
+            if (state->expr_entry_start > state->expr_len) {
+                state->expr_entry_start = state->expr_len;
+            }
+            state->expr_len = state->expr_entry_start;
+            state->expr[state->expr_len] = '\0';
+            state->expr_entry_start = -1;
+        }
+    }
+}
+
+static void handle_operator(struct CalcState *state, char op)
+{
+    struct CalcNum value;
+    struct CalcNum lhs;
+
+    if (state->error) {
+        return;
+    }
+    if (!state->accum_set && state->entry_len == 0) {
+        set_accum_zero(state);
+        state->accum_set = 1;
+    }
+    if (state->entry_len > 0) {
+        num_from_entry(state, &value);
+        if (!state->accum_set) {
+            set_accum(state, &value);
+            state->accum_set = 1;
+        } else if (state->op != 0) {
+            num_from_accum(state, &lhs);
+            if (!compute_num(state->arith_mode, &lhs, state->op, &value, &lhs)) {
+                state->error = 1;
+                return;
+            }
+            set_accum(state, &lhs);
+        } else {
+            set_accum(state, &value);
+        }
+        state->entry_len = 0;
+        state->entry[0] = '\0';
+    }
+    state->op = op;
+    state->just_result = 0;
+}
+
+static int eval_pending(const struct CalcState *state, struct CalcNum *out)
+{
+    struct CalcNum value;
+    struct CalcNum lhs;
+
+    if (state->entry_len > 0) {
+        num_from_entry(state, &value);
+    } else if (state->accum_set) {
+        num_from_accum(state, &value);
+    } else {
+        return 0;
+    }
+
+    if (state->op != 0 && state->accum_set) {
+        num_from_accum(state, &lhs);
+        if (!compute_num(state->arith_mode, &lhs, state->op, &value, out)) {
+            return 0;
+        }
+    } else {
+        *out = value;
+    }
+    return 1;
+}
+
+/*
+ * The value "=" would give now, with any open parentheses closed: the
+ * current level's pending operation, then each saved level's operation
+ * applied to it from the inside out. The accumulators already hold
+ * everything to the left, so this is at most MAX_PAREN_DEPTH + 1
+ * operations per key however long the expression is. nCr and nPr, which
+ * can be slow and make long results, are not previewed.
+ */
+static int eval_preview(const struct CalcState *state, struct CalcNum *out)
+{
+    struct CalcNum lhs;
+    struct CalcNum rhs;
+    int level;
+
+    if (state->op == 'C' || state->op == 'P' || !eval_pending(state, out)) {
+        return 0;
+    }
+    for (level = state->paren_depth - 1; level >= 0; --level) {
+        char op = state->paren_op[level];
+
+        if (!state->paren_accum_set[level] || op == 0) {
+            continue;
+        }
+        if (op == 'C' || op == 'P') {
+            return 0;
+        }
+        lhs.kind = state->paren_accum_kind[level];
+        lhs.ival = state->paren_accum_int[level];
+        lhs.real = state->paren_accum[level];
+        lhs.imag = state->paren_accum_im[level];
+        lhs.dd = state->paren_accum_dd[level];
+        lhs.rat = state->paren_accum_rat[level];
+        lhs.long_id = 0;
+        rhs = *out;
+        if (!compute_num(state->arith_mode, &lhs, op, &rhs, out)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Running value for the display's left corner while an operation or a
+ * parenthesis is pending. The text is only formatted again when the
+ * value changes.
+ */
+static void update_preview(struct CalcState *state)
+{
+    struct CalcNum value;
+    calc_real re;
+    calc_real im;
+
+    if (state->error || (state->op == 0 && state->paren_depth == 0) ||
+        !eval_preview(state, &value)) {
+        state->preview_text[0] = '\0';
+        return;
+    }
+    re = num_real(&value);
+    im = (value.kind == NUM_CPLX) ? value.imag : REAL_C(0.0);
+    if (state->preview_text[0] != '\0' && re == state->preview_re && im == state->preview_im) {
+        return;
+    }
+    state->preview_re = re;
+    state->preview_im = im;
+    if (im != REAL_C(0.0)) {
+        sprintf(state->preview_text, "=%.4g%+.4gi", (double)re, (double)im);
+    } else {
+        sprintf(state->preview_text, "=%.6g", (double)re);
+    }
+}
+
+static void handle_paren_open(struct CalcState *state)
+{
+    if (state->error) {
+        return;
+    }
+    if (state->paren_depth >= MAX_PAREN_DEPTH) {
+        state->error = 1;
+        return;
+    }
+
+    if (state->entry_len > 0 && state->op == 0 && !state->accum_set) {
+        struct CalcNum value;
+
+        num_from_entry(state, &value);
+        set_accum(state, &value);
+        state->accum_set = 1;
+        state->op = '*';
+        state->entry_len = 0;
+        state->entry[0] = '\0';
+    }
+
+    state->paren_accum[state->paren_depth] = state->accum;
+    state->paren_accum_im[state->paren_depth] = state->accum_im;
+    state->paren_accum_int[state->paren_depth] = state->accum_int;
+    state->paren_accum_dd[state->paren_depth] = state->accum_dd;
+    state->paren_accum_rat[state->paren_depth] = state->accum_rat;
+    state->paren_accum_kind[state->paren_depth] = state->accum_kind;
+    state->paren_accum_set[state->paren_depth] = state->accum_set;
+    state->paren_op[state->paren_depth] = state->op;
+    state->paren_depth++;
+
+    set_accum_zero(state);
+    state->accum_set = 0;
+    state->op = 0;
+    state->entry_len = 0;
+    state->entry[0] = '\0';
+    state->just_result = 0;
+}
+
+static void handle_paren_close(struct CalcState *state)
+{
+    struct CalcNum value;
+
+    if (state->error) {
+        return;
+    }
+    if (state->paren_depth == 0) {
+        state->error = 1;
+        return;
+    }
+    if (!eval_pending(state, &value)) {
+        state->error = 1;
+        return;
+    }
+
+    state->paren_depth--;
+    state->accum = state->paren_accum[state->paren_depth];
+    state->accum_im = state->paren_accum_im[state->paren_depth];
+    state->accum_int = state->paren_accum_int[state->paren_depth];
+    state->accum_dd = state->paren_accum_dd[state->paren_depth];
+    state->accum_rat = state->paren_accum_rat[state->paren_depth];
+    state->accum_long_id = 0;
+    state->accum_kind = state->paren_accum_kind[state->paren_depth];
+    state->accum_set = state->paren_accum_set[state->paren_depth];
+    state->op = state->paren_op[state->paren_depth];
+
+    set_result_num(state, &value);
+}
+
+static void handle_equals(struct CalcState *state)
+{
+    struct CalcNum value;
+    struct CalcNum lhs;
+
+    if (state->error) {
+        return;
+    }
+    if (state->paren_depth > 0) {
+        state->error = 1;
+        return;
+    }
+    if (!state->accum_set && state->entry_len == 0) {
+        state->entry_len = 1;
+        state->entry[0] = '0';
+        state->entry[1] = '\0';
+        state->just_result = 1;
+        return;
+    }
+
+    if (state->entry_len > 0) {
+        num_from_entry(state, &value);
+    } else {
+        num_from_accum(state, &value);
+    }
+
+    if (state->op != 0) {
+        if (!state->accum_set) {
+            set_accum_zero(state);
+            state->accum_set = 1;
+        }
+        num_from_accum(state, &lhs);
+        if (!compute_num(state->arith_mode, &lhs, state->op, &value, &lhs)) {
+            state->error = 1;
+            return;
+        }
+        set_accum(state, &lhs);
+    } else {
+        set_accum(state, &value);
+        state->accum_set = 1;
+    }
+
+    num_from_accum(state, &lhs);
+    set_result_num(state, &lhs);
+    state->op = 0;
+}
+
+/* The expression line as a function of var, with worksheet cells readable. */
+static int compile_expr(const struct CalcState *state, char var, struct Fexpr *f)
+{
+    if (!fexpr_compile(state->expr, var, state->angle_mode == ANGLE_DEG, f)) {
+        return 0;
+    }
+    f->cells = sheet_cells();
+    return 1;
+}
+
+/* The job posted to the compute task, or run here when there is none. */
+static void finish_job(struct CalcState *state);
+static void handle_action(struct CalcState *state, char action);
+
+static void start_job(struct CalcState *state)
+{
+    if (compute_start(&job)) {
+        job_busy = 1;
+        job_owner = state;
+        strcpy(state->status, "Calculando");
+        return;
+    }
+    compute_run(&job);
+    finish_job(state);
+}
+
+/*
+ * A cancelled job leaves the calculator as it was. The left corner shows
+ * how the solver, the series or the sampling ended. n!, nPr and nCr press
+ * their key again, which takes the digits instead of computing them.
+ */
+static void finish_job(struct CalcState *state)
+{
+    static const char *const stop_names[] = {"Terminos", "Directo", "Levin", "Limite"};
+
+    job_busy = 0;
+    if (job.watch.stop) {
+        strcpy(state->status, "Cancelado");
+        free(job.limbs);
+        job.limbs = NULL;
+        return;
+    }
+    state->status[0] = '\0';
+    if (!job.ok) {
+        state->error = 1;
+        return;
+    }
+    if (job.kind == JOB_COMBI) {
+        job_combi_ready = 1;
+        handle_action(state, job_key);
+        job_combi_ready = 0;
+        free(job.limbs);
+        job.limbs = NULL;
+        return;
+    }
+    clear_state(state);
+    switch (job.kind) {
+        case JOB_SOLVE:
+            state->var_x = job.solve.root;
+            set_result(state, job.solve.root);
+            sprintf(state->status, "%s %d",
+                    job.solve.method == SOLVE_NEWTON ? "Newton" : "Brent",
+                    job.solve.iterations);
+            break;
+        case JOB_INTEGRATE:
+            set_result(state, job.integ.value);
+            sprintf(state->status, "+-%.1e", (double)job.integ.error);
+            break;
+        case JOB_MONTE_CARLO:
+            set_result(state, job.mc.mean);
+            sprintf(state->status, "+-%.1e", (double)job.mc.error);
+            break;
+        default:
+            set_result(state, job.series.value);
+            if (job.series.digits > 0) {
+                sprintf(state->entry, "%.*g", job.series.digits, (double)job.series.value);
+                state->entry_len = (int)strlen(state->entry);
+            }
+            sprintf(state->status, "%s %ld", stop_names[job.series.stop], job.series.terms);
+            break;
+    }
+    expr_set(state, state->entry);
+}
+
+/*
+ * Solve the expression line for x, starting from the current value of x.
+ * The root goes to the entry and to x; the display's left corner names
+ * the method and its iteration count.
+ */
+static void handle_solve(struct CalcState *state)
+{
+    if (state->error) {
+        return;
+    }
+    if (!compile_expr(state, 'x', &job.f) || !job.f.uses_var) {
+        state->error = 1;
+        return;
+    }
+    job.kind = JOB_SOLVE;
+    job.a = state->var_x;
+    start_job(state);
+}
+
+/*
+ * Takes the entry as the lower or upper bound for Integrar, Suma and
+ * Producto and clears the calculator for the expression that follows.
+ */
+static void handle_int_bound(struct CalcState *state, int upper)
+{
+    struct CalcNum num;
+    calc_real value;
+
+    if (state->error) {
+        return;
+    }
+    num_from_entry(state, &num);
+    value = num_real(&num);
+    if (upper) {
+        state->int_to = value;
+        state->int_to_inf = 0;
+    } else {
+        state->int_from = value;
+    }
+    clear_state(state);
+    sprintf(state->status, "%s %.6g", upper ? "Hasta" : "Desde", (double)value);
+}
+
+/*
+ * Integrate the expression line in x between the Desde and Hasta bounds.
+ * The left corner of the display shows the error estimate.
+ */
+static void handle_integrate(struct CalcState *state)
+{
+    if (state->error) {
+        return;
+    }
+    if (state->int_to_inf || !compile_expr(state, 'x', &job.f)) {
+        state->error = 1;
+        return;
+    }
+    job.kind = JOB_INTEGRATE;
+    job.a = state->int_from;
+    job.b = state->int_to;
+    start_job(state);
+}
+
+/* Mean of the expression in x over MC_SAMPLES random x, uniform in [Desde, Hasta] or normal. */
+static void handle_monte_carlo(struct CalcState *state, int normal)
+{
+    if (state->error) {
+        return;
+    }
+    if ((!normal && state->int_to_inf) || !compile_expr(state, 'x', &job.f)) {
+        state->error = 1;
+        return;
+    }
+    job.kind = JOB_MONTE_CARLO;
+    job.flag = normal;
+    job.a = state->int_from;
+    job.b = state->int_to;
+    job.rng = &rng_mc;
+    start_job(state);
+}
+
+static void handle_int_to_inf(struct CalcState *state)
+{
+    state->int_to_inf = 1;
+    clear_state(state);
+    sprintf(state->status, "Hasta inf.");
+}
+
+static long round_index(calc_real value)
+{
+    return (long)(value < REAL_C(0.0) ? value - REAL_C(0.5) : value + REAL_C(0.5));
+}
+
+/*
+ * Sum or multiply the expression line as a term in n, for n from Desde to
+ * Hasta or, after Hasta inf., until it converges.
+ */
+static void handle_series(struct CalcState *state, int product)
+{
+    if (state->error) {
+        return;
+    }
+    if (!compile_expr(state, 'n', &job.f)) {
+        state->error = 1;
+        return;
+    }
+    job.kind = state->int_to_inf ? JOB_SERIES_LIMIT : JOB_SERIES;
+    job.flag = product;
+    job.first = round_index(state->int_from);
+    job.last = round_index(state->int_to);
+    start_job(state);
+}
+
+/* Appends the entry as the next coefficient, leading one first. */
+static void handle_poly_coef(struct CalcState *state)
+{
+    struct CalcNum num;
+
+    if (state->error) {
+        return;
+    }
+    if (poly_len > POLY_MAX_DEGREE) {
+        state->error = 1;
+        return;
+    }
+    num_from_entry(state, &num);
+    poly_coef[poly_len++] = num_real(&num);
+    clear_state(state);
+    sprintf(state->status, "Grado %d", poly_len - 1);
+}
+
+/*
+ * S+ adds the entry as y to the statistics (S- takes it back out). Its x
+ * is the one given with Dato x, otherwise the point number. S- needs the
+ * value typed in: an empty entry would take out a 0 that was never added.
+ */
+static void handle_stat_add(struct CalcState *state, int remove)
+{
+    struct CalcNum num;
+    calc_real x;
+
+    if (state->error) {
+        return;
+    }
+    if (remove && state->entry_len == 0) {
+        state->error = 1;
+        return;
+    }
+    num_from_entry(state, &num);
+    if (num.kind == NUM_CPLX) {
+        state->error = 1;
+        return;
+    }
+    if (stat_x_set) {
+        x = stat_x;
+    } else {
+        x = (calc_real)(remove ? stat_data.n : stat_data.n + 1);
+    }
+    if (remove) {
+        if (!stats_remove(&stat_data, x, num_real(&num))) {
+            state->error = 1;
+            return;
+        }
+    } else {
+        stats_add(&stat_data, x, num_real(&num));
+    }
+    stat_x_set = 0;
+    clear_state(state);
+    sprintf(state->status, "n %ld", stat_data.n);
+}
+
+static void handle_stat_x(struct CalcState *state)
+{
+    struct CalcNum num;
+
+    if (state->error) {
+        return;
+    }
+    num_from_entry(state, &num);
+    stat_x = num_real(&num);
+    stat_x_set = 1;
+    clear_state(state);
+    sprintf(state->status, "x %.6g", (double)stat_x);
+}
+
+static void handle_stat_import(struct CalcState *state)
+{
+    long count;
+
+    if (state->error) {
+        return;
+    }
+    count = stats_import(&stat_data, STAT_FILE);
+    if (count < 0) {
+        state->error = 1;
+        return;
+    }
+    clear_state(state);
+    sprintf(state->status, "n %ld", stat_data.n);
+}
+
+/* A statistic into the entry, as an operand like the constants. */
+static void handle_stat_recall(struct CalcState *state, int item)
+{
+    calc_real value = REAL_C(0.0);
+    calc_real other;
+    int ok = (stat_data.n > 0);
+
+    if (state->error) {
+        return;
+    }
+    switch (item) {
+        case ITEM_STAT_N:
+            value = (calc_real)stat_data.n;
+            ok = 1;
+            break;
+        case ITEM_STAT_MEAN:
+            value = stat_data.mean_y;
+            break;
+        case ITEM_STAT_SDEV:
+            ok = stats_stddev(&stat_data, &value);
             break;
-        case 'F': {
-            long n;
-            long i;
-            double fact = 1.0;
-
-            if (value < 0.0) {
-                state->error = 1;
-                return;
-            }
-            n = (long)value;
-            if (value != (double)n) {
-                state->error = 1;
-                return;
-            }
-            if (n > 170) {
-                state->error = 1;
-                return;
-            }
-            for (i = 2; i <= n; ++i) {
-                fact *= (double)i;
-            }
-            result = fact;
+        case ITEM_STAT_MIN:
+            value = stat_data.min;
             break;
-        }
-        case 'N':
-            if (state->inv) {
-                if (value < -1.0 || value > 1.0) {
-                    state->error = 1;
-                    return;
-                }
-                result = asin(value);
-                if (state->angle_mode == ANGLE_DEG) {
-                    result = rad_to_deg(result);
-                }
-            } else {
-                angle = value;
-                if (state->angle_mode == ANGLE_DEG) {
-                    angle = deg_to_rad(angle);
-                }
-                result = sin(angle);
-            }
+        case ITEM_STAT_MAX:
+            value = stat_data.max;
             break;
-        case 'O':
-            if (state->inv) {
-                if (value < -1.0 || value > 1.0) {
-                    state->error = 1;
-                    return;
-                }
-                result = acos(value);
-                if (state->angle_mode == ANGLE_DEG) {
-                    result = rad_to_deg(result);
-                }
-            } else {
-                angle = value;
-                if (state->angle_mode == ANGLE_DEG) {
-                    angle = deg_to_rad(angle);
-                }
-                result = cos(angle);
-            }
+        case ITEM_STAT_SLOPE:
+            ok = stats_line(&stat_data, &value, &other);
             break;
-        case 'T':
-            if (state->inv) {
-                result = atan(value);
-                if (state->angle_mode == ANGLE_DEG) {
-                    result = rad_to_deg(result);
-                }
-            } else {
-                angle = value;
-                if (state->angle_mode == ANGLE_DEG) {
-                    angle = deg_to_rad(angle);
-                }
-                result = tan(angle);
-            }
+        case ITEM_STAT_INTERCEPT:
+            ok = stats_line(&stat_data, &other, &value);
+            break;
+        case ITEM_STAT_CORR:
+            ok = stats_corr(&stat_data, &value);
             break;
         default:
             return;
     }
-
-    if (result != result) {
+    if (!ok) {
         state->error = 1;
         return;
     }
-    set_result(state, result);
-    if (from_accum) {
-        state->accum = result;
-        state->accum_set = 1;
+    if (state->just_result) {
+        expr_reset(state);
     }
+    sprintf(state->entry, CALC_REAL_FMT, value);
+    state->entry_len = (int)strlen(state->entry);
+    state->just_result = 0;
+    expr_update_entry(state);
 }
 
-static char *find_exp(char *entry)
+/* The cell number in the entry, plain or as a reference; -1 if there is none. */
+static int entry_cell_number(const struct CalcState *state)
 {
-    char *pos = strchr(entry, 'e');
-    if (!pos) {
-        pos = strchr(entry, 'E');
+    calc_int n;
+    int cell = entry_cell(state->entry);
+
+    if (cell >= 0 && cell < SHEET_CELLS) {
+        return cell;
     }
-    return pos;
+    if (cell < 0 && parse_int_entry(state->entry, &n) && n >= 0 && n < SHEET_CELLS) {
+        return (int)n;
+    }
+    return -1;
 }
 
-static int entry_has_exp(const char *entry)
+/* A cell's value as the result, its formula on the expression line. */
+static void show_cell(struct CalcState *state, int cell)
 {
-    return strchr(entry, 'e') != NULL || strchr(entry, 'E') != NULL;
+    const char *text = sheet_text(cell);
+    calc_real value;
+
+    clear_state(state);
+    sheet_cur = cell;
+    state->cell_pos = cell;
+    if (!sheet_get(cell, &value)) {
+        expr_set(state, text);
+        state->error = 1;
+        return;
+    }
+    set_result(state, value);
+    expr_set(state, text ? text : state->entry);
+    sprintf(state->status, "#%d", cell);
 }
 
-static int entry_has_decimal(const char *entry)
+/* Hoja -> Celda; clicking the display then steps through the grid. */
+static void handle_sheet_cell(struct CalcState *state)
 {
-    const char *p = entry;
+    int cell;
 
-    while (*p != '\0' && *p != 'e' && *p != 'E') {
-        if (*p == '.') {
-            return 1;
-        }
-        ++p;
+    if (state->error) {
+        return;
     }
-    return 0;
+    cell = entry_cell_number(state);
+    if (cell < 0) {
+        state->error = 1;
+        return;
+    }
+    show_cell(state, cell);
 }
 
-static int insert_char(struct CalcState *state, int pos, char ch)
+static void scroll_cells(struct CalcState *state, int forward)
 {
-    if (pos < 0 || pos > state->entry_len) {
-        return 0;
-    }
-    if (state->entry_len >= MAX_ENTRY) {
-        return 0;
+    if (forward && state->cell_pos + 1 < SHEET_CELLS) {
+        show_cell(state, state->cell_pos + 1);
+    } else if (!forward && state->cell_pos > 0) {
+        show_cell(state, state->cell_pos - 1);
     }
-    memmove(state->entry + pos + 1, state->entry + pos,
-            (size_t)(state->entry_len - pos + 1));
-    state->entry[pos] = ch;
-    state->entry_len++;
-    return 1;
 }
 
-static void remove_char(struct CalcState *state, int pos)
+/* Hoja -> Referencia: the entry's cell number becomes the operand "#n". */
+static void handle_sheet_ref(struct CalcState *state)
 {
-    if (pos < 0 || pos >= state->entry_len) {
+    calc_real value;
+    int cell;
+
+    if (state->error) {
         return;
     }
-    memmove(state->entry + pos, state->entry + pos + 1,
-            (size_t)(state->entry_len - pos));
-    state->entry_len--;
+    cell = entry_cell_number(state);
+    if (cell < 0 || !sheet_get(cell, &value)) {
+        state->error = 1;
+        return;
+    }
+    if (state->just_result) {
+        expr_reset(state);
+    }
+    sprintf(state->entry, "#%d", cell);
+    state->entry_len = (int)strlen(state->entry);
+    state->just_result = 0;
+    expr_update_entry(state);
+    sprintf(state->status, "= %.6g", (double)value);
 }
 
-static void handle_decimal(struct CalcState *state)
+/*
+ * Hoja -> Definir: the expression line becomes the formula of the picked
+ * cell (an empty line clears it). The left corner counts the cells that
+ * were recomputed.
+ */
+static void handle_sheet_define(struct CalcState *state)
 {
+    int cell = sheet_cur;
+    int count;
+
     if (state->error) {
         return;
     }
-    if (state->just_result) {
-        state->entry_len = 0;
-        state->entry[0] = '\0';
-        state->just_result = 0;
-    }
-    if (entry_has_exp(state->entry) || entry_has_decimal(state->entry)) {
+    if (cell < 0) {
+        state->error = 1;
         return;
     }
-    if (state->entry_len == 0) {
-        if (MAX_ENTRY < 2) {
-            return;
-        }
-        state->entry[0] = '0';
-        state->entry[1] = '.';
-        state->entry[2] = '\0';
-        state->entry_len = 2;
+    count = sheet_set(cell, state->expr, state->angle_mode == ANGLE_DEG);
+    if (count < 0) {
+        state->error = 1;
         return;
     }
-    if (state->entry_len == 1 && state->entry[0] == '-') {
-        if (MAX_ENTRY < 3) {
-            return;
-        }
-        state->entry[1] = '0';
-        state->entry[2] = '.';
-        state->entry[3] = '\0';
-        state->entry_len = 3;
-        return;
+    show_cell(state, cell);
+    if (!state->error) {
+        sprintf(state->status, "%d celdas", count);
     }
-    if (state->entry_len >= MAX_ENTRY) {
+}
+
+/* The expression "=" is about to evaluate; macros run quiet. */
+static char hist_line[MAX_EXPR + 1];
+static int hist_quiet = 0;
+
+/*
+ * Entry "back" of the history becomes the operand, like a recalled
+ * statistic, with its number and expression in the status line.
+ */
+static void show_history(struct CalcState *state, long back)
+{
+    const char *expr;
+    const char *value;
+
+    if (!hist_get(back, &expr, &value)) {
         return;
     }
-    state->entry[state->entry_len++] = '.';
-    state->entry[state->entry_len] = '\0';
+    if (state->just_result) {
+        expr_reset(state);
+    }
+    strncpy(state->entry, value, MAX_ENTRY);
+    state->entry[MAX_ENTRY] = '\0';
+    state->entry_len = (int)strlen(state->entry);
+    state->just_result = 0;
+    expr_update_entry(state);
+    state->hist_pos = back;
+    sprintf(state->status, "H%ld %.12s%s", back, expr, strlen(expr) > 12 ? ".." : "");
 }
 
-static void handle_exp(struct CalcState *state)
+/* Hst goes one result further back each time it is pressed in a row. */
+static void handle_history_key(struct CalcState *state, long pos)
 {
     if (state->error) {
         return;
     }
-    if (state->just_result) {
-        state->just_result = 0;
-    }
-    if (entry_has_exp(state->entry)) {
+    if (hist_count() == 0) {
+        strcpy(state->status, "Historial vacio");
         return;
     }
-    if (state->entry_len == 0) {
-        state->entry[0] = '0';
-        state->entry[1] = '\0';
-        state->entry_len = 1;
-    } else if (state->entry_len == 1 && state->entry[0] == '-') {
-        if (state->entry_len < MAX_ENTRY) {
-            state->entry[state->entry_len++] = '0';
-            state->entry[state->entry_len] = '\0';
-        }
+    if (pos < 1) {
+        pos = 0;
+    } else if (pos == hist_count()) {
+        pos--;
     }
-    if (state->entry_len >= MAX_ENTRY) {
-        return;
+    state->hist_query[0] = '\0';
+    show_history(state, pos + 1);
+}
+
+/* The right half of the display goes to older results, the left to newer. */
+static void scroll_history(struct CalcState *state, int older)
+{
+    long back;
+
+    if (state->hist_query[0] != '\0') {
+        back = hist_find(state->hist_query, state->hist_pos, !older);
+    } else {
+        back = older ? state->hist_pos + 1 : state->hist_pos - 1;
+    }
+    if (back >= 1 && back <= hist_count()) {
+        show_history(state, back);
     }
-    state->entry[state->entry_len++] = 'e';
-    state->entry[state->entry_len] = '\0';
 }
 
-static void handle_sign(struct CalcState *state)
+/*
+ * Variables menu: the item waits for a name typed on the keyboard, which
+ * the left corner echoes; Return takes it, Esc or any key on the pad
+ * cancels.
+ */
+static void show_name_prompt(struct CalcState *state)
 {
-    char *exp_pos;
+    static const char *const prompts[] = {"", "STO", "RCL", "f(x)", "Aplicar", "Buscar"};
+
+    sprintf(state->status, "%s %s_", prompts[state->name_mode], state->name);
+}
 
+static void start_name(struct CalcState *state, int mode)
+{
     if (state->error) {
         return;
     }
+    state->name_mode = mode;
+    state->name_len = 0;
+    state->name[0] = '\0';
+    show_name_prompt(state);
+}
+
+/* RCL: the variable becomes the operand "@NAME". */
+static void recall_symbol(struct CalcState *state, int id)
+{
+    calc_real value;
+
+    if (!sym_value(id, &value)) {
+        state->error = 1;
+        return;
+    }
     if (state->just_result) {
-        state->just_result = 0;
+        expr_reset(state);
     }
-    if (state->entry_len == 0) {
-        state->entry[0] = '-';
-        state->entry[1] = '\0';
-        state->entry_len = 1;
+    sprintf(state->entry, "@%s", sym_name(id));
+    state->entry_len = (int)strlen(state->entry);
+    state->just_result = 0;
+    expr_update_entry(state);
+    sprintf(state->status, "= %.6g", (double)value);
+}
+
+/* Aplicar f: the function applies to the current value like a key such as sin. */
+static void apply_symbol(struct CalcState *state, int id)
+{
+    char prefix[SYM_NAME + 3];
+    struct CalcNum num;
+    calc_real result;
+    int from_accum = 0;
+
+    if (sym_kind(id) != SYM_FUNC) {
+        state->error = 1;
+        return;
+    }
+    if (!get_current_num(state, &num, &from_accum)) {
+        return;
+    }
+    sprintf(prefix, "@%s(", sym_name(id));
+    expr_apply_prefix(state, prefix, ")");
+    if (!sym_call(id, num_real(&num), &result)) {
+        state->error = 1;
+        return;
+    }
+    num.long_id = 0;
+    num.real = result;
+    num.kind = NUM_REAL;
+    set_result_num(state, &num);
+    if (from_accum) {
+        set_accum(state, &num);
+        state->accum_set = 1;
+    }
+}
+
+static void finish_name(struct CalcState *state)
+{
+    struct CalcNum num;
+    int mode = state->name_mode;
+    int from_accum;
+    int id;
+
+    state->name_mode = NAME_NONE;
+    state->status[0] = '\0';
+    if (state->name_len == 0) {
         return;
     }
+    if (mode == NAME_SEARCH) {
+        long back = hist_find(state->name, 0, 0);
 
-    exp_pos = find_exp(state->entry);
-    if (exp_pos) {
-        int sign_idx = (int)(exp_pos - state->entry) + 1;
-        if (sign_idx < state->entry_len &&
-            (state->entry[sign_idx] == '+' || state->entry[sign_idx] == '-')) {
-            if (state->entry[sign_idx] == '-') {
-                remove_char(state, sign_idx);
-            } else {
-                state->entry[sign_idx] = '-';
-            }
+        strcpy(state->hist_query, state->name);
+        if (back > 0) {
+            show_history(state, back);
         } else {
-            insert_char(state, sign_idx, '-');
+            strcpy(state->status, "No encontrado");
         }
         return;
     }
-
-    if (state->entry[0] == '-') {
-        remove_char(state, 0);
-    } else {
-        insert_char(state, 0, '-');
+    id = (mode == NAME_STO || mode == NAME_DEFINE) ? sym_intern(state->name) : sym_find(state->name);
+    if (id < 0) {
+        state->error = 1;
+        return;
+    }
+    if (mode == NAME_STO) {
+        if (get_current_num(state, &num, &from_accum)) {
+            sym_store(id, num_real(&num));
+            sprintf(state->status, "%s %.6g", state->name, (double)num_real(&num));
+        }
+    } else if (mode == NAME_RCL) {
+        recall_symbol(state, id);
+    } else if (mode == NAME_DEFINE) {
+        /* The expression line in x becomes the body. */
+        if (!sym_define(id, state->expr, state->angle_mode == ANGLE_DEG)) {
+            state->error = 1;
+            return;
+        }
+        clear_state(state);
+        sprintf(state->status, "%s(x)", sym_name(id));
+    } else if (mode == NAME_APPLY) {
+        apply_symbol(state, id);
     }
 }
 
-static void handle_backspace(struct CalcState *state)
+static void handle_name_key(struct CalcState *state, char key)
 {
-    if (state->error) {
+    if (state->name_mode == NAME_NONE) {
         return;
     }
-    if (state->entry_len <= 0) {
+    if (key >= 'a' && key <= 'z' && state->name_mode != NAME_SEARCH) {
+        key = (char)(key - 'a' + 'A');
+    }
+    if (key == '\r' || key == '\n') {
+        finish_name(state);
         return;
     }
-    state->entry_len--;
-    state->entry[state->entry_len] = '\0';
-    state->just_result = 0;
-    if (state->expr_entry_start >= 0 || state->expr_len == 0) {
-        if (state->entry_len > 0) {
-            expr_update_entry(state);
-        } else if (state->expr_entry_start >= 0) {
-            if (state->expr_entry_start > state->expr_len) {
-                state->expr_entry_start = state->expr_len;
-            }
-            state->expr_len = state->expr_entry_start;
-            state->expr[state->expr_len] = '\0';
-            state->expr_entry_start = -1;
+    if (key == 27) {
+        state->name_mode = NAME_NONE;
+        state->status[0] = '\0';
+        return;
+    }
+    if (key == 8) {
+        if (state->name_len > 0) {
+            state->name[--state->name_len] = '\0';
+        }
+    } else if (state->name_mode == NAME_SEARCH) {
+        if (state->name_len < HIST_QUERY && key >= ' ' && key <= '~') {
+            state->name[state->name_len++] = key;
+            state->name[state->name_len] = '\0';
         }
+    } else if (state->name_len < SYM_NAME &&
+               ((key >= 'A' && key <= 'Z') || (key >= '0' && key <= '9' && state->name_len > 0))) {
+        state->name[state->name_len++] = key;
+        state->name[state->name_len] = '\0';
     }
+    show_name_prompt(state);
 }
 
-static void handle_operator(struct CalcState *state, char op)
+/* p(entry) by Horner, in double-double outside Real mode. */
+static void handle_poly_eval(struct CalcState *state)
 {
-    double value;
+    struct CalcNum num;
 
     if (state->error) {
         return;
     }
-    if (!state->accum_set && state->entry_len == 0) {
-        state->accum = 0.0;
-        state->accum_set = 1;
+    if (poly_len == 0) {
+        state->error = 1;
+        return;
     }
-    if (state->entry_len > 0) {
-        value = strtod(state->entry, NULL);
-        if (!state->accum_set) {
-            state->accum = value;
-            state->accum_set = 1;
-        } else if (state->op != 0) {
-            if (!compute_op(state->accum, state->op, value, &state->accum)) {
+    num_from_entry(state, &num);
+    if (num.kind == NUM_CPLX) {
+        struct Cplx z;
+        struct Cplx p;
+        int i;
+
+        /* Horner at a complex point. */
+        num_cplx(&num, &z);
+        p.re = REAL_C(0.0);
+        p.im = REAL_C(0.0);
+        for (i = 0; i < poly_len; ++i) {
+            if (!cplx_mul(&p, &z, &p)) {
                 state->error = 1;
                 return;
             }
-        } else {
-            state->accum = value;
+            p.re += poly_coef[i];
         }
-        state->entry_len = 0;
-        state->entry[0] = '\0';
+        num_set_cplx(&num, &p);
+        set_result_num(state, &num);
+    } else if (!mode_uses_dd(state->arith_mode)) {
+        calc_real value = poly_eval(poly_coef, poly_len, num_real(&num));
+
+        if (value - value != REAL_C(0.0)) {
+            state->error = 1;
+            return;
+        }
+        set_result(state, value);
+    } else {
+        num.dd = poly_eval_dd(poly_coef, poly_len, num_dd(&num));
+        num.kind = NUM_DD;
+        num.long_id = 0;
+        if (dd_isnan(num.dd)) {
+            state->error = 1;
+            return;
+        }
+        set_result_num(state, &num);
     }
-    state->op = op;
-    state->just_result = 0;
+    expr_set(state, state->entry);
 }
 
-static int eval_pending(const struct CalcState *state, double *out)
+static void show_root(struct CalcState *state)
 {
-    double value;
+    const struct PolyRoot *root = &poly_root_list[state->root_pos];
 
-    if (state->entry_len > 0) {
-        value = strtod(state->entry, NULL);
-    } else if (state->accum_set) {
-        value = state->accum;
-    } else {
-        return 0;
-    }
+    if (state->arith_mode == ARITH_CPLX) {
+        struct CalcNum num;
+        struct Cplx z;
 
-    if (state->op != 0 && state->accum_set) {
-        if (!compute_op(state->accum, state->op, value, out)) {
-            return 0;
-        }
+        z.re = root->re;
+        z.im = root->im;
+        num.long_id = 0;
+        num_set_cplx(&num, &z);
+        set_result_num(state, &num);
     } else {
-        *out = value;
+        set_result(state, root->re);
     }
-    return 1;
+    expr_set(state, state->entry);
 }
 
-static void handle_paren_open(struct CalcState *state)
+/* All roots of the polynomial; clicking the display steps through them. */
+static void handle_poly_roots(struct CalcState *state)
 {
+    int iterations;
+    int count;
+
     if (state->error) {
         return;
     }
-    if (state->paren_depth >= MAX_PAREN_DEPTH) {
+    count = poly_roots(poly_coef, poly_len, poly_root_list, &iterations);
+    if (count <= 0) {
         state->error = 1;
         return;
     }
-
-    if (state->entry_len > 0 && state->op == 0 && !state->accum_set) {
-        state->accum = strtod(state->entry, NULL);
-        state->accum_set = 1;
-        state->op = '*';
-        state->entry_len = 0;
-        state->entry[0] = '\0';
-    }
-
-    state->paren_accum[state->paren_depth] = state->accum;
-    state->paren_accum_set[state->paren_depth] = state->accum_set;
-    state->paren_op[state->paren_depth] = state->op;
-    state->paren_depth++;
-
-    state->accum = 0.0;
-    state->accum_set = 0;
-    state->op = 0;
-    state->entry_len = 0;
-    state->entry[0] = '\0';
-    state->just_result = 0;
+    poly_root_count = count;
+    clear_state(state);
+    state->root_pos = 0;
+    show_root(state);
 }
 
-static void handle_paren_close(struct CalcState *state)
+static void scroll_roots(struct CalcState *state, int forward)
 {
-    double value;
-
-    if (state->error) {
-        return;
-    }
-    if (state->paren_depth == 0) {
-        state->error = 1;
-        return;
-    }
-    if (!eval_pending(state, &value)) {
-        state->error = 1;
+    if (forward && state->root_pos + 1 < poly_root_count) {
+        state->root_pos++;
+    } else if (!forward && state->root_pos > 0) {
+        state->root_pos--;
+    } else {
         return;
     }
-
-    state->paren_depth--;
-    state->accum = state->paren_accum[state->paren_depth];
-    state->accum_set = state->paren_accum_set[state->paren_depth];
-    state->op = state->paren_op[state->paren_depth];
-
-    set_result(state, value);
+    show_root(state);
 }
 
-static void handle_equals(struct CalcState *state)
+/*
+ * A key that takes n! or completes an nPr or nCr with n from
+ * COMBI_JOB_MIN posts the product to the compute task instead, and
+ * finish_job presses it again. The state is left alone meanwhile.
+ */
+static int start_combi_job(struct CalcState *state, char action)
 {
-    double value;
+    struct CalcNum lhs;
+    struct CalcNum rhs;
+    unsigned long n;
+    unsigned long r;
+    int from_accum;
 
     if (state->error) {
-        return;
-    }
-    if (state->paren_depth > 0) {
-        state->error = 1;
-        return;
-    }
-    if (!state->accum_set && state->entry_len == 0) {
-        state->entry_len = 1;
-        state->entry[0] = '0';
-        state->entry[1] = '\0';
-        state->just_result = 1;
-        return;
+        return 0;
     }
-
-    if (state->entry_len > 0) {
-        value = strtod(state->entry, NULL);
-    } else if (state->accum_set) {
-        value = state->accum;
+    if (action == 'F') {
+        if (state->inv || !get_current_num(state, &rhs, &from_accum) ||
+            !num_count(&rhs, &n) || n < COMBI_JOB_MIN) {
+            return 0;
+        }
+        job.flag = 'P';
+        r = n;
     } else {
-        value = 0.0;
-    }
-
-    if (state->op != 0) {
-        if (!state->accum_set) {
-            state->accum = 0.0;
-            state->accum_set = 1;
+        if ((state->op != 'C' && state->op != 'P') || !state->accum_set) {
+            return 0;
         }
-        if (!compute_op(state->accum, state->op, value, &state->accum)) {
-            state->error = 1;
-            return;
+        switch (action) {
+            case '=':
+                if (state->paren_depth > 0) {
+                    return 0;
+                }
+                break;
+            case ')':
+                if (state->paren_depth == 0) {
+                    return 0;
+                }
+                break;
+            case '+':
+            case '-':
+            case '*':
+            case '/':
+            case 'P':
+            case 'K':
+                if (state->entry_len == 0) {
+                    return 0;
+                }
+                break;
+            default:
+                return 0;
         }
-    } else {
-        state->accum = value;
-        state->accum_set = 1;
+        num_from_accum(state, &lhs);
+        if (state->entry_len > 0) {
+            num_from_entry(state, &rhs);
+        } else {
+            rhs = lhs;
+        }
+        if (!num_count(&lhs, &n) || !num_count(&rhs, &r) || r > n || n < COMBI_JOB_MIN) {
+            return 0;
+        }
+        job.flag = state->op;
     }
-
-    sprintf(state->entry, "%.15g", state->accum);
-    state->entry_len = (int)strlen(state->entry);
-    state->op = 0;
-    state->just_result = 1;
+    job.kind = JOB_COMBI;
+    job.first = (long)n;
+    job.last = (long)r;
+    job.limbs = NULL;
+    job_key = action;
+    start_job(state);
+    return 1;
 }
 
 static void handle_action(struct CalcState *state, char action)
 {
+    long hist_pos = state->hist_pos;
+
+    state->status[0] = '\0';
+    state->root_pos = -1;
+    state->cell_pos = -1;
+    state->hist_pos = -1;
+    state->name_mode = NAME_NONE;
     if (action >= '0' && action <= '9') {
         if (state->just_result) {
             expr_reset(state);
@@ -1098,14 +3631,26 @@ static void handle_action(struct CalcState *state, char action)
                 handle_operator(state, '^');
             }
             break;
+        case 'K':
+            if (!state->error) {
+                expr_add_operator(state, state->inv ? 'P' : 'C');
+            }
+            handle_operator(state, state->inv ? 'P' : 'C');
+            break;
         case '=':
             if (!state->error && state->entry_len > 0 &&
                 (state->expr_entry_start >= 0 || state->expr_len == 0)) {
                 expr_update_entry(state);
                 state->expr_entry_start = -1;
             }
+            if (!hist_quiet) {
+                strcpy(hist_line, state->expr);
+            }
             handle_equals(state);
             if (!state->error) {
+                if (!hist_quiet && strcmp(hist_line, state->entry) != 0) {
+                    hist_add(hist_line[0] != '\0' ? hist_line : state->entry, state->entry);
+                }
                 expr_set(state, state->entry);
             }
             break;
@@ -1113,12 +3658,26 @@ static void handle_action(struct CalcState *state, char action)
             if (state->just_result) {
                 expr_reset(state);
             }
-            handle_decimal(state);
+            if (state->inv) {
+                handle_imag(state);
+            } else {
+                handle_decimal(state);
+            }
             if (!state->error) {
                 expr_update_entry(state);
             }
             break;
         case 'E':
+            if (state->inv) {
+                if (state->just_result) {
+                    expr_reset(state);
+                }
+                handle_var(state, 'x');
+                if (!state->error) {
+                    expr_update_entry(state);
+                }
+                break;
+            }
             if (state->just_result) {
                 expr_set(state, state->entry);
             }
@@ -1128,6 +3687,16 @@ static void handle_action(struct CalcState *state, char action)
             }
             break;
         case 'S':
+            if (state->inv) {
+                if (state->just_result) {
+                    expr_reset(state);
+                }
+                handle_var(state, 'n');
+                if (!state->error) {
+                    expr_update_entry(state);
+                }
+                break;
+            }
             if (state->just_result) {
                 expr_set(state, state->entry);
             }
@@ -1137,7 +3706,17 @@ static void handle_action(struct CalcState *state, char action)
             }
             break;
         case 'B':
-            handle_backspace(state);
+            if (state->inv) {
+                handle_history_key(state, hist_pos);
+            } else {
+                handle_backspace(state);
+            }
+            break;
+        case 'W':
+            handle_stat_add(state, state->inv);
+            break;
+        case 'U':
+            handle_random(state, state->inv);
             break;
         case '(':
             if (!state->error) {
@@ -1177,35 +3756,339 @@ static void handle_action(struct CalcState *state, char action)
     }
 }
 
+/* Keys that extend a number once a digit or "." has started it. */
+static int macro_number_key(char key)
+{
+    return (key >= '0' && key <= '9') || key == '.' || key == 'E' || key == 'S';
+}
+
+/*
+ * Straight-line program for a macro: number runs are typed into a
+ * scratch state of the same arithmetic mode, so the text they leave is
+ * exactly what the keys would have entered.
+ */
+static void compile_macro(struct Macro *m, int mode)
+{
+    static struct CalcState scratch;
+    int pool_len = 0;
+    int inv = 0;
+    int i = 0;
+
+    m->op_count = 0;
+    while (i < m->len) {
+        struct MacroOp *op = &m->ops[m->op_count];
+        char key = m->keys[i];
+
+        op->key = key;
+        op->inv = (char)inv;
+        op->text = -1;
+        op->first = (short)i;
+        op->count = 1;
+        if (key == 'I') {
+            inv = !inv;
+            ++i;
+            continue;
+        }
+        if (!inv && ((key >= '0' && key <= '9') || key == '.')) {
+            clear_state(&scratch);
+            scratch.arith_mode = mode;
+            scratch.inv = 0;
+            for (; i < m->len && macro_number_key(m->keys[i]); ++i) {
+                if (m->keys[i] == '.') {
+                    handle_decimal(&scratch);
+                } else if (m->keys[i] == 'E') {
+                    handle_exp(&scratch);
+                } else if (m->keys[i] == 'S') {
+                    handle_sign(&scratch);
+                } else {
+                    handle_digit(&scratch, m->keys[i]);
+                }
+            }
+            if (m->op_count > 0 && op[-1].code == MOP_OPERATOR) {
+                --op;
+                op->code = MOP_OPERAND;
+                op->first = op[1].first;
+            } else {
+                op->code = MOP_NUMBER;
+                m->op_count++;
+            }
+            op->count = (short)(i - op->first);
+            op->text = (short)pool_len;
+            strcpy(m->pool + pool_len, scratch.entry);
+            pool_len += scratch.entry_len + 1;
+            continue;
+        }
+        switch (key) {
+            case '+':
+            case '-':
+            case '*':
+            case '/':
+                op->code = MOP_OPERATOR;
+                break;
+            case 'P':
+                op->code = MOP_OPERATOR;
+                op->key = inv ? 'r' : '^';
+                break;
+            case 'K':
+                op->code = MOP_OPERATOR;
+                op->key = inv ? 'P' : 'C';
+                break;
+            case 'L':
+            case 'G':
+            case 'X':
+            case 'Q':
+            case '%':
+            case 'F':
+            case 'N':
+            case 'O':
+            case 'T':
+                op->code = MOP_UNARY;
+                break;
+            default:
+                op->code = MOP_KEY;
+                break;
+        }
+        m->op_count++;
+        ++i;
+    }
+    m->final_inv = inv;
+    m->ends_equals = (m->op_count > 0 && m->ops[m->op_count - 1].code == MOP_KEY &&
+                      m->ops[m->op_count - 1].key == '=');
+    m->mode = mode;
+    m->compiled = 1;
+}
+
+static void macro_number(struct CalcState *state, const struct Macro *m,
+                         const struct MacroOp *op, int track)
+{
+    int i;
+
+    if (state->entry_len > 0 && !state->just_result && !entry_is_var(state->entry)) {
+        /* The digits continue a typed entry. */
+        state->inv = 0;
+        for (i = 0; i < op->count; ++i) {
+            handle_action(state, m->keys[op->first + i]);
+        }
+        return;
+    }
+    if (track && state->just_result) {
+        expr_reset(state);
+    }
+    strcpy(state->entry, m->pool + op->text);
+    state->entry_len = (int)strlen(state->entry);
+    state->just_result = 0;
+    if (track) {
+        expr_update_entry(state);
+    }
+}
+
+/*
+ * The expression line is kept up step by step only while it is shown or
+ * when the macro leaves an expression open; a macro ending in "=" just
+ * sets it to the result, as "=" would.
+ */
+static void run_macro(struct CalcState *state, int slot)
+{
+    struct Macro *m = &macro_slots[slot];
+    int track;
+    int i;
+
+    if (state->error) {
+        return;
+    }
+    if (m->len == 0) {
+        sprintf(state->status, "M%d vacia", slot + 1);
+        return;
+    }
+    if (!m->compiled || m->mode != state->arith_mode) {
+        compile_macro(m, state->arith_mode);
+    }
+    track = state->show_expr || !m->ends_equals;
+    state->status[0] = '\0';
+    state->root_pos = -1;
+    state->cell_pos = -1;
+    state->hist_pos = -1;
+    if (!track) {
+        sprintf(hist_line, "%.*s M%d", MAX_EXPR - 4, state->expr, slot + 1);
+        hist_quiet = 1;
+    }
+    state->name_mode = NAME_NONE;
+    if (state->entry_len > 0) {
+        state->just_result = 1;
+    }
+    for (i = 0; i < m->op_count && !state->error; ++i) {
+        const struct MacroOp *op = &m->ops[i];
+
+        state->inv = op->inv;
+        switch (op->code) {
+            case MOP_NUMBER:
+                macro_number(state, m, op, track);
+                break;
+            case MOP_OPERATOR:
+            case MOP_OPERAND:
+                if (track) {
+                    expr_add_operator(state, op->key);
+                }
+                handle_operator(state, op->key);
+                if (op->code == MOP_OPERAND && !state->error) {
+                    macro_number(state, m, op, track);
+                }
+                break;
+            case MOP_UNARY:
+                if (track) {
+                    expr_apply_unary(state, op->key);
+                }
+                handle_unary(state, op->key);
+                break;
+            default:
+                handle_action(state, op->key);
+                break;
+        }
+    }
+    state->inv = m->final_inv;
+    hist_quiet = 0;
+    if (!track && !state->error) {
+        hist_add(hist_line, state->entry);
+        expr_set(state, state->entry);
+    }
+}
+
+static void handle_macro_slot(struct CalcState *state, int slot)
+{
+    int count;
+
+    if (!macro_recording()) {
+        run_macro(state, slot);
+        return;
+    }
+    count = macro_store(slot);
+    sprintf(state->status, "M%d %d teclas", slot + 1, count);
+}
+
+static void handle_macro_record(struct CalcState *state)
+{
+    if (macro_recording()) {
+        macro_cancel();
+        state->status[0] = '\0';
+        return;
+    }
+    macro_record_start();
+    state->inv = 0;
+}
+
+static void handle_macro_file(struct CalcState *state, int load)
+{
+    int count;
+
+    if (state->error) {
+        return;
+    }
+    if (load) {
+        count = macro_load(MACRO_FILE);
+        if (count < 0) {
+            state->error = 1;
+            return;
+        }
+        sprintf(state->status, "%d macros", count);
+    } else if (!macro_save(MACRO_FILE)) {
+        state->error = 1;
+    }
+}
+
+static int long_view_available(const struct CalcState *state)
+{
+    return long_digits != NULL && state->entry_num_valid && state->just_result &&
+           state->entry_num.long_id == long_serial &&
+           strcmp(state->entry, state->entry_num_text) == 0;
+}
+
+/* Digits shown per page of the long view, after the "[position] " tag. */
+static int long_view_page(const struct CalcState *state)
+{
+    char tag[24];
+
+    sprintf(tag, "[%ld] ", state->long_pos + 1);
+    return DISP_CHARS - (int)strlen(tag);
+}
+
+/*
+ * Clicking the right half of the display pages forward through the exact
+ * digits of a long result, the left half back; paging back from the
+ * first digits returns to the normal rounded display.
+ */
+static void scroll_long_view(struct CalcState *state, int forward)
+{
+    if (state->error || !long_view_available(state)) {
+        return;
+    }
+    if (forward) {
+        if (state->long_pos < 0) {
+            state->long_pos = 0;
+        } else if (state->long_pos + long_view_page(state) < long_len) {
+            state->long_pos += long_view_page(state);
+        }
+    } else if (state->long_pos > 0) {
+        state->long_pos -= long_view_page(state);
+        if (state->long_pos < 0) {
+            state->long_pos = 0;
+        }
+    } else {
+        state->long_pos = -1;
+    }
+}
+
 static void get_display_value(const struct CalcState *state, char *out)
 {
     if (state->error) {
         strcpy(out, "ERR");
         return;
     }
+    if (state->root_pos >= 0) {
+        const struct PolyRoot *root = &poly_root_list[state->root_pos];
+        int digits;
+
+        /* "[k/n] re+im i", with as many digits as fit the display. */
+        for (digits = CALC_REAL_DIGITS; digits > 3; --digits) {
+            if (root->im == REAL_C(0.0)) {
+                sprintf(out, "[%d/%d] %.*g", state->root_pos + 1, poly_root_count, digits,
+                        (double)root->re);
+            } else {
+                sprintf(out, "[%d/%d] %.*g%+.*gi", state->root_pos + 1, poly_root_count,
+                        digits, (double)root->re, digits, (double)root->im);
+            }
+            if ((int)strlen(out) <= DISP_CHARS) {
+                break;
+            }
+        }
+        return;
+    }
+    if (state->long_pos >= 0 && long_view_available(state)) {
+        int len;
+        int page = long_view_page(state);
+
+        sprintf(out, "[%ld] ", state->long_pos + 1);
+        len = (int)strlen(out);
+        if (page > long_len - state->long_pos) {
+            page = (int)(long_len - state->long_pos);
+        }
+        memcpy(out + len, long_digits + state->long_pos, (size_t)page);
+        out[len + page] = '\0';
+        return;
+    }
     if (state->entry_len > 0) {
         strcpy(out, state->entry);
         return;
     }
     if (state->accum_set) {
-        sprintf(out, "%.15g", state->accum);
+        struct CalcNum accum;
+
+        num_from_accum(state, &accum);
+        format_num(state, &accum, out);
         return;
     }
     strcpy(out, "0");
 }
 
-static int button_left(const struct Button *btn)
-{
-    int base = (btn->group == 0) ? FUNC_X : KEY_X;
-    return base + btn->col * (BTN_W + BTN_X_SP);
-}
-
-static int button_top(const struct Button *btn)
-{
-    int base = (btn->group == 0) ? FUNC_Y : KEY_Y;
-    return base + btn->row * (BTN_H + BTN_Y_SP);
-}
-
 static int content_left(const struct Window *win)
 {
     if (win->Flags & GIMMEZEROZERO) {
@@ -1252,6 +4135,103 @@ static int content_bottom(const struct Window *win)
     return content_top(win) + content_height(win) - 1;
 }
 
+static int grid_col(const struct Button *btn)
+{
+    return (btn->group == 0) ? btn->col : FUNC_COLS + btn->col;
+}
+
+static void index_buttons(void)
+{
+    size_t i;
+
+    memset(grid_button, -1, sizeof(grid_button));
+    for (i = 0; i < sizeof(buttons) / sizeof(buttons[0]); ++i) {
+        grid_button[buttons[i].row][grid_col(&buttons[i])] = (BYTE)i;
+    }
+}
+
+static const struct Layout *window_layout(const struct Window *win)
+{
+    return (const struct Layout *)win->UserData;
+}
+
+static int button_left(const struct Layout *lay, const struct Button *btn)
+{
+    return lay->col_x[grid_col(btn)];
+}
+
+static int button_top(const struct Layout *lay, const struct Button *btn)
+{
+    return lay->row_y[btn->row];
+}
+
+/*
+ * Buttons share out the room the window gives them, but never get smaller
+ * than BTN_W x BTN_H or than the widest label and the font need. min_w and
+ * min_h are the smallest content size, which also keeps DISP_CHARS
+ * characters in the display.
+ */
+static void compute_layout(struct Layout *lay, const struct Window *win)
+{
+    int text_h = win->RPort->TxHeight;
+    int widest = 0;
+    int fixed_w = 2 * DISP_X + GAP_X + (GRID_COLS - 2) * BTN_X_SP;
+    int min_btn_w = BTN_W;
+    int min_btn_h = BTN_H;
+    int top;
+    int fixed_h;
+    int btn_w;
+    int btn_h;
+    size_t i;
+
+    for (i = 0; i < sizeof(buttons) / sizeof(buttons[0]); ++i) {
+        if (label_width[i][0] > widest) {
+            widest = label_width[i][0];
+        }
+        if (label_width[i][1] > widest) {
+            widest = label_width[i][1];
+        }
+    }
+    if (widest + 6 > min_btn_w) {
+        min_btn_w = widest + 6;
+    }
+    if (text_h + 6 > min_btn_h) {
+        min_btn_h = text_h + 6;
+    }
+    lay->disp_x = DISP_X;
+    lay->disp_y = DISP_Y;
+    lay->disp_h = (WORD)(text_h + 8 > DISP_H ? text_h + 8 : DISP_H);
+    top = DISP_Y + lay->disp_h + DISP_GAP;
+    fixed_h = top + GRID_ROWS * BTN_Y_SP;
+
+    btn_w = (content_width(win) - fixed_w) / GRID_COLS;
+    if (btn_w < min_btn_w) {
+        btn_w = min_btn_w;
+    }
+    btn_h = (content_height(win) - fixed_h) / GRID_ROWS;
+    if (btn_h < min_btn_h) {
+        btn_h = min_btn_h;
+    }
+    lay->btn_w = (WORD)btn_w;
+    lay->btn_h = (WORD)btn_h;
+    lay->pitch_x = (WORD)(btn_w + BTN_X_SP);
+    lay->pitch_y = (WORD)(btn_h + BTN_Y_SP);
+    for (i = 0; i < GRID_COLS; ++i) {
+        lay->col_x[i] = (WORD)(DISP_X + (int)i * lay->pitch_x +
+                               (i >= FUNC_COLS ? GAP_X - BTN_X_SP : 0));
+    }
+    for (i = 0; i < GRID_ROWS; ++i) {
+        lay->row_y[i] = (WORD)(top + (int)i * lay->pitch_y);
+    }
+    lay->min_w = (WORD)(fixed_w + GRID_COLS * min_btn_w);
+    if (lay->min_w < 2 * DISP_X + 8 + DISP_CHARS * win->RPort->TxWidth) {
+        lay->min_w = (WORD)(2 * DISP_X + 8 + DISP_CHARS * win->RPort->TxWidth);
+    }
+    lay->disp_w = (WORD)((content_width(win) > lay->min_w ? content_width(win) : lay->min_w) -
+                         2 * DISP_X);
+    lay->min_h = (WORD)(fixed_h + GRID_ROWS * min_btn_h);
+}
+
 static const char *button_label(const struct Button *btn, const struct CalcState *state)
 {
     if (state->inv) {
@@ -1265,14 +4245,14 @@ static const char *button_label(const struct Button *btn, const struct CalcState
     return btn->label;
 }
 
-static void draw_root_symbol(struct RastPort *rp, int x, int y)
+static void draw_root_symbol(struct RastPort *rp, const struct Layout *lay, int x, int y)
 {
     static const UWORD root_bits[ROOT_H] = {
         0x07F, 0x07F, 0x0C0, 0x180,
         0x300, 0x600, 0xC00, 0x800
     };
-    int tx = x + (BTN_W - ROOT_W) / 2;
-    int ty = y + (BTN_H - ROOT_H) / 2;
+    int tx = x + (lay->btn_w - ROOT_W) / 2;
+    int ty = y + (lay->btn_h - ROOT_H) / 2;
     int row;
 
     SetDrMd(rp, JAM1);
@@ -1305,44 +4285,168 @@ static int message_inner_y(const struct Window *win, const struct IntuiMessage *
     return msg->MouseY - win->BorderTop;
 }
 
-static void set_angle_mode(struct CalcState *state, int mode)
+/*
+ * The menus are shared by every window, so their checkmarks are set from
+ * the state of the window that is active.
+ */
+static void check_menus(const struct CalcState *state)
 {
-    state->angle_mode = mode;
-    if (mode == ANGLE_RAD) {
+    menu_item_rad.Flags &= ~CHECKED;
+    menu_item_deg.Flags &= ~CHECKED;
+    menu_item_expr.Flags &= ~CHECKED;
+    menu_item_decimal.Flags &= ~CHECKED;
+    menu_item_arith_real.Flags &= ~CHECKED;
+    menu_item_arith_dd.Flags &= ~CHECKED;
+    menu_item_arith_frac.Flags &= ~CHECKED;
+    menu_item_arith_cplx.Flags &= ~CHECKED;
+    if (state->angle_mode == ANGLE_RAD) {
         menu_item_rad.Flags |= CHECKED;
-        menu_item_deg.Flags &= ~CHECKED;
     } else {
         menu_item_deg.Flags |= CHECKED;
-        menu_item_rad.Flags &= ~CHECKED;
+    }
+    if (state->show_expr) {
+        menu_item_expr.Flags |= CHECKED;
+    }
+    if (state->show_decimal) {
+        menu_item_decimal.Flags |= CHECKED;
+    }
+    if (state->arith_mode == ARITH_REAL) {
+        menu_item_arith_real.Flags |= CHECKED;
+    } else if (state->arith_mode == ARITH_DD) {
+        menu_item_arith_dd.Flags |= CHECKED;
+    } else if (state->arith_mode == ARITH_FRAC) {
+        menu_item_arith_frac.Flags |= CHECKED;
+    } else {
+        menu_item_arith_cplx.Flags |= CHECKED;
     }
 }
 
+static void set_angle_mode(struct CalcState *state, int mode)
+{
+    state->angle_mode = mode;
+    check_menus(state);
+}
+
 static void set_show_expr(struct CalcState *state, int show)
 {
     state->show_expr = show;
-    if (show) {
-        menu_item_expr.Flags |= CHECKED;
-    } else {
-        menu_item_expr.Flags &= ~CHECKED;
+    check_menus(state);
+}
+
+static void set_show_decimal(struct CalcState *state, int show)
+{
+    state->show_decimal = show;
+    check_menus(state);
+    if (state->entry_num_valid && state->just_result && !state->error &&
+        strcmp(state->entry, state->entry_num_text) == 0) {
+        set_result_num(state, &state->entry_num);
+    }
+}
+
+/*
+ * Fractions are exact only in ARITH_FRAC; the other modes turn them into
+ * their own inexact kind, and ARITH_FRAC keeps doubles as double-double.
+ * Complex values keep only their real part outside ARITH_CPLX.
+ */
+static void convert_kind(int mode, int *kind, calc_real *real, struct DDReal *dd,
+                         const struct Ratio *rat)
+{
+    if (*kind == NUM_RAT && mode != ARITH_FRAC) {
+        *dd = ratio_to_dd(rat);
+        *kind = NUM_DD;
+    }
+    if (*kind == NUM_CPLX && mode != ARITH_CPLX) {
+        *kind = NUM_REAL;
+    }
+    if (mode_uses_dd(mode) && *kind == NUM_REAL) {
+        *dd = dd_from_double((double)*real);
+        *kind = NUM_DD;
+    } else if (!mode_uses_dd(mode) && *kind == NUM_DD) {
+        *real = (calc_real)dd->hi;
+        *kind = NUM_REAL;
     }
 }
 
-static void init_menus(struct Window *win, struct CalcState *state)
+static void set_arith_mode(struct CalcState *state, int mode)
+{
+    int i;
+
+    state->arith_mode = mode;
+    state->entry_num_valid = 0;
+    if (mode != ARITH_CPLX && strchr(state->entry, 'i') && !state->error) {
+        /* The entry keeps its real part. */
+        struct CalcNum num;
+
+        num_from_entry(state, &num);
+        set_result_num(state, &num);
+    }
+    convert_kind(mode, &state->accum_kind, &state->accum, &state->accum_dd,
+                 &state->accum_rat);
+    for (i = 0; i < state->paren_depth; ++i) {
+        convert_kind(mode, &state->paren_accum_kind[i], &state->paren_accum[i],
+                     &state->paren_accum_dd[i], &state->paren_accum_rat[i]);
+    }
+    check_menus(state);
+}
+
+static void init_menus(struct Window *win, const struct CalcState *state)
 {
     struct RastPort *rp = win->RPort;
     int menu_height = rp->TxHeight + 4;
     int menu_width = TextLength(rp, (UBYTE *)MENU_TITLE, (int)strlen(MENU_TITLE)) + 12;
     int mode_width = TextLength(rp, (UBYTE *)MENU_MODE_TITLE, (int)strlen(MENU_MODE_TITLE)) + 12;
     int view_width = TextLength(rp, (UBYTE *)MENU_VIEW_TITLE, (int)strlen(MENU_VIEW_TITLE)) + 12;
+    int arith_width = TextLength(rp, (UBYTE *)MENU_ARITH_TITLE, (int)strlen(MENU_ARITH_TITLE)) + 12;
+    int calc_width = TextLength(rp, (UBYTE *)MENU_CALC_TITLE, (int)strlen(MENU_CALC_TITLE)) + 12;
+    int poly_width = TextLength(rp, (UBYTE *)MENU_POLY_TITLE, (int)strlen(MENU_POLY_TITLE)) + 12;
+    int stat_width = TextLength(rp, (UBYTE *)MENU_STAT_TITLE, (int)strlen(MENU_STAT_TITLE)) + 12;
+    int sheet_width = TextLength(rp, (UBYTE *)MENU_SHEET_TITLE, (int)strlen(MENU_SHEET_TITLE)) + 12;
+    int vars_width = TextLength(rp, (UBYTE *)MENU_VARS_TITLE, (int)strlen(MENU_VARS_TITLE)) + 12;
+    int macro_width = TextLength(rp, (UBYTE *)MENU_MACRO_TITLE, (int)strlen(MENU_MACRO_TITLE)) + 12;
     int item_height = rp->TxHeight + 2;
     int pi_width = TextLength(rp, (UBYTE *)MENU_PI_LABEL, (int)strlen(MENU_PI_LABEL));
     int e_width = TextLength(rp, (UBYTE *)MENU_E_LABEL, (int)strlen(MENU_E_LABEL));
     int rad_width = TextLength(rp, (UBYTE *)MENU_RAD_LABEL, (int)strlen(MENU_RAD_LABEL));
     int deg_width = TextLength(rp, (UBYTE *)MENU_DEG_LABEL, (int)strlen(MENU_DEG_LABEL));
     int expr_width = TextLength(rp, (UBYTE *)MENU_EXPR_LABEL, (int)strlen(MENU_EXPR_LABEL));
+    int real_width = TextLength(rp, (UBYTE *)MENU_ARITH_REAL_LABEL, (int)strlen(MENU_ARITH_REAL_LABEL));
+    int dd_width = TextLength(rp, (UBYTE *)MENU_ARITH_DD_LABEL, (int)strlen(MENU_ARITH_DD_LABEL));
+    int frac_width = TextLength(rp, (UBYTE *)MENU_ARITH_FRAC_LABEL, (int)strlen(MENU_ARITH_FRAC_LABEL));
+    int cplx_width = TextLength(rp, (UBYTE *)MENU_ARITH_CPLX_LABEL, (int)strlen(MENU_ARITH_CPLX_LABEL));
+    int decimal_width = TextLength(rp, (UBYTE *)MENU_DECIMAL_LABEL, (int)strlen(MENU_DECIMAL_LABEL));
+    int new_window_width = TextLength(rp, (UBYTE *)MENU_NEW_WINDOW_LABEL,
+                                      (int)strlen(MENU_NEW_WINDOW_LABEL));
+    int to_inf_width = TextLength(rp, (UBYTE *)MENU_INT_TO_INF_LABEL,
+                                  (int)strlen(MENU_INT_TO_INF_LABEL));
+    int mc_width = TextLength(rp, (UBYTE *)MENU_MC_UNIFORM_LABEL,
+                              (int)strlen(MENU_MC_UNIFORM_LABEL));
+    int coef_width = TextLength(rp, (UBYTE *)MENU_POLY_COEF_LABEL,
+                                (int)strlen(MENU_POLY_COEF_LABEL));
     int item_width = (pi_width > e_width ? pi_width : e_width) + 12;
     int mode_item_width = (rad_width > deg_width ? rad_width : deg_width) + CHECKWIDTH + 8;
-    int view_item_width = expr_width + CHECKWIDTH + 8;
+    int view_item_width = (expr_width > decimal_width ? expr_width : decimal_width) + CHECKWIDTH + 8;
+    int arith_item_width = (real_width > dd_width ? real_width : dd_width);
+    int calc_item_width = (mc_width > to_inf_width ? mc_width : to_inf_width) + 12;
+    int poly_item_width = coef_width + 12;
+    int stat_item_width = TextLength(rp, (UBYTE *)MENU_STAT_CORR_LABEL,
+                                     (int)strlen(MENU_STAT_CORR_LABEL)) + 12;
+    int sheet_item_width = TextLength(rp, (UBYTE *)MENU_SHEET_REF_LABEL,
+                                      (int)strlen(MENU_SHEET_REF_LABEL)) + 12;
+    int vars_item_width = TextLength(rp, (UBYTE *)MENU_VAR_DEFINE_LABEL,
+                                     (int)strlen(MENU_VAR_DEFINE_LABEL)) + 12;
+    int macro_item_width = TextLength(rp, (UBYTE *)MENU_MACRO_1_LABEL,
+                                      (int)strlen(MENU_MACRO_1_LABEL)) + 12;
+
+    if (new_window_width + CHECKWIDTH + 8 > view_item_width) {
+        view_item_width = new_window_width + CHECKWIDTH + 8;
+    }
+    if (frac_width > arith_item_width) {
+        arith_item_width = frac_width;
+    }
+    if (cplx_width > arith_item_width) {
+        arith_item_width = cplx_width;
+    }
+    arith_item_width += CHECKWIDTH + 8;
 
     memset(&menu_constants, 0, sizeof(menu_constants));
     menu_constants.LeftEdge = 0;
@@ -1464,10 +4568,10 @@ static void init_menus(struct Window *win, struct CalcState *state)
     menu_view.Flags = MENUENABLED;
     menu_view.MenuName = (BYTE *)MENU_VIEW_TITLE;
     menu_view.FirstItem = &menu_item_expr;
-    menu_view.NextMenu = NULL;
+    menu_view.NextMenu = &menu_arith;
 
     memset(&menu_item_expr, 0, sizeof(menu_item_expr));
-    menu_item_expr.NextItem = NULL;
+    menu_item_expr.NextItem = &menu_item_decimal;
     menu_item_expr.LeftEdge = 0;
     menu_item_expr.TopEdge = 0;
     menu_item_expr.Width = view_item_width;
@@ -1489,13 +4593,1193 @@ static void init_menus(struct Window *win, struct CalcState *state)
     menu_text_expr.IText = (UBYTE *)MENU_EXPR_LABEL;
     menu_text_expr.NextText = NULL;
 
-    set_angle_mode(state, state->angle_mode);
-    set_show_expr(state, state->show_expr);
+    memset(&menu_item_decimal, 0, sizeof(menu_item_decimal));
+    menu_item_decimal.NextItem = &menu_item_new_window;
+    menu_item_decimal.LeftEdge = 0;
+    menu_item_decimal.TopEdge = item_height;
+    menu_item_decimal.Width = view_item_width;
+    menu_item_decimal.Height = item_height;
+    menu_item_decimal.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP | CHECKIT | MENUTOGGLE;
+    menu_item_decimal.ItemFill = (APTR)&menu_text_decimal;
+    menu_item_decimal.SelectFill = NULL;
+    menu_item_decimal.Command = 0;
+    menu_item_decimal.SubItem = NULL;
+    menu_item_decimal.NextSelect = MENUNULL;
+    menu_item_decimal.MutualExclude = 0;
+
+    menu_text_decimal.FrontPen = 0;
+    menu_text_decimal.BackPen = 1;
+    menu_text_decimal.DrawMode = JAM2;
+    menu_text_decimal.LeftEdge = CHECKWIDTH;
+    menu_text_decimal.TopEdge = 1;
+    menu_text_decimal.ITextFont = NULL;
+    menu_text_decimal.IText = (UBYTE *)MENU_DECIMAL_LABEL;
+    menu_text_decimal.NextText = NULL;
+
+    memset(&menu_item_new_window, 0, sizeof(menu_item_new_window));
+    menu_item_new_window.NextItem = &menu_item_history;
+    menu_item_new_window.LeftEdge = 0;
+    menu_item_new_window.TopEdge = 2 * item_height;
+    menu_item_new_window.Width = view_item_width;
+    menu_item_new_window.Height = item_height;
+    menu_item_new_window.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_new_window.ItemFill = (APTR)&menu_text_new_window;
+    menu_item_new_window.SelectFill = NULL;
+    menu_item_new_window.Command = 0;
+    menu_item_new_window.SubItem = NULL;
+    menu_item_new_window.NextSelect = MENUNULL;
+    menu_item_new_window.MutualExclude = 0;
+
+    menu_text_new_window.FrontPen = 0;
+    menu_text_new_window.BackPen = 1;
+    menu_text_new_window.DrawMode = JAM2;
+    menu_text_new_window.LeftEdge = CHECKWIDTH;
+    menu_text_new_window.TopEdge = 1;
+    menu_text_new_window.ITextFont = NULL;
+    menu_text_new_window.IText = (UBYTE *)MENU_NEW_WINDOW_LABEL;
+    menu_text_new_window.NextText = NULL;
+
+    memset(&menu_item_history, 0, sizeof(menu_item_history));
+    menu_item_history.NextItem = &menu_item_search;
+    menu_item_history.LeftEdge = 0;
+    menu_item_history.TopEdge = 3 * item_height;
+    menu_item_history.Width = view_item_width;
+    menu_item_history.Height = item_height;
+    menu_item_history.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_history.ItemFill = (APTR)&menu_text_history;
+    menu_item_history.SelectFill = NULL;
+    menu_item_history.Command = 0;
+    menu_item_history.SubItem = NULL;
+    menu_item_history.NextSelect = MENUNULL;
+    menu_item_history.MutualExclude = 0;
+
+    menu_text_history.FrontPen = 0;
+    menu_text_history.BackPen = 1;
+    menu_text_history.DrawMode = JAM2;
+    menu_text_history.LeftEdge = CHECKWIDTH;
+    menu_text_history.TopEdge = 1;
+    menu_text_history.ITextFont = NULL;
+    menu_text_history.IText = (UBYTE *)MENU_HISTORY_LABEL;
+    menu_text_history.NextText = NULL;
+
+    memset(&menu_item_search, 0, sizeof(menu_item_search));
+    menu_item_search.NextItem = NULL;
+    menu_item_search.LeftEdge = 0;
+    menu_item_search.TopEdge = 4 * item_height;
+    menu_item_search.Width = view_item_width;
+    menu_item_search.Height = item_height;
+    menu_item_search.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_search.ItemFill = (APTR)&menu_text_search;
+    menu_item_search.SelectFill = NULL;
+    menu_item_search.Command = 0;
+    menu_item_search.SubItem = NULL;
+    menu_item_search.NextSelect = MENUNULL;
+    menu_item_search.MutualExclude = 0;
+
+    menu_text_search.FrontPen = 0;
+    menu_text_search.BackPen = 1;
+    menu_text_search.DrawMode = JAM2;
+    menu_text_search.LeftEdge = CHECKWIDTH;
+    menu_text_search.TopEdge = 1;
+    menu_text_search.ITextFont = NULL;
+    menu_text_search.IText = (UBYTE *)MENU_SEARCH_LABEL;
+    menu_text_search.NextText = NULL;
+
+    memset(&menu_arith, 0, sizeof(menu_arith));
+    menu_arith.LeftEdge = menu_width + mode_width + view_width;
+    menu_arith.TopEdge = 0;
+    menu_arith.Width = arith_width;
+    menu_arith.Height = menu_height;
+    menu_arith.Flags = MENUENABLED;
+    menu_arith.MenuName = (BYTE *)MENU_ARITH_TITLE;
+    menu_arith.FirstItem = &menu_item_arith_real;
+    menu_arith.NextMenu = &menu_calc;
+
+    memset(&menu_item_arith_real, 0, sizeof(menu_item_arith_real));
+    menu_item_arith_real.NextItem = &menu_item_arith_dd;
+    menu_item_arith_real.LeftEdge = 0;
+    menu_item_arith_real.TopEdge = 0;
+    menu_item_arith_real.Width = arith_item_width;
+    menu_item_arith_real.Height = item_height;
+    menu_item_arith_real.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP | CHECKIT | MENUTOGGLE;
+    menu_item_arith_real.ItemFill = (APTR)&menu_text_arith_real;
+    menu_item_arith_real.SelectFill = NULL;
+    menu_item_arith_real.Command = 0;
+    menu_item_arith_real.SubItem = NULL;
+    menu_item_arith_real.NextSelect = MENUNULL;
+    menu_item_arith_real.MutualExclude = (1 << ITEM_ARITH_DD) | (1 << ITEM_ARITH_FRAC) |
+                                         (1 << ITEM_ARITH_CPLX);
+
+    memset(&menu_item_arith_dd, 0, sizeof(menu_item_arith_dd));
+    menu_item_arith_dd.NextItem = &menu_item_arith_frac;
+    menu_item_arith_dd.LeftEdge = 0;
+    menu_item_arith_dd.TopEdge = item_height;
+    menu_item_arith_dd.Width = arith_item_width;
+    menu_item_arith_dd.Height = item_height;
+    menu_item_arith_dd.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP | CHECKIT | MENUTOGGLE;
+    menu_item_arith_dd.ItemFill = (APTR)&menu_text_arith_dd;
+    menu_item_arith_dd.SelectFill = NULL;
+    menu_item_arith_dd.Command = 0;
+    menu_item_arith_dd.SubItem = NULL;
+    menu_item_arith_dd.NextSelect = MENUNULL;
+    menu_item_arith_dd.MutualExclude = (1 << ITEM_ARITH_REAL) | (1 << ITEM_ARITH_FRAC) |
+                                       (1 << ITEM_ARITH_CPLX);
+
+    memset(&menu_item_arith_frac, 0, sizeof(menu_item_arith_frac));
+    menu_item_arith_frac.NextItem = &menu_item_arith_cplx;
+    menu_item_arith_frac.LeftEdge = 0;
+    menu_item_arith_frac.TopEdge = 2 * item_height;
+    menu_item_arith_frac.Width = arith_item_width;
+    menu_item_arith_frac.Height = item_height;
+    menu_item_arith_frac.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP | CHECKIT | MENUTOGGLE;
+    menu_item_arith_frac.ItemFill = (APTR)&menu_text_arith_frac;
+    menu_item_arith_frac.SelectFill = NULL;
+    menu_item_arith_frac.Command = 0;
+    menu_item_arith_frac.SubItem = NULL;
+    menu_item_arith_frac.NextSelect = MENUNULL;
+    menu_item_arith_frac.MutualExclude = (1 << ITEM_ARITH_REAL) | (1 << ITEM_ARITH_DD) |
+                                         (1 << ITEM_ARITH_CPLX);
+
+    memset(&menu_item_arith_cplx, 0, sizeof(menu_item_arith_cplx));
+    menu_item_arith_cplx.NextItem = NULL;
+    menu_item_arith_cplx.LeftEdge = 0;
+    menu_item_arith_cplx.TopEdge = 3 * item_height;
+    menu_item_arith_cplx.Width = arith_item_width;
+    menu_item_arith_cplx.Height = item_height;
+    menu_item_arith_cplx.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP | CHECKIT | MENUTOGGLE;
+    menu_item_arith_cplx.ItemFill = (APTR)&menu_text_arith_cplx;
+    menu_item_arith_cplx.SelectFill = NULL;
+    menu_item_arith_cplx.Command = 0;
+    menu_item_arith_cplx.SubItem = NULL;
+    menu_item_arith_cplx.NextSelect = MENUNULL;
+    menu_item_arith_cplx.MutualExclude = (1 << ITEM_ARITH_REAL) | (1 << ITEM_ARITH_DD) |
+                                         (1 << ITEM_ARITH_FRAC);
+
+    menu_text_arith_real.FrontPen = 0;
+    menu_text_arith_real.BackPen = 1;
+    menu_text_arith_real.DrawMode = JAM2;
+    menu_text_arith_real.LeftEdge = CHECKWIDTH;
+    menu_text_arith_real.TopEdge = 1;
+    menu_text_arith_real.ITextFont = NULL;
+    menu_text_arith_real.IText = (UBYTE *)MENU_ARITH_REAL_LABEL;
+    menu_text_arith_real.NextText = NULL;
+
+    menu_text_arith_dd.FrontPen = 0;
+    menu_text_arith_dd.BackPen = 1;
+    menu_text_arith_dd.DrawMode = JAM2;
+    menu_text_arith_dd.LeftEdge = CHECKWIDTH;
+    menu_text_arith_dd.TopEdge = 1;
+    menu_text_arith_dd.ITextFont = NULL;
+    menu_text_arith_dd.IText = (UBYTE *)MENU_ARITH_DD_LABEL;
+    menu_text_arith_dd.NextText = NULL;
+
+    menu_text_arith_frac.FrontPen = 0;
+    menu_text_arith_frac.BackPen = 1;
+    menu_text_arith_frac.DrawMode = JAM2;
+    menu_text_arith_frac.LeftEdge = CHECKWIDTH;
+    menu_text_arith_frac.TopEdge = 1;
+    menu_text_arith_frac.ITextFont = NULL;
+    menu_text_arith_frac.IText = (UBYTE *)MENU_ARITH_FRAC_LABEL;
+    menu_text_arith_frac.NextText = NULL;
+
+    menu_text_arith_cplx.FrontPen = 0;
+    menu_text_arith_cplx.BackPen = 1;
+    menu_text_arith_cplx.DrawMode = JAM2;
+    menu_text_arith_cplx.LeftEdge = CHECKWIDTH;
+    menu_text_arith_cplx.TopEdge = 1;
+    menu_text_arith_cplx.ITextFont = NULL;
+    menu_text_arith_cplx.IText = (UBYTE *)MENU_ARITH_CPLX_LABEL;
+    menu_text_arith_cplx.NextText = NULL;
+
+    memset(&menu_calc, 0, sizeof(menu_calc));
+    menu_calc.LeftEdge = menu_width + mode_width + view_width + arith_width;
+    menu_calc.TopEdge = 0;
+    menu_calc.Width = calc_width;
+    menu_calc.Height = menu_height;
+    menu_calc.Flags = MENUENABLED;
+    menu_calc.MenuName = (BYTE *)MENU_CALC_TITLE;
+    menu_calc.FirstItem = &menu_item_solve;
+    menu_calc.NextMenu = &menu_poly;
+
+    memset(&menu_item_solve, 0, sizeof(menu_item_solve));
+    menu_item_solve.NextItem = &menu_item_int_from;
+    menu_item_solve.LeftEdge = 0;
+    menu_item_solve.TopEdge = 0;
+    menu_item_solve.Width = calc_item_width;
+    menu_item_solve.Height = item_height;
+    menu_item_solve.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_solve.ItemFill = (APTR)&menu_text_solve;
+    menu_item_solve.SelectFill = NULL;
+    menu_item_solve.Command = 0;
+    menu_item_solve.SubItem = NULL;
+    menu_item_solve.NextSelect = MENUNULL;
+    menu_item_solve.MutualExclude = 0;
+
+    menu_text_solve.FrontPen = 0;
+    menu_text_solve.BackPen = 1;
+    menu_text_solve.DrawMode = JAM2;
+    menu_text_solve.LeftEdge = 2;
+    menu_text_solve.TopEdge = 1;
+    menu_text_solve.ITextFont = NULL;
+    menu_text_solve.IText = (UBYTE *)MENU_SOLVE_LABEL;
+    menu_text_solve.NextText = NULL;
+
+    memset(&menu_item_int_from, 0, sizeof(menu_item_int_from));
+    menu_item_int_from.NextItem = &menu_item_int_to;
+    menu_item_int_from.LeftEdge = 0;
+    menu_item_int_from.TopEdge = item_height;
+    menu_item_int_from.Width = calc_item_width;
+    menu_item_int_from.Height = item_height;
+    menu_item_int_from.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_int_from.ItemFill = (APTR)&menu_text_int_from;
+    menu_item_int_from.SelectFill = NULL;
+    menu_item_int_from.Command = 0;
+    menu_item_int_from.SubItem = NULL;
+    menu_item_int_from.NextSelect = MENUNULL;
+    menu_item_int_from.MutualExclude = 0;
+
+    menu_text_int_from.FrontPen = 0;
+    menu_text_int_from.BackPen = 1;
+    menu_text_int_from.DrawMode = JAM2;
+    menu_text_int_from.LeftEdge = 2;
+    menu_text_int_from.TopEdge = 1;
+    menu_text_int_from.ITextFont = NULL;
+    menu_text_int_from.IText = (UBYTE *)MENU_INT_FROM_LABEL;
+    menu_text_int_from.NextText = NULL;
+
+    memset(&menu_item_int_to, 0, sizeof(menu_item_int_to));
+    menu_item_int_to.NextItem = &menu_item_int_to_inf;
+    menu_item_int_to.LeftEdge = 0;
+    menu_item_int_to.TopEdge = 2 * item_height;
+    menu_item_int_to.Width = calc_item_width;
+    menu_item_int_to.Height = item_height;
+    menu_item_int_to.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_int_to.ItemFill = (APTR)&menu_text_int_to;
+    menu_item_int_to.SelectFill = NULL;
+    menu_item_int_to.Command = 0;
+    menu_item_int_to.SubItem = NULL;
+    menu_item_int_to.NextSelect = MENUNULL;
+    menu_item_int_to.MutualExclude = 0;
+
+    menu_text_int_to.FrontPen = 0;
+    menu_text_int_to.BackPen = 1;
+    menu_text_int_to.DrawMode = JAM2;
+    menu_text_int_to.LeftEdge = 2;
+    menu_text_int_to.TopEdge = 1;
+    menu_text_int_to.ITextFont = NULL;
+    menu_text_int_to.IText = (UBYTE *)MENU_INT_TO_LABEL;
+    menu_text_int_to.NextText = NULL;
+
+    memset(&menu_item_int_to_inf, 0, sizeof(menu_item_int_to_inf));
+    menu_item_int_to_inf.NextItem = &menu_item_integrate;
+    menu_item_int_to_inf.LeftEdge = 0;
+    menu_item_int_to_inf.TopEdge = 3 * item_height;
+    menu_item_int_to_inf.Width = calc_item_width;
+    menu_item_int_to_inf.Height = item_height;
+    menu_item_int_to_inf.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_int_to_inf.ItemFill = (APTR)&menu_text_int_to_inf;
+    menu_item_int_to_inf.SelectFill = NULL;
+    menu_item_int_to_inf.Command = 0;
+    menu_item_int_to_inf.SubItem = NULL;
+    menu_item_int_to_inf.NextSelect = MENUNULL;
+    menu_item_int_to_inf.MutualExclude = 0;
+
+    menu_text_int_to_inf.FrontPen = 0;
+    menu_text_int_to_inf.BackPen = 1;
+    menu_text_int_to_inf.DrawMode = JAM2;
+    menu_text_int_to_inf.LeftEdge = 2;
+    menu_text_int_to_inf.TopEdge = 1;
+    menu_text_int_to_inf.ITextFont = NULL;
+    menu_text_int_to_inf.IText = (UBYTE *)MENU_INT_TO_INF_LABEL;
+    menu_text_int_to_inf.NextText = NULL;
+
+    memset(&menu_item_integrate, 0, sizeof(menu_item_integrate));
+    menu_item_integrate.NextItem = &menu_item_sum;
+    menu_item_integrate.LeftEdge = 0;
+    menu_item_integrate.TopEdge = 4 * item_height;
+    menu_item_integrate.Width = calc_item_width;
+    menu_item_integrate.Height = item_height;
+    menu_item_integrate.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_integrate.ItemFill = (APTR)&menu_text_integrate;
+    menu_item_integrate.SelectFill = NULL;
+    menu_item_integrate.Command = 0;
+    menu_item_integrate.SubItem = NULL;
+    menu_item_integrate.NextSelect = MENUNULL;
+    menu_item_integrate.MutualExclude = 0;
+
+    menu_text_integrate.FrontPen = 0;
+    menu_text_integrate.BackPen = 1;
+    menu_text_integrate.DrawMode = JAM2;
+    menu_text_integrate.LeftEdge = 2;
+    menu_text_integrate.TopEdge = 1;
+    menu_text_integrate.ITextFont = NULL;
+    menu_text_integrate.IText = (UBYTE *)MENU_INTEGRATE_LABEL;
+    menu_text_integrate.NextText = NULL;
+
+    memset(&menu_item_sum, 0, sizeof(menu_item_sum));
+    menu_item_sum.NextItem = &menu_item_product;
+    menu_item_sum.LeftEdge = 0;
+    menu_item_sum.TopEdge = 5 * item_height;
+    menu_item_sum.Width = calc_item_width;
+    menu_item_sum.Height = item_height;
+    menu_item_sum.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_sum.ItemFill = (APTR)&menu_text_sum;
+    menu_item_sum.SelectFill = NULL;
+    menu_item_sum.Command = 0;
+    menu_item_sum.SubItem = NULL;
+    menu_item_sum.NextSelect = MENUNULL;
+    menu_item_sum.MutualExclude = 0;
+
+    menu_text_sum.FrontPen = 0;
+    menu_text_sum.BackPen = 1;
+    menu_text_sum.DrawMode = JAM2;
+    menu_text_sum.LeftEdge = 2;
+    menu_text_sum.TopEdge = 1;
+    menu_text_sum.ITextFont = NULL;
+    menu_text_sum.IText = (UBYTE *)MENU_SUM_LABEL;
+    menu_text_sum.NextText = NULL;
+
+    memset(&menu_item_product, 0, sizeof(menu_item_product));
+    menu_item_product.NextItem = &menu_item_mc_uniform;
+    menu_item_product.LeftEdge = 0;
+    menu_item_product.TopEdge = 6 * item_height;
+    menu_item_product.Width = calc_item_width;
+    menu_item_product.Height = item_height;
+    menu_item_product.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_product.ItemFill = (APTR)&menu_text_product;
+    menu_item_product.SelectFill = NULL;
+    menu_item_product.Command = 0;
+    menu_item_product.SubItem = NULL;
+    menu_item_product.NextSelect = MENUNULL;
+    menu_item_product.MutualExclude = 0;
+
+    menu_text_product.FrontPen = 0;
+    menu_text_product.BackPen = 1;
+    menu_text_product.DrawMode = JAM2;
+    menu_text_product.LeftEdge = 2;
+    menu_text_product.TopEdge = 1;
+    menu_text_product.ITextFont = NULL;
+    menu_text_product.IText = (UBYTE *)MENU_PRODUCT_LABEL;
+    menu_text_product.NextText = NULL;
+
+    memset(&menu_item_mc_uniform, 0, sizeof(menu_item_mc_uniform));
+    menu_item_mc_uniform.NextItem = &menu_item_mc_normal;
+    menu_item_mc_uniform.LeftEdge = 0;
+    menu_item_mc_uniform.TopEdge = 7 * item_height;
+    menu_item_mc_uniform.Width = calc_item_width;
+    menu_item_mc_uniform.Height = item_height;
+    menu_item_mc_uniform.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_mc_uniform.ItemFill = (APTR)&menu_text_mc_uniform;
+    menu_item_mc_uniform.SelectFill = NULL;
+    menu_item_mc_uniform.Command = 0;
+    menu_item_mc_uniform.SubItem = NULL;
+    menu_item_mc_uniform.NextSelect = MENUNULL;
+    menu_item_mc_uniform.MutualExclude = 0;
+
+    menu_text_mc_uniform.FrontPen = 0;
+    menu_text_mc_uniform.BackPen = 1;
+    menu_text_mc_uniform.DrawMode = JAM2;
+    menu_text_mc_uniform.LeftEdge = 2;
+    menu_text_mc_uniform.TopEdge = 1;
+    menu_text_mc_uniform.ITextFont = NULL;
+    menu_text_mc_uniform.IText = (UBYTE *)MENU_MC_UNIFORM_LABEL;
+    menu_text_mc_uniform.NextText = NULL;
+
+    memset(&menu_item_mc_normal, 0, sizeof(menu_item_mc_normal));
+    menu_item_mc_normal.NextItem = NULL;
+    menu_item_mc_normal.LeftEdge = 0;
+    menu_item_mc_normal.TopEdge = 8 * item_height;
+    menu_item_mc_normal.Width = calc_item_width;
+    menu_item_mc_normal.Height = item_height;
+    menu_item_mc_normal.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_mc_normal.ItemFill = (APTR)&menu_text_mc_normal;
+    menu_item_mc_normal.SelectFill = NULL;
+    menu_item_mc_normal.Command = 0;
+    menu_item_mc_normal.SubItem = NULL;
+    menu_item_mc_normal.NextSelect = MENUNULL;
+    menu_item_mc_normal.MutualExclude = 0;
+
+    menu_text_mc_normal.FrontPen = 0;
+    menu_text_mc_normal.BackPen = 1;
+    menu_text_mc_normal.DrawMode = JAM2;
+    menu_text_mc_normal.LeftEdge = 2;
+    menu_text_mc_normal.TopEdge = 1;
+    menu_text_mc_normal.ITextFont = NULL;
+    menu_text_mc_normal.IText = (UBYTE *)MENU_MC_NORMAL_LABEL;
+    menu_text_mc_normal.NextText = NULL;
+
+    memset(&menu_poly, 0, sizeof(menu_poly));
+    menu_poly.LeftEdge = menu_width + mode_width + view_width + arith_width + calc_width;
+    menu_poly.TopEdge = 0;
+    menu_poly.Width = poly_width;
+    menu_poly.Height = menu_height;
+    menu_poly.Flags = MENUENABLED;
+    menu_poly.MenuName = (BYTE *)MENU_POLY_TITLE;
+    menu_poly.FirstItem = &menu_item_poly_coef;
+    menu_poly.NextMenu = &menu_stat;
+
+    memset(&menu_item_poly_coef, 0, sizeof(menu_item_poly_coef));
+    menu_item_poly_coef.NextItem = &menu_item_poly_eval;
+    menu_item_poly_coef.LeftEdge = 0;
+    menu_item_poly_coef.TopEdge = 0;
+    menu_item_poly_coef.Width = poly_item_width;
+    menu_item_poly_coef.Height = item_height;
+    menu_item_poly_coef.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_poly_coef.ItemFill = (APTR)&menu_text_poly_coef;
+    menu_item_poly_coef.SelectFill = NULL;
+    menu_item_poly_coef.Command = 0;
+    menu_item_poly_coef.SubItem = NULL;
+    menu_item_poly_coef.NextSelect = MENUNULL;
+    menu_item_poly_coef.MutualExclude = 0;
+
+    menu_text_poly_coef.FrontPen = 0;
+    menu_text_poly_coef.BackPen = 1;
+    menu_text_poly_coef.DrawMode = JAM2;
+    menu_text_poly_coef.LeftEdge = 2;
+    menu_text_poly_coef.TopEdge = 1;
+    menu_text_poly_coef.ITextFont = NULL;
+    menu_text_poly_coef.IText = (UBYTE *)MENU_POLY_COEF_LABEL;
+    menu_text_poly_coef.NextText = NULL;
+
+    memset(&menu_item_poly_eval, 0, sizeof(menu_item_poly_eval));
+    menu_item_poly_eval.NextItem = &menu_item_poly_roots;
+    menu_item_poly_eval.LeftEdge = 0;
+    menu_item_poly_eval.TopEdge = item_height;
+    menu_item_poly_eval.Width = poly_item_width;
+    menu_item_poly_eval.Height = item_height;
+    menu_item_poly_eval.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_poly_eval.ItemFill = (APTR)&menu_text_poly_eval;
+    menu_item_poly_eval.SelectFill = NULL;
+    menu_item_poly_eval.Command = 0;
+    menu_item_poly_eval.SubItem = NULL;
+    menu_item_poly_eval.NextSelect = MENUNULL;
+    menu_item_poly_eval.MutualExclude = 0;
+
+    menu_text_poly_eval.FrontPen = 0;
+    menu_text_poly_eval.BackPen = 1;
+    menu_text_poly_eval.DrawMode = JAM2;
+    menu_text_poly_eval.LeftEdge = 2;
+    menu_text_poly_eval.TopEdge = 1;
+    menu_text_poly_eval.ITextFont = NULL;
+    menu_text_poly_eval.IText = (UBYTE *)MENU_POLY_EVAL_LABEL;
+    menu_text_poly_eval.NextText = NULL;
+
+    memset(&menu_item_poly_roots, 0, sizeof(menu_item_poly_roots));
+    menu_item_poly_roots.NextItem = &menu_item_poly_clear;
+    menu_item_poly_roots.LeftEdge = 0;
+    menu_item_poly_roots.TopEdge = 2 * item_height;
+    menu_item_poly_roots.Width = poly_item_width;
+    menu_item_poly_roots.Height = item_height;
+    menu_item_poly_roots.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_poly_roots.ItemFill = (APTR)&menu_text_poly_roots;
+    menu_item_poly_roots.SelectFill = NULL;
+    menu_item_poly_roots.Command = 0;
+    menu_item_poly_roots.SubItem = NULL;
+    menu_item_poly_roots.NextSelect = MENUNULL;
+    menu_item_poly_roots.MutualExclude = 0;
+
+    menu_text_poly_roots.FrontPen = 0;
+    menu_text_poly_roots.BackPen = 1;
+    menu_text_poly_roots.DrawMode = JAM2;
+    menu_text_poly_roots.LeftEdge = 2;
+    menu_text_poly_roots.TopEdge = 1;
+    menu_text_poly_roots.ITextFont = NULL;
+    menu_text_poly_roots.IText = (UBYTE *)MENU_POLY_ROOTS_LABEL;
+    menu_text_poly_roots.NextText = NULL;
+
+    memset(&menu_item_poly_clear, 0, sizeof(menu_item_poly_clear));
+    menu_item_poly_clear.NextItem = NULL;
+    menu_item_poly_clear.LeftEdge = 0;
+    menu_item_poly_clear.TopEdge = 3 * item_height;
+    menu_item_poly_clear.Width = poly_item_width;
+    menu_item_poly_clear.Height = item_height;
+    menu_item_poly_clear.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_poly_clear.ItemFill = (APTR)&menu_text_poly_clear;
+    menu_item_poly_clear.SelectFill = NULL;
+    menu_item_poly_clear.Command = 0;
+    menu_item_poly_clear.SubItem = NULL;
+    menu_item_poly_clear.NextSelect = MENUNULL;
+    menu_item_poly_clear.MutualExclude = 0;
+
+    menu_text_poly_clear.FrontPen = 0;
+    menu_text_poly_clear.BackPen = 1;
+    menu_text_poly_clear.DrawMode = JAM2;
+    menu_text_poly_clear.LeftEdge = 2;
+    menu_text_poly_clear.TopEdge = 1;
+    menu_text_poly_clear.ITextFont = NULL;
+    menu_text_poly_clear.IText = (UBYTE *)MENU_POLY_CLEAR_LABEL;
+    menu_text_poly_clear.NextText = NULL;
+
+    memset(&menu_stat, 0, sizeof(menu_stat));
+    menu_stat.LeftEdge = menu_width + mode_width + view_width + arith_width + calc_width + poly_width;
+    menu_stat.TopEdge = 0;
+    menu_stat.Width = stat_width;
+    menu_stat.Height = menu_height;
+    menu_stat.Flags = MENUENABLED;
+    menu_stat.MenuName = (BYTE *)MENU_STAT_TITLE;
+    menu_stat.FirstItem = &menu_item_stat_x;
+    menu_stat.NextMenu = &menu_sheet;
+
+    memset(&menu_item_stat_x, 0, sizeof(menu_item_stat_x));
+    menu_item_stat_x.NextItem = &menu_item_stat_n;
+    menu_item_stat_x.LeftEdge = 0;
+    menu_item_stat_x.TopEdge = 0;
+    menu_item_stat_x.Width = stat_item_width;
+    menu_item_stat_x.Height = item_height;
+    menu_item_stat_x.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_x.ItemFill = (APTR)&menu_text_stat_x;
+    menu_item_stat_x.SelectFill = NULL;
+    menu_item_stat_x.Command = 0;
+    menu_item_stat_x.SubItem = NULL;
+    menu_item_stat_x.NextSelect = MENUNULL;
+    menu_item_stat_x.MutualExclude = 0;
+
+    menu_text_stat_x.FrontPen = 0;
+    menu_text_stat_x.BackPen = 1;
+    menu_text_stat_x.DrawMode = JAM2;
+    menu_text_stat_x.LeftEdge = 2;
+    menu_text_stat_x.TopEdge = 1;
+    menu_text_stat_x.ITextFont = NULL;
+    menu_text_stat_x.IText = (UBYTE *)MENU_STAT_X_LABEL;
+    menu_text_stat_x.NextText = NULL;
+
+    memset(&menu_item_stat_n, 0, sizeof(menu_item_stat_n));
+    menu_item_stat_n.NextItem = &menu_item_stat_mean;
+    menu_item_stat_n.LeftEdge = 0;
+    menu_item_stat_n.TopEdge = item_height;
+    menu_item_stat_n.Width = stat_item_width;
+    menu_item_stat_n.Height = item_height;
+    menu_item_stat_n.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_n.ItemFill = (APTR)&menu_text_stat_n;
+    menu_item_stat_n.SelectFill = NULL;
+    menu_item_stat_n.Command = 0;
+    menu_item_stat_n.SubItem = NULL;
+    menu_item_stat_n.NextSelect = MENUNULL;
+    menu_item_stat_n.MutualExclude = 0;
+
+    menu_text_stat_n.FrontPen = 0;
+    menu_text_stat_n.BackPen = 1;
+    menu_text_stat_n.DrawMode = JAM2;
+    menu_text_stat_n.LeftEdge = 2;
+    menu_text_stat_n.TopEdge = 1;
+    menu_text_stat_n.ITextFont = NULL;
+    menu_text_stat_n.IText = (UBYTE *)MENU_STAT_N_LABEL;
+    menu_text_stat_n.NextText = NULL;
+
+    memset(&menu_item_stat_mean, 0, sizeof(menu_item_stat_mean));
+    menu_item_stat_mean.NextItem = &menu_item_stat_sdev;
+    menu_item_stat_mean.LeftEdge = 0;
+    menu_item_stat_mean.TopEdge = 2 * item_height;
+    menu_item_stat_mean.Width = stat_item_width;
+    menu_item_stat_mean.Height = item_height;
+    menu_item_stat_mean.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_mean.ItemFill = (APTR)&menu_text_stat_mean;
+    menu_item_stat_mean.SelectFill = NULL;
+    menu_item_stat_mean.Command = 0;
+    menu_item_stat_mean.SubItem = NULL;
+    menu_item_stat_mean.NextSelect = MENUNULL;
+    menu_item_stat_mean.MutualExclude = 0;
+
+    menu_text_stat_mean.FrontPen = 0;
+    menu_text_stat_mean.BackPen = 1;
+    menu_text_stat_mean.DrawMode = JAM2;
+    menu_text_stat_mean.LeftEdge = 2;
+    menu_text_stat_mean.TopEdge = 1;
+    menu_text_stat_mean.ITextFont = NULL;
+    menu_text_stat_mean.IText = (UBYTE *)MENU_STAT_MEAN_LABEL;
+    menu_text_stat_mean.NextText = NULL;
+
+    memset(&menu_item_stat_sdev, 0, sizeof(menu_item_stat_sdev));
+    menu_item_stat_sdev.NextItem = &menu_item_stat_min;
+    menu_item_stat_sdev.LeftEdge = 0;
+    menu_item_stat_sdev.TopEdge = 3 * item_height;
+    menu_item_stat_sdev.Width = stat_item_width;
+    menu_item_stat_sdev.Height = item_height;
+    menu_item_stat_sdev.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_sdev.ItemFill = (APTR)&menu_text_stat_sdev;
+    menu_item_stat_sdev.SelectFill = NULL;
+    menu_item_stat_sdev.Command = 0;
+    menu_item_stat_sdev.SubItem = NULL;
+    menu_item_stat_sdev.NextSelect = MENUNULL;
+    menu_item_stat_sdev.MutualExclude = 0;
+
+    menu_text_stat_sdev.FrontPen = 0;
+    menu_text_stat_sdev.BackPen = 1;
+    menu_text_stat_sdev.DrawMode = JAM2;
+    menu_text_stat_sdev.LeftEdge = 2;
+    menu_text_stat_sdev.TopEdge = 1;
+    menu_text_stat_sdev.ITextFont = NULL;
+    menu_text_stat_sdev.IText = (UBYTE *)MENU_STAT_SDEV_LABEL;
+    menu_text_stat_sdev.NextText = NULL;
+
+    memset(&menu_item_stat_min, 0, sizeof(menu_item_stat_min));
+    menu_item_stat_min.NextItem = &menu_item_stat_max;
+    menu_item_stat_min.LeftEdge = 0;
+    menu_item_stat_min.TopEdge = 4 * item_height;
+    menu_item_stat_min.Width = stat_item_width;
+    menu_item_stat_min.Height = item_height;
+    menu_item_stat_min.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_min.ItemFill = (APTR)&menu_text_stat_min;
+    menu_item_stat_min.SelectFill = NULL;
+    menu_item_stat_min.Command = 0;
+    menu_item_stat_min.SubItem = NULL;
+    menu_item_stat_min.NextSelect = MENUNULL;
+    menu_item_stat_min.MutualExclude = 0;
+
+    menu_text_stat_min.FrontPen = 0;
+    menu_text_stat_min.BackPen = 1;
+    menu_text_stat_min.DrawMode = JAM2;
+    menu_text_stat_min.LeftEdge = 2;
+    menu_text_stat_min.TopEdge = 1;
+    menu_text_stat_min.ITextFont = NULL;
+    menu_text_stat_min.IText = (UBYTE *)MENU_STAT_MIN_LABEL;
+    menu_text_stat_min.NextText = NULL;
+
+    memset(&menu_item_stat_max, 0, sizeof(menu_item_stat_max));
+    menu_item_stat_max.NextItem = &menu_item_stat_slope;
+    menu_item_stat_max.LeftEdge = 0;
+    menu_item_stat_max.TopEdge = 5 * item_height;
+    menu_item_stat_max.Width = stat_item_width;
+    menu_item_stat_max.Height = item_height;
+    menu_item_stat_max.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_max.ItemFill = (APTR)&menu_text_stat_max;
+    menu_item_stat_max.SelectFill = NULL;
+    menu_item_stat_max.Command = 0;
+    menu_item_stat_max.SubItem = NULL;
+    menu_item_stat_max.NextSelect = MENUNULL;
+    menu_item_stat_max.MutualExclude = 0;
+
+    menu_text_stat_max.FrontPen = 0;
+    menu_text_stat_max.BackPen = 1;
+    menu_text_stat_max.DrawMode = JAM2;
+    menu_text_stat_max.LeftEdge = 2;
+    menu_text_stat_max.TopEdge = 1;
+    menu_text_stat_max.ITextFont = NULL;
+    menu_text_stat_max.IText = (UBYTE *)MENU_STAT_MAX_LABEL;
+    menu_text_stat_max.NextText = NULL;
+
+    memset(&menu_item_stat_slope, 0, sizeof(menu_item_stat_slope));
+    menu_item_stat_slope.NextItem = &menu_item_stat_intercept;
+    menu_item_stat_slope.LeftEdge = 0;
+    menu_item_stat_slope.TopEdge = 6 * item_height;
+    menu_item_stat_slope.Width = stat_item_width;
+    menu_item_stat_slope.Height = item_height;
+    menu_item_stat_slope.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_slope.ItemFill = (APTR)&menu_text_stat_slope;
+    menu_item_stat_slope.SelectFill = NULL;
+    menu_item_stat_slope.Command = 0;
+    menu_item_stat_slope.SubItem = NULL;
+    menu_item_stat_slope.NextSelect = MENUNULL;
+    menu_item_stat_slope.MutualExclude = 0;
+
+    menu_text_stat_slope.FrontPen = 0;
+    menu_text_stat_slope.BackPen = 1;
+    menu_text_stat_slope.DrawMode = JAM2;
+    menu_text_stat_slope.LeftEdge = 2;
+    menu_text_stat_slope.TopEdge = 1;
+    menu_text_stat_slope.ITextFont = NULL;
+    menu_text_stat_slope.IText = (UBYTE *)MENU_STAT_SLOPE_LABEL;
+    menu_text_stat_slope.NextText = NULL;
+
+    memset(&menu_item_stat_intercept, 0, sizeof(menu_item_stat_intercept));
+    menu_item_stat_intercept.NextItem = &menu_item_stat_corr;
+    menu_item_stat_intercept.LeftEdge = 0;
+    menu_item_stat_intercept.TopEdge = 7 * item_height;
+    menu_item_stat_intercept.Width = stat_item_width;
+    menu_item_stat_intercept.Height = item_height;
+    menu_item_stat_intercept.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_intercept.ItemFill = (APTR)&menu_text_stat_intercept;
+    menu_item_stat_intercept.SelectFill = NULL;
+    menu_item_stat_intercept.Command = 0;
+    menu_item_stat_intercept.SubItem = NULL;
+    menu_item_stat_intercept.NextSelect = MENUNULL;
+    menu_item_stat_intercept.MutualExclude = 0;
+
+    menu_text_stat_intercept.FrontPen = 0;
+    menu_text_stat_intercept.BackPen = 1;
+    menu_text_stat_intercept.DrawMode = JAM2;
+    menu_text_stat_intercept.LeftEdge = 2;
+    menu_text_stat_intercept.TopEdge = 1;
+    menu_text_stat_intercept.ITextFont = NULL;
+    menu_text_stat_intercept.IText = (UBYTE *)MENU_STAT_INTERCEPT_LABEL;
+    menu_text_stat_intercept.NextText = NULL;
+
+    memset(&menu_item_stat_corr, 0, sizeof(menu_item_stat_corr));
+    menu_item_stat_corr.NextItem = &menu_item_stat_import;
+    menu_item_stat_corr.LeftEdge = 0;
+    menu_item_stat_corr.TopEdge = 8 * item_height;
+    menu_item_stat_corr.Width = stat_item_width;
+    menu_item_stat_corr.Height = item_height;
+    menu_item_stat_corr.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_corr.ItemFill = (APTR)&menu_text_stat_corr;
+    menu_item_stat_corr.SelectFill = NULL;
+    menu_item_stat_corr.Command = 0;
+    menu_item_stat_corr.SubItem = NULL;
+    menu_item_stat_corr.NextSelect = MENUNULL;
+    menu_item_stat_corr.MutualExclude = 0;
+
+    menu_text_stat_corr.FrontPen = 0;
+    menu_text_stat_corr.BackPen = 1;
+    menu_text_stat_corr.DrawMode = JAM2;
+    menu_text_stat_corr.LeftEdge = 2;
+    menu_text_stat_corr.TopEdge = 1;
+    menu_text_stat_corr.ITextFont = NULL;
+    menu_text_stat_corr.IText = (UBYTE *)MENU_STAT_CORR_LABEL;
+    menu_text_stat_corr.NextText = NULL;
+
+    memset(&menu_item_stat_import, 0, sizeof(menu_item_stat_import));
+    menu_item_stat_import.NextItem = &menu_item_stat_clear;
+    menu_item_stat_import.LeftEdge = 0;
+    menu_item_stat_import.TopEdge = 9 * item_height;
+    menu_item_stat_import.Width = stat_item_width;
+    menu_item_stat_import.Height = item_height;
+    menu_item_stat_import.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_import.ItemFill = (APTR)&menu_text_stat_import;
+    menu_item_stat_import.SelectFill = NULL;
+    menu_item_stat_import.Command = 0;
+    menu_item_stat_import.SubItem = NULL;
+    menu_item_stat_import.NextSelect = MENUNULL;
+    menu_item_stat_import.MutualExclude = 0;
+
+    menu_text_stat_import.FrontPen = 0;
+    menu_text_stat_import.BackPen = 1;
+    menu_text_stat_import.DrawMode = JAM2;
+    menu_text_stat_import.LeftEdge = 2;
+    menu_text_stat_import.TopEdge = 1;
+    menu_text_stat_import.ITextFont = NULL;
+    menu_text_stat_import.IText = (UBYTE *)MENU_STAT_IMPORT_LABEL;
+    menu_text_stat_import.NextText = NULL;
+
+    memset(&menu_item_stat_clear, 0, sizeof(menu_item_stat_clear));
+    menu_item_stat_clear.NextItem = NULL;
+    menu_item_stat_clear.LeftEdge = 0;
+    menu_item_stat_clear.TopEdge = 10 * item_height;
+    menu_item_stat_clear.Width = stat_item_width;
+    menu_item_stat_clear.Height = item_height;
+    menu_item_stat_clear.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_stat_clear.ItemFill = (APTR)&menu_text_stat_clear;
+    menu_item_stat_clear.SelectFill = NULL;
+    menu_item_stat_clear.Command = 0;
+    menu_item_stat_clear.SubItem = NULL;
+    menu_item_stat_clear.NextSelect = MENUNULL;
+    menu_item_stat_clear.MutualExclude = 0;
+
+    menu_text_stat_clear.FrontPen = 0;
+    menu_text_stat_clear.BackPen = 1;
+    menu_text_stat_clear.DrawMode = JAM2;
+    menu_text_stat_clear.LeftEdge = 2;
+    menu_text_stat_clear.TopEdge = 1;
+    menu_text_stat_clear.ITextFont = NULL;
+    menu_text_stat_clear.IText = (UBYTE *)MENU_STAT_CLEAR_LABEL;
+    menu_text_stat_clear.NextText = NULL;
+
+    memset(&menu_sheet, 0, sizeof(menu_sheet));
+    menu_sheet.LeftEdge = menu_width + mode_width + view_width + arith_width + calc_width +
+                          poly_width + stat_width;
+    menu_sheet.TopEdge = 0;
+    menu_sheet.Width = sheet_width;
+    menu_sheet.Height = menu_height;
+    menu_sheet.Flags = MENUENABLED;
+    menu_sheet.MenuName = (BYTE *)MENU_SHEET_TITLE;
+    menu_sheet.FirstItem = &menu_item_sheet_cell;
+    menu_sheet.NextMenu = &menu_vars;
+
+    memset(&menu_item_sheet_cell, 0, sizeof(menu_item_sheet_cell));
+    menu_item_sheet_cell.NextItem = &menu_item_sheet_ref;
+    menu_item_sheet_cell.LeftEdge = 0;
+    menu_item_sheet_cell.TopEdge = 0;
+    menu_item_sheet_cell.Width = sheet_item_width;
+    menu_item_sheet_cell.Height = item_height;
+    menu_item_sheet_cell.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_sheet_cell.ItemFill = (APTR)&menu_text_sheet_cell;
+    menu_item_sheet_cell.SelectFill = NULL;
+    menu_item_sheet_cell.Command = 0;
+    menu_item_sheet_cell.SubItem = NULL;
+    menu_item_sheet_cell.NextSelect = MENUNULL;
+    menu_item_sheet_cell.MutualExclude = 0;
+
+    menu_text_sheet_cell.FrontPen = 0;
+    menu_text_sheet_cell.BackPen = 1;
+    menu_text_sheet_cell.DrawMode = JAM2;
+    menu_text_sheet_cell.LeftEdge = 2;
+    menu_text_sheet_cell.TopEdge = 1;
+    menu_text_sheet_cell.ITextFont = NULL;
+    menu_text_sheet_cell.IText = (UBYTE *)MENU_SHEET_CELL_LABEL;
+    menu_text_sheet_cell.NextText = NULL;
+
+    memset(&menu_item_sheet_ref, 0, sizeof(menu_item_sheet_ref));
+    menu_item_sheet_ref.NextItem = &menu_item_sheet_define;
+    menu_item_sheet_ref.LeftEdge = 0;
+    menu_item_sheet_ref.TopEdge = item_height;
+    menu_item_sheet_ref.Width = sheet_item_width;
+    menu_item_sheet_ref.Height = item_height;
+    menu_item_sheet_ref.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_sheet_ref.ItemFill = (APTR)&menu_text_sheet_ref;
+    menu_item_sheet_ref.SelectFill = NULL;
+    menu_item_sheet_ref.Command = 0;
+    menu_item_sheet_ref.SubItem = NULL;
+    menu_item_sheet_ref.NextSelect = MENUNULL;
+    menu_item_sheet_ref.MutualExclude = 0;
+
+    menu_text_sheet_ref.FrontPen = 0;
+    menu_text_sheet_ref.BackPen = 1;
+    menu_text_sheet_ref.DrawMode = JAM2;
+    menu_text_sheet_ref.LeftEdge = 2;
+    menu_text_sheet_ref.TopEdge = 1;
+    menu_text_sheet_ref.ITextFont = NULL;
+    menu_text_sheet_ref.IText = (UBYTE *)MENU_SHEET_REF_LABEL;
+    menu_text_sheet_ref.NextText = NULL;
+
+    memset(&menu_item_sheet_define, 0, sizeof(menu_item_sheet_define));
+    menu_item_sheet_define.NextItem = &menu_item_sheet_clear;
+    menu_item_sheet_define.LeftEdge = 0;
+    menu_item_sheet_define.TopEdge = 2 * item_height;
+    menu_item_sheet_define.Width = sheet_item_width;
+    menu_item_sheet_define.Height = item_height;
+    menu_item_sheet_define.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_sheet_define.ItemFill = (APTR)&menu_text_sheet_define;
+    menu_item_sheet_define.SelectFill = NULL;
+    menu_item_sheet_define.Command = 0;
+    menu_item_sheet_define.SubItem = NULL;
+    menu_item_sheet_define.NextSelect = MENUNULL;
+    menu_item_sheet_define.MutualExclude = 0;
+
+    menu_text_sheet_define.FrontPen = 0;
+    menu_text_sheet_define.BackPen = 1;
+    menu_text_sheet_define.DrawMode = JAM2;
+    menu_text_sheet_define.LeftEdge = 2;
+    menu_text_sheet_define.TopEdge = 1;
+    menu_text_sheet_define.ITextFont = NULL;
+    menu_text_sheet_define.IText = (UBYTE *)MENU_SHEET_DEFINE_LABEL;
+    menu_text_sheet_define.NextText = NULL;
+
+    memset(&menu_item_sheet_clear, 0, sizeof(menu_item_sheet_clear));
+    menu_item_sheet_clear.NextItem = NULL;
+    menu_item_sheet_clear.LeftEdge = 0;
+    menu_item_sheet_clear.TopEdge = 3 * item_height;
+    menu_item_sheet_clear.Width = sheet_item_width;
+    menu_item_sheet_clear.Height = item_height;
+    menu_item_sheet_clear.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_sheet_clear.ItemFill = (APTR)&menu_text_sheet_clear;
+    menu_item_sheet_clear.SelectFill = NULL;
+    menu_item_sheet_clear.Command = 0;
+    menu_item_sheet_clear.SubItem = NULL;
+    menu_item_sheet_clear.NextSelect = MENUNULL;
+    menu_item_sheet_clear.MutualExclude = 0;
+
+    menu_text_sheet_clear.FrontPen = 0;
+    menu_text_sheet_clear.BackPen = 1;
+    menu_text_sheet_clear.DrawMode = JAM2;
+    menu_text_sheet_clear.LeftEdge = 2;
+    menu_text_sheet_clear.TopEdge = 1;
+    menu_text_sheet_clear.ITextFont = NULL;
+    menu_text_sheet_clear.IText = (UBYTE *)MENU_SHEET_CLEAR_LABEL;
+    menu_text_sheet_clear.NextText = NULL;
+
+    memset(&menu_vars, 0, sizeof(menu_vars));
+    menu_vars.LeftEdge = menu_width + mode_width + view_width + arith_width + calc_width +
+                         poly_width + stat_width + sheet_width;
+    menu_vars.TopEdge = 0;
+    menu_vars.Width = vars_width;
+    menu_vars.Height = menu_height;
+    menu_vars.Flags = MENUENABLED;
+    menu_vars.MenuName = (BYTE *)MENU_VARS_TITLE;
+    menu_vars.FirstItem = &menu_item_var_sto;
+    menu_vars.NextMenu = &menu_macro;
+
+    memset(&menu_item_var_sto, 0, sizeof(menu_item_var_sto));
+    menu_item_var_sto.NextItem = &menu_item_var_rcl;
+    menu_item_var_sto.LeftEdge = 0;
+    menu_item_var_sto.TopEdge = 0;
+    menu_item_var_sto.Width = vars_item_width;
+    menu_item_var_sto.Height = item_height;
+    menu_item_var_sto.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_var_sto.ItemFill = (APTR)&menu_text_var_sto;
+    menu_item_var_sto.SelectFill = NULL;
+    menu_item_var_sto.Command = 0;
+    menu_item_var_sto.SubItem = NULL;
+    menu_item_var_sto.NextSelect = MENUNULL;
+    menu_item_var_sto.MutualExclude = 0;
+
+    menu_text_var_sto.FrontPen = 0;
+    menu_text_var_sto.BackPen = 1;
+    menu_text_var_sto.DrawMode = JAM2;
+    menu_text_var_sto.LeftEdge = 2;
+    menu_text_var_sto.TopEdge = 1;
+    menu_text_var_sto.ITextFont = NULL;
+    menu_text_var_sto.IText = (UBYTE *)MENU_VAR_STO_LABEL;
+    menu_text_var_sto.NextText = NULL;
+
+    memset(&menu_item_var_rcl, 0, sizeof(menu_item_var_rcl));
+    menu_item_var_rcl.NextItem = &menu_item_var_define;
+    menu_item_var_rcl.LeftEdge = 0;
+    menu_item_var_rcl.TopEdge = item_height;
+    menu_item_var_rcl.Width = vars_item_width;
+    menu_item_var_rcl.Height = item_height;
+    menu_item_var_rcl.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_var_rcl.ItemFill = (APTR)&menu_text_var_rcl;
+    menu_item_var_rcl.SelectFill = NULL;
+    menu_item_var_rcl.Command = 0;
+    menu_item_var_rcl.SubItem = NULL;
+    menu_item_var_rcl.NextSelect = MENUNULL;
+    menu_item_var_rcl.MutualExclude = 0;
+
+    menu_text_var_rcl.FrontPen = 0;
+    menu_text_var_rcl.BackPen = 1;
+    menu_text_var_rcl.DrawMode = JAM2;
+    menu_text_var_rcl.LeftEdge = 2;
+    menu_text_var_rcl.TopEdge = 1;
+    menu_text_var_rcl.ITextFont = NULL;
+    menu_text_var_rcl.IText = (UBYTE *)MENU_VAR_RCL_LABEL;
+    menu_text_var_rcl.NextText = NULL;
+
+    memset(&menu_item_var_define, 0, sizeof(menu_item_var_define));
+    menu_item_var_define.NextItem = &menu_item_var_apply;
+    menu_item_var_define.LeftEdge = 0;
+    menu_item_var_define.TopEdge = 2 * item_height;
+    menu_item_var_define.Width = vars_item_width;
+    menu_item_var_define.Height = item_height;
+    menu_item_var_define.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_var_define.ItemFill = (APTR)&menu_text_var_define;
+    menu_item_var_define.SelectFill = NULL;
+    menu_item_var_define.Command = 0;
+    menu_item_var_define.SubItem = NULL;
+    menu_item_var_define.NextSelect = MENUNULL;
+    menu_item_var_define.MutualExclude = 0;
+
+    menu_text_var_define.FrontPen = 0;
+    menu_text_var_define.BackPen = 1;
+    menu_text_var_define.DrawMode = JAM2;
+    menu_text_var_define.LeftEdge = 2;
+    menu_text_var_define.TopEdge = 1;
+    menu_text_var_define.ITextFont = NULL;
+    menu_text_var_define.IText = (UBYTE *)MENU_VAR_DEFINE_LABEL;
+    menu_text_var_define.NextText = NULL;
+
+    memset(&menu_item_var_apply, 0, sizeof(menu_item_var_apply));
+    menu_item_var_apply.NextItem = &menu_item_var_clear;
+    menu_item_var_apply.LeftEdge = 0;
+    menu_item_var_apply.TopEdge = 3 * item_height;
+    menu_item_var_apply.Width = vars_item_width;
+    menu_item_var_apply.Height = item_height;
+    menu_item_var_apply.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_var_apply.ItemFill = (APTR)&menu_text_var_apply;
+    menu_item_var_apply.SelectFill = NULL;
+    menu_item_var_apply.Command = 0;
+    menu_item_var_apply.SubItem = NULL;
+    menu_item_var_apply.NextSelect = MENUNULL;
+    menu_item_var_apply.MutualExclude = 0;
+
+    menu_text_var_apply.FrontPen = 0;
+    menu_text_var_apply.BackPen = 1;
+    menu_text_var_apply.DrawMode = JAM2;
+    menu_text_var_apply.LeftEdge = 2;
+    menu_text_var_apply.TopEdge = 1;
+    menu_text_var_apply.ITextFont = NULL;
+    menu_text_var_apply.IText = (UBYTE *)MENU_VAR_APPLY_LABEL;
+    menu_text_var_apply.NextText = NULL;
+
+    memset(&menu_item_var_clear, 0, sizeof(menu_item_var_clear));
+    menu_item_var_clear.NextItem = NULL;
+    menu_item_var_clear.LeftEdge = 0;
+    menu_item_var_clear.TopEdge = 4 * item_height;
+    menu_item_var_clear.Width = vars_item_width;
+    menu_item_var_clear.Height = item_height;
+    menu_item_var_clear.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_var_clear.ItemFill = (APTR)&menu_text_var_clear;
+    menu_item_var_clear.SelectFill = NULL;
+    menu_item_var_clear.Command = 0;
+    menu_item_var_clear.SubItem = NULL;
+    menu_item_var_clear.NextSelect = MENUNULL;
+    menu_item_var_clear.MutualExclude = 0;
+
+    menu_text_var_clear.FrontPen = 0;
+    menu_text_var_clear.BackPen = 1;
+    menu_text_var_clear.DrawMode = JAM2;
+    menu_text_var_clear.LeftEdge = 2;
+    menu_text_var_clear.TopEdge = 1;
+    menu_text_var_clear.ITextFont = NULL;
+    menu_text_var_clear.IText = (UBYTE *)MENU_VAR_CLEAR_LABEL;
+    menu_text_var_clear.NextText = NULL;
+
+    memset(&menu_macro, 0, sizeof(menu_macro));
+    menu_macro.LeftEdge = menu_width + mode_width + view_width + arith_width + calc_width +
+                          poly_width + stat_width + sheet_width + vars_width;
+    menu_macro.TopEdge = 0;
+    menu_macro.Width = macro_width;
+    menu_macro.Height = menu_height;
+    menu_macro.Flags = MENUENABLED;
+    menu_macro.MenuName = (BYTE *)MENU_MACRO_TITLE;
+    menu_macro.FirstItem = &menu_item_macro_record;
+    menu_macro.NextMenu = NULL;
+
+    memset(&menu_item_macro_record, 0, sizeof(menu_item_macro_record));
+    menu_item_macro_record.NextItem = &menu_item_macro_1;
+    menu_item_macro_record.LeftEdge = 0;
+    menu_item_macro_record.TopEdge = 0;
+    menu_item_macro_record.Width = macro_item_width;
+    menu_item_macro_record.Height = item_height;
+    menu_item_macro_record.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_macro_record.ItemFill = (APTR)&menu_text_macro_record;
+    menu_item_macro_record.SelectFill = NULL;
+    menu_item_macro_record.Command = 0;
+    menu_item_macro_record.SubItem = NULL;
+    menu_item_macro_record.NextSelect = MENUNULL;
+    menu_item_macro_record.MutualExclude = 0;
+
+    menu_text_macro_record.FrontPen = 0;
+    menu_text_macro_record.BackPen = 1;
+    menu_text_macro_record.DrawMode = JAM2;
+    menu_text_macro_record.LeftEdge = 2;
+    menu_text_macro_record.TopEdge = 1;
+    menu_text_macro_record.ITextFont = NULL;
+    menu_text_macro_record.IText = (UBYTE *)MENU_MACRO_RECORD_LABEL;
+    menu_text_macro_record.NextText = NULL;
+
+    memset(&menu_item_macro_1, 0, sizeof(menu_item_macro_1));
+    menu_item_macro_1.NextItem = &menu_item_macro_2;
+    menu_item_macro_1.LeftEdge = 0;
+    menu_item_macro_1.TopEdge = item_height;
+    menu_item_macro_1.Width = macro_item_width;
+    menu_item_macro_1.Height = item_height;
+    menu_item_macro_1.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_macro_1.ItemFill = (APTR)&menu_text_macro_1;
+    menu_item_macro_1.SelectFill = NULL;
+    menu_item_macro_1.Command = 0;
+    menu_item_macro_1.SubItem = NULL;
+    menu_item_macro_1.NextSelect = MENUNULL;
+    menu_item_macro_1.MutualExclude = 0;
+
+    menu_text_macro_1.FrontPen = 0;
+    menu_text_macro_1.BackPen = 1;
+    menu_text_macro_1.DrawMode = JAM2;
+    menu_text_macro_1.LeftEdge = 2;
+    menu_text_macro_1.TopEdge = 1;
+    menu_text_macro_1.ITextFont = NULL;
+    menu_text_macro_1.IText = (UBYTE *)MENU_MACRO_1_LABEL;
+    menu_text_macro_1.NextText = NULL;
+
+    memset(&menu_item_macro_2, 0, sizeof(menu_item_macro_2));
+    menu_item_macro_2.NextItem = &menu_item_macro_3;
+    menu_item_macro_2.LeftEdge = 0;
+    menu_item_macro_2.TopEdge = 2 * item_height;
+    menu_item_macro_2.Width = macro_item_width;
+    menu_item_macro_2.Height = item_height;
+    menu_item_macro_2.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_macro_2.ItemFill = (APTR)&menu_text_macro_2;
+    menu_item_macro_2.SelectFill = NULL;
+    menu_item_macro_2.Command = 0;
+    menu_item_macro_2.SubItem = NULL;
+    menu_item_macro_2.NextSelect = MENUNULL;
+    menu_item_macro_2.MutualExclude = 0;
+
+    menu_text_macro_2.FrontPen = 0;
+    menu_text_macro_2.BackPen = 1;
+    menu_text_macro_2.DrawMode = JAM2;
+    menu_text_macro_2.LeftEdge = 2;
+    menu_text_macro_2.TopEdge = 1;
+    menu_text_macro_2.ITextFont = NULL;
+    menu_text_macro_2.IText = (UBYTE *)MENU_MACRO_2_LABEL;
+    menu_text_macro_2.NextText = NULL;
+
+    memset(&menu_item_macro_3, 0, sizeof(menu_item_macro_3));
+    menu_item_macro_3.NextItem = &menu_item_macro_4;
+    menu_item_macro_3.LeftEdge = 0;
+    menu_item_macro_3.TopEdge = 3 * item_height;
+    menu_item_macro_3.Width = macro_item_width;
+    menu_item_macro_3.Height = item_height;
+    menu_item_macro_3.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_macro_3.ItemFill = (APTR)&menu_text_macro_3;
+    menu_item_macro_3.SelectFill = NULL;
+    menu_item_macro_3.Command = 0;
+    menu_item_macro_3.SubItem = NULL;
+    menu_item_macro_3.NextSelect = MENUNULL;
+    menu_item_macro_3.MutualExclude = 0;
+
+    menu_text_macro_3.FrontPen = 0;
+    menu_text_macro_3.BackPen = 1;
+    menu_text_macro_3.DrawMode = JAM2;
+    menu_text_macro_3.LeftEdge = 2;
+    menu_text_macro_3.TopEdge = 1;
+    menu_text_macro_3.ITextFont = NULL;
+    menu_text_macro_3.IText = (UBYTE *)MENU_MACRO_3_LABEL;
+    menu_text_macro_3.NextText = NULL;
+
+    memset(&menu_item_macro_4, 0, sizeof(menu_item_macro_4));
+    menu_item_macro_4.NextItem = &menu_item_macro_save;
+    menu_item_macro_4.LeftEdge = 0;
+    menu_item_macro_4.TopEdge = 4 * item_height;
+    menu_item_macro_4.Width = macro_item_width;
+    menu_item_macro_4.Height = item_height;
+    menu_item_macro_4.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_macro_4.ItemFill = (APTR)&menu_text_macro_4;
+    menu_item_macro_4.SelectFill = NULL;
+    menu_item_macro_4.Command = 0;
+    menu_item_macro_4.SubItem = NULL;
+    menu_item_macro_4.NextSelect = MENUNULL;
+    menu_item_macro_4.MutualExclude = 0;
+
+    menu_text_macro_4.FrontPen = 0;
+    menu_text_macro_4.BackPen = 1;
+    menu_text_macro_4.DrawMode = JAM2;
+    menu_text_macro_4.LeftEdge = 2;
+    menu_text_macro_4.TopEdge = 1;
+    menu_text_macro_4.ITextFont = NULL;
+    menu_text_macro_4.IText = (UBYTE *)MENU_MACRO_4_LABEL;
+    menu_text_macro_4.NextText = NULL;
+
+    memset(&menu_item_macro_save, 0, sizeof(menu_item_macro_save));
+    menu_item_macro_save.NextItem = &menu_item_macro_load;
+    menu_item_macro_save.LeftEdge = 0;
+    menu_item_macro_save.TopEdge = 5 * item_height;
+    menu_item_macro_save.Width = macro_item_width;
+    menu_item_macro_save.Height = item_height;
+    menu_item_macro_save.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_macro_save.ItemFill = (APTR)&menu_text_macro_save;
+    menu_item_macro_save.SelectFill = NULL;
+    menu_item_macro_save.Command = 0;
+    menu_item_macro_save.SubItem = NULL;
+    menu_item_macro_save.NextSelect = MENUNULL;
+    menu_item_macro_save.MutualExclude = 0;
+
+    menu_text_macro_save.FrontPen = 0;
+    menu_text_macro_save.BackPen = 1;
+    menu_text_macro_save.DrawMode = JAM2;
+    menu_text_macro_save.LeftEdge = 2;
+    menu_text_macro_save.TopEdge = 1;
+    menu_text_macro_save.ITextFont = NULL;
+    menu_text_macro_save.IText = (UBYTE *)MENU_MACRO_SAVE_LABEL;
+    menu_text_macro_save.NextText = NULL;
+
+    memset(&menu_item_macro_load, 0, sizeof(menu_item_macro_load));
+    menu_item_macro_load.NextItem = NULL;
+    menu_item_macro_load.LeftEdge = 0;
+    menu_item_macro_load.TopEdge = 6 * item_height;
+    menu_item_macro_load.Width = macro_item_width;
+    menu_item_macro_load.Height = item_height;
+    menu_item_macro_load.Flags = ITEMTEXT | ITEMENABLED | HIGHCOMP;
+    menu_item_macro_load.ItemFill = (APTR)&menu_text_macro_load;
+    menu_item_macro_load.SelectFill = NULL;
+    menu_item_macro_load.Command = 0;
+    menu_item_macro_load.SubItem = NULL;
+    menu_item_macro_load.NextSelect = MENUNULL;
+    menu_item_macro_load.MutualExclude = 0;
+
+    menu_text_macro_load.FrontPen = 0;
+    menu_text_macro_load.BackPen = 1;
+    menu_text_macro_load.DrawMode = JAM2;
+    menu_text_macro_load.LeftEdge = 2;
+    menu_text_macro_load.TopEdge = 1;
+    menu_text_macro_load.ITextFont = NULL;
+    menu_text_macro_load.IText = (UBYTE *)MENU_MACRO_LOAD_LABEL;
+    menu_text_macro_load.NextText = NULL;
+
+    check_menus(state);
 }
 
 static void handle_menu_pick(struct CalcState *state, USHORT code)
 {
-    while (code != MENUNULL) {
+    while (code != MENUNULL && !job_busy) {
         UWORD menu_num = MENUNUM(code);
         UWORD item_num = ITEMNUM(code);
         struct MenuItem *item;
@@ -1505,13 +5789,13 @@ static void handle_menu_pick(struct CalcState *state, USHORT code)
                 if (state->just_result) {
                     expr_reset(state);
                 }
-                insert_constant(state, CONST_PI);
+                insert_constant(state, CONST_PI, dd_pi);
                 expr_update_entry(state);
             } else if (item_num == ITEM_E) {
                 if (state->just_result) {
                     expr_reset(state);
                 }
-                insert_constant(state, CONST_E);
+                insert_constant(state, CONST_E, dd_e);
                 expr_update_entry(state);
             }
         } else if (menu_num == MENU_MODE) {
@@ -1523,6 +5807,102 @@ static void handle_menu_pick(struct CalcState *state, USHORT code)
         } else if (menu_num == MENU_VIEW) {
             if (item_num == ITEM_EXPR) {
                 set_show_expr(state, !state->show_expr);
+            } else if (item_num == ITEM_DECIMAL) {
+                set_show_decimal(state, !state->show_decimal);
+            } else if (item_num == ITEM_NEW_WINDOW) {
+                window_wanted = 1;
+            } else if (item_num == ITEM_HISTORY) {
+                handle_history_key(state, 0);
+            } else if (item_num == ITEM_SEARCH) {
+                start_name(state, NAME_SEARCH);
+            }
+        } else if (menu_num == MENU_ARITH) {
+            if (item_num == ITEM_ARITH_REAL) {
+                set_arith_mode(state, ARITH_REAL);
+            } else if (item_num == ITEM_ARITH_DD) {
+                set_arith_mode(state, ARITH_DD);
+            } else if (item_num == ITEM_ARITH_FRAC) {
+                set_arith_mode(state, ARITH_FRAC);
+            } else if (item_num == ITEM_ARITH_CPLX) {
+                set_arith_mode(state, ARITH_CPLX);
+            }
+        } else if (menu_num == MENU_CALC) {
+            if (item_num == ITEM_SOLVE) {
+                handle_solve(state);
+            } else if (item_num == ITEM_INT_FROM) {
+                handle_int_bound(state, 0);
+            } else if (item_num == ITEM_INT_TO) {
+                handle_int_bound(state, 1);
+            } else if (item_num == ITEM_INT_TO_INF) {
+                handle_int_to_inf(state);
+            } else if (item_num == ITEM_INTEGRATE) {
+                handle_integrate(state);
+            } else if (item_num == ITEM_SUM) {
+                handle_series(state, 0);
+            } else if (item_num == ITEM_PRODUCT) {
+                handle_series(state, 1);
+            } else if (item_num == ITEM_MC_UNIFORM) {
+                handle_monte_carlo(state, 0);
+            } else if (item_num == ITEM_MC_NORMAL) {
+                handle_monte_carlo(state, 1);
+            }
+        } else if (menu_num == MENU_POLY) {
+            if (item_num == ITEM_POLY_COEF) {
+                handle_poly_coef(state);
+            } else if (item_num == ITEM_POLY_EVAL) {
+                handle_poly_eval(state);
+            } else if (item_num == ITEM_POLY_ROOTS) {
+                handle_poly_roots(state);
+            } else if (item_num == ITEM_POLY_CLEAR) {
+                poly_len = 0;
+                clear_state(state);
+            }
+        } else if (menu_num == MENU_STAT) {
+            if (item_num == ITEM_STAT_X) {
+                handle_stat_x(state);
+            } else if (item_num == ITEM_STAT_IMPORT) {
+                handle_stat_import(state);
+            } else if (item_num == ITEM_STAT_CLEAR) {
+                stats_clear(&stat_data);
+                stat_x_set = 0;
+                clear_state(state);
+            } else {
+                handle_stat_recall(state, item_num);
+            }
+        } else if (menu_num == MENU_SHEET) {
+            if (item_num == ITEM_SHEET_CELL) {
+                handle_sheet_cell(state);
+            } else if (item_num == ITEM_SHEET_REF) {
+                handle_sheet_ref(state);
+            } else if (item_num == ITEM_SHEET_DEFINE) {
+                handle_sheet_define(state);
+            } else if (item_num == ITEM_SHEET_CLEAR) {
+                sheet_clear();
+                sheet_cur = -1;
+                clear_state(state);
+            }
+        } else if (menu_num == MENU_VARS) {
+            if (item_num == ITEM_VAR_STO) {
+                start_name(state, NAME_STO);
+            } else if (item_num == ITEM_VAR_RCL) {
+                start_name(state, NAME_RCL);
+            } else if (item_num == ITEM_VAR_DEFINE) {
+                start_name(state, NAME_DEFINE);
+            } else if (item_num == ITEM_VAR_APPLY) {
+                start_name(state, NAME_APPLY);
+            } else if (item_num == ITEM_VAR_CLEAR) {
+                sym_clear();
+                clear_state(state);
+            }
+        } else if (menu_num == MENU_MACRO) {
+            if (item_num == ITEM_MACRO_RECORD) {
+                handle_macro_record(state);
+            } else if (item_num == ITEM_MACRO_SAVE) {
+                handle_macro_file(state, 0);
+            } else if (item_num == ITEM_MACRO_LOAD) {
+                handle_macro_file(state, 1);
+            } else if (item_num >= ITEM_MACRO_1 && item_num < ITEM_MACRO_1 + MACRO_SLOTS) {
+                handle_macro_slot(state, item_num - ITEM_MACRO_1);
             }
         }
 
@@ -1534,25 +5914,42 @@ static void handle_menu_pick(struct CalcState *state, USHORT code)
     }
 }
 
-static void draw_button(struct RastPort *rp, int x, int y, const char *label, int root_symbol)
+/* Label widths in the window font, plain and with Inv, for every button. */
+static void measure_labels(struct RastPort *rp)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(buttons) / sizeof(buttons[0]); ++i) {
+        const char *label = buttons[i].label;
+        const char *alt = buttons[i].alt_label ? buttons[i].alt_label : label;
+
+        label_width[i][0] = (WORD)TextLength(rp, (UBYTE *)label, (int)strlen(label));
+        label_width[i][1] = (WORD)TextLength(rp, (UBYTE *)alt, (int)strlen(alt));
+    }
+}
+
+static void draw_button(struct RastPort *rp, const struct Layout *lay, int x, int y,
+                        const char *label, int text_w, int root_symbol)
 {
+    int w = lay->btn_w;
+    int h = lay->btn_h;
+
     SetAPen(rp, 0);
-    RectFill(rp, x + 1, y + 1, x + BTN_W - 2, y + BTN_H - 2);
+    RectFill(rp, x + 1, y + 1, x + w - 2, y + h - 2);
 
     SetAPen(rp, 1);
     Move(rp, x, y);
-    Draw(rp, x + BTN_W - 1, y);
-    Draw(rp, x + BTN_W - 1, y + BTN_H - 1);
-    Draw(rp, x, y + BTN_H - 1);
+    Draw(rp, x + w - 1, y);
+    Draw(rp, x + w - 1, y + h - 1);
+    Draw(rp, x, y + h - 1);
     Draw(rp, x, y);
 
     if (root_symbol) {
-        draw_root_symbol(rp, x, y);
+        draw_root_symbol(rp, lay, x, y);
     } else if (label) {
         int len = (int)strlen(label);
-        int text_w = TextLength(rp, (UBYTE *)label, len);
-        int tx = x + (BTN_W - text_w) / 2;
-        int ty = y + (BTN_H - rp->TxHeight) / 2 + rp->TxBaseline;
+        int tx = x + (w - text_w) / 2;
+        int ty = y + (h - rp->TxHeight) / 2 + rp->TxBaseline;
 
         Move(rp, tx, ty);
         Text(rp, (UBYTE *)label, len);
@@ -1562,13 +5959,15 @@ static void draw_button(struct RastPort *rp, int x, int y, const char *label, in
 static void draw_display(struct Window *win, const struct CalcState *state)
 {
     struct RastPort *rp = win->RPort;
+    const struct Layout *lay = window_layout(win);
     char buffer[64];
-    char left_buf[8];
-    int ox = content_left(win) + DISP_X;
-    int oy = content_top(win) + DISP_Y;
-    int right = ox + DISP_W - 1;
-    int bottom = oy + DISP_H - 1;
-    int text_y = oy + (DISP_H - rp->TxHeight) / 2 + rp->TxBaseline;
+    char left_buf[64];
+    int disp_w = lay->disp_w;
+    int ox = content_left(win) + lay->disp_x;
+    int oy = content_top(win) + lay->disp_y;
+    int right = ox + disp_w - 1;
+    int bottom = oy + lay->disp_h - 1;
+    int text_y = oy + (lay->disp_h - rp->TxHeight) / 2 + rp->TxBaseline;
     int len;
     int width;
     int num_x;
@@ -1586,7 +5985,7 @@ static void draw_display(struct Window *win, const struct CalcState *state)
 
     if (state->show_expr && !state->error && state->expr_len > 0) {
         int text_x = ox + 4;
-        int avail = DISP_W - 8;
+        int avail = disp_w - 8;
         int start = 0;
         const char *expr_ptr = state->expr;
         int expr_len = state->expr_len;
@@ -1622,9 +6021,14 @@ static void draw_display(struct Window *win, const struct CalcState *state)
     get_display_value(state, buffer);
 
     left_buf[0] = '\0';
-    if (!state->error) {
+    if (!state->error && state->status[0] != '\0') {
+        strcpy(left_buf, state->status);
+    } else if (!state->error) {
+        if (macro_recording()) {
+            strcpy(left_buf, "REC");
+        }
         if (state->inv) {
-            strcpy(left_buf, "INV");
+            strcat(left_buf, left_buf[0] != '\0' ? " INV" : "INV");
         }
         if (state->op != 0) {
             size_t pos = strlen(left_buf);
@@ -1636,14 +6040,24 @@ static void draw_display(struct Window *win, const struct CalcState *state)
         }
     }
 
+    len = (int)strlen(buffer);
+    width = TextLength(rp, (UBYTE *)buffer, len);
+    if (!state->error && state->status[0] == '\0' && state->preview_text[0] != '\0') {
+        /* The preview only where it leaves room for the number. */
+        size_t pos = strlen(left_buf);
+
+        sprintf(left_buf + pos, pos > 0 ? " %s" : "%s", state->preview_text);
+        if (TextLength(rp, (UBYTE *)left_buf, (int)strlen(left_buf)) + width + 16 > disp_w) {
+            left_buf[pos] = '\0';
+        }
+    }
+
     if (left_buf[0] != '\0') {
         Move(rp, ox + 4, text_y);
         Text(rp, (UBYTE *)left_buf, (int)strlen(left_buf));
     }
 
-    len = (int)strlen(buffer);
-    width = TextLength(rp, (UBYTE *)buffer, len);
-    num_x = ox + DISP_W - 4 - width;
+    num_x = ox + disp_w - 4 - width;
     if (num_x < ox + 4) {
         num_x = ox + 4;
     }
@@ -1654,6 +6068,7 @@ static void draw_display(struct Window *win, const struct CalcState *state)
 static void draw_buttons(struct Window *win, const struct CalcState *state)
 {
     struct RastPort *rp = win->RPort;
+    const struct Layout *lay = window_layout(win);
     size_t i;
     int ox = content_left(win);
     int oy = content_top(win);
@@ -1661,9 +6076,9 @@ static void draw_buttons(struct Window *win, const struct CalcState *state)
     for (i = 0; i < sizeof(buttons) / sizeof(buttons[0]); ++i) {
         const char *label = button_label(&buttons[i], state);
         int root_symbol = (state->inv && buttons[i].action == 'P');
-        int x = ox + button_left(&buttons[i]);
-        int y = oy + button_top(&buttons[i]);
-        draw_button(rp, x, y, label, root_symbol);
+        int x = ox + button_left(lay, &buttons[i]);
+        int y = oy + button_top(lay, &buttons[i]);
+        draw_button(rp, lay, x, y, label, label_width[i][state->inv != 0], root_symbol);
     }
 }
 
@@ -1684,111 +6099,611 @@ static void draw_ui(struct Window *win, const struct CalcState *state)
     draw_buttons(win, state);
 }
 
-static const struct Button *find_button(int x, int y)
+/* The grid cell from the pitch, then whether the point misses the spacing. */
+static const struct Button *find_button(const struct Layout *lay, int x, int y)
 {
-    size_t i;
+    int col;
+    int row;
+    int index;
 
-    for (i = 0; i < sizeof(buttons) / sizeof(buttons[0]); ++i) {
-        int bx = button_left(&buttons[i]);
-        int by = button_top(&buttons[i]);
-        if (x >= bx && x < bx + BTN_W && y >= by && y < by + BTN_H) {
-            return &buttons[i];
-        }
+    if (x < lay->col_x[0] || y < lay->row_y[0]) {
+        return NULL;
     }
-    return NULL;
+    if (x >= lay->col_x[FUNC_COLS]) {
+        col = FUNC_COLS + (x - lay->col_x[FUNC_COLS]) / lay->pitch_x;
+    } else {
+        col = (x - lay->col_x[0]) / lay->pitch_x;
+    }
+    row = (y - lay->row_y[0]) / lay->pitch_y;
+    if (col >= GRID_COLS || row >= GRID_ROWS || x < lay->col_x[col] ||
+        x >= lay->col_x[col] + lay->btn_w || y >= lay->row_y[row] + lay->btn_h) {
+        return NULL;
+    }
+    index = grid_button[row][col];
+    return index < 0 ? NULL : &buttons[index];
 }
 
-int main(void)
+/* The limbs of a ratio only mean something once it has gone big. */
+static void put_value(struct Session *s, int kind, calc_real re, calc_real im, calc_int ival,
+                      const struct DDReal *dd, const struct Ratio *rat)
 {
-    struct Window *win = NULL;
-    struct NewWindow nw;
-    struct CalcState state;
-    struct IntuiMessage *msg;
-    int running = 1;
+    int nlen = rat->big ? rat->nlen : 0;
+    int dlen = rat->big ? rat->dlen : 0;
+    int i;
 
-    IntuitionBase = (struct IntuitionBase *)OpenLibrary("intuition.library", 0);
-    if (!IntuitionBase) {
+    session_put_long(s, kind);
+    session_put_real(s, (double)re);
+    session_put_real(s, (double)im);
+    session_put_int(s, ival);
+    session_put_real(s, dd->hi);
+    session_put_real(s, dd->lo);
+    session_put_long(s, rat->big);
+    session_put_int(s, rat->num);
+    session_put_int(s, rat->den);
+    session_put_long(s, rat->neg);
+    session_put_long(s, nlen);
+    session_put_long(s, dlen);
+    for (i = 0; i < nlen; ++i) {
+        session_put_long(s, (long)rat->n[i]);
+    }
+    for (i = 0; i < dlen; ++i) {
+        session_put_long(s, (long)rat->d[i]);
+    }
+}
+
+static void get_value(struct Session *s, int *kind, calc_real *re, calc_real *im, calc_int *ival,
+                      struct DDReal *dd, struct Ratio *rat)
+{
+    int i;
+
+    *kind = (int)session_get_long(s);
+    *re = (calc_real)session_get_real(s);
+    *im = (calc_real)session_get_real(s);
+    *ival = session_get_int(s);
+    dd->hi = session_get_real(s);
+    dd->lo = session_get_real(s);
+    rat->big = (int)session_get_long(s);
+    rat->num = session_get_int(s);
+    rat->den = session_get_int(s);
+    rat->neg = (int)session_get_long(s);
+    rat->nlen = (short)session_get_long(s);
+    rat->dlen = (short)session_get_long(s);
+    if (*kind < NUM_INT || *kind > NUM_CPLX || rat->nlen < 0 || rat->nlen > RAT_LIMBS ||
+        rat->dlen < 0 || rat->dlen > RAT_LIMBS) {
+        s->ok = 0;
+        return;
+    }
+    for (i = 0; i < rat->nlen; ++i) {
+        rat->n[i] = (bn_limb)session_get_long(s);
+    }
+    for (i = 0; i < rat->dlen; ++i) {
+        rat->d[i] = (bn_limb)session_get_long(s);
+    }
+}
+
+/* One record for saving and loading, which never overlap. */
+static struct Session session;
+static char session_expr[HIST_ARENA / 4];
+static char session_value[HIST_ARENA / 4];
+
+/*
+ * The calculator as it was left: modes, entry, expression line, the
+ * pending operator and parentheses with their exact values, the cached
+ * exact result, the Calculo bounds and the history, oldest first. The
+ * digits of a long result are not kept, so such a value comes back as
+ * its shown text.
+ */
+static void save_session(const struct CalcState *state, const struct Window *win)
+{
+    struct Session *s = &session;
+    const struct CalcNum *num = &state->entry_num;
+    int keep_num = state->entry_num_valid && num->long_id == 0;
+    const char *expr;
+    const char *value;
+    long back;
+    int i;
+
+    session_begin(s);
+    session_put_long(s, win->LeftEdge);
+    session_put_long(s, win->TopEdge);
+    session_put_long(s, win->Width);
+    session_put_long(s, win->Height);
+    session_put_long(s, state->angle_mode);
+    session_put_long(s, state->arith_mode);
+    session_put_long(s, state->show_expr);
+    session_put_long(s, state->show_decimal);
+    session_put_long(s, state->inv);
+    session_put_long(s, state->error);
+    session_put_long(s, state->just_result);
+    session_put_text(s, state->entry);
+    session_put_text(s, state->expr);
+    session_put_long(s, state->expr_entry_start);
+    put_value(s, state->accum_kind, state->accum, state->accum_im, state->accum_int,
+              &state->accum_dd, &state->accum_rat);
+    session_put_long(s, state->accum_set);
+    session_put_long(s, state->op);
+    session_put_long(s, state->paren_depth);
+    for (i = 0; i < state->paren_depth; ++i) {
+        put_value(s, state->paren_accum_kind[i], state->paren_accum[i],
+                  state->paren_accum_im[i], state->paren_accum_int[i],
+                  &state->paren_accum_dd[i], &state->paren_accum_rat[i]);
+        session_put_long(s, state->paren_accum_set[i]);
+        session_put_long(s, state->paren_op[i]);
+    }
+    session_put_long(s, keep_num);
+    if (keep_num) {
+        put_value(s, num->kind, num->real, num->imag, num->ival, &num->dd, &num->rat);
+        session_put_text(s, state->entry_num_text);
+    }
+    session_put_real(s, (double)state->var_x);
+    session_put_real(s, (double)state->int_from);
+    session_put_real(s, (double)state->int_to);
+    session_put_long(s, state->int_to_inf);
+    session_put_long(s, hist_count());
+    for (back = hist_count(); back >= 1; --back) {
+        hist_get(back, &expr, &value);
+        session_put_text(s, expr);
+        session_put_text(s, value);
+    }
+    session_write(s, SESSION_FILE);
+}
+
+/* Nothing changes unless the whole snapshot reads back and makes sense. */
+static int load_session(struct CalcState *state, int *left, int *top, int *width, int *height)
+{
+    struct Session *s = &session;
+    static struct CalcState saved;
+    struct CalcNum *num = &saved.entry_num;
+    int box[4];
+    long hist_start;
+    long count;
+    long back;
+    int i;
+
+    if (!session_read(s, SESSION_FILE)) {
         return 0;
     }
-    GfxBase = (struct GfxBase *)OpenLibrary("graphics.library", 0);
-    if (!GfxBase) {
-        CloseLibrary((struct Library *)IntuitionBase);
+    saved = *state;
+    box[0] = (int)session_get_long(s);
+    box[1] = (int)session_get_long(s);
+    box[2] = (int)session_get_long(s);
+    box[3] = (int)session_get_long(s);
+    saved.angle_mode = (int)session_get_long(s);
+    saved.arith_mode = (int)session_get_long(s);
+    saved.show_expr = (int)session_get_long(s);
+    saved.show_decimal = (int)session_get_long(s);
+    saved.inv = (int)session_get_long(s);
+    saved.error = (int)session_get_long(s);
+    saved.just_result = (int)session_get_long(s);
+    session_get_text(s, saved.entry, (int)sizeof(saved.entry));
+    saved.entry_len = (int)strlen(saved.entry);
+    session_get_text(s, saved.expr, (int)sizeof(saved.expr));
+    saved.expr_len = (int)strlen(saved.expr);
+    saved.expr_entry_start = (int)session_get_long(s);
+    get_value(s, &saved.accum_kind, &saved.accum, &saved.accum_im, &saved.accum_int,
+              &saved.accum_dd, &saved.accum_rat);
+    saved.accum_set = (int)session_get_long(s);
+    saved.op = (char)session_get_long(s);
+    saved.paren_depth = (int)session_get_long(s);
+    if (saved.paren_depth < 0 || saved.paren_depth > MAX_PAREN_DEPTH) {
+        return 0;
+    }
+    for (i = 0; i < saved.paren_depth; ++i) {
+        get_value(s, &saved.paren_accum_kind[i], &saved.paren_accum[i],
+                  &saved.paren_accum_im[i], &saved.paren_accum_int[i],
+                  &saved.paren_accum_dd[i], &saved.paren_accum_rat[i]);
+        saved.paren_accum_set[i] = (int)session_get_long(s);
+        saved.paren_op[i] = (char)session_get_long(s);
+    }
+    saved.entry_num_valid = (int)session_get_long(s);
+    if (saved.entry_num_valid) {
+        get_value(s, &num->kind, &num->real, &num->imag, &num->ival, &num->dd, &num->rat);
+        num->long_id = 0;
+        session_get_text(s, saved.entry_num_text, (int)sizeof(saved.entry_num_text));
+    }
+    saved.var_x = (calc_real)session_get_real(s);
+    saved.int_from = (calc_real)session_get_real(s);
+    saved.int_to = (calc_real)session_get_real(s);
+    saved.int_to_inf = (int)session_get_long(s);
+    hist_start = s->pos;
+    count = session_get_long(s);
+    if (count < 0 || count > HIST_SIZE) {
+        return 0;
+    }
+    for (back = 0; back < count; ++back) {
+        session_get_text(s, session_expr, (int)sizeof(session_expr));
+        session_get_text(s, session_value, (int)sizeof(session_value));
+    }
+    if (!s->ok || s->pos != s->len ||
+        saved.angle_mode < ANGLE_RAD || saved.angle_mode > ANGLE_DEG ||
+        saved.arith_mode < ARITH_REAL || saved.arith_mode > ARITH_CPLX ||
+        saved.expr_entry_start < -1 || saved.expr_entry_start > saved.expr_len ||
+        box[2] <= 0 || box[3] <= 0) {
         return 0;
     }
+    *state = saved;
+    *left = box[0];
+    *top = box[1];
+    *width = box[2];
+    *height = box[3];
+    hist_clear();
+    s->pos = hist_start;
+    count = session_get_long(s);
+    for (back = 0; back < count; ++back) {
+        session_get_text(s, session_expr, (int)sizeof(session_expr));
+        session_get_text(s, session_value, (int)sizeof(session_value));
+        hist_add(session_expr, session_value);
+    }
+    return 1;
+}
+
+/*
+ * Every window has its own calculator but they share one IDCMP port, the
+ * menus and the label widths. The registers, the worksheet, the names,
+ * the macros and the generators belong to the process, so all windows see
+ * the same ones.
+ */
+struct CalcWindow {
+    struct Window *win;
+    struct CalcState state;
+    struct Layout layout;
+};
+
+static struct CalcWindow calc_windows[MAX_WINDOWS];
+static struct MsgPort *idcmp_port = NULL;
+static int menus_ready = 0;
+
+static void init_state(struct CalcState *state)
+{
+    clear_state(state);
+    state->inv = 0;
+    state->angle_mode = ANGLE_RAD;
+    state->show_expr = 0;
+    state->show_decimal = 0;
+    state->arith_mode = ARITH_REAL;
+    state->var_x = REAL_C(0.0);
+    state->int_from = REAL_C(0.0);
+    state->int_to = REAL_C(1.0);
+    state->int_to_inf = 0;
+}
+
+static struct CalcWindow *window_of(const struct Window *win)
+{
+    int i;
+
+    for (i = 0; i < MAX_WINDOWS; ++i) {
+        if (calc_windows[i].win && calc_windows[i].win == win) {
+            return &calc_windows[i];
+        }
+    }
+    return NULL;
+}
+
+static struct CalcWindow *window_of_state(const struct CalcState *state)
+{
+    int i;
+
+    for (i = 0; i < MAX_WINDOWS; ++i) {
+        if (calc_windows[i].win && &calc_windows[i].state == state) {
+            return &calc_windows[i];
+        }
+    }
+    return NULL;
+}
+
+/* Opened without IDCMP, then hooked to the shared port. */
+/*
+ * Lays the window out again for its current size, first growing it to
+ * the smallest size the font allows; that size change comes back as
+ * NEWSIZE and lays it out once more.
+ */
+static void fit_window(struct CalcWindow *cw)
+{
+    struct Window *win = cw->win;
+    struct Layout *lay = &cw->layout;
+    int border_w = win->Width - content_width(win);
+    int border_h = win->Height - content_height(win);
+    int grow_w;
+    int grow_h;
+
+    compute_layout(lay, win);
+    WindowLimits(win, lay->min_w + border_w, lay->min_h + border_h, (ULONG)~0UL, (ULONG)~0UL);
+    grow_w = lay->min_w - content_width(win);
+    grow_h = lay->min_h - content_height(win);
+    if (grow_w > 0 || grow_h > 0) {
+        SizeWindow(win, grow_w > 0 ? grow_w : 0, grow_h > 0 ? grow_h : 0);
+    }
+}
 
-    clear_state(&state);
-    state.inv = 0;
-    state.angle_mode = ANGLE_RAD;
-    state.show_expr = 0;
+static int open_calc_window(struct CalcWindow *cw, int left, int top, int width, int height)
+{
+    struct NewWindow nw;
+    struct Window *win;
 
     memset(&nw, 0, sizeof(nw));
-    nw.LeftEdge = 50;
-    nw.TopEdge = 50;
-    nw.Width = WIN_W;
-    nw.Height = WIN_H;
+    nw.LeftEdge = (WORD)left;
+    nw.TopEdge = (WORD)top;
+    nw.Width = (WORD)width;
+    nw.Height = (WORD)height;
     nw.DetailPen = (UBYTE)-1;
     nw.BlockPen = (UBYTE)-1;
-    nw.IDCMPFlags = CLOSEWINDOW | MOUSEBUTTONS | REFRESHWINDOW | MENUPICK;
-    nw.Flags = WINDOWDRAG | WINDOWDEPTH | WINDOWCLOSE |
+    nw.IDCMPFlags = 0;
+    nw.Flags = WINDOWDRAG | WINDOWDEPTH | WINDOWCLOSE | WINDOWSIZING |
                SMART_REFRESH | ACTIVATE | GIMMEZEROZERO;
     nw.Title = (UBYTE *)"AmiCalc 1.3";
     nw.Type = WBENCHSCREEN;
 
     win = OpenWindow(&nw);
+    if (!win && (left != WIN_LEFT || top != WIN_TOP || width != WIN_W || height != WIN_H)) {
+        /* A position or size saved on a larger screen. */
+        nw.LeftEdge = WIN_LEFT;
+        nw.TopEdge = WIN_TOP;
+        nw.Width = WIN_W;
+        nw.Height = WIN_H;
+        win = OpenWindow(&nw);
+    }
     if (!win) {
-        CloseLibrary((struct Library *)GfxBase);
-        CloseLibrary((struct Library *)IntuitionBase);
         return 0;
     }
-
-    init_menus(win, &state);
+    win->UserPort = idcmp_port;
+    ModifyIDCMP(win, WIN_IDCMP);
+    if (!menus_ready) {
+        init_menus(win, &cw->state);
+        measure_labels(win->RPort);
+        index_buttons();
+        menus_ready = 1;
+    }
+    check_menus(&cw->state);
     SetMenuStrip(win, &menu_constants);
+    win->UserData = (APTR)&cw->layout;
+    cw->win = win;
+    fit_window(cw);
+
+    update_preview(&cw->state);
+    draw_ui(win, &cw->state);
+    return 1;
+}
+
+/*
+ * The port outlives the window, so the messages still queued for it are
+ * replied here, and Intuition must not free the port with the window.
+ */
+/* Cancels the job the window's state posted and waits for it to come back. */
+static void stop_job(struct CalcState *state)
+{
+    if (!job_busy || job_owner != state) {
+        return;
+    }
+    compute_cancel(&job);
+    while (compute_done() == NULL) {
+        Wait(compute_signal());
+    }
+    job_busy = 0;
+    free(job.limbs);
+    job.limbs = NULL;
+}
+
+static void close_calc_window(struct CalcWindow *cw)
+{
+    struct Window *win = cw->win;
+    struct IntuiMessage *msg;
+    struct Node *succ;
+
+    stop_job(&cw->state);
+    Forbid();
+    msg = (struct IntuiMessage *)idcmp_port->mp_MsgList.lh_Head;
+    while ((succ = msg->ExecMessage.mn_Node.ln_Succ) != NULL) {
+        if (msg->IDCMPWindow == win) {
+            Remove((struct Node *)msg);
+            ReplyMsg((struct Message *)msg);
+        }
+        msg = (struct IntuiMessage *)succ;
+    }
+    win->UserPort = NULL;
+    ModifyIDCMP(win, 0);
+    Permit();
+    ClearMenuStrip(win);
+    CloseWindow(win);
+    cw->win = NULL;
+}
 
-    draw_ui(win, &state);
+/* A new window starts in the modes of the one it was opened from. */
+static int new_calc_window(const struct CalcWindow *from)
+{
+    int i;
+
+    for (i = 0; i < MAX_WINDOWS; ++i) {
+        struct CalcWindow *cw = &calc_windows[i];
+
+        if (!cw->win) {
+            init_state(&cw->state);
+            cw->state.angle_mode = from->state.angle_mode;
+            cw->state.arith_mode = from->state.arith_mode;
+            cw->state.show_expr = from->state.show_expr;
+            cw->state.show_decimal = from->state.show_decimal;
+            return open_calc_window(cw, from->win->LeftEdge + WIN_STEP,
+                                    from->win->TopEdge + WIN_STEP,
+                                    from->win->Width, from->win->Height);
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    struct CalcWindow *cw;
+    struct IntuiMessage *msg;
+    int open_count;
+    int left = WIN_LEFT;
+    int top = WIN_TOP;
+    int width = WIN_W;
+    int height = WIN_H;
 
-    while (running) {
-        WaitPort(win->UserPort);
-        while ((msg = (struct IntuiMessage *)GetMsg(win->UserPort)) != NULL) {
+    IntuitionBase = (struct IntuitionBase *)OpenLibrary("intuition.library", 0);
+    if (!IntuitionBase) {
+        return 0;
+    }
+    GfxBase = (struct GfxBase *)OpenLibrary("graphics.library", 0);
+    if (!GfxBase) {
+        CloseLibrary((struct Library *)IntuitionBase);
+        return 0;
+    }
+    idcmp_port = CreatePort(NULL, 0);
+    if (!idcmp_port) {
+        CloseLibrary((struct Library *)GfxBase);
+        CloseLibrary((struct Library *)IntuitionBase);
+        return 0;
+    }
+    calc_math_init();
+    compute_init();
+
+    init_state(&calc_windows[0].state);
+    load_session(&calc_windows[0].state, &left, &top, &width, &height);
+    rng_seed(&rng_key, (unsigned long)time(NULL));
+    rng_mc = rng_key;
+    rng_jump(&rng_mc);
+
+    if (!open_calc_window(&calc_windows[0], left, top, width, height)) {
+        compute_cleanup();
+        calc_math_cleanup();
+        DeletePort(idcmp_port);
+        CloseLibrary((struct Library *)GfxBase);
+        CloseLibrary((struct Library *)IntuitionBase);
+        return 0;
+    }
+    open_count = 1;
+
+    while (open_count > 0) {
+        Wait((1UL << idcmp_port->mp_SigBit) | compute_signal());
+        while (compute_done() != NULL) {
+            struct CalcState *owner = job_owner;
+
+            finish_job(owner);
+            update_preview(owner);
+            cw = window_of_state(owner);
+            if (cw) {
+                draw_display(cw->win, owner);
+            }
+        }
+        while (open_count > 0 &&
+               (msg = (struct IntuiMessage *)GetMsg(idcmp_port)) != NULL) {
             ULONG cls = msg->Class;
             UWORD code = msg->Code;
+            struct Window *win = msg->IDCMPWindow;
+            struct CalcState *state;
+            int local_x;
+            int local_y;
+
+            cw = window_of(win);
+            if (!cw) {
+                ReplyMsg((struct Message *)msg);
+                continue;
+            }
+            state = &cw->state;
             if (cls == REFRESHWINDOW) {
                 BeginRefresh(win);
-                draw_ui(win, &state);
+                draw_ui(win, state);
                 EndRefresh(win, TRUE);
                 ReplyMsg((struct Message *)msg);
                 continue;
             }
+            local_x = message_inner_x(win, msg);
+            local_y = message_inner_y(win, msg);
 
             ReplyMsg((struct Message *)msg);
 
             if (cls == CLOSEWINDOW) {
-                running = 0;
+                if (open_count == 1) {
+                    /* The session goes through stdio, which must not meet the task's mallocs. */
+                    stop_job(state);
+                    save_session(state, win);
+                }
+                close_calc_window(cw);
+                open_count--;
+            } else if (cls == ACTIVEWINDOW) {
+                check_menus(state);
+            } else if (cls == NEWSIZE) {
+                fit_window(cw);
+                draw_ui(win, state);
+            } else if (job_busy) {
+                /* Only C in the window that started the job, which cancels it. */
+                if (cls == INTUITICKS) {
+                    struct CalcWindow *owner = window_of_state(job_owner);
+
+                    if (owner && job.kind != JOB_COMBI) {
+                        sprintf(job_owner->status, "Calculando %ld", job.watch.points);
+                        draw_display(owner->win, job_owner);
+                    }
+                } else if (cls == MOUSEBUTTONS && code == SELECTUP && state == job_owner) {
+                    const struct Button *btn = NULL;
+
+                    if (local_x >= 0 && local_y >= 0) {
+                        btn = find_button(&cw->layout, local_x, local_y);
+                    }
+                    if (btn && btn->action == 'C') {
+                        compute_cancel(&job);
+                    }
+                }
             } else if (cls == MENUPICK) {
-                handle_menu_pick(&state, (USHORT)msg->Code);
-                draw_display(win, &state);
+                handle_menu_pick(state, code);
+                update_preview(state);
+                draw_display(win, state);
+                if (window_wanted) {
+                    window_wanted = 0;
+                    open_count += new_calc_window(cw);
+                }
+            } else if (cls == VANILLAKEY) {
+                handle_name_key(state, (char)code);
+                update_preview(state);
+                draw_display(win, state);
             } else if (cls == MOUSEBUTTONS) {
                 if (code == SELECTUP) {
-                    int local_x = message_inner_x(win, msg);
-                    int local_y = message_inner_y(win, msg);
                     const struct Button *btn = NULL;
 
                     if (local_x >= 0 && local_y >= 0) {
-                        btn = find_button(local_x, local_y);
+                        btn = find_button(&cw->layout, local_x, local_y);
                     }
                     if (btn) {
-                        handle_action(&state, btn->action);
-                        draw_display(win, &state);
+                        macro_record_key(btn->action);
+                        if (!start_combi_job(state, btn->action)) {
+                            handle_action(state, btn->action);
+                        }
+                        update_preview(state);
+                        draw_display(win, state);
                         if (btn->action == 'I') {
-                            draw_buttons(win, &state);
+                            draw_buttons(win, state);
                         }
+                    } else if (local_x >= cw->layout.disp_x &&
+                               local_x < cw->layout.disp_x + cw->layout.disp_w &&
+                               local_y >= cw->layout.disp_y &&
+                               local_y < cw->layout.disp_y + cw->layout.disp_h) {
+                        int forward = local_x >= cw->layout.disp_x + cw->layout.disp_w / 2;
+
+                        if (state->hist_pos >= 0) {
+                            scroll_history(state, forward);
+                        } else if (state->root_pos >= 0) {
+                            scroll_roots(state, forward);
+                        } else if (state->cell_pos >= 0) {
+                            scroll_cells(state, forward);
+                        } else {
+                            scroll_long_view(state, forward);
+                        }
+                        draw_display(win, state);
                     }
                 }
             }
         }
     }
 
-    ClearMenuStrip(win);
-    CloseWindow(win);
+    if (job_busy) {
+        compute_cancel(&job);
+    }
+    compute_cleanup();
+    DeletePort(idcmp_port);
+    free(long_digits);
+    sheet_clear();
+    sym_clear();
+    calc_math_cleanup();
     CloseLibrary((struct Library *)GfxBase);
     CloseLibrary((struct Library *)IntuitionBase);
 
@@ -0,0 +1,622 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bignum.h"
+
+long bn_trim(const bn_limb *a, long len)
+{
+    while (len > 0 && a[len - 1] == 0) {
+        len--;
+    }
+    return len;
+}
+
+int bn_cmp(const bn_limb *a, long alen, const bn_limb *b, long blen)
+{
+    long i;
+
+    if (alen != blen) {
+        return (alen < blen) ? -1 : 1;
+    }
+    for (i = alen - 1; i >= 0; --i) {
+        if (a[i] != b[i]) {
+            return (a[i] < b[i]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+long bn_from_uint(bn_limb *r, unsigned long long value)
+{
+    long len = 0;
+
+    while (value != 0) {
+        r[len++] = (bn_limb)(value % BN_BASE);
+        value /= BN_BASE;
+    }
+    return len;
+}
+
+int bn_to_uint(const bn_limb *a, long alen, unsigned long long *out)
+{
+    unsigned long long value = 0;
+    long i;
+
+    for (i = alen - 1; i >= 0; --i) {
+        if (value > (0xFFFFFFFFFFFFFFFFULL - a[i]) / BN_BASE) {
+            return 0;
+        }
+        value = value * BN_BASE + a[i];
+    }
+    *out = value;
+    return 1;
+}
+
+/* r may alias a or b and needs room for max(alen, blen) + 1 limbs. */
+long bn_add(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen)
+{
+    unsigned long carry = 0;
+    long len = (alen > blen) ? alen : blen;
+    long i;
+
+    for (i = 0; i < len; ++i) {
+        unsigned long t = carry;
+
+        if (i < alen) {
+            t += a[i];
+        }
+        if (i < blen) {
+            t += b[i];
+        }
+        if (t >= BN_BASE) {
+            r[i] = (bn_limb)(t - BN_BASE);
+            carry = 1;
+        } else {
+            r[i] = (bn_limb)t;
+            carry = 0;
+        }
+    }
+    if (carry) {
+        r[len++] = 1;
+    }
+    return len;
+}
+
+/* Requires a >= b; r may alias a or b. */
+long bn_sub(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen)
+{
+    long borrow = 0;
+    long i;
+
+    for (i = 0; i < alen; ++i) {
+        long t = (long)a[i] - borrow;
+
+        if (i < blen) {
+            t -= b[i];
+        }
+        if (t < 0) {
+            r[i] = (bn_limb)(t + BN_BASE);
+            borrow = 1;
+        } else {
+            r[i] = (bn_limb)t;
+            borrow = 0;
+        }
+    }
+    return bn_trim(r, alen);
+}
+
+/* Schoolbook product; r holds alen + blen limbs and must not alias a or b. */
+long bn_mul(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen)
+{
+    long i;
+    long j;
+
+    if (alen == 0 || blen == 0) {
+        return 0;
+    }
+    memset(r, 0, (size_t)(alen + blen) * sizeof(bn_limb));
+    for (i = 0; i < alen; ++i) {
+        unsigned long ai = a[i];
+        unsigned long carry = 0;
+
+        if (ai == 0) {
+            continue;
+        }
+        for (j = 0; j < blen; ++j) {
+            unsigned long t = r[i + j] + ai * b[j] + carry;
+
+            carry = t / BN_BASE;
+            r[i + j] = (bn_limb)(t - carry * BN_BASE);
+        }
+        r[i + blen] = (bn_limb)carry;
+    }
+    return bn_trim(r, alen + blen);
+}
+
+static void add_at(bn_limb *r, long rlen, long pos, const bn_limb *a, long alen)
+{
+    unsigned long carry = 0;
+    long i;
+
+    for (i = 0; i < alen || carry; ++i) {
+        unsigned long v;
+
+        if (pos + i >= rlen) {
+            break;
+        }
+        v = (unsigned long)r[pos + i] + carry + (i < alen ? a[i] : 0);
+        carry = (v >= BN_BASE);
+        r[pos + i] = (bn_limb)(carry ? v - BN_BASE : v);
+    }
+}
+
+/* r -= a over rlen limbs; the caller guarantees r >= a. */
+static void sub_at(bn_limb *r, long rlen, const bn_limb *a, long alen)
+{
+    long borrow = 0;
+    long i;
+
+    for (i = 0; i < rlen && (i < alen || borrow); ++i) {
+        long v = (long)r[i] - borrow - (i < alen ? a[i] : 0);
+
+        borrow = (v < 0);
+        r[i] = (bn_limb)(borrow ? v + BN_BASE : v);
+    }
+}
+
+/*
+ * Column sums of fewer than 42 limb products fit 32 bits, so below the
+ * Karatsuba threshold the carries are propagated once at the end instead
+ * of dividing after every product.
+ */
+static void kara_base(bn_limb *r, const bn_limb *a, const bn_limb *b, long n)
+{
+    unsigned long acc[2 * BN_KARA_THRESH];
+    unsigned long carry = 0;
+    long i;
+    long j;
+
+    memset(acc, 0, (size_t)(2 * n) * sizeof(unsigned long));
+    for (i = 0; i < n; ++i) {
+        unsigned long ai = a[i];
+
+        if (ai == 0) {
+            continue;
+        }
+        for (j = 0; j < n; ++j) {
+            acc[i + j] += ai * b[j];
+        }
+    }
+    for (i = 0; i < 2 * n; ++i) {
+        unsigned long v = acc[i] + carry;
+
+        carry = v / BN_BASE;
+        r[i] = (bn_limb)(v - carry * BN_BASE);
+    }
+}
+
+/*
+ * Karatsuba on two n-limb operands (zero padded); r receives all 2n limbs
+ * untrimmed. The half sums may carry into one extra limb, which is why
+ * the middle product works on h + 1 limbs.
+ */
+static void kara(bn_limb *r, const bn_limb *a, const bn_limb *b, long n, bn_limb *scratch)
+{
+    bn_limb *sa;
+    bn_limb *sb;
+    bn_limb *t;
+    unsigned long carry;
+    long m;
+    long h;
+    long i;
+
+    if (n < BN_KARA_THRESH) {
+        kara_base(r, a, b, n);
+        return;
+    }
+    m = n / 2;
+    h = n - m;
+    sa = scratch;
+    sb = sa + h + 1;
+    t = sb + h + 1;
+
+    kara(r, a, b, m, t);
+    kara(r + 2 * m, a + m, b + m, h, t);
+
+    /* sa = a0 + a1, sb = b0 + b1; the high halves are the longer ones. */
+    carry = 0;
+    for (i = 0; i < h; ++i) {
+        unsigned long x = carry + a[m + i] + (i < m ? a[i] : 0);
+
+        carry = (x >= BN_BASE);
+        sa[i] = (bn_limb)(carry ? x - BN_BASE : x);
+    }
+    sa[h] = (bn_limb)carry;
+    carry = 0;
+    for (i = 0; i < h; ++i) {
+        unsigned long y = carry + b[m + i] + (i < m ? b[i] : 0);
+
+        carry = (y >= BN_BASE);
+        sb[i] = (bn_limb)(carry ? y - BN_BASE : y);
+    }
+    sb[h] = (bn_limb)carry;
+    kara(t, sa, sb, h + 1, t + 2 * (h + 1));
+
+    /* t -= z0, t -= z2; what is left is a0*b1 + a1*b0 and stays positive. */
+    sub_at(t, 2 * (h + 1), r, 2 * m);
+    sub_at(t, 2 * (h + 1), r + 2 * m, 2 * h);
+    add_at(r, 2 * n, m, t, 2 * (h + 1));
+}
+
+static long kara_scratch(long n)
+{
+    long total = 0;
+
+    while (n >= BN_KARA_THRESH) {
+        long h = n - n / 2;
+
+        total += 4 * (h + 1);
+        n = h + 1;
+    }
+    return total;
+}
+
+#define NTT_P1 998244353UL
+#define NTT_P2 469762049UL
+#define NTT_ROOT 3UL
+
+static unsigned long mod_mul(unsigned long a, unsigned long b, unsigned long p)
+{
+    return (unsigned long)((unsigned long long)a * b % p);
+}
+
+static unsigned long mod_pow(unsigned long b, unsigned long e, unsigned long p)
+{
+    unsigned long r = 1;
+
+    while (e > 0) {
+        if (e & 1) {
+            r = mod_mul(r, b, p);
+        }
+        b = mod_mul(b, b, p);
+        e >>= 1;
+    }
+    return r;
+}
+
+/* In-place transform of n (a power of two) residues modulo p. */
+static void ntt(unsigned long *a, long n, int inverse, unsigned long p)
+{
+    long len;
+    long i;
+    long j;
+
+    for (i = 1, j = 0; i < n; ++i) {
+        long bit = n >> 1;
+
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            unsigned long t = a[i];
+
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+    for (len = 2; len <= n; len <<= 1) {
+        long half = len / 2;
+        unsigned long w = mod_pow(NTT_ROOT, (p - 1) / (unsigned long)len, p);
+
+        if (inverse) {
+            w = mod_pow(w, p - 2, p);
+        }
+        for (i = 0; i < n; i += len) {
+            unsigned long wk = 1;
+
+            for (j = 0; j < half; ++j) {
+                unsigned long u = a[i + j];
+                unsigned long v = mod_mul(a[i + j + half], wk, p);
+
+                a[i + j] = (u + v >= p) ? u + v - p : u + v;
+                a[i + j + half] = (u >= v) ? u - v : u + p - v;
+                wk = mod_mul(wk, w, p);
+            }
+        }
+    }
+    if (inverse) {
+        unsigned long n_inv = mod_pow((unsigned long)n % p, p - 2, p);
+
+        for (i = 0; i < n; ++i) {
+            a[i] = mod_mul(a[i], n_inv, p);
+        }
+    }
+}
+
+/* The cyclic convolution of a and b modulo p, left in fa. */
+static void ntt_convolve(unsigned long *fa, unsigned long *fb, long n, const bn_limb *a,
+                         long alen, const bn_limb *b, long blen, unsigned long p)
+{
+    long i;
+
+    for (i = 0; i < n; ++i) {
+        fa[i] = i < alen ? a[i] : 0;
+        fb[i] = i < blen ? b[i] : 0;
+    }
+    ntt(fa, n, 0, p);
+    ntt(fb, n, 0, p);
+    for (i = 0; i < n; ++i) {
+        fa[i] = mod_mul(fa[i], fb[i], p);
+    }
+    ntt(fa, n, 1, p);
+}
+
+/*
+ * Each column of the product is below blen * 9999^2 < NTT_P1 * NTT_P2,
+ * so its residues modulo the two primes determine it. Returns -1 when
+ * the transforms cannot be allocated.
+ */
+static long ntt_mul(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen)
+{
+    unsigned long *f1;
+    unsigned long *f2;
+    unsigned long *fb;
+    unsigned long p1_inv;
+    unsigned long long carry = 0;
+    long n = 1;
+    long i;
+
+    while (n < alen + blen) {
+        n <<= 1;
+    }
+    f1 = (unsigned long *)malloc((size_t)(3 * n) * sizeof(unsigned long));
+    if (!f1) {
+        return -1;
+    }
+    f2 = f1 + n;
+    fb = f2 + n;
+    ntt_convolve(f1, fb, n, a, alen, b, blen, NTT_P1);
+    ntt_convolve(f2, fb, n, a, alen, b, blen, NTT_P2);
+    p1_inv = mod_pow(NTT_P1 % NTT_P2, NTT_P2 - 2, NTT_P2);
+    for (i = 0; i < alen + blen; ++i) {
+        unsigned long k = mod_mul((f2[i] + NTT_P2 - f1[i] % NTT_P2) % NTT_P2, p1_inv, NTT_P2);
+        unsigned long long v = carry + f1[i] + (unsigned long long)NTT_P1 * k;
+
+        carry = v / BN_BASE;
+        r[i] = (bn_limb)(v - carry * BN_BASE);
+    }
+    free(f1);
+    return bn_trim(r, alen + blen);
+}
+
+/*
+ * Product for large operands: transforms for the largest, otherwise
+ * Karatsuba on blen-sized slices of the longer operand, the short tail
+ * recursing with the roles swapped. r holds
+ * alen + blen limbs and must not alias a or b. Returns the trimmed length,
+ * or -1 if the scratch space cannot be allocated.
+ */
+long bn_mul_fast(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen)
+{
+    bn_limb *scratch;
+    bn_limb *prod;
+    long pos;
+    long tail;
+
+    if (alen < blen) {
+        const bn_limb *tp = a;
+        long tl = alen;
+
+        a = b;
+        alen = blen;
+        b = tp;
+        blen = tl;
+    }
+    if (blen < BN_KARA_THRESH) {
+        return bn_mul(r, a, alen, b, blen);
+    }
+    if (blen >= BN_NTT_THRESH && alen + blen <= BN_NTT_MAX) {
+        long len = ntt_mul(r, a, alen, b, blen);
+
+        if (len >= 0) {
+            return len;
+        }
+    }
+    scratch = (bn_limb *)malloc((size_t)(2 * blen + kara_scratch(blen)) * sizeof(bn_limb));
+    if (!scratch) {
+        return -1;
+    }
+    prod = scratch;
+    memset(r, 0, (size_t)(alen + blen) * sizeof(bn_limb));
+    for (pos = 0; pos + blen <= alen; pos += blen) {
+        kara(prod, a + pos, b, blen, prod + 2 * blen);
+        add_at(r, alen + blen, pos, prod, 2 * blen);
+    }
+    tail = bn_trim(a + pos, alen - pos);
+    if (tail > 0) {
+        /* The tail is shorter than b, so prod has room for its product. */
+        if (bn_mul_fast(prod, b, blen, a + pos, tail) < 0) {
+            free(scratch);
+            return -1;
+        }
+        add_at(r, alen + blen, pos, prod, blen + tail);
+    }
+    free(scratch);
+    return bn_trim(r, alen + blen);
+}
+
+/* m must stay below 400000 so limb products fit 32 bits; r may alias a. */
+long bn_mul_small(bn_limb *r, const bn_limb *a, long alen, unsigned long m)
+{
+    unsigned long carry = 0;
+    long i;
+
+    if (m == 0) {
+        return 0;
+    }
+    for (i = 0; i < alen; ++i) {
+        unsigned long t = a[i] * m + carry;
+
+        carry = t / BN_BASE;
+        r[i] = (bn_limb)(t - carry * BN_BASE);
+    }
+    while (carry != 0) {
+        r[i++] = (bn_limb)(carry % BN_BASE);
+        carry /= BN_BASE;
+    }
+    return i;
+}
+
+/* d must stay below 400000; q may alias a. */
+long bn_div_small(bn_limb *q, const bn_limb *a, long alen, unsigned long d, unsigned long *rem)
+{
+    unsigned long r = 0;
+    long i;
+
+    for (i = alen - 1; i >= 0; --i) {
+        unsigned long t = r * BN_BASE + a[i];
+
+        q[i] = (bn_limb)(t / d);
+        r = t - (unsigned long)q[i] * d;
+    }
+    if (rem) {
+        *rem = r;
+    }
+    return bn_trim(q, alen);
+}
+
+long bn_shr1(bn_limb *a, long alen)
+{
+    unsigned long r = 0;
+    long i;
+
+    for (i = alen - 1; i >= 0; --i) {
+        unsigned long t = r * BN_BASE + a[i];
+
+        a[i] = (bn_limb)(t >> 1);
+        r = t & 1UL;
+    }
+    return bn_trim(a, alen);
+}
+
+/*
+ * Knuth algorithm D in base 10000. q receives alen - blen + 1 limbs, r
+ * blen limbs and scratch needs alen + blen + 1 limbs. b must be nonzero.
+ * Returns the remainder length.
+ */
+long bn_divmod(bn_limb *q, long *qlen, bn_limb *r, const bn_limb *a, long alen,
+               const bn_limb *b, long blen, bn_limb *scratch)
+{
+    bn_limb *u = scratch;
+    bn_limb *v = scratch + alen + 1;
+    unsigned long d;
+    unsigned long rem;
+    long i;
+    long j;
+
+    alen = bn_trim(a, alen);
+    blen = bn_trim(b, blen);
+    if (bn_cmp(a, alen, b, blen) < 0) {
+        *qlen = 0;
+        memmove(r, a, (size_t)alen * sizeof(bn_limb));
+        return alen;
+    }
+    if (blen == 1) {
+        *qlen = bn_div_small(q, a, alen, b[0], &rem);
+        r[0] = (bn_limb)rem;
+        return rem ? 1 : 0;
+    }
+
+    d = BN_BASE / ((unsigned long)b[blen - 1] + 1);
+    memset(u, 0, (size_t)(alen + 1) * sizeof(bn_limb));
+    bn_mul_small(u, a, alen, d);
+    bn_mul_small(v, b, blen, d);
+
+    for (j = alen - blen; j >= 0; --j) {
+        unsigned long num = (unsigned long)u[j + blen] * BN_BASE + u[j + blen - 1];
+        unsigned long qhat = num / v[blen - 1];
+        unsigned long rhat = num - qhat * v[blen - 1];
+        unsigned long carry = 0;
+        long borrow = 0;
+        long t;
+
+        while (qhat >= BN_BASE ||
+               qhat * v[blen - 2] > rhat * BN_BASE + u[j + blen - 2]) {
+            qhat--;
+            rhat += v[blen - 1];
+            if (rhat >= BN_BASE) {
+                break;
+            }
+        }
+
+        for (i = 0; i < blen; ++i) {
+            unsigned long p = qhat * v[i] + carry;
+
+            carry = p / BN_BASE;
+            t = (long)u[i + j] - (long)(p - carry * BN_BASE) - borrow;
+            if (t < 0) {
+                u[i + j] = (bn_limb)(t + BN_BASE);
+                borrow = 1;
+            } else {
+                u[i + j] = (bn_limb)t;
+                borrow = 0;
+            }
+        }
+        t = (long)u[j + blen] - (long)carry - borrow;
+        if (t < 0) {
+            /* qhat was one too large: add the divisor back. */
+            u[j + blen] = (bn_limb)(t + BN_BASE);
+            qhat--;
+            carry = 0;
+            for (i = 0; i < blen; ++i) {
+                unsigned long s = (unsigned long)u[i + j] + v[i] + carry;
+
+                carry = (s >= BN_BASE);
+                u[i + j] = (bn_limb)(carry ? s - BN_BASE : s);
+            }
+            u[j + blen] = (bn_limb)((u[j + blen] + carry) % BN_BASE);
+        } else {
+            u[j + blen] = (bn_limb)t;
+        }
+        q[j] = (bn_limb)qhat;
+    }
+    *qlen = bn_trim(q, alen - blen + 1);
+    return bn_div_small(r, u, blen, d, NULL);
+}
+
+long bn_to_string(char *out, const bn_limb *a, long alen)
+{
+    char *p = out;
+    long i;
+
+    alen = bn_trim(a, alen);
+    if (alen == 0) {
+        out[0] = '0';
+        out[1] = '\0';
+        return 1;
+    }
+    for (i = alen - 1; i >= 0; --i) {
+        unsigned int limb = a[i];
+        int pos;
+
+        for (pos = BN_DIGITS - 1; pos >= 0; --pos) {
+            p[pos] = (char)('0' + limb % 10);
+            limb /= 10;
+        }
+        if (i == alen - 1) {
+            /* The top limb is printed without its leading zeros. */
+            int skip = 0;
+
+            while (skip < BN_DIGITS - 1 && p[skip] == '0') {
+                skip++;
+            }
+            memmove(p, p + skip, (size_t)(BN_DIGITS - skip));
+            p += BN_DIGITS - skip;
+        } else {
+            p += BN_DIGITS;
+        }
+    }
+    *p = '\0';
+    return (long)(p - out);
+}
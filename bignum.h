@@ -0,0 +1,45 @@
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+/*
+ * Unsigned big integers as little-endian arrays of base 10000 limbs. The
+ * base keeps every limb product inside 32 bits (the 68000 MULU is 16x16)
+ * and makes decimal output a straight copy of the limbs. Lengths never
+ * count leading zero limbs; zero has length 0.
+ */
+typedef unsigned short bn_limb;
+
+#define BN_BASE 10000
+#define BN_DIGITS 4
+
+/*
+ * Below this many limbs bn_mul_fast falls back to the schoolbook loop; it
+ * must stay under 42 so a column of limb products fits 32 bits.
+ */
+#define BN_KARA_THRESH 32
+
+/*
+ * From this many limbs in the shorter operand bn_mul_fast multiplies by
+ * number-theoretic transforms modulo two primes, joined by the Chinese
+ * remainder theorem; BN_NTT_MAX limbs is the longest product they can
+ * hold. A transform that cannot get its memory falls back to Karatsuba.
+ */
+#define BN_NTT_THRESH 2048
+#define BN_NTT_MAX 8388608L
+
+long bn_trim(const bn_limb *a, long len);
+int bn_cmp(const bn_limb *a, long alen, const bn_limb *b, long blen);
+long bn_from_uint(bn_limb *r, unsigned long long value);
+int bn_to_uint(const bn_limb *a, long alen, unsigned long long *out);
+long bn_add(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen);
+long bn_sub(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen);
+long bn_mul(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen);
+long bn_mul_fast(bn_limb *r, const bn_limb *a, long alen, const bn_limb *b, long blen);
+long bn_mul_small(bn_limb *r, const bn_limb *a, long alen, unsigned long m);
+long bn_div_small(bn_limb *q, const bn_limb *a, long alen, unsigned long d, unsigned long *rem);
+long bn_shr1(bn_limb *a, long alen);
+long bn_divmod(bn_limb *q, long *qlen, bn_limb *r, const bn_limb *a, long alen,
+               const bn_limb *b, long blen, bn_limb *scratch);
+long bn_to_string(char *out, const bn_limb *a, long alen);
+
+#endif
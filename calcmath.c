@@ -0,0 +1,45 @@
+#ifndef AMICALC_HOST
+#include <exec/types.h>
+#include <exec/execbase.h>
+#endif
+#include "calcmath.h"
+
+#ifndef AMICALC_HOST
+extern struct ExecBase *SysBase;
+#endif
+
+const struct CalcMath *calc_math = &calc_math_soft;
+
+#if !defined(AMICALC_HOST) && !defined(AMICALC_FLOAT32)
+static int ieee_open = 0;
+#endif
+
+void calc_math_init(void)
+{
+#ifndef AMICALC_HOST
+    if (SysBase->AttnFlags & AFF_68881) {
+        calc_math = &calc_math_881;
+        return;
+    }
+#ifndef AMICALC_FLOAT32
+    /* The libraries only work in double; a float build is faster in soft-float. */
+    if (calc_math_ieee_open()) {
+        ieee_open = 1;
+        calc_math = &calc_math_ieee;
+        return;
+    }
+#endif
+#endif
+    calc_math = &calc_math_soft;
+}
+
+void calc_math_cleanup(void)
+{
+#if !defined(AMICALC_HOST) && !defined(AMICALC_FLOAT32)
+    if (ieee_open) {
+        calc_math_ieee_close();
+        ieee_open = 0;
+    }
+#endif
+    calc_math = &calc_math_soft;
+}
@@ -0,0 +1,83 @@
+#ifndef CALCMATH_H
+#define CALCMATH_H
+
+/*
+ * Scalar type of the numeric core. AMICALC_FLOAT32 trades precision for
+ * the much cheaper single precision soft-float routines on 68000 machines.
+ * CALC_REAL_SIG_DIGITS is the number of significant digits worth typing,
+ * CALC_REAL_EXP_DIGITS the widest decimal exponent the type can hold and
+ * CALC_REAL_MAX_FACT the largest n whose factorial is still finite.
+ */
+#ifdef AMICALC_FLOAT32
+typedef float calc_real;
+#define REAL_C(x) x##f
+#define CALC_REAL_FMT "%.7g"
+#define CALC_REAL_DIGITS 7
+#define CALC_REAL_SIG_DIGITS 9
+#define CALC_REAL_EXP_DIGITS 2
+#define CALC_REAL_MAX_FACT 34
+#else
+typedef double calc_real;
+#define REAL_C(x) x
+#define CALC_REAL_FMT "%.15g"
+#define CALC_REAL_DIGITS 15
+#define CALC_REAL_SIG_DIGITS 17
+#define CALC_REAL_EXP_DIGITS 3
+#define CALC_REAL_MAX_FACT 170
+#endif
+
+/*
+ * Exact integers used by the integer fast path and the rational mode.
+ * CALC_INT_DIGITS decimal digits always fit; CALC_INT_SMALL bounds the
+ * factors whose product cannot overflow.
+ */
+typedef long long calc_int;
+typedef unsigned long long calc_uint;
+
+#define CALC_INT_DIGITS 18
+#define CALC_INT_MAX 0x7FFFFFFFFFFFFFFFLL
+#define CALC_INT_MIN (-CALC_INT_MAX - 1)
+#define CALC_INT_SMALL 0x7FFFFFFFL
+
+/*
+ * Floating point backend used by compute_op and handle_unary. Each entry
+ * stores its result through a pointer instead of returning it: the 68881
+ * backend is compiled with -fpu=68881, which returns floating point values
+ * in fp0, while the rest of the program is built for d0/d1 returns.
+ */
+struct CalcMath {
+    const char *name;
+    void (*add)(calc_real *out, calc_real lhs, calc_real rhs);
+    void (*sub)(calc_real *out, calc_real lhs, calc_real rhs);
+    void (*mul)(calc_real *out, calc_real lhs, calc_real rhs);
+    void (*div)(calc_real *out, calc_real lhs, calc_real rhs);
+    void (*pow_f)(calc_real *out, calc_real base, calc_real exponent);
+    void (*sqrt_f)(calc_real *out, calc_real value);
+    void (*exp_f)(calc_real *out, calc_real value);
+    void (*log_f)(calc_real *out, calc_real value);
+    void (*log10_f)(calc_real *out, calc_real value);
+    void (*sin_f)(calc_real *out, calc_real value);
+    void (*cos_f)(calc_real *out, calc_real value);
+    void (*tan_f)(calc_real *out, calc_real value);
+    void (*asin_f)(calc_real *out, calc_real value);
+    void (*acos_f)(calc_real *out, calc_real value);
+    void (*atan_f)(calc_real *out, calc_real value);
+};
+
+extern const struct CalcMath *calc_math;
+
+extern const struct CalcMath calc_math_soft;
+#ifndef AMICALC_HOST
+extern const struct CalcMath calc_math_881;
+#ifndef AMICALC_FLOAT32
+extern const struct CalcMath calc_math_ieee;
+
+int calc_math_ieee_open(void);
+void calc_math_ieee_close(void);
+#endif
+#endif
+
+void calc_math_init(void);
+void calc_math_cleanup(void);
+
+#endif
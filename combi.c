@@ -0,0 +1,182 @@
+#include <stdlib.h>
+
+#include "combi.h"
+
+#define COMBI_LEAF 16
+#define COMBI_WORD_MAX 400000UL
+
+/* Factors are either the consecutive run first .. first + count - 1 or an array. */
+struct WordList {
+    const unsigned long *words;
+    unsigned long first;
+    const volatile int *stop;
+};
+
+static unsigned long word_at(const struct WordList *list, long i)
+{
+    return list->words ? list->words[i] : list->first + (unsigned long)i;
+}
+
+/*
+ * Binary splitting: the product of words lo .. hi - 1. Splitting by count
+ * keeps both halves of similar size, so bn_mul_fast sees balanced operands
+ * and the total cost follows the final multiplication instead of the
+ * O(n^2) of multiplying one growing number by each factor in turn.
+ */
+static long prod_tree(const struct WordList *list, long lo, long hi, bn_limb **out)
+{
+    bn_limb *left;
+    bn_limb *right;
+    bn_limb *r;
+    long llen;
+    long rlen;
+    long len;
+    long mid;
+    long i;
+
+    if (list->stop && *list->stop) {
+        return -1;
+    }
+    if (hi - lo <= COMBI_LEAF) {
+        r = (bn_limb *)malloc((size_t)(2 * (hi - lo) + 1) * sizeof(bn_limb));
+        if (!r) {
+            return -1;
+        }
+        r[0] = 1;
+        len = 1;
+        for (i = lo; i < hi; ++i) {
+            len = bn_mul_small(r, r, len, word_at(list, i));
+        }
+        *out = r;
+        return len;
+    }
+    mid = lo + (hi - lo) / 2;
+    llen = prod_tree(list, lo, mid, &left);
+    if (llen < 0) {
+        return -1;
+    }
+    rlen = prod_tree(list, mid, hi, &right);
+    if (rlen < 0) {
+        free(left);
+        return -1;
+    }
+    r = (bn_limb *)malloc((size_t)(llen + rlen) * sizeof(bn_limb));
+    len = r ? bn_mul_fast(r, left, llen, right, rlen) : -1;
+    free(left);
+    free(right);
+    if (len < 0) {
+        free(r);
+        return -1;
+    }
+    *out = r;
+    return len;
+}
+
+static long prod_words(const struct WordList *list, long count, bn_limb **out)
+{
+    if (count == 0) {
+        bn_limb *r = (bn_limb *)malloc(sizeof(bn_limb));
+
+        if (!r) {
+            return -1;
+        }
+        r[0] = 1;
+        *out = r;
+        return 1;
+    }
+    return prod_tree(list, 0, count, out);
+}
+
+long combi_factorial(unsigned long n, bn_limb **out, const volatile int *stop)
+{
+    return combi_permutations(n, n, out, stop);
+}
+
+long combi_permutations(unsigned long n, unsigned long r, bn_limb **out,
+                        const volatile int *stop)
+{
+    struct WordList list;
+
+    if (n > COMBI_MAX_N || r > n) {
+        return -1;
+    }
+    list.words = NULL;
+    list.first = n - r + 1;
+    list.stop = stop;
+    return prod_words(&list, (long)r, out);
+}
+
+/* Legendre: the exponent of p in n!. */
+static unsigned long legendre(unsigned long n, unsigned long p)
+{
+    unsigned long e = 0;
+
+    while (n >= p) {
+        n /= p;
+        e += n;
+    }
+    return e;
+}
+
+/*
+ * nCr from its prime factorization (Kummer/Legendre) instead of a
+ * quotient of factorials: no big division, and the product is only as
+ * long as the result. Prime powers are packed into words below the
+ * bn_mul_small limit before they enter the product tree.
+ */
+long combi_binomial(unsigned long n, unsigned long r, bn_limb **out, const volatile int *stop)
+{
+    struct WordList list;
+    unsigned char *composite;
+    unsigned long *words;
+    unsigned long word = 1;
+    unsigned long p;
+    unsigned long q;
+    long count = 0;
+    long len;
+
+    if (n > COMBI_MAX_N || r > n) {
+        return -1;
+    }
+    if (r > n - r) {
+        r = n - r;
+    }
+    composite = (unsigned char *)calloc((size_t)n + 1, 1);
+    /* C(n, r) < 2^n and every flushed word is at least 4: n / 2 words do. */
+    words = (unsigned long *)malloc(((size_t)n / 2 + 2) * sizeof(unsigned long));
+    if (!composite || !words) {
+        free(composite);
+        free(words);
+        return -1;
+    }
+    for (p = 2; p <= n; ++p) {
+        unsigned long e;
+
+        if (composite[p]) {
+            continue;
+        }
+        if (p <= n / p) {
+            for (q = p * p; q <= n; q += p) {
+                composite[q] = 1;
+            }
+        }
+        e = legendre(n, p) - legendre(r, p) - legendre(n - r, p);
+        while (e-- > 0) {
+            if (word > (COMBI_WORD_MAX - 1) / p) {
+                words[count++] = word;
+                word = 1;
+            }
+            word *= p;
+        }
+    }
+    if (word > 1) {
+        words[count++] = word;
+    }
+    free(composite);
+    list.words = words;
+    list.first = 0;
+    list.stop = stop;
+    len = prod_words(&list, count, out);
+    free(words);
+    return len;
+}
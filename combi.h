@@ -0,0 +1,25 @@
+#ifndef COMBI_H
+#define COMBI_H
+
+#include "bignum.h"
+
+/*
+ * Exact n!, nPr and nCr as big integers. Every result is a product tree
+ * over single-word factors, multiplied pairwise with bn_mul_fast so the
+ * large products at the top of the tree are balanced. COMBI_MAX_N keeps
+ * each factor below the bn_mul_small limit.
+ *
+ * The functions return the limb count and hand back a malloc'ed array in
+ * *out, or -1 when the arguments are out of range or memory runs out.
+ * When stop is not NULL, a nonzero *stop makes them give up and return -1
+ * before the next node of the tree; the multiplication already under way
+ * runs to its end.
+ */
+#define COMBI_MAX_N 100000UL
+
+long combi_factorial(unsigned long n, bn_limb **out, const volatile int *stop);
+long combi_permutations(unsigned long n, unsigned long r, bn_limb **out,
+                        const volatile int *stop);
+long combi_binomial(unsigned long n, unsigned long r, bn_limb **out, const volatile int *stop);
+
+#endif
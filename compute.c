@@ -0,0 +1,271 @@
+#ifndef AMICALC_HOST
+#include <exec/types.h>
+#include <exec/tasks.h>
+#include <clib/exec_protos.h>
+#include <clib/alib_protos.h>
+#else
+#include <pthread.h>
+#endif
+
+#include <stddef.h>
+
+#include "compute.h"
+
+#ifndef AMICALC_HOST
+static struct Task *parent = NULL;
+static struct MsgPort *reply_port = NULL;
+static struct MsgPort *job_port = NULL;
+static struct Message quit_msg;
+
+/*
+ * The task's own port is created here, by the task that owns its signal.
+ * The parent is signalled on its reply port once job_port is known. The
+ * mathieee libraries want every task that calls them to open them, so
+ * with that backend the task opens its own and fails to start without
+ * them. At the end the task stays in Forbid() from replying quit_msg
+ * until it is gone, so the parent cannot unload the code it still runs.
+ */
+static void compute_main(void)
+{
+    struct Message *msg;
+    struct Library *ieee_bas = NULL;
+    struct Library *ieee_trans = NULL;
+    int ready = 1;
+    int running = 1;
+
+#ifndef AMICALC_FLOAT32
+    if (calc_math == &calc_math_ieee) {
+        ieee_bas = OpenLibrary("mathieeedoubbas.library", 0);
+        ieee_trans = OpenLibrary("mathieeedoubtrans.library", 0);
+        ready = ieee_bas && ieee_trans;
+    }
+#endif
+    if (ready) {
+        job_port = CreatePort(NULL, 0);
+    }
+    Signal(parent, 1UL << reply_port->mp_SigBit);
+    while (job_port && running) {
+        WaitPort(job_port);
+        while ((msg = GetMsg(job_port)) != NULL) {
+            if (msg == &quit_msg) {
+                running = 0;
+                break;
+            }
+            compute_run((struct Job *)msg);
+            ReplyMsg(msg);
+        }
+    }
+    if (ieee_trans) {
+        CloseLibrary(ieee_trans);
+    }
+    if (ieee_bas) {
+        CloseLibrary(ieee_bas);
+    }
+    if (job_port) {
+        DeletePort(job_port);
+        job_port = NULL;
+        Forbid();
+        ReplyMsg(&quit_msg);
+    }
+}
+#else
+static pthread_t thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static struct Job *pending = NULL;
+static struct Job *finished = NULL;
+static int started = 0;
+static int quitting = 0;
+
+/* Appends job to the singly linked queue at *head. */
+static void enqueue(struct Job **head, struct Job *job)
+{
+    job->next = NULL;
+    while (*head) {
+        head = &(*head)->next;
+    }
+    *head = job;
+}
+
+/* Runs the jobs in the order posted; leaves once quitting is set and none is left. */
+static void *compute_main(void *arg)
+{
+    struct Job *job;
+
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!pending && !quitting) {
+            pthread_cond_wait(&wake, &lock);
+        }
+        job = pending;
+        if (!job) {
+            break;
+        }
+        pending = job->next;
+        pthread_mutex_unlock(&lock);
+        compute_run(job);
+        pthread_mutex_lock(&lock);
+        enqueue(&finished, job);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+#endif
+
+int compute_init(void)
+{
+#ifndef AMICALC_HOST
+    parent = FindTask(NULL);
+    reply_port = CreatePort(NULL, 0);
+    if (!reply_port) {
+        return 0;
+    }
+    SetSignal(0, 1UL << reply_port->mp_SigBit);
+    if (!CreateTask((STRPTR)"AmiCalc calculo", COMPUTE_PRI, (APTR)compute_main,
+                    COMPUTE_STACK)) {
+        DeletePort(reply_port);
+        reply_port = NULL;
+        return 0;
+    }
+    Wait(1UL << reply_port->mp_SigBit);
+    if (!job_port) {
+        DeletePort(reply_port);
+        reply_port = NULL;
+        return 0;
+    }
+    return 1;
+#else
+    quitting = 0;
+    started = pthread_create(&thread, NULL, compute_main, NULL) == 0;
+    return started;
+#endif
+}
+
+/* Jobs still out are waited for; cancel them first. */
+void compute_cleanup(void)
+{
+#ifndef AMICALC_HOST
+    struct Message *msg;
+
+    if (job_port) {
+        quit_msg.mn_ReplyPort = reply_port;
+        quit_msg.mn_Length = sizeof(quit_msg);
+        PutMsg(job_port, &quit_msg);
+        do {
+            WaitPort(reply_port);
+            msg = GetMsg(reply_port);
+        } while (msg != &quit_msg);
+    }
+    if (reply_port) {
+        DeletePort(reply_port);
+        reply_port = NULL;
+    }
+#else
+    if (started) {
+        pthread_mutex_lock(&lock);
+        quitting = 1;
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&lock);
+        pthread_join(thread, NULL);
+        started = 0;
+        finished = NULL;
+    }
+#endif
+}
+
+unsigned long compute_signal(void)
+{
+#ifndef AMICALC_HOST
+    if (reply_port) {
+        return 1UL << reply_port->mp_SigBit;
+    }
+#endif
+    return 0;
+}
+
+int compute_start(struct Job *job)
+{
+    job->watch.points = 0;
+    job->watch.stop = 0;
+#ifndef AMICALC_HOST
+    if (!job_port) {
+        return 0;
+    }
+    job->msg.mn_ReplyPort = reply_port;
+    job->msg.mn_Length = sizeof(*job);
+    PutMsg(job_port, &job->msg);
+    return 1;
+#else
+    if (!started) {
+        return 0;
+    }
+    pthread_mutex_lock(&lock);
+    enqueue(&pending, job);
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    return 1;
+#endif
+}
+
+struct Job *compute_done(void)
+{
+#ifndef AMICALC_HOST
+    if (reply_port) {
+        return (struct Job *)GetMsg(reply_port);
+    }
+    return NULL;
+#else
+    struct Job *job;
+
+    pthread_mutex_lock(&lock);
+    job = finished;
+    if (job) {
+        finished = job->next;
+    }
+    pthread_mutex_unlock(&lock);
+    return job;
+#endif
+}
+
+void compute_cancel(struct Job *job)
+{
+    job->watch.stop = 1;
+}
+
+void compute_run(struct Job *job)
+{
+    job->f.watch = &job->watch;
+    switch (job->kind) {
+        case JOB_SOLVE:
+            job->ok = solve_root(&job->f, job->a, &job->solve);
+            break;
+        case JOB_INTEGRATE:
+            job->ok = integ_gk15(&job->f, job->a, job->b, &job->integ);
+            break;
+        case JOB_SERIES:
+            job->ok = series_range(&job->f, job->flag, job->first, job->last, &job->series);
+            break;
+        case JOB_SERIES_LIMIT:
+            job->ok = series_to_limit(&job->f, job->flag, job->first, &job->series);
+            break;
+        case JOB_MONTE_CARLO:
+            job->ok = mc_mean(&job->f, job->rng, job->flag, job->a, job->b, MC_SAMPLES,
+                              &job->mc);
+            break;
+        case JOB_COMBI:
+            if (job->flag == 'C') {
+                job->len = combi_binomial((unsigned long)job->first, (unsigned long)job->last,
+                                          &job->limbs, &job->watch.stop);
+            } else {
+                job->len = combi_permutations((unsigned long)job->first,
+                                              (unsigned long)job->last, &job->limbs,
+                                              &job->watch.stop);
+            }
+            job->ok = job->len >= 0;
+            break;
+        default:
+            job->ok = 0;
+            break;
+    }
+}
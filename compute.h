@@ -0,0 +1,86 @@
+#ifndef COMPUTE_H
+#define COMPUTE_H
+
+#ifndef AMICALC_HOST
+#include <exec/ports.h>
+#endif
+
+#include "fexpr.h"
+#include "solve.h"
+#include "integ.h"
+#include "series.h"
+#include "mcarlo.h"
+#include "combi.h"
+
+/*
+ * Resolver, Integrar, the series, Monte Carlo and the exact n!, nPr and
+ * nCr on a task of their own, so the window keeps redrawing and answering
+ * while they run. The caller fills in a Job, compiling the expression
+ * into f, and posts it with compute_start; the compute task runs
+ * compute_run on it and replies it to a port in the caller's task, whose
+ * signal mask compute_signal gives and whose jobs compute_done returns.
+ * watch.points counts the points evaluated so far. compute_cancel makes
+ * the job's next evaluation fail, so it comes back soon with ok clear and
+ * watch.stop set. Until a job comes back neither it nor what its
+ * expression reads (cells, names, the generator) may change.
+ *
+ * JOB_COMBI takes no expression: it computes first P last (flag 'P'; n!
+ * is n P n) or first C last (flag 'C') into limbs and len, which the
+ * caller frees. It counts no points.
+ *
+ * compute_start returns 0 when there is no compute task, because
+ * compute_init could not start one. The caller then runs compute_run
+ * itself.
+ *
+ * The task runs one priority below the caller, so input is handled as
+ * soon as it arrives. It must not use dos.library, which rules out the
+ * file imports. JOB_COMBI allocates its limbs on the task, which is safe
+ * only because the caller does not allocate while a job is out.
+ * compute_init has to come after calc_math_init, so the task knows
+ * whether to open the mathieee libraries for itself. On the host the
+ * task is a POSIX thread; compute_signal is 0 there and the caller polls
+ * compute_done.
+ */
+#define JOB_SOLVE 0
+#define JOB_INTEGRATE 1
+#define JOB_SERIES 2
+#define JOB_SERIES_LIMIT 3
+#define JOB_MONTE_CARLO 4
+#define JOB_COMBI 5
+
+#define COMPUTE_STACK 8192L
+#define COMPUTE_PRI (-1)
+
+struct Job {
+#ifndef AMICALC_HOST
+    struct Message msg;
+#else
+    struct Job *next;
+#endif
+    int kind;
+    int flag;
+    calc_real a;
+    calc_real b;
+    long first;
+    long last;
+    struct Rng *rng;
+    struct Fexpr f;
+    struct FexprWatch watch;
+    int ok;
+    struct SolveResult solve;
+    struct IntegResult integ;
+    struct SeriesResult series;
+    struct McResult mc;
+    bn_limb *limbs;
+    long len;
+};
+
+int compute_init(void);
+void compute_cleanup(void);
+unsigned long compute_signal(void);
+int compute_start(struct Job *job);
+struct Job *compute_done(void);
+void compute_cancel(struct Job *job);
+void compute_run(struct Job *job);
+
+#endif
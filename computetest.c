@@ -0,0 +1,151 @@
+/*
+ * Test of the compute task on the host, where it is a POSIX thread
+ * (make check). Jobs of every kind that needs no window come back in the
+ * order they were posted, with the results compute_run gives on the
+ * caller's own task; a cancelled job comes back with ok clear and
+ * watch.stop set and the thread goes on with the next one. After
+ * compute_cleanup has joined the thread compute_start refuses jobs, as
+ * it does on the Amiga when no task could be started.
+ *
+ * computetest [-v]
+ *
+ * -v lists every check. Returns 0 when all checks pass, 10 otherwise.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "compute.h"
+
+#define TEST_JOBS 5
+#define TEST_TOL REAL_C(1e-5)
+
+static int verbose = 0;
+static int failures = 0;
+
+static struct Job jobs[TEST_JOBS];
+static struct Job direct;
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    } else if (verbose) {
+        printf("ok   %s\n", what);
+    }
+}
+
+static int close_to(calc_real got, calc_real want)
+{
+    calc_real diff = got - want;
+
+    if (diff < REAL_C(0.0)) {
+        diff = -diff;
+    }
+    return diff <= TEST_TOL;
+}
+
+static void set_expr(struct Job *job, int kind, const char *text)
+{
+    memset(job, 0, sizeof(*job));
+    job->kind = kind;
+    if (!fexpr_compile(text, 'x', 0, &job->f)) {
+        printf("FAIL compile %s\n", text);
+        failures++;
+    }
+}
+
+static void set_combi(struct Job *job, int flag, long n, long r)
+{
+    memset(job, 0, sizeof(*job));
+    job->kind = JOB_COMBI;
+    job->flag = flag;
+    job->first = n;
+    job->last = r;
+}
+
+/* The next job to come back; the thread is left to run meanwhile. */
+static struct Job *wait_done(void)
+{
+    struct Job *done;
+
+    while ((done = compute_done()) == NULL) {
+        sched_yield();
+    }
+    return done;
+}
+
+static int same_limbs(const struct Job *a, const struct Job *b)
+{
+    return a->ok && b->ok && a->len == b->len &&
+           memcmp(a->limbs, b->limbs, (size_t)a->len * sizeof(bn_limb)) == 0;
+}
+
+static void test_queue(void)
+{
+    struct Job *done;
+    int i;
+    int posted = 1;
+
+    set_expr(&jobs[0], JOB_SOLVE, "x*x-2");
+    jobs[0].a = REAL_C(1.0);
+    set_expr(&jobs[1], JOB_INTEGRATE, "x*x");
+    jobs[1].a = REAL_C(0.0);
+    jobs[1].b = REAL_C(3.0);
+    set_combi(&jobs[2], 'C', 2000L, 1000L);
+    set_combi(&jobs[3], 'P', (long)COMBI_MAX_N, (long)COMBI_MAX_N);
+    set_expr(&jobs[4], JOB_SOLVE, "x*x*x-8");
+    jobs[4].a = REAL_C(1.0);
+    for (i = 0; i < TEST_JOBS; ++i) {
+        posted = compute_start(&jobs[i]) && posted;
+        if (i == 3) {
+            compute_cancel(&jobs[3]);
+        }
+    }
+    check(posted, "compute_start takes every job");
+    if (!posted) {
+        return;
+    }
+    for (i = 0; i < TEST_JOBS; ++i) {
+        done = wait_done();
+        check(done == &jobs[i], "jobs come back in the order posted");
+    }
+    check(compute_done() == NULL, "no job comes back twice");
+
+    check(jobs[0].ok && close_to(jobs[0].solve.root, REAL_C(1.4142135623730951)),
+          "solve x*x-2 from 1");
+    check(jobs[1].ok && close_to(jobs[1].integ.value, REAL_C(9.0)), "integrate x*x over 0..3");
+    set_combi(&direct, 'C', 2000L, 1000L);
+    compute_run(&direct);
+    check(same_limbs(&jobs[2], &direct), "2000 C 1000 matches compute_run here");
+    check(!jobs[3].ok && jobs[3].watch.stop && !jobs[3].limbs, "cancelled n! gives up");
+    check(jobs[4].ok && close_to(jobs[4].solve.root, REAL_C(2.0)),
+          "the job after a cancel still runs");
+    free(direct.limbs);
+    free(jobs[2].limbs);
+}
+
+static void test_cleanup(void)
+{
+    set_combi(&jobs[0], 'P', 20L, 20L);
+    check(!compute_start(&jobs[0]), "compute_start refuses jobs after compute_cleanup");
+    compute_run(&jobs[0]);
+    check(jobs[0].ok && jobs[0].len > 0, "compute_run still works without the thread");
+    free(jobs[0].limbs);
+}
+
+int main(int argc, char **argv)
+{
+    verbose = (argc > 1 && strcmp(argv[1], "-v") == 0);
+
+    calc_math_init();
+    check(compute_init(), "compute_init starts the thread");
+    test_queue();
+    compute_cleanup();
+    test_cleanup();
+    calc_math_cleanup();
+    printf("%s: %d failure%s\n", failures ? "FAIL" : "PASS", failures, failures == 1 ? "" : "s");
+    return failures ? 10 : 0;
+}
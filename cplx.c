@@ -0,0 +1,459 @@
+#include <math.h>
+
+#include "cplx.h"
+
+#define CPLX_PI REAL_C(3.141592653589793)
+#define CPLX_HALF_PI REAL_C(1.5707963267948966)
+#define CPLX_LN10 REAL_C(2.302585092994046)
+#define CPLX_LN2 REAL_C(0.6931471805599453)
+#define CPLX_POW_SQUARING_MAX 1024L
+
+/* Beyond these, cosh(2y) swamps cos(2x) and asinh(t) is ln(2t) to working precision. */
+#ifdef AMICALC_FLOAT32
+#define CPLX_TAN_BIG REAL_C(10.0)
+#define CPLX_ASINH_BIG REAL_C(1e4)
+#else
+#define CPLX_TAN_BIG REAL_C(20.0)
+#define CPLX_ASINH_BIG REAL_C(1e8)
+#endif
+
+static calc_real abs_real(calc_real value)
+{
+    return value < REAL_C(0.0) ? -value : value;
+}
+
+/* Inf - inf and NaN - NaN are both NaN, which compares unequal to 0. */
+static int finite_cplx(const struct Cplx *z)
+{
+    return z->re - z->re == REAL_C(0.0) && z->im - z->im == REAL_C(0.0);
+}
+
+/* atan2(y, x) from the backend's atan, taking the quadrant from the signs. */
+static calc_real atan2_real(calc_real y, calc_real x)
+{
+    calc_real t;
+
+    if (x == REAL_C(0.0)) {
+        if (y == REAL_C(0.0)) {
+            return REAL_C(0.0);
+        }
+        return y > REAL_C(0.0) ? CPLX_HALF_PI : -CPLX_HALF_PI;
+    }
+    if (abs_real(y) <= abs_real(x)) {
+        calc_math->atan_f(&t, y / x);
+        if (x < REAL_C(0.0)) {
+            t += (y < REAL_C(0.0)) ? -CPLX_PI : CPLX_PI;
+        }
+        return t;
+    }
+    calc_math->atan_f(&t, x / y);
+    return (y > REAL_C(0.0) ? CPLX_HALF_PI : -CPLX_HALF_PI) - t;
+}
+
+/* ln(1 + u), exact for small u: the rounding of 1 + u is divided back out. */
+static calc_real log1p_real(calc_real u)
+{
+    calc_real w = REAL_C(1.0) + u;
+    calc_real l;
+
+    if (w == REAL_C(1.0)) {
+        return u;
+    }
+    calc_math->log_f(&l, w);
+    return u * l / (w - REAL_C(1.0));
+}
+
+static calc_real asinh_real(calc_real t)
+{
+    calc_real a = abs_real(t);
+    calc_real r;
+
+    if (a > CPLX_ASINH_BIG) {
+        calc_math->log_f(&r, a);
+        r += CPLX_LN2;
+    } else {
+        calc_math->sqrt_f(&r, REAL_C(1.0) + a * a);
+        r = log1p_real(a + a * a / (REAL_C(1.0) + r));
+    }
+    return t < REAL_C(0.0) ? -r : r;
+}
+
+/*
+ * sinh and cosh of a real. Below 1 the sinh series avoids the cancellation
+ * of (e^y - e^-y) / 2; eleven terms reach 1 / 23! there.
+ */
+static void sinh_cosh(calc_real y, calc_real *sh, calc_real *ch)
+{
+    calc_real e;
+
+    if (abs_real(y) < REAL_C(1.0)) {
+        calc_real y2 = y * y;
+        calc_real term = y;
+        calc_real sum = y;
+        int k;
+
+        for (k = 1; k <= 10; ++k) {
+            term *= y2 / (calc_real)((2 * k) * (2 * k + 1));
+            sum += term;
+        }
+        *sh = sum;
+        calc_math->sqrt_f(ch, REAL_C(1.0) + sum * sum);
+        return;
+    }
+    calc_math->exp_f(&e, y);
+    *sh = (e - REAL_C(1.0) / e) * REAL_C(0.5);
+    *ch = (e + REAL_C(1.0) / e) * REAL_C(0.5);
+}
+
+/* |z| scaled by the larger part, so it overflows only when the result does. */
+calc_real cplx_abs(const struct Cplx *z)
+{
+    calc_real a = abs_real(z->re);
+    calc_real b = abs_real(z->im);
+    calc_real t;
+    calc_real r;
+
+    if (a < b) {
+        t = a;
+        a = b;
+        b = t;
+    }
+    if (a == REAL_C(0.0)) {
+        return REAL_C(0.0);
+    }
+    t = b / a;
+    calc_math->sqrt_f(&r, REAL_C(1.0) + t * t);
+    return a * r;
+}
+
+calc_real cplx_arg(const struct Cplx *z)
+{
+    return atan2_real(z->im, z->re);
+}
+
+int cplx_mul(const struct Cplx *a, const struct Cplx *b, struct Cplx *out)
+{
+    calc_real re = a->re * b->re - a->im * b->im;
+
+    out->im = a->re * b->im + a->im * b->re;
+    out->re = re;
+    return finite_cplx(out);
+}
+
+/* Smith's division: scaled by the larger part of b, so |b|^2 is never formed. */
+int cplx_div(const struct Cplx *a, const struct Cplx *b, struct Cplx *out)
+{
+    calc_real t;
+    calc_real d;
+    calc_real re;
+
+    if (b->re == REAL_C(0.0) && b->im == REAL_C(0.0)) {
+        return 0;
+    }
+    if (abs_real(b->re) >= abs_real(b->im)) {
+        t = b->im / b->re;
+        d = b->re + b->im * t;
+        re = (a->re + a->im * t) / d;
+        out->im = (a->im - a->re * t) / d;
+    } else {
+        t = b->re / b->im;
+        d = b->re * t + b->im;
+        re = (a->re * t + a->im) / d;
+        out->im = (a->im * t - a->re) / d;
+    }
+    out->re = re;
+    return finite_cplx(out);
+}
+
+/*
+ * Kahan's square root: the larger part comes from sqrt((|re| + |z|) / 2)
+ * and the other one from a division, so neither cancels. lower picks the
+ * side of the cut for a negative real z: -i sqrt(|z|) instead of +i.
+ */
+static void sqrt_side(const struct Cplx *z, int lower, struct Cplx *out)
+{
+    calc_real t;
+
+    if (z->re == REAL_C(0.0) && z->im == REAL_C(0.0)) {
+        out->re = REAL_C(0.0);
+        out->im = REAL_C(0.0);
+        return;
+    }
+    calc_math->sqrt_f(&t, abs_real(z->re) * REAL_C(0.5) + cplx_abs(z) * REAL_C(0.5));
+    if (z->re >= REAL_C(0.0)) {
+        out->re = t;
+        out->im = z->im / (REAL_C(2.0) * t);
+    } else {
+        out->re = abs_real(z->im) / (REAL_C(2.0) * t);
+        out->im = (z->im < REAL_C(0.0) || (z->im == REAL_C(0.0) && lower)) ? -t : t;
+    }
+}
+
+int cplx_sqrt(const struct Cplx *z, struct Cplx *out)
+{
+    sqrt_side(z, 0, out);
+    return finite_cplx(out);
+}
+
+int cplx_exp(const struct Cplx *z, struct Cplx *out)
+{
+    calc_real m;
+    calc_real c;
+    calc_real s;
+
+    calc_math->exp_f(&m, z->re);
+    if (z->im == REAL_C(0.0)) {
+        out->re = m;
+        out->im = REAL_C(0.0);
+    } else {
+        calc_math->cos_f(&c, z->im);
+        calc_math->sin_f(&s, z->im);
+        out->re = m * c;
+        out->im = m * s;
+    }
+    return finite_cplx(out);
+}
+
+/*
+ * ln|z| + i arg(z). Near the unit circle ln|z| is taken as
+ * log1p((a - 1)(a + 1) + b^2) / 2, which keeps the digits that ln of a
+ * modulus close to 1 would lose.
+ */
+int cplx_log(const struct Cplx *z, struct Cplx *out)
+{
+    calc_real a = abs_real(z->re);
+    calc_real b = abs_real(z->im);
+    calc_real t;
+
+    if (a == REAL_C(0.0) && b == REAL_C(0.0)) {
+        return 0;
+    }
+    if (a < b) {
+        t = a;
+        a = b;
+        b = t;
+    }
+    if (a > REAL_C(0.5) && a < REAL_C(2.0)) {
+        t = log1p_real((a - REAL_C(1.0)) * (a + REAL_C(1.0)) + b * b) * REAL_C(0.5);
+    } else {
+        calc_math->log_f(&t, cplx_abs(z));
+    }
+    out->im = cplx_arg(z);
+    out->re = t;
+    return finite_cplx(out);
+}
+
+int cplx_log10(const struct Cplx *z, struct Cplx *out)
+{
+    if (!cplx_log(z, out)) {
+        return 0;
+    }
+    out->re /= CPLX_LN10;
+    out->im /= CPLX_LN10;
+    return 1;
+}
+
+int cplx_exp10(const struct Cplx *z, struct Cplx *out)
+{
+    struct Cplx t;
+
+    t.re = z->re * CPLX_LN10;
+    t.im = z->im * CPLX_LN10;
+    return cplx_exp(&t, out);
+}
+
+/* z^n by repeated squaring, so i^2 is exactly -1. */
+static int pow_squaring(const struct Cplx *z, long n, struct Cplx *out)
+{
+    struct Cplx base = *z;
+    struct Cplx result;
+
+    result.re = REAL_C(1.0);
+    result.im = REAL_C(0.0);
+    while (n > 0) {
+        if ((n & 1L) && !cplx_mul(&result, &base, &result)) {
+            return 0;
+        }
+        n >>= 1;
+        if (n > 0 && !cplx_mul(&base, &base, &base)) {
+            return 0;
+        }
+    }
+    *out = result;
+    return 1;
+}
+
+int cplx_pow(const struct Cplx *base, const struct Cplx *exponent, struct Cplx *out)
+{
+    struct Cplx l;
+    struct Cplx t;
+    calc_real e = exponent->re;
+
+    if (exponent->im == REAL_C(0.0) && e == (calc_real)floor((double)e) &&
+        abs_real(e) <= (calc_real)CPLX_POW_SQUARING_MAX) {
+        if (e >= REAL_C(0.0)) {
+            return pow_squaring(base, (long)e, out);
+        }
+        if (!pow_squaring(base, -(long)e, &t)) {
+            return 0;
+        }
+        l.re = REAL_C(1.0);
+        l.im = REAL_C(0.0);
+        return cplx_div(&l, &t, out);
+    }
+    if (exponent->im == REAL_C(0.0) && e == REAL_C(0.5)) {
+        return cplx_sqrt(base, out);
+    }
+    if (base->re == REAL_C(0.0) && base->im == REAL_C(0.0)) {
+        if (e <= REAL_C(0.0)) {
+            return 0;
+        }
+        out->re = REAL_C(0.0);
+        out->im = REAL_C(0.0);
+        return 1;
+    }
+    if (!cplx_log(base, &l) || !cplx_mul(exponent, &l, &t)) {
+        return 0;
+    }
+    return cplx_exp(&t, out);
+}
+
+/* The principal root, value^(1 / degree). */
+int cplx_root(const struct Cplx *value, const struct Cplx *degree, struct Cplx *out)
+{
+    struct Cplx one;
+    struct Cplx e;
+
+    if (degree->re == REAL_C(2.0) && degree->im == REAL_C(0.0)) {
+        return cplx_sqrt(value, out);
+    }
+    one.re = REAL_C(1.0);
+    one.im = REAL_C(0.0);
+    if (!cplx_div(&one, degree, &e)) {
+        return 0;
+    }
+    return cplx_pow(value, &e, out);
+}
+
+/* sin(x + iy) = sin x cosh y + i cos x sinh y */
+int cplx_sin(const struct Cplx *z, struct Cplx *out)
+{
+    calc_real s;
+    calc_real c;
+    calc_real sh;
+    calc_real ch;
+
+    calc_math->sin_f(&s, z->re);
+    calc_math->cos_f(&c, z->re);
+    sinh_cosh(z->im, &sh, &ch);
+    out->re = s * ch;
+    out->im = c * sh;
+    return finite_cplx(out);
+}
+
+/* cos(x + iy) = cos x cosh y - i sin x sinh y */
+int cplx_cos(const struct Cplx *z, struct Cplx *out)
+{
+    calc_real s;
+    calc_real c;
+    calc_real sh;
+    calc_real ch;
+
+    calc_math->sin_f(&s, z->re);
+    calc_math->cos_f(&c, z->re);
+    sinh_cosh(z->im, &sh, &ch);
+    out->re = c * ch;
+    out->im = -s * sh;
+    return finite_cplx(out);
+}
+
+/*
+ * tan(x + iy) = (sin 2x + i sinh 2y) / (cos 2x + cosh 2y). Far from the
+ * real axis both parts of the quotient are settled without forming the
+ * overflowing cosh: the real part decays as 2 sin 2x e^-2|y|, the
+ * imaginary part is the sign of y.
+ */
+int cplx_tan(const struct Cplx *z, struct Cplx *out)
+{
+    calc_real s;
+    calc_real c;
+    calc_real sh;
+    calc_real ch;
+    calc_real d;
+
+    calc_math->sin_f(&s, REAL_C(2.0) * z->re);
+    if (abs_real(z->im) > CPLX_TAN_BIG) {
+        calc_math->exp_f(&d, REAL_C(-2.0) * abs_real(z->im));
+        out->re = REAL_C(2.0) * s * d;
+        out->im = z->im > REAL_C(0.0) ? REAL_C(1.0) : REAL_C(-1.0);
+        return 1;
+    }
+    calc_math->cos_f(&c, REAL_C(2.0) * z->re);
+    sinh_cosh(REAL_C(2.0) * z->im, &sh, &ch);
+    d = c + ch;
+    if (d == REAL_C(0.0)) {
+        return 0;
+    }
+    out->re = s / d;
+    out->im = sh / d;
+    return finite_cplx(out);
+}
+
+/*
+ * Kahan's formulas from s1 = sqrt(1 - z) and s2 = sqrt(1 + z): no
+ * logarithm of a difference, so nothing cancels near +-1. On the real
+ * axis 1 - z is taken from below, which puts asin(2) on the upper side.
+ */
+static void asin_roots(const struct Cplx *z, struct Cplx *s1, struct Cplx *s2)
+{
+    struct Cplx t;
+
+    t.re = REAL_C(1.0) - z->re;
+    t.im = -z->im;
+    sqrt_side(&t, 1, s1);
+    t.re = REAL_C(1.0) + z->re;
+    t.im = z->im;
+    sqrt_side(&t, 0, s2);
+}
+
+int cplx_asin(const struct Cplx *z, struct Cplx *out)
+{
+    struct Cplx s1;
+    struct Cplx s2;
+
+    asin_roots(z, &s1, &s2);
+    out->re = atan2_real(z->re, s1.re * s2.re - s1.im * s2.im);
+    out->im = asinh_real(s1.re * s2.im - s1.im * s2.re);
+    return finite_cplx(out);
+}
+
+int cplx_acos(const struct Cplx *z, struct Cplx *out)
+{
+    struct Cplx s1;
+    struct Cplx s2;
+
+    asin_roots(z, &s1, &s2);
+    out->re = REAL_C(2.0) * atan2_real(s1.re, s2.re);
+    out->im = asinh_real(s2.re * s1.im - s2.im * s1.re);
+    return finite_cplx(out);
+}
+
+/*
+ * atan(x + iy) = atan2(2x, (1 - y)(1 + y) - x^2) / 2
+ *              + i log1p(4y / (x^2 + (1 - y)^2)) / 4
+ * with poles at +-i.
+ */
+int cplx_atan(const struct Cplx *z, struct Cplx *out)
+{
+    calc_real x = z->re;
+    calc_real y = z->im;
+    calc_real d = x * x + (REAL_C(1.0) - y) * (REAL_C(1.0) - y);
+
+    if (d == REAL_C(0.0) || (x == REAL_C(0.0) && y == REAL_C(-1.0))) {
+        return 0;
+    }
+    out->re = atan2_real(REAL_C(2.0) * x, (REAL_C(1.0) - y) * (REAL_C(1.0) + y) - x * x) *
+              REAL_C(0.5);
+    out->im = log1p_real(REAL_C(4.0) * y / d) * REAL_C(0.25);
+    return finite_cplx(out);
+}
@@ -0,0 +1,44 @@
+#ifndef CPLX_H
+#define CPLX_H
+
+#include "calcmath.h"
+
+/*
+ * Complex arithmetic on pairs of calc_real for the complex mode. Every
+ * function returns 0 where the result is undefined or not finite (a
+ * division by zero, log(0), atan(+-i), an overflow) and 1 otherwise.
+ *
+ * Multivalued functions give their principal value. The branch cuts are
+ * the usual ones: log, sqrt and non-integer powers along the negative
+ * real axis, asin and acos along the real axis outside [-1, 1], atan
+ * along the imaginary axis outside [-i, i]. A point on a cut takes the
+ * value from the upper (or right) side, as with C99's +0, so that
+ * sqrt(-4) = 2i, log(-1) = pi i and asin(2) = pi/2 + 1.317i.
+ */
+struct Cplx {
+    calc_real re;
+    calc_real im;
+};
+
+calc_real cplx_abs(const struct Cplx *z);
+calc_real cplx_arg(const struct Cplx *z);
+
+int cplx_mul(const struct Cplx *a, const struct Cplx *b, struct Cplx *out);
+int cplx_div(const struct Cplx *a, const struct Cplx *b, struct Cplx *out);
+int cplx_pow(const struct Cplx *base, const struct Cplx *exponent, struct Cplx *out);
+int cplx_root(const struct Cplx *value, const struct Cplx *degree, struct Cplx *out);
+
+int cplx_sqrt(const struct Cplx *z, struct Cplx *out);
+int cplx_exp(const struct Cplx *z, struct Cplx *out);
+int cplx_log(const struct Cplx *z, struct Cplx *out);
+int cplx_log10(const struct Cplx *z, struct Cplx *out);
+int cplx_exp10(const struct Cplx *z, struct Cplx *out);
+
+int cplx_sin(const struct Cplx *z, struct Cplx *out);
+int cplx_cos(const struct Cplx *z, struct Cplx *out);
+int cplx_tan(const struct Cplx *z, struct Cplx *out);
+int cplx_asin(const struct Cplx *z, struct Cplx *out);
+int cplx_acos(const struct Cplx *z, struct Cplx *out);
+int cplx_atan(const struct Cplx *z, struct Cplx *out);
+
+#endif
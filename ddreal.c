@@ -0,0 +1,1078 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ddreal.h"
+
+/*
+ * The error-free transformations below rely on every double operation
+ * being rounded to 53 bits. Do not build this file with -fpu=68881: the
+ * FPU keeps intermediates in extended precision.
+ */
+
+#define DD_SPLITTER 134217729.0
+#define DD_SPLIT_THRESH 6.69692879491417e+299
+#define DD_EPS 4.93038065763132e-32
+#define DD_EXP_LIMIT 709.0
+#define DD_EXP_HALVINGS 9
+#define DD_EXP_INV_K (1.0 / 512.0)
+#define DD_PIO2_WORDS 54
+#define DD_PIO2_COLUMNS 9
+
+const struct DDReal dd_pi = {3.141592653589793116e+00, 1.224646799147353207e-16};
+const struct DDReal dd_e = {2.718281828459045091e+00, 1.445646891729250158e-16};
+const struct DDReal dd_ln2 = {6.931471805599452862e-01, 2.319046813846299558e-17};
+const struct DDReal dd_ln10 = {2.302585092994045901e+00, -2.170756223382249351e-16};
+
+/* ln 2 = sum of these; the first two have 40 bits, so m times them is exact for |m| < 2^13. */
+static const double dd_ln2_part[3] = {6.931471805601177039e-01, -1.723944452561082612e-13,
+                                      -4.008656105520169726e-26};
+static const struct DDReal dd_pi2 = {1.570796326794896558e+00, 6.123233995736766036e-17};
+static const struct DDReal dd_pi4 = {7.853981633974482790e-01, 3.061616997868383018e-17};
+static const struct DDReal dd_half_ln_2pi = {9.189385332046727418e-01, -3.878294158067241449e-17};
+
+/* B(2k) / (2k (2k - 1)), k = 1 .. 14: the Stirling series for ln(gamma). */
+static const struct DDReal dd_stirling[14] = {
+    {8.333333333333332871e-02, 4.625929269271485328e-18},
+    {-2.777777777777777884e-03, 1.060108790874715412e-19},
+    {7.936507936507936501e-04, 6.883823317368282115e-22},
+    {-5.952380952380952918e-04, 5.369382187547260238e-20},
+    {8.417508417508417140e-04, 3.687017488923769356e-20},
+    {-1.917526917526917634e-03, 1.067570277687247494e-19},
+    {6.410256410256410034e-03, 2.224004456380521718e-19},
+    {-2.955065359477124232e-02, 4.861760957508855307e-19},
+    {1.796443723688305738e-01, -6.401600482710945799e-19},
+    {-1.392432216905901132e+00, 1.583705698923030267e-17},
+    {1.340286404416839261e+01, -6.154114101993966415e-16},
+    {-1.568482846260020267e+02, 9.391823141715388945e-15},
+    {2.193103333333333467e+03, -1.333925562600294756e-13},
+    {-3.610877125372498995e+04, 5.897583353514364795e-13}
+};
+
+/* 2/pi = sum of two_over_pi[k] * 2^(-24 (k + 1)), enough words for any double. */
+static const long two_over_pi[DD_PIO2_WORDS] = {
+    0xA2F983L, 0x6E4E44L, 0x1529FCL, 0x2757D1L, 0xF534DDL, 0xC0DB62L,
+    0x95993CL, 0x439041L, 0xFE5163L, 0xABDEBBL, 0xC561B7L, 0x246E3AL,
+    0x424DD2L, 0xE00649L, 0x2EEA09L, 0xD1921CL, 0xFE1DEBL, 0x1CB129L,
+    0xA73EE8L, 0x8235F5L, 0x2EBB44L, 0x84E99CL, 0x7026B4L, 0x5F7E41L,
+    0x3991D6L, 0x398353L, 0x39F49CL, 0x845F8BL, 0xBDF928L, 0x3B1FF8L,
+    0x97FFDEL, 0x05980FL, 0xEF2F11L, 0x8B5A0AL, 0x6D1F6DL, 0x367ECFL,
+    0x27CB09L, 0xB74F46L, 0x3F669EL, 0x5FEA2DL, 0x7527BAL, 0xC7EBE5L,
+    0xF17B3DL, 0x0739F7L, 0x8A5292L, 0xEA6BFBL, 0x5FB11FL, 0x8D5D08L,
+    0x560330L, 0x46FC7BL, 0x6BABF0L, 0xCFBC20L, 0x9AF436L, 0x1DA9E3L
+};
+
+static volatile double dd_zero = 0.0;
+
+static int finite_d(double value)
+{
+    return value - value == 0.0;
+}
+
+static double quick_two_sum(double a, double b, double *err)
+{
+    double s = a + b;
+
+    *err = b - (s - a);
+    return s;
+}
+
+static double two_sum(double a, double b, double *err)
+{
+    double s = a + b;
+    double bb = s - a;
+
+    *err = (a - (s - bb)) + (b - bb);
+    return s;
+}
+
+static void split(double a, double *hi, double *lo)
+{
+    double temp;
+
+    if (a > DD_SPLIT_THRESH || a < -DD_SPLIT_THRESH) {
+        a *= 3.7252902984619140625e-09;
+        temp = DD_SPLITTER * a;
+        *hi = temp - (temp - a);
+        *lo = a - *hi;
+        *hi *= 268435456.0;
+        *lo *= 268435456.0;
+    } else {
+        temp = DD_SPLITTER * a;
+        *hi = temp - (temp - a);
+        *lo = a - *hi;
+    }
+}
+
+static double two_prod(double a, double b, double *err)
+{
+    double a_hi;
+    double a_lo;
+    double b_hi;
+    double b_lo;
+    double p = a * b;
+
+    split(a, &a_hi, &a_lo);
+    split(b, &b_hi, &b_lo);
+    *err = ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+    return p;
+}
+
+static double two_sqr(double a, double *err)
+{
+    double hi;
+    double lo;
+    double q = a * a;
+
+    split(a, &hi, &lo);
+    *err = ((hi * hi - q) + 2.0 * hi * lo) + lo * lo;
+    return q;
+}
+
+static struct DDReal dd_make(double hi, double lo)
+{
+    struct DDReal r;
+
+    if (!finite_d(hi)) {
+        r.hi = hi;
+        r.lo = 0.0;
+        return r;
+    }
+    r.hi = quick_two_sum(hi, lo, &r.lo);
+    return r;
+}
+
+static struct DDReal dd_nan(void)
+{
+    return dd_from_double(dd_zero / dd_zero);
+}
+
+static struct DDReal dd_add_d(struct DDReal lhs, double rhs)
+{
+    double s1;
+    double s2;
+
+    s1 = two_sum(lhs.hi, rhs, &s2);
+    if (!finite_d(s1)) {
+        return dd_from_double(s1);
+    }
+    s2 += lhs.lo;
+    return dd_make(s1, s2);
+}
+
+static struct DDReal dd_div_d(struct DDReal lhs, double rhs)
+{
+    double q1;
+    double q2;
+    double p1;
+    double p2;
+    double s;
+    double e;
+
+    q1 = lhs.hi / rhs;
+    if (!finite_d(q1)) {
+        return dd_from_double(q1);
+    }
+    p1 = two_prod(q1, rhs, &p2);
+    s = two_sum(lhs.hi, -p1, &e);
+    e -= p2;
+    e += lhs.lo;
+    q2 = (s + e) / rhs;
+    return dd_make(q1, q2);
+}
+
+static struct DDReal dd_ldexp(struct DDReal value, int exp2)
+{
+    value.hi = ldexp(value.hi, exp2);
+    value.lo = ldexp(value.lo, exp2);
+    return value;
+}
+
+struct DDReal dd_from_double(double value)
+{
+    struct DDReal r;
+
+    r.hi = value;
+    r.lo = 0.0;
+    return r;
+}
+
+struct DDReal dd_from_int(long long value)
+{
+    long long high = value / 4294967296LL;
+    long long low = value - high * 4294967296LL;
+    double s;
+    double e;
+
+    s = two_sum((double)high * 4294967296.0, (double)low, &e);
+    return dd_make(s, e);
+}
+
+int dd_isnan(struct DDReal value)
+{
+    return value.hi != value.hi;
+}
+
+int dd_is_integer(struct DDReal value)
+{
+    return value.hi == floor(value.hi) && value.lo == floor(value.lo);
+}
+
+int dd_sign(struct DDReal value)
+{
+    if (value.hi > 0.0) {
+        return 1;
+    }
+    if (value.hi < 0.0) {
+        return -1;
+    }
+    return 0;
+}
+
+struct DDReal dd_neg(struct DDReal value)
+{
+    value.hi = -value.hi;
+    value.lo = -value.lo;
+    return value;
+}
+
+struct DDReal dd_add(struct DDReal lhs, struct DDReal rhs)
+{
+    double s1;
+    double s2;
+    double t1;
+    double t2;
+
+    s1 = two_sum(lhs.hi, rhs.hi, &s2);
+    if (!finite_d(s1)) {
+        return dd_from_double(s1);
+    }
+    t1 = two_sum(lhs.lo, rhs.lo, &t2);
+    s2 += t1;
+    s1 = quick_two_sum(s1, s2, &s2);
+    s2 += t2;
+    return dd_make(s1, s2);
+}
+
+struct DDReal dd_sub(struct DDReal lhs, struct DDReal rhs)
+{
+    return dd_add(lhs, dd_neg(rhs));
+}
+
+struct DDReal dd_mul(struct DDReal lhs, struct DDReal rhs)
+{
+    double p1;
+    double p2;
+
+    p1 = two_prod(lhs.hi, rhs.hi, &p2);
+    if (!finite_d(p1)) {
+        return dd_from_double(p1);
+    }
+    p2 += lhs.hi * rhs.lo + lhs.lo * rhs.hi;
+    return dd_make(p1, p2);
+}
+
+struct DDReal dd_mul_d(struct DDReal lhs, double rhs)
+{
+    double p1;
+    double p2;
+
+    p1 = two_prod(lhs.hi, rhs, &p2);
+    if (!finite_d(p1)) {
+        return dd_from_double(p1);
+    }
+    p2 += lhs.lo * rhs;
+    return dd_make(p1, p2);
+}
+
+struct DDReal dd_div(struct DDReal lhs, struct DDReal rhs)
+{
+    struct DDReal r;
+    double q1;
+    double q2;
+    double q3;
+
+    q1 = lhs.hi / rhs.hi;
+    if (!finite_d(q1)) {
+        return dd_from_double(q1);
+    }
+    r = dd_sub(lhs, dd_mul_d(rhs, q1));
+    q2 = r.hi / rhs.hi;
+    r = dd_sub(r, dd_mul_d(rhs, q2));
+    q3 = r.hi / rhs.hi;
+    q1 = quick_two_sum(q1, q2, &q2);
+    r.hi = q1;
+    r.lo = q2;
+    return dd_add_d(r, q3);
+}
+
+struct DDReal dd_sqr(struct DDReal value)
+{
+    double p1;
+    double p2;
+
+    p1 = two_sqr(value.hi, &p2);
+    if (!finite_d(p1)) {
+        return dd_from_double(p1);
+    }
+    p2 += 2.0 * value.hi * value.lo;
+    p2 += value.lo * value.lo;
+    return dd_make(p1, p2);
+}
+
+struct DDReal dd_sqrt(struct DDReal value)
+{
+    double x;
+    double ax;
+    double e;
+    struct DDReal r;
+    int k;
+
+    if (value.hi == 0.0) {
+        return dd_from_double(0.0);
+    }
+    if (value.hi < 0.0) {
+        return dd_nan();
+    }
+    if (!finite_d(value.hi)) {
+        return value;
+    }
+    /* Far from 1 the square below would lose its low word to underflow. */
+    frexp(value.hi, &k);
+    if (k < -600 || k > 600) {
+        k &= ~1;
+        return dd_ldexp(dd_sqrt(dd_ldexp(value, -k)), k / 2);
+    }
+    /* One Newton step on 1/sqrt from the double estimate doubles the digits. */
+    x = 1.0 / sqrt(value.hi);
+    ax = value.hi * x;
+    e = dd_sub(value, dd_sqr(dd_from_double(ax))).hi * (x * 0.5);
+    r.hi = two_sum(ax, e, &r.lo);
+    return r;
+}
+
+struct DDReal dd_npwr(struct DDReal base, long exponent)
+{
+    struct DDReal r = dd_from_double(1.0);
+    unsigned long n = (exponent < 0) ? 0UL - (unsigned long)exponent : (unsigned long)exponent;
+
+    while (n > 0) {
+        if (n & 1UL) {
+            r = dd_mul(r, base);
+        }
+        n >>= 1;
+        if (n > 0) {
+            base = dd_sqr(base);
+        }
+    }
+    if (exponent < 0) {
+        r = dd_div(dd_from_double(1.0), r);
+    }
+    return r;
+}
+
+/*
+ * The real n-th root, negative for odd roots of negative values. Two
+ * Newton steps on x^n = value take the double estimate to full precision.
+ */
+struct DDReal dd_root(struct DDReal value, long n)
+{
+    struct DDReal x;
+    int neg = 0;
+    int i;
+
+    if (n == 0 || value.hi != value.hi) {
+        return dd_nan();
+    }
+    if (n < 0) {
+        if (value.hi == 0.0) {
+            return dd_nan();
+        }
+        return dd_div(dd_from_double(1.0), dd_root(value, -n));
+    }
+    if (n == 1 || value.hi == 0.0) {
+        return value;
+    }
+    if (value.hi < 0.0) {
+        if ((n & 1L) == 0) {
+            return dd_nan();
+        }
+        value = dd_neg(value);
+        neg = 1;
+    }
+    if (n == 2) {
+        x = dd_sqrt(value);
+    } else {
+        x = dd_from_double(pow(value.hi, 1.0 / (double)n));
+        for (i = 0; i < 2; ++i) {
+            x = dd_add(x, dd_div_d(dd_sub(dd_div(value, dd_npwr(x, n - 1)), x), (double)n));
+        }
+    }
+    return neg ? dd_neg(x) : x;
+}
+
+struct DDReal dd_pow(struct DDReal base, struct DDReal exponent)
+{
+    if (dd_is_integer(exponent) && exponent.hi > -2147483647.0 && exponent.hi < 2147483647.0) {
+        if (base.hi == 0.0 && exponent.hi < 0.0) {
+            return dd_from_double(1.0 / dd_zero);
+        }
+        return dd_npwr(base, (long)exponent.hi + (long)exponent.lo);
+    }
+    if (base.hi < 0.0) {
+        return dd_nan();
+    }
+    if (base.hi == 0.0) {
+        return dd_from_double(exponent.hi > 0.0 ? 0.0 : 1.0 / dd_zero);
+    }
+    return dd_exp(dd_mul(exponent, dd_log(base)));
+}
+
+/*
+ * exp(r) - 1 for |r| <= ln2 / 2, to the precision of the result rather
+ * than of 1: exp(r) = exp(r / 512)^512 with the Taylor series for
+ * exp(r / 512) - 1, squared up as s = 2 s + s^2.
+ */
+static struct DDReal dd_expm1_reduced(struct DDReal r)
+{
+    struct DDReal s;
+    struct DDReal p;
+    struct DDReal t;
+    double fact = 2.0;
+    int i;
+
+    r = dd_ldexp(r, -DD_EXP_HALVINGS);
+    p = dd_sqr(r);
+    s = dd_add(r, dd_ldexp(p, -1));
+    i = 2;
+    do {
+        p = dd_mul(p, r);
+        fact *= (double)++i;
+        t = dd_div_d(p, fact);
+        s = dd_add(s, t);
+    } while (fabs(t.hi) > DD_EXP_INV_K * DD_EPS * fabs(s.hi) && i < 20);
+
+    for (i = 0; i < DD_EXP_HALVINGS; ++i) {
+        s = dd_add(dd_ldexp(s, 1), dd_sqr(s));
+    }
+    return s;
+}
+
+struct DDReal dd_exp(struct DDReal value)
+{
+    struct DDReal r;
+    double m;
+
+    if (value.hi <= -DD_EXP_LIMIT) {
+        return dd_from_double(0.0);
+    }
+    if (value.hi >= DD_EXP_LIMIT) {
+        return dd_from_double(1.0 / dd_zero);
+    }
+    if (value.hi == 0.0) {
+        return dd_from_double(1.0);
+    }
+    if (value.hi != value.hi) {
+        return value;
+    }
+
+    /*
+     * exp(x) = 2^m * exp(r) with r = x - m ln2. m ln2 rounded to
+     * double-double would be off by up to 2^-106 m, so it is taken off
+     * in the three pieces of dd_ln2_part, the first two exact times m.
+     */
+    m = floor(value.hi / dd_ln2.hi + 0.5);
+    r = dd_add_d(value, -m * dd_ln2_part[0]);
+    r = dd_add_d(r, -m * dd_ln2_part[1]);
+    r = dd_add_d(r, -m * dd_ln2_part[2]);
+    return dd_ldexp(dd_add_d(dd_expm1_reduced(r), 1.0), (int)m);
+}
+
+struct DDReal dd_log(struct DDReal value)
+{
+    struct DDReal f;
+    struct DDReal x;
+    int k;
+
+    if (value.hi != value.hi) {
+        return value;
+    }
+    if (value.hi <= 0.0) {
+        return dd_nan();
+    }
+    if (value.hi == 1.0 && value.lo == 0.0) {
+        return dd_from_double(0.0);
+    }
+    if (!finite_d(value.hi)) {
+        return value;
+    }
+    /*
+     * ln(value) = k ln2 + ln(f) with f = value / 2^k in [sqrt(1/2), sqrt(2)),
+     * and ln(f) by Newton on exp(x) = f: x += f (exp(-x) - 1) + (f - 1),
+     * which keeps the digits a subtraction of 1 would cancel.
+     */
+    frexp(value.hi, &k);
+    if (ldexp(value.hi, -k) < 0.70710678118654752) {
+        k--;
+    }
+    f = dd_ldexp(value, -k);
+    x = dd_from_double(log(f.hi));
+    x = dd_add(x, dd_add(dd_mul(f, dd_expm1_reduced(dd_neg(x))), dd_add_d(f, -1.0)));
+    return dd_add(dd_mul_d(dd_ln2, (double)k), x);
+}
+
+struct DDReal dd_log10(struct DDReal value)
+{
+    return dd_div(dd_log(value), dd_ln10);
+}
+
+static struct DDReal sin_taylor(struct DDReal t)
+{
+    struct DDReal x;
+    struct DDReal p;
+    struct DDReal s;
+    double thresh;
+    int i = 1;
+
+    if (t.hi == 0.0) {
+        return t;
+    }
+    thresh = 0.5 * fabs(t.hi) * DD_EPS;
+    x = dd_neg(dd_sqr(t));
+    s = t;
+    p = t;
+    do {
+        i += 2;
+        p = dd_div_d(dd_mul(p, x), (double)(i * (i - 1)));
+        s = dd_add(s, p);
+    } while (fabs(p.hi) > thresh && i < 60);
+    return s;
+}
+
+static struct DDReal cos_taylor(struct DDReal t)
+{
+    struct DDReal x;
+    struct DDReal p;
+    struct DDReal s;
+    int i = 0;
+
+    if (t.hi == 0.0) {
+        return dd_from_double(1.0);
+    }
+    x = dd_neg(dd_sqr(t));
+    p = dd_from_double(1.0);
+    s = p;
+    do {
+        i += 2;
+        p = dd_div_d(dd_mul(p, x), (double)(i * (i - 1)));
+        s = dd_add(s, p);
+    } while (fabs(p.hi) > 0.5 * DD_EPS && i < 60);
+    return s;
+}
+
+/*
+ * Payne-Hanek reduction of a double: value * 2/pi = *quadrant + *frac
+ * (mod 4) with |*frac| <= 1/2. value is an integer m of three 24-bit
+ * words times 2^e; each column of word products with two_over_pi is an
+ * exact double, the columns worth a multiple of 4 are never formed, and
+ * the whole part is taken out after every column, so *frac keeps its
+ * bits down to about 2^-165 even for the arguments closest to a multiple
+ * of pi/2.
+ */
+static void reduce_pio2(double value, int *quadrant, struct DDReal *frac)
+{
+    struct DDReal acc = {0.0, 0.0};
+    double m[3];
+    double mant;
+    int q = 0;
+    int e;
+    int n;
+    int c;
+    int i;
+
+    mant = ldexp(frexp(fabs(value), &e), 53);
+    e -= 53;
+    m[2] = floor(ldexp(mant, -48));
+    mant -= ldexp(m[2], 48);
+    m[1] = floor(ldexp(mant, -24));
+    m[0] = mant - ldexp(m[1], 24);
+
+    for (n = -2; e - 24 * (n + 1) >= 2; ++n) {
+    }
+    for (c = 0; c < DD_PIO2_COLUMNS; ++c, ++n) {
+        double d = 0.0;
+        double r;
+
+        for (i = 0; i < 3; ++i) {
+            if (n + i >= 0 && n + i < DD_PIO2_WORDS) {
+                d += m[i] * (double)two_over_pi[n + i];
+            }
+        }
+        d = ldexp(d, e - 24 * (n + 1));
+        d -= 4.0 * floor(d * 0.25);
+        acc = dd_add_d(acc, d);
+        r = floor(acc.hi + 0.5);
+        acc = dd_add_d(acc, -r);
+        q += (int)r;
+    }
+    if (value < 0.0) {
+        acc = dd_neg(acc);
+        q = -q;
+    }
+    *quadrant = q;
+    *frac = acc;
+}
+
+/*
+ * value = t + j*pi/2 (mod 2*pi) with t in [-pi/4, pi/4]. Both words of
+ * value are reduced exactly, so large arguments keep all 106 bits.
+ */
+static void dd_sincos(struct DDReal value, struct DDReal *sin_out, struct DDReal *cos_out)
+{
+    struct DDReal t;
+    struct DDReal s;
+    struct DDReal c;
+    int j = 0;
+
+    if (value.hi == 0.0) {
+        *sin_out = dd_from_double(0.0);
+        *cos_out = dd_from_double(1.0);
+        return;
+    }
+    if (!finite_d(value.hi)) {
+        *sin_out = dd_nan();
+        *cos_out = dd_nan();
+        return;
+    }
+    t = value;
+    if (fabs(value.hi) > dd_pi4.hi) {
+        struct DDReal f;
+
+        reduce_pio2(value.hi, &j, &f);
+        if (fabs(value.lo) > dd_pi4.hi) {
+            struct DDReal f_lo;
+            int j_lo;
+            double r;
+
+            reduce_pio2(value.lo, &j_lo, &f_lo);
+            f = dd_add(f, f_lo);
+            r = floor(f.hi + 0.5);
+            f = dd_add_d(f, -r);
+            j += j_lo + (int)r;
+            t = dd_mul(f, dd_pi2);
+        } else {
+            t = dd_add_d(dd_mul(f, dd_pi2), value.lo);
+            if (t.hi > dd_pi4.hi) {
+                t = dd_sub(t, dd_pi2);
+                j++;
+            } else if (t.hi < -dd_pi4.hi) {
+                t = dd_add(t, dd_pi2);
+                j--;
+            }
+        }
+    }
+
+    s = sin_taylor(t);
+    c = cos_taylor(t);
+    switch (((j % 4) + 4) % 4) {
+        case 0:
+            *sin_out = s;
+            *cos_out = c;
+            break;
+        case 1:
+            *sin_out = c;
+            *cos_out = dd_neg(s);
+            break;
+        case 2:
+            *sin_out = dd_neg(s);
+            *cos_out = dd_neg(c);
+            break;
+        default:
+            *sin_out = dd_neg(c);
+            *cos_out = s;
+            break;
+    }
+}
+
+struct DDReal dd_sin(struct DDReal value)
+{
+    struct DDReal s;
+    struct DDReal c;
+
+    dd_sincos(value, &s, &c);
+    return s;
+}
+
+struct DDReal dd_cos(struct DDReal value)
+{
+    struct DDReal s;
+    struct DDReal c;
+
+    dd_sincos(value, &s, &c);
+    return c;
+}
+
+struct DDReal dd_tan(struct DDReal value)
+{
+    struct DDReal s;
+    struct DDReal c;
+
+    dd_sincos(value, &s, &c);
+    return dd_div(s, c);
+}
+
+struct DDReal dd_atan2(struct DDReal y, struct DDReal x)
+{
+    struct DDReal r;
+    struct DDReal xx;
+    struct DDReal yy;
+    struct DDReal z;
+    struct DDReal sin_z;
+    struct DDReal cos_z;
+    int e;
+
+    if (x.hi == 0.0) {
+        if (y.hi == 0.0) {
+            return dd_nan();
+        }
+        return (y.hi > 0.0) ? dd_ldexp(dd_pi, -1) : dd_neg(dd_ldexp(dd_pi, -1));
+    }
+    if (y.hi == 0.0) {
+        return (x.hi > 0.0) ? dd_from_double(0.0) : dd_pi;
+    }
+
+    /*
+     * Newton step from the double estimate on the unit circle point. x and
+     * y are scaled by a power of two first so their squares cannot
+     * overflow or underflow.
+     */
+    frexp(fabs(x.hi) > fabs(y.hi) ? x.hi : y.hi, &e);
+    x = dd_ldexp(x, -e);
+    y = dd_ldexp(y, -e);
+    r = dd_sqrt(dd_add(dd_sqr(x), dd_sqr(y)));
+    xx = dd_div(x, r);
+    yy = dd_div(y, r);
+    z = dd_from_double(atan2(y.hi, x.hi));
+    dd_sincos(z, &sin_z, &cos_z);
+    if (fabs(xx.hi) > fabs(yy.hi)) {
+        z = dd_add(z, dd_div(dd_sub(yy, sin_z), cos_z));
+    } else {
+        z = dd_sub(z, dd_div(dd_sub(xx, cos_z), sin_z));
+    }
+    return z;
+}
+
+struct DDReal dd_atan(struct DDReal value)
+{
+    return dd_atan2(value, dd_from_double(1.0));
+}
+
+struct DDReal dd_asin(struct DDReal value)
+{
+    struct DDReal c;
+
+    if (fabs(value.hi) > 1.0 || (fabs(value.hi) == 1.0 && value.lo * value.hi > 0.0)) {
+        return dd_nan();
+    }
+    c = dd_sqrt(dd_sub(dd_from_double(1.0), dd_sqr(value)));
+    if (c.hi == 0.0) {
+        return (value.hi > 0.0) ? dd_ldexp(dd_pi, -1) : dd_neg(dd_ldexp(dd_pi, -1));
+    }
+    return dd_atan2(value, c);
+}
+
+struct DDReal dd_acos(struct DDReal value)
+{
+    struct DDReal s;
+
+    if (fabs(value.hi) > 1.0 || (fabs(value.hi) == 1.0 && value.lo * value.hi > 0.0)) {
+        return dd_nan();
+    }
+    s = dd_sqrt(dd_sub(dd_from_double(1.0), dd_sqr(value)));
+    if (s.hi == 0.0) {
+        return (value.hi > 0.0) ? dd_from_double(0.0) : dd_pi;
+    }
+    return dd_atan2(s, value);
+}
+
+/*
+ * sin(pi * value) with the nearest integer removed first; *pole is set
+ * when value is an integer.
+ */
+static struct DDReal dd_sin_pi(struct DDReal value, int *pole)
+{
+    double n = floor(value.hi + 0.5);
+    struct DDReal r = dd_add_d(value, -n);
+    struct DDReal s;
+
+    *pole = (r.hi == 0.0);
+    s = dd_sin(dd_mul(dd_pi, r));
+    return (fmod(n, 2.0) != 0.0) ? dd_neg(s) : s;
+}
+
+/*
+ * ln(gamma(value + n)) for value >= 1/2, with n the number of unit steps
+ * that bring the argument up to 25, where 14 Stirling terms reach the
+ * full 106 bits. *shift receives value (value + 1) ... (value + n - 1).
+ */
+static struct DDReal dd_lgamma_shifted(struct DDReal value, struct DDReal *shift)
+{
+    struct DDReal p = dd_from_double(1.0);
+    struct DDReal z;
+    struct DDReal z2;
+    struct DDReal sum;
+    struct DDReal r;
+    int k;
+
+    while (value.hi < 25.0) {
+        p = dd_mul(p, value);
+        value = dd_add_d(value, 1.0);
+    }
+    z = dd_div(dd_from_double(1.0), value);
+    z2 = dd_sqr(z);
+    sum = dd_stirling[13];
+    for (k = 12; k >= 0; --k) {
+        sum = dd_add(dd_mul(sum, z2), dd_stirling[k]);
+    }
+    r = dd_mul(dd_add_d(value, -0.5), dd_log(value));
+    r = dd_add(dd_sub(r, value), dd_half_ln_2pi);
+    *shift = p;
+    return dd_add(r, dd_mul(sum, z));
+}
+
+struct DDReal dd_gamma(struct DDReal value)
+{
+    struct DDReal s;
+    struct DDReal g;
+    struct DDReal p;
+    int pole;
+
+    if (value.hi != value.hi) {
+        return value;
+    }
+    if (value.hi < 0.5) {
+        s = dd_sin_pi(value, &pole);
+        if (pole) {
+            return dd_nan();
+        }
+        g = dd_gamma(dd_sub(dd_from_double(1.0), value));
+        return dd_div(dd_pi, dd_mul(s, g));
+    }
+    g = dd_lgamma_shifted(value, &p);
+    return dd_div(dd_exp(g), p);
+}
+
+struct DDReal dd_lgamma(struct DDReal value)
+{
+    struct DDReal s;
+    struct DDReal p;
+    int pole;
+
+    if (value.hi != value.hi) {
+        return value;
+    }
+    if (value.hi < 0.5) {
+        s = dd_sin_pi(value, &pole);
+        if (pole || s.hi < 0.0) {
+            return dd_nan();
+        }
+        return dd_sub(dd_log(dd_div(dd_pi, s)),
+                      dd_lgamma(dd_sub(dd_from_double(1.0), value)));
+    }
+    if (value.lo == 0.0 && (value.hi == 1.0 || value.hi == 2.0)) {
+        /* the shifted Stirling sum would leave ~1e-31 at the exact zeros */
+        return dd_from_double(0.0);
+    }
+    s = dd_lgamma_shifted(value, &p);
+    return dd_sub(s, dd_log(p));
+}
+
+static struct DDReal dd_scale10(struct DDReal value, int exp10)
+{
+    while (exp10 > 300) {
+        value = dd_mul(value, dd_npwr(dd_from_double(10.0), 300));
+        exp10 -= 300;
+    }
+    while (exp10 < -300) {
+        value = dd_div(value, dd_npwr(dd_from_double(10.0), 300));
+        exp10 += 300;
+    }
+    if (exp10 > 0) {
+        value = dd_mul(value, dd_npwr(dd_from_double(10.0), exp10));
+    } else if (exp10 < 0) {
+        value = dd_div(value, dd_npwr(dd_from_double(10.0), -exp10));
+    }
+    return value;
+}
+
+int dd_from_string(const char *text, struct DDReal *out)
+{
+    struct DDReal r = dd_from_double(0.0);
+    int neg = 0;
+    int exp10 = 0;
+    int digits = 0;
+    int seen = 0;
+    int frac = 0;
+
+    if (*text == '-' || *text == '+') {
+        neg = (*text == '-');
+        ++text;
+    }
+    for (; *text != '\0'; ++text) {
+        if (*text >= '0' && *text <= '9') {
+            seen = 1;
+            if (digits < DD_DIGITS + 2) {
+                r = dd_add_d(dd_mul_d(r, 10.0), (double)(*text - '0'));
+                if (r.hi != 0.0) {
+                    digits++;
+                }
+                if (frac) {
+                    exp10--;
+                }
+            } else if (!frac) {
+                exp10++;
+            }
+        } else if (*text == '.' && !frac) {
+            frac = 1;
+        } else {
+            break;
+        }
+    }
+    if (*text == 'e' || *text == 'E') {
+        int eneg = 0;
+        int e = 0;
+
+        ++text;
+        if (*text == '-' || *text == '+') {
+            eneg = (*text == '-');
+            ++text;
+        }
+        while (*text >= '0' && *text <= '9') {
+            if (e < 10000) {
+                e = e * 10 + (*text - '0');
+            }
+            ++text;
+        }
+        exp10 += eneg ? -e : e;
+    }
+    if (r.hi != 0.0) {
+        r = dd_scale10(r, exp10);
+    }
+    *out = neg ? dd_neg(r) : r;
+    return seen;
+}
+
+void dd_format(struct DDReal value, int digits, char *out)
+{
+    int d[DD_DIGITS + 2];
+    struct DDReal r;
+    int e;
+    int i;
+    int len;
+    char *p = out;
+
+    if (value.hi != value.hi) {
+        strcpy(out, "nan");
+        return;
+    }
+    if (!finite_d(value.hi)) {
+        strcpy(out, value.hi > 0.0 ? "inf" : "-inf");
+        return;
+    }
+    if (value.hi == 0.0) {
+        strcpy(out, "0");
+        return;
+    }
+    if (digits > DD_DIGITS) {
+        digits = DD_DIGITS;
+    }
+    if (digits < 1) {
+        digits = 1;
+    }
+    if (value.hi < 0.0) {
+        *p++ = '-';
+        value = dd_neg(value);
+    }
+
+    e = (int)floor(log10(value.hi));
+    r = dd_scale10(value, -e);
+    if (r.hi >= 10.0) {
+        r = dd_div_d(r, 10.0);
+        e++;
+    } else if (r.hi < 1.0) {
+        r = dd_mul_d(r, 10.0);
+        e--;
+    }
+
+    for (i = 0; i <= digits; ++i) {
+        d[i] = (int)floor(r.hi);
+        r = dd_mul_d(dd_add_d(r, -(double)d[i]), 10.0);
+    }
+    for (i = digits; i > 0; --i) {
+        while (d[i] < 0) {
+            d[i] += 10;
+            d[i - 1]--;
+        }
+        while (d[i] > 9) {
+            d[i] -= 10;
+            d[i - 1]++;
+        }
+    }
+    if (d[digits] >= 5) {
+        d[digits - 1]++;
+        for (i = digits - 1; i > 0 && d[i] > 9; --i) {
+            d[i] -= 10;
+            d[i - 1]++;
+        }
+    }
+    if (d[0] > 9) {
+        d[0] = 1;
+        for (i = 1; i < digits; ++i) {
+            d[i] = 0;
+        }
+        e++;
+    } else if (d[0] == 0) {
+        for (i = 0; i < digits; ++i) {
+            d[i] = d[i + 1];
+        }
+        e--;
+    }
+
+    len = digits;
+    while (len > 1 && d[len - 1] == 0) {
+        len--;
+    }
+
+    if (e < -5 || e >= digits) {
+        *p++ = (char)('0' + d[0]);
+        if (len > 1) {
+            *p++ = '.';
+            for (i = 1; i < len; ++i) {
+                *p++ = (char)('0' + d[i]);
+            }
+        }
+        sprintf(p, "e%c%02d", e < 0 ? '-' : '+', e < 0 ? -e : e);
+        return;
+    }
+    if (e < 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for (i = -1; i > e; --i) {
+            *p++ = '0';
+        }
+        for (i = 0; i < len; ++i) {
+            *p++ = (char)('0' + d[i]);
+        }
+    } else {
+        for (i = 0; i <= e; ++i) {
+            *p++ = (char)('0' + (i < len ? d[i] : 0));
+        }
+        if (len > e + 1) {
+            *p++ = '.';
+            for (i = e + 1; i < len; ++i) {
+                *p++ = (char)('0' + d[i]);
+            }
+        }
+    }
+    *p = '\0';
+}
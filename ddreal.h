@@ -0,0 +1,53 @@
+#ifndef DDREAL_H
+#define DDREAL_H
+
+/*
+ * Double-double arithmetic: a value is the unevaluated sum hi + lo with
+ * |lo| <= ulp(hi) / 2, giving about 106 bits (31 decimal digits).
+ */
+struct DDReal {
+    double hi;
+    double lo;
+};
+
+#define DD_DIGITS 31
+
+extern const struct DDReal dd_pi;
+extern const struct DDReal dd_e;
+extern const struct DDReal dd_ln2;
+extern const struct DDReal dd_ln10;
+
+struct DDReal dd_from_double(double value);
+struct DDReal dd_from_int(long long value);
+int dd_from_string(const char *text, struct DDReal *out);
+void dd_format(struct DDReal value, int digits, char *out);
+
+int dd_isnan(struct DDReal value);
+int dd_is_integer(struct DDReal value);
+int dd_sign(struct DDReal value);
+
+struct DDReal dd_neg(struct DDReal value);
+struct DDReal dd_add(struct DDReal lhs, struct DDReal rhs);
+struct DDReal dd_sub(struct DDReal lhs, struct DDReal rhs);
+struct DDReal dd_mul(struct DDReal lhs, struct DDReal rhs);
+struct DDReal dd_mul_d(struct DDReal lhs, double rhs);
+struct DDReal dd_div(struct DDReal lhs, struct DDReal rhs);
+struct DDReal dd_sqr(struct DDReal value);
+struct DDReal dd_sqrt(struct DDReal value);
+struct DDReal dd_npwr(struct DDReal base, long exponent);
+struct DDReal dd_root(struct DDReal value, long n);
+struct DDReal dd_pow(struct DDReal base, struct DDReal exponent);
+struct DDReal dd_exp(struct DDReal value);
+struct DDReal dd_log(struct DDReal value);
+struct DDReal dd_log10(struct DDReal value);
+struct DDReal dd_sin(struct DDReal value);
+struct DDReal dd_cos(struct DDReal value);
+struct DDReal dd_tan(struct DDReal value);
+struct DDReal dd_atan2(struct DDReal y, struct DDReal x);
+struct DDReal dd_atan(struct DDReal value);
+struct DDReal dd_asin(struct DDReal value);
+struct DDReal dd_acos(struct DDReal value);
+struct DDReal dd_gamma(struct DDReal value);
+struct DDReal dd_lgamma(struct DDReal value);
+
+#endif
@@ -0,0 +1,789 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fexpr.h"
+#include "gamma.h"
+#include "power.h"
+#include "symtab.h"
+
+#define FX_PI REAL_C(3.141592653589793)
+#define FX_LN10 REAL_C(2.302585092994046)
+#define FX_BINARY(code) ((code) >= FX_ADD && (code) <= FX_NPR)
+#define FX_LOAD(code) ((code) == FX_NUM || (code) == FX_VAR || (code) == FX_CELL || (code) == FX_SYM)
+
+struct FexprName {
+    const char *text;
+    int code;
+};
+
+/* Prefixes written by expr_apply_unary; the x^2 key writes "(...)^2". */
+static const struct FexprName fx_prefixes[] = {
+    {"asin(", FX_ASIN}, {"acos(", FX_ACOS}, {"atan(", FX_ATAN},
+    {"sin(", FX_SIN}, {"cos(", FX_COS}, {"tan(", FX_TAN},
+    {"sqrt(", FX_SQRT}, {"exp(", FX_EXP}, {"e^(", FX_EXP},
+    {"10^(", FX_EXP10}, {"log(", FX_LOG}, {"ln(", FX_LN}
+};
+
+struct Parser {
+    const char *p;
+    struct Fexpr *f;
+    int depth;
+    char var;
+};
+
+static int parse_seq(struct Parser *ps);
+
+static int emit(struct Parser *ps, int code, calc_real value)
+{
+    struct FexprOp *op;
+
+    if (ps->f->len >= FEXPR_MAX_OPS) {
+        return 0;
+    }
+    op = &ps->f->ops[ps->f->len++];
+    op->code = code;
+    op->value = value;
+    if (FX_LOAD(code)) {
+        if (++ps->depth > FEXPR_STACK) {
+            return 0;
+        }
+    } else if (FX_BINARY(code)) {
+        ps->depth--;
+    }
+    return 1;
+}
+
+/* The body of a group up to its ')', which may be missing at the end. */
+static int parse_group(struct Parser *ps)
+{
+    if (!parse_seq(ps)) {
+        return 0;
+    }
+    if (*ps->p == ')') {
+        ps->p++;
+        return 1;
+    }
+    return *ps->p == '\0';
+}
+
+static int parse_operand(struct Parser *ps)
+{
+    const char *s = ps->p;
+    struct FexprOp *last;
+    char *end;
+    size_t i;
+    size_t len;
+    int neg = 0;
+
+    if (*s == '-') {
+        neg = 1;
+        ++s;
+    }
+    for (i = 0; i < sizeof(fx_prefixes) / sizeof(fx_prefixes[0]); ++i) {
+        len = strlen(fx_prefixes[i].text);
+        if (strncmp(s, fx_prefixes[i].text, len) == 0) {
+            break;
+        }
+    }
+    if (i < sizeof(fx_prefixes) / sizeof(fx_prefixes[0])) {
+        ps->p = s + len;
+        if (!parse_group(ps)) {
+            return 0;
+        }
+        last = &ps->f->ops[ps->f->len - 1];
+        if (fx_prefixes[i].code == FX_LN && last->code == FX_FACT) {
+            /* ln(x!) from Inv + n!: log-gamma never overflows. */
+            last->code = FX_LNFACT;
+        } else if (!emit(ps, fx_prefixes[i].code, REAL_C(0.0))) {
+            return 0;
+        }
+    } else if (*s == '(') {
+        ps->p = s + 1;
+        if (!parse_group(ps)) {
+            return 0;
+        }
+        s = ps->p;
+        if (s[0] == '^' && s[1] == '2' && !(s[2] >= '0' && s[2] <= '9') && s[2] != '.' &&
+            s[2] != 'e') {
+            ps->p = s + 2;
+            if (!emit(ps, FX_SQR, REAL_C(0.0))) {
+                return 0;
+            }
+        }
+    } else if (*s == ps->var) {
+        ps->p = s + 1;
+        ps->f->uses_var = 1;
+        if (!emit(ps, FX_VAR, REAL_C(0.0))) {
+            return 0;
+        }
+    } else if (*s == '#' && s[1] >= '0' && s[1] <= '9') {
+        long cell = strtol(s + 1, &end, 10);
+
+        ps->p = end;
+        if (!emit(ps, FX_CELL, (calc_real)cell)) {
+            return 0;
+        }
+    } else if (*s == '@') {
+        char name[SYM_NAME + 1];
+        int id;
+
+        for (i = 0, ++s; i < SYM_NAME && ((*s >= 'A' && *s <= 'Z') || (*s >= '0' && *s <= '9')); ++i) {
+            name[i] = *s++;
+        }
+        name[i] = '\0';
+        id = sym_intern(name);
+        if (id < 0) {
+            return 0;
+        }
+        if (*s == '(') {
+            ps->p = s + 1;
+            if (!parse_group(ps) || !emit(ps, FX_CALL, (calc_real)id)) {
+                return 0;
+            }
+        } else {
+            ps->p = s;
+            if (!emit(ps, FX_SYM, (calc_real)id)) {
+                return 0;
+            }
+        }
+    } else if ((*s >= '0' && *s <= '9') || *s == '.') {
+        double value = strtod(s, &end);
+
+        if (end == s) {
+            return 0;
+        }
+        ps->p = end;
+        if (!emit(ps, FX_NUM, (calc_real)value)) {
+            return 0;
+        }
+    } else {
+        return 0;
+    }
+    if (neg) {
+        last = &ps->f->ops[ps->f->len - 1];
+        if (last->code == FX_NUM) {
+            last->value = -last->value;
+        } else if (!emit(ps, FX_NEG, REAL_C(0.0))) {
+            return 0;
+        }
+    }
+    for (;;) {
+        if (*ps->p == '!') {
+            if (!emit(ps, FX_FACT, REAL_C(0.0))) {
+                return 0;
+            }
+        } else if (*ps->p == '%') {
+            if (!emit(ps, FX_PCT, REAL_C(0.0))) {
+                return 0;
+            }
+        } else {
+            break;
+        }
+        ps->p++;
+    }
+    return 1;
+}
+
+static int binary_code(char c)
+{
+    switch (c) {
+        case '+':
+            return FX_ADD;
+        case '-':
+            return FX_SUB;
+        case '*':
+            return FX_MUL;
+        case '/':
+            return FX_DIV;
+        case '^':
+            return FX_POW;
+        case 'r':
+            return FX_ROOT;
+        case 'C':
+            return FX_NCR;
+        case 'P':
+            return FX_NPR;
+        default:
+            break;
+    }
+    return -1;
+}
+
+static int parse_seq(struct Parser *ps)
+{
+    int code;
+
+    if (!parse_operand(ps)) {
+        return 0;
+    }
+    for (;;) {
+        code = binary_code(*ps->p);
+        if (code < 0) {
+            return 1;
+        }
+        ps->p++;
+        if (*ps->p == '\0') {
+            /* An operator still waiting for its operand. */
+            return 1;
+        }
+        if (!parse_operand(ps) || !emit(ps, code, REAL_C(0.0))) {
+            return 0;
+        }
+    }
+}
+
+int fexpr_compile(const char *text, char var, int degrees, struct Fexpr *out)
+{
+    struct Parser ps;
+
+    out->cells = NULL;
+    out->watch = NULL;
+    out->len = 0;
+    out->degrees = degrees;
+    out->uses_var = 0;
+    ps.p = text;
+    ps.var = var;
+    ps.f = out;
+    ps.depth = 0;
+    return parse_seq(&ps) && *ps.p == '\0';
+}
+
+static int finite_real(calc_real value)
+{
+    return value - value == REAL_C(0.0);
+}
+
+static calc_real fact_real(calc_real n, int *ok)
+{
+    calc_real r;
+
+    if (n >= REAL_C(0.0) && n <= (calc_real)CALC_REAL_MAX_FACT && n == (calc_real)(long)n) {
+        *ok = 1;
+        return calc_fact_table[(long)n];
+    }
+    *ok = calc_gamma(n + REAL_C(1.0), &r);
+    return r;
+}
+
+/* nCr and nPr extended to real arguments through the gamma function. */
+static int choose_real(int code, calc_real n, calc_real r, calc_real *out)
+{
+    calc_real a;
+    calc_real b;
+    calc_real c;
+    int ok;
+
+    if (n >= REAL_C(0.0) && r >= REAL_C(0.0) && r <= n && n <= (calc_real)CALC_REAL_MAX_FACT &&
+        n == (calc_real)(long)n && r == (calc_real)(long)r) {
+        *out = calc_fact_table[(long)n] / calc_fact_table[(long)(n - r)];
+        if (code == FX_NCR) {
+            *out /= calc_fact_table[(long)r];
+        }
+        return 1;
+    }
+    ok = calc_lgamma(n + REAL_C(1.0), &a) && calc_lgamma(n - r + REAL_C(1.0), &b);
+    if (code == FX_NCR) {
+        ok = ok && calc_lgamma(r + REAL_C(1.0), &c);
+    } else {
+        c = REAL_C(0.0);
+    }
+    if (!ok) {
+        return 0;
+    }
+    calc_math->exp_f(out, a - b - c);
+    return 1;
+}
+
+static int cell_value(const struct Fexpr *f, const struct FexprOp *op, calc_real *out)
+{
+    int cell = (int)op->value;
+
+    if (!f->cells || cell >= f->cells->count || !f->cells->ok[cell]) {
+        return 0;
+    }
+    *out = f->cells->value[cell];
+    return 1;
+}
+
+static int apply_binary(int code, calc_real a, calc_real b, calc_real *out)
+{
+    switch (code) {
+        case FX_ADD:
+            calc_math->add(out, a, b);
+            break;
+        case FX_SUB:
+            calc_math->sub(out, a, b);
+            break;
+        case FX_MUL:
+            calc_math->mul(out, a, b);
+            break;
+        case FX_DIV:
+            if (b == REAL_C(0.0)) {
+                return 0;
+            }
+            calc_math->div(out, a, b);
+            break;
+        case FX_POW:
+            if (!calc_pow(a, b, out)) {
+                return 0;
+            }
+            break;
+        case FX_ROOT:
+            if (!calc_root(a, b, out)) {
+                return 0;
+            }
+            break;
+        default:
+            if (!choose_real(code, a, b, out)) {
+                return 0;
+            }
+            break;
+    }
+    return finite_real(*out);
+}
+
+static int apply_unary(const struct Fexpr *f, int code, calc_real a, calc_real *out)
+{
+    calc_real to_rad = f->degrees ? FX_PI / REAL_C(180.0) : REAL_C(1.0);
+    int ok = 1;
+
+    switch (code) {
+        case FX_NEG:
+            *out = -a;
+            break;
+        case FX_SIN:
+            calc_math->sin_f(out, a * to_rad);
+            break;
+        case FX_COS:
+            calc_math->cos_f(out, a * to_rad);
+            break;
+        case FX_TAN:
+            calc_math->tan_f(out, a * to_rad);
+            break;
+        case FX_ASIN:
+        case FX_ACOS:
+            if (a < -REAL_C(1.0) || a > REAL_C(1.0)) {
+                return 0;
+            }
+            if (code == FX_ASIN) {
+                calc_math->asin_f(out, a);
+            } else {
+                calc_math->acos_f(out, a);
+            }
+            *out /= to_rad;
+            break;
+        case FX_ATAN:
+            calc_math->atan_f(out, a);
+            *out /= to_rad;
+            break;
+        case FX_LN:
+        case FX_LOG:
+            if (a <= REAL_C(0.0)) {
+                return 0;
+            }
+            if (code == FX_LN) {
+                calc_math->log_f(out, a);
+            } else {
+                calc_math->log10_f(out, a);
+            }
+            break;
+        case FX_EXP:
+            calc_math->exp_f(out, a);
+            break;
+        case FX_EXP10:
+            calc_math->pow_f(out, REAL_C(10.0), a);
+            break;
+        case FX_SQRT:
+            if (a < REAL_C(0.0)) {
+                return 0;
+            }
+            calc_math->sqrt_f(out, a);
+            break;
+        case FX_SQR:
+            calc_math->mul(out, a, a);
+            break;
+        case FX_PCT:
+            calc_math->div(out, a, REAL_C(100.0));
+            break;
+        case FX_FACT:
+            *out = fact_real(a, &ok);
+            break;
+        case FX_LNFACT:
+            ok = calc_lgamma(a + REAL_C(1.0), out);
+            break;
+        default:
+            return 0;
+    }
+    return ok && finite_real(*out);
+}
+
+static int watch_points(const struct Fexpr *f, int n)
+{
+    if (f->watch) {
+        if (f->watch->stop) {
+            return 0;
+        }
+        f->watch->points += n;
+    }
+    return 1;
+}
+
+int fexpr_eval(const struct Fexpr *f, calc_real x, calc_real *out)
+{
+    calc_real stack[FEXPR_STACK];
+    int sp = 0;
+    int i;
+
+    if (!watch_points(f, 1)) {
+        return 0;
+    }
+    for (i = 0; i < f->len; ++i) {
+        int code = f->ops[i].code;
+
+        if (code == FX_NUM) {
+            stack[sp++] = f->ops[i].value;
+        } else if (code == FX_VAR) {
+            stack[sp++] = x;
+        } else if (code == FX_CELL) {
+            if (!cell_value(f, &f->ops[i], &stack[sp++])) {
+                return 0;
+            }
+        } else if (code == FX_SYM) {
+            if (!sym_value((int)f->ops[i].value, &stack[sp++])) {
+                return 0;
+            }
+        } else if (code == FX_CALL) {
+            if (!sym_call((int)f->ops[i].value, stack[sp - 1], &stack[sp - 1])) {
+                return 0;
+            }
+        } else if (FX_BINARY(code)) {
+            --sp;
+            if (!apply_binary(code, stack[sp - 1], stack[sp], &stack[sp - 1])) {
+                return 0;
+            }
+        } else if (!apply_unary(f, code, stack[sp - 1], &stack[sp - 1])) {
+            return 0;
+        }
+    }
+    *out = stack[0];
+    return 1;
+}
+
+/*
+ * fexpr_eval over a batch of x: each op runs across the whole batch before
+ * the next one is decoded. The stack is static, too big for a 4K task
+ * stack.
+ */
+int fexpr_eval_many(const struct Fexpr *f, const calc_real *x, int n, calc_real *out)
+{
+    static calc_real stack[FEXPR_STACK][FEXPR_BATCH];
+    int base;
+    int count;
+    int sp;
+    int i;
+    int j;
+
+    if (!watch_points(f, n)) {
+        return 0;
+    }
+    for (base = 0; base < n; base += count) {
+        count = n - base < FEXPR_BATCH ? n - base : FEXPR_BATCH;
+        sp = 0;
+        for (i = 0; i < f->len; ++i) {
+            int code = f->ops[i].code;
+            calc_real *top = stack[sp];
+
+            if (code == FX_NUM) {
+                for (j = 0; j < count; ++j) {
+                    top[j] = f->ops[i].value;
+                }
+                ++sp;
+            } else if (code == FX_VAR) {
+                for (j = 0; j < count; ++j) {
+                    top[j] = x[base + j];
+                }
+                ++sp;
+            } else if (code == FX_CELL || code == FX_SYM) {
+                if (code == FX_CELL ? !cell_value(f, &f->ops[i], &top[0]) :
+                                      !sym_value((int)f->ops[i].value, &top[0])) {
+                    return 0;
+                }
+                for (j = 1; j < count; ++j) {
+                    top[j] = top[0];
+                }
+                ++sp;
+            } else if (code == FX_CALL) {
+                top = stack[sp - 1];
+                for (j = 0; j < count; ++j) {
+                    if (!sym_call((int)f->ops[i].value, top[j], &top[j])) {
+                        return 0;
+                    }
+                }
+            } else if (FX_BINARY(code)) {
+                calc_real *lhs = stack[sp - 2];
+
+                --sp;
+                for (j = 0; j < count; ++j) {
+                    if (!apply_binary(code, lhs[j], stack[sp][j], &lhs[j])) {
+                        return 0;
+                    }
+                }
+            } else {
+                top = stack[sp - 1];
+                for (j = 0; j < count; ++j) {
+                    if (!apply_unary(f, code, top[j], &top[j])) {
+                        return 0;
+                    }
+                }
+            }
+        }
+        for (j = 0; j < count; ++j) {
+            out[base + j] = stack[0][j];
+        }
+    }
+    return 1;
+}
+
+/* d/da of the unary function at a, whose value there is v. */
+static int unary_slope(const struct Fexpr *f, int code, calc_real a, calc_real v,
+                       calc_real *out)
+{
+    calc_real to_rad = f->degrees ? FX_PI / REAL_C(180.0) : REAL_C(1.0);
+    calc_real t;
+
+    switch (code) {
+        case FX_NEG:
+            *out = -REAL_C(1.0);
+            break;
+        case FX_SIN:
+            calc_math->cos_f(&t, a * to_rad);
+            *out = t * to_rad;
+            break;
+        case FX_COS:
+            calc_math->sin_f(&t, a * to_rad);
+            *out = -t * to_rad;
+            break;
+        case FX_TAN:
+            *out = (REAL_C(1.0) + v * v) * to_rad;
+            break;
+        case FX_ASIN:
+        case FX_ACOS:
+            if (a <= -REAL_C(1.0) || a >= REAL_C(1.0)) {
+                return 0;
+            }
+            calc_math->sqrt_f(&t, REAL_C(1.0) - a * a);
+            *out = REAL_C(1.0) / (t * to_rad);
+            if (code == FX_ACOS) {
+                *out = -*out;
+            }
+            break;
+        case FX_ATAN:
+            *out = REAL_C(1.0) / ((REAL_C(1.0) + a * a) * to_rad);
+            break;
+        case FX_LN:
+            *out = REAL_C(1.0) / a;
+            break;
+        case FX_LOG:
+            *out = REAL_C(1.0) / (a * FX_LN10);
+            break;
+        case FX_EXP:
+            *out = v;
+            break;
+        case FX_EXP10:
+            *out = v * FX_LN10;
+            break;
+        case FX_SQRT:
+            if (v == REAL_C(0.0)) {
+                return 0;
+            }
+            *out = REAL_C(0.5) / v;
+            break;
+        case FX_SQR:
+            *out = REAL_C(2.0) * a;
+            break;
+        case FX_PCT:
+            *out = REAL_C(0.01);
+            break;
+        case FX_FACT:
+        case FX_LNFACT:
+            if (!calc_digamma(a + REAL_C(1.0), &t)) {
+                return 0;
+            }
+            *out = (code == FX_FACT) ? v * t : t;
+            break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+/* Partial derivatives of the binary operator at (a, b), whose value is v. */
+static int binary_slopes(int code, calc_real a, calc_real b, calc_real v,
+                         calc_real *da, calc_real *db)
+{
+    calc_real t;
+    calc_real u;
+
+    switch (code) {
+        case FX_ADD:
+            *da = REAL_C(1.0);
+            *db = REAL_C(1.0);
+            break;
+        case FX_SUB:
+            *da = REAL_C(1.0);
+            *db = -REAL_C(1.0);
+            break;
+        case FX_MUL:
+            *da = b;
+            *db = a;
+            break;
+        case FX_DIV:
+            *da = REAL_C(1.0) / b;
+            *db = -v / b;
+            break;
+        case FX_POW:
+            /* d(a^b) = b a^(b-1) da + a^b ln(a) db */
+            if (a != REAL_C(0.0)) {
+                *da = b * v / a;
+            } else if (b >= REAL_C(1.0)) {
+                *da = (b == REAL_C(1.0)) ? REAL_C(1.0) : REAL_C(0.0);
+            } else {
+                return 0;
+            }
+            if (a > REAL_C(0.0)) {
+                calc_math->log_f(&t, a);
+                *db = v * t;
+            } else {
+                /* A negative base only has a power for isolated exponents. */
+                *db = REAL_C(0.0);
+            }
+            break;
+        case FX_ROOT:
+            if (a == REAL_C(0.0)) {
+                return 0;
+            }
+            *da = v / (b * a);
+            calc_math->log_f(&t, a < REAL_C(0.0) ? -a : a);
+            *db = -v * t / (b * b);
+            break;
+        default:
+            /* nCr, nPr: through psi, the derivative of ln(gamma). */
+            if (!calc_digamma(a + REAL_C(1.0), &t) || !calc_digamma(a - b + REAL_C(1.0), &u)) {
+                return 0;
+            }
+            *da = v * (t - u);
+            if (code == FX_NCR) {
+                if (!calc_digamma(b + REAL_C(1.0), &t)) {
+                    return 0;
+                }
+                *db = v * (u - t);
+            } else {
+                *db = v * u;
+            }
+            break;
+    }
+    return 1;
+}
+
+int fexpr_eval_dual(const struct Fexpr *f, calc_real x, struct Dual *out)
+{
+    struct Dual stack[FEXPR_STACK];
+    struct Dual *a;
+    struct Dual *b;
+    calc_real v;
+    calc_real da;
+    calc_real db;
+    int sp = 0;
+    int i;
+
+    if (!watch_points(f, 1)) {
+        return 0;
+    }
+    for (i = 0; i < f->len; ++i) {
+        int code = f->ops[i].code;
+
+        if (code == FX_NUM) {
+            stack[sp].v = f->ops[i].value;
+            stack[sp++].d = REAL_C(0.0);
+        } else if (code == FX_VAR) {
+            stack[sp].v = x;
+            stack[sp++].d = REAL_C(1.0);
+        } else if (code == FX_CELL || code == FX_SYM) {
+            if (code == FX_CELL ? !cell_value(f, &f->ops[i], &stack[sp].v) :
+                                  !sym_value((int)f->ops[i].value, &stack[sp].v)) {
+                return 0;
+            }
+            stack[sp++].d = REAL_C(0.0);
+        } else if (code == FX_CALL) {
+            struct Dual r;
+
+            a = &stack[sp - 1];
+            if (!sym_call_dual((int)f->ops[i].value, a->v, &r)) {
+                return 0;
+            }
+            a->d = (a->d != REAL_C(0.0)) ? a->d * r.d : REAL_C(0.0);
+            a->v = r.v;
+        } else if (FX_BINARY(code)) {
+            --sp;
+            a = &stack[sp - 1];
+            b = &stack[sp];
+            if (!apply_binary(code, a->v, b->v, &v) ||
+                !binary_slopes(code, a->v, b->v, v, &da, &db)) {
+                return 0;
+            }
+            /* A constant operand contributes nothing, even where its slope is undefined. */
+            a->d = (a->d != REAL_C(0.0) ? da * a->d : REAL_C(0.0)) +
+                   (b->d != REAL_C(0.0) ? db * b->d : REAL_C(0.0));
+            a->v = v;
+        } else {
+            a = &stack[sp - 1];
+            if (!apply_unary(f, code, a->v, &v)) {
+                return 0;
+            }
+            if (a->d != REAL_C(0.0)) {
+                if (!unary_slope(f, code, a->v, v, &da)) {
+                    return 0;
+                }
+                a->d *= da;
+            }
+            a->v = v;
+        }
+    }
+    *out = stack[0];
+    return finite_real(out->d);
+}
+
+/*
+ * Peephole pass over the postfix program: a unary op right after a
+ * constant, or a binary op right after two, is replaced by its value, so
+ * chains of constants collapse from the inside out. An op that fails on
+ * its constants is left for fexpr_eval to report.
+ */
+void fexpr_fold(struct Fexpr *f)
+{
+    int len = 0;
+    int i;
+
+    for (i = 0; i < f->len; ++i) {
+        struct FexprOp *out = &f->ops[len];
+        int code = f->ops[i].code;
+        calc_real v;
+
+        *out = f->ops[i];
+        ++len;
+        if (FX_BINARY(code)) {
+            if (len >= 3 && out[-1].code == FX_NUM && out[-2].code == FX_NUM &&
+                apply_binary(code, out[-2].value, out[-1].value, &v)) {
+                len -= 2;
+                out[-2].value = v;
+            }
+        } else if (!FX_LOAD(code) && code != FX_CALL) {
+            if (len >= 2 && out[-1].code == FX_NUM && apply_unary(f, code, out[-1].value, &v)) {
+                len -= 1;
+                out[-1].value = v;
+            }
+        }
+    }
+    f->len = len;
+}
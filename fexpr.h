@@ -0,0 +1,102 @@
+#ifndef FEXPR_H
+#define FEXPR_H
+
+#include "calcmath.h"
+
+/*
+ * Functions of one variable read back from the expression line; var names
+ * it ('x' for Resolver and Integrar, 'n' for series) and any other letter
+ * is an error. The text is what the keys wrote, so it is evaluated the way
+ * the keys work: prefix functions and the postfix !, % and (...)^2 apply
+ * to the operand they wrap, binary operators run strictly left to right.
+ * fexpr_compile turns the text into a postfix program; fexpr_eval runs it
+ * for one x and fexpr_eval_dual carries the derivative along with the
+ * value (forward-mode automatic differentiation on dual numbers).
+ * fexpr_eval_many evaluates n points in one pass over the program. All
+ * return 0 where the function is undefined or not finite.
+ *
+ * "#n" reads worksheet cell n. The compiled program only keeps the cell
+ * number; the values come from the FexprCells table in f->cells, which
+ * fexpr_compile leaves NULL, so a reference fails until the caller sets it.
+ * "@RATE" reads a named variable and "@F(...)" calls a user function (see
+ * symtab.h). fexpr_fold replaces every operation whose operands are all
+ * constants by its value.
+ *
+ * When f->watch is set (fexpr_compile leaves it NULL) the evaluators add
+ * the number of points they are asked for to watch->points, and fail
+ * once watch->stop is set; another task can follow or end a long
+ * computation through it.
+ */
+#define FEXPR_MAX_OPS 128
+#define FEXPR_STACK 24
+#define FEXPR_BATCH 16
+
+#define FX_NUM 0
+#define FX_VAR 1
+#define FX_ADD 2
+#define FX_SUB 3
+#define FX_MUL 4
+#define FX_DIV 5
+#define FX_POW 6
+#define FX_ROOT 7
+#define FX_NCR 8
+#define FX_NPR 9
+#define FX_NEG 10
+#define FX_SIN 11
+#define FX_COS 12
+#define FX_TAN 13
+#define FX_ASIN 14
+#define FX_ACOS 15
+#define FX_ATAN 16
+#define FX_LN 17
+#define FX_EXP 18
+#define FX_LOG 19
+#define FX_EXP10 20
+#define FX_SQRT 21
+#define FX_SQR 22
+#define FX_PCT 23
+#define FX_FACT 24
+#define FX_LNFACT 25
+#define FX_CELL 26
+#define FX_SYM 27
+#define FX_CALL 28
+
+struct FexprOp {
+    int code;
+    calc_real value;
+};
+
+/* Cell values, and whether each holds one (an error cell does not). */
+struct FexprCells {
+    const calc_real *value;
+    const unsigned char *ok;
+    int count;
+};
+
+struct FexprWatch {
+    volatile long points;
+    volatile int stop;
+};
+
+struct Fexpr {
+    const struct FexprCells *cells;
+    struct FexprWatch *watch;
+    int len;
+    int degrees;
+    int uses_var;
+    struct FexprOp ops[FEXPR_MAX_OPS];
+};
+
+/* A value and its derivative with respect to x. */
+struct Dual {
+    calc_real v;
+    calc_real d;
+};
+
+int fexpr_compile(const char *text, char var, int degrees, struct Fexpr *out);
+int fexpr_eval(const struct Fexpr *f, calc_real x, calc_real *out);
+int fexpr_eval_many(const struct Fexpr *f, const calc_real *x, int n, calc_real *out);
+int fexpr_eval_dual(const struct Fexpr *f, calc_real x, struct Dual *out);
+void fexpr_fold(struct Fexpr *f);
+
+#endif
@@ -0,0 +1,409 @@
+#include <math.h>
+
+#include "gamma.h"
+
+#define GAMMA_PI REAL_C(3.141592653589793)
+#define GAMMA_SQRT_2PI REAL_C(2.5066282746310002)
+#define GAMMA_HALF_LN_2PI REAL_C(0.91893853320467274)
+#define GAMMA_SHIFT REAL_C(10.0)
+
+/* n! for n = 0 .. CALC_REAL_MAX_FACT, from exact integer products. */
+const calc_real calc_fact_table[CALC_REAL_MAX_FACT + 1] = {
+    REAL_C(1.00000000000000000000e+00), REAL_C(1.00000000000000000000e+00),
+    REAL_C(2.00000000000000000000e+00), REAL_C(6.00000000000000000000e+00),
+    REAL_C(2.40000000000000000000e+01), REAL_C(1.20000000000000000000e+02),
+    REAL_C(7.20000000000000000000e+02), REAL_C(5.04000000000000000000e+03),
+    REAL_C(4.03200000000000000000e+04), REAL_C(3.62880000000000000000e+05),
+    REAL_C(3.62880000000000000000e+06), REAL_C(3.99168000000000000000e+07),
+    REAL_C(4.79001600000000000000e+08), REAL_C(6.22702080000000000000e+09),
+    REAL_C(8.71782912000000000000e+10), REAL_C(1.30767436800000000000e+12),
+    REAL_C(2.09227898880000000000e+13), REAL_C(3.55687428096000000000e+14),
+    REAL_C(6.40237370572800000000e+15), REAL_C(1.21645100408832000000e+17),
+    REAL_C(2.43290200817664000000e+18), REAL_C(5.10909421717094400000e+19),
+    REAL_C(1.12400072777760768000e+21), REAL_C(2.58520167388849766400e+22),
+    REAL_C(6.20448401733239439360e+23), REAL_C(1.55112100433309859840e+25),
+    REAL_C(4.03291461126605635584e+26), REAL_C(1.08888694504183521608e+28),
+    REAL_C(3.04888344611713860502e+29), REAL_C(8.84176199373970195454e+30),
+    REAL_C(2.65252859812191058636e+32), REAL_C(8.22283865417792281773e+33),
+    REAL_C(2.63130836933693530167e+35), REAL_C(8.68331761881188649552e+36),
+    REAL_C(2.95232799039604140848e+38),
+#ifndef AMICALC_FLOAT32
+    REAL_C(1.03331479663861449297e+40), REAL_C(3.71993326789901217468e+41),
+    REAL_C(1.37637530912263450463e+43), REAL_C(5.23022617466601111760e+44),
+    REAL_C(2.03978820811974433586e+46), REAL_C(8.15915283247897734346e+47),
+    REAL_C(3.34525266131638071082e+49), REAL_C(1.40500611775287989854e+51),
+    REAL_C(6.04152630633738356374e+52), REAL_C(2.65827157478844876804e+54),
+    REAL_C(1.19622220865480194562e+56), REAL_C(5.50262215981208894985e+57),
+    REAL_C(2.58623241511168180643e+59), REAL_C(1.24139155925360726709e+61),
+    REAL_C(6.08281864034267560872e+62), REAL_C(3.04140932017133780436e+64),
+    REAL_C(1.55111875328738228022e+66), REAL_C(8.06581751709438785717e+67),
+    REAL_C(4.27488328406002556430e+69), REAL_C(2.30843697339241380472e+71),
+    REAL_C(1.26964033536582759260e+73), REAL_C(7.10998587804863451854e+74),
+    REAL_C(4.05269195048772167557e+76), REAL_C(2.35056133128287857183e+78),
+    REAL_C(1.38683118545689835738e+80), REAL_C(8.32098711274139014428e+81),
+    REAL_C(5.07580213877224798801e+83), REAL_C(3.14699732603879375257e+85),
+    REAL_C(1.98260831540444006412e+87), REAL_C(1.26886932185884164103e+89),
+    REAL_C(8.24765059208247066672e+90), REAL_C(5.44344939077443064004e+92),
+    REAL_C(3.64711109181886852882e+94), REAL_C(2.48003554243683059960e+96),
+    REAL_C(1.71122452428141311372e+98), REAL_C(1.19785716699698917961e+100),
+    REAL_C(8.50478588567862317521e+101), REAL_C(6.12344583768860868615e+103),
+    REAL_C(4.47011546151268434089e+105), REAL_C(3.30788544151938641226e+107),
+    REAL_C(2.48091408113953980919e+109), REAL_C(1.88549470166605025499e+111),
+    REAL_C(1.45183092028285869634e+113), REAL_C(1.13242811782062978315e+115),
+    REAL_C(8.94618213078297528685e+116), REAL_C(7.15694570462638022948e+118),
+    REAL_C(5.79712602074736798588e+120), REAL_C(4.75364333701284174842e+122),
+    REAL_C(3.94552396972065865119e+124), REAL_C(3.31424013456535326700e+126),
+    REAL_C(2.81710411438055027695e+128), REAL_C(2.42270953836727323818e+130),
+    REAL_C(2.10775729837952771721e+132), REAL_C(1.85482642257398439115e+134),
+    REAL_C(1.65079551609084610812e+136), REAL_C(1.48571596448176149731e+138),
+    REAL_C(1.35200152767840296255e+140), REAL_C(1.24384140546413072555e+142),
+    REAL_C(1.15677250708164157476e+144), REAL_C(1.08736615665674308027e+146),
+    REAL_C(1.03299784882390592626e+148), REAL_C(9.91677934870949689210e+149),
+    REAL_C(9.61927596824821198533e+151), REAL_C(9.42689044888324774563e+153),
+    REAL_C(9.33262154439441526817e+155), REAL_C(9.33262154439441526817e+157),
+    REAL_C(9.42594775983835942085e+159), REAL_C(9.61446671503512660927e+161),
+    REAL_C(9.90290071648618040755e+163), REAL_C(1.02990167451456276238e+166),
+    REAL_C(1.08139675824029090050e+168), REAL_C(1.14628056373470835453e+170),
+    REAL_C(1.22652020319613793935e+172), REAL_C(1.32464181945182897450e+174),
+    REAL_C(1.44385958320249358220e+176), REAL_C(1.58824554152274294043e+178),
+    REAL_C(1.76295255109024466387e+180), REAL_C(1.97450685722107402354e+182),
+    REAL_C(2.23119274865981364660e+184), REAL_C(2.54355973347218755712e+186),
+    REAL_C(2.92509369349301569069e+188), REAL_C(3.39310868445189820120e+190),
+    REAL_C(3.96993716080872089540e+192), REAL_C(4.68452584975429065657e+194),
+    REAL_C(5.57458576120760588132e+196), REAL_C(6.68950291344912705759e+198),
+    REAL_C(8.09429852527344373968e+200), REAL_C(9.87504420083360136241e+202),
+    REAL_C(1.21463043670253296758e+205), REAL_C(1.50614174151114087980e+207),
+    REAL_C(1.88267717688892609974e+209), REAL_C(2.37217324288004688568e+211),
+    REAL_C(3.01266001845765954481e+213), REAL_C(3.85620482362580421736e+215),
+    REAL_C(4.97450422247728744039e+217), REAL_C(6.46685548922047367251e+219),
+    REAL_C(8.47158069087882051098e+221), REAL_C(1.11824865119600430745e+224),
+    REAL_C(1.48727070609068572891e+226), REAL_C(1.99294274616151887674e+228),
+    REAL_C(2.69047270731805048360e+230), REAL_C(3.65904288195254865769e+232),
+    REAL_C(5.01288874827499166103e+234), REAL_C(6.91778647261948849223e+236),
+    REAL_C(9.61572319694108900420e+238), REAL_C(1.34620124757175246059e+241),
+    REAL_C(1.89814375907617096943e+243), REAL_C(2.69536413788816277659e+245),
+    REAL_C(3.85437071718007277052e+247), REAL_C(5.55029383273930478955e+249),
+    REAL_C(8.04792605747199194485e+251), REAL_C(1.17499720439091082395e+254),
+    REAL_C(1.72724589045463891120e+256), REAL_C(2.55632391787286558858e+258),
+    REAL_C(3.80892263763056972699e+260), REAL_C(5.71338395644585459048e+262),
+    REAL_C(8.62720977423324043162e+264), REAL_C(1.31133588568345254561e+267),
+    REAL_C(2.00634390509568239478e+269), REAL_C(3.08976961384735088796e+271),
+    REAL_C(4.78914290146339387634e+273), REAL_C(7.47106292628289444708e+275),
+    REAL_C(1.17295687942641442819e+278), REAL_C(1.85327186949373479654e+280),
+    REAL_C(2.94670227249503832650e+282), REAL_C(4.71472363599206132241e+284),
+    REAL_C(7.59070505394721872908e+286), REAL_C(1.22969421873944943411e+289),
+    REAL_C(2.00440157654530257760e+291), REAL_C(3.28721858553429622726e+293),
+    REAL_C(5.42391066613158877498e+295), REAL_C(9.00369170577843736647e+297),
+    REAL_C(1.50361651486499904020e+300), REAL_C(2.52607574497319838754e+302),
+    REAL_C(4.26906800900470527494e+304), REAL_C(7.25741561530799896740e+306)
+#endif
+};
+
+/* B(2k) / (2k (2k - 1)), k = 1 .. 8: enough for full precision from 10 up. */
+static const calc_real stirling_coef[8] = {
+    REAL_C(8.3333333333333333e-2), REAL_C(-2.7777777777777778e-3),
+    REAL_C(7.9365079365079365e-4), REAL_C(-5.9523809523809524e-4),
+    REAL_C(8.4175084175084175e-4), REAL_C(-1.9175269175269175e-3),
+    REAL_C(6.4102564102564103e-3), REAL_C(-2.9550653594771242e-2)
+};
+
+/*
+ * Moves x >= 1/2 up to GAMMA_SHIFT with gamma(x) = gamma(x + 1) / x and
+ * returns the Stirling correction ln(gamma(x)) - (x - 1/2) ln(x) + x -
+ * ln(2 pi) / 2 at the shifted point. *shift receives the product of the
+ * steps.
+ */
+static calc_real stirling_sum(calc_real *x, calc_real *shift)
+{
+    calc_real p = REAL_C(1.0);
+    calc_real z;
+    calc_real z2;
+    calc_real sum;
+    int k;
+
+    while (*x < GAMMA_SHIFT) {
+        p *= *x;
+        *x += REAL_C(1.0);
+    }
+    z = REAL_C(1.0) / *x;
+    z2 = z * z;
+    sum = stirling_coef[7];
+    for (k = 6; k >= 0; --k) {
+        sum = sum * z2 + stirling_coef[k];
+    }
+    *shift = p;
+    return sum * z;
+}
+
+/*
+ * sin(pi * x) after removing the nearest integer, so the argument stays
+ * within [-pi/2, pi/2] however large x is. Returns 0 for integers.
+ */
+static int sin_pi(calc_real x, calc_real *out)
+{
+    calc_real n = (calc_real)floor((double)x + 0.5);
+    calc_real r = x - n;
+
+    if (r == REAL_C(0.0)) {
+        return 0;
+    }
+    calc_math->sin_f(out, GAMMA_PI * r);
+    if (fmod((double)n, 2.0) != 0.0) {
+        *out = -*out;
+    }
+    return 1;
+}
+
+int calc_gamma(calc_real x, calc_real *out)
+{
+    calc_real s;
+    calc_real g;
+    calc_real p;
+    calc_real half_pow;
+    calc_real e;
+    calc_real c;
+
+    if (x < REAL_C(0.5)) {
+        if (!sin_pi(x, &s)) {
+            return 0;
+        }
+        if (!calc_gamma(REAL_C(1.0) - x, &g)) {
+            return 0;
+        }
+        *out = GAMMA_PI / (s * g);
+        return 1;
+    }
+    s = stirling_sum(&x, &p);
+    /*
+     * x^(x - 1/2) overflows long before gamma does, so it is applied in
+     * halves; e^-x and the correction are separate so that x's rounding
+     * is not magnified by the exponential.
+     */
+    calc_math->pow_f(&half_pow, x, (x - REAL_C(0.5)) * REAL_C(0.5));
+    calc_math->exp_f(&e, -x);
+    calc_math->exp_f(&c, s);
+    *out = GAMMA_SQRT_2PI * c * (half_pow * e) * half_pow / p;
+    return 1;
+}
+
+/*
+ * ln(gamma(2 + t)) = (1 - euler) t + sum (-1)^k (zeta(k) - 1) / k t^k,
+ * k >= 2: the coefficients from t up to t^26, which reach full precision
+ * for |t| <= 1/2 (float needs 12 of them).
+ */
+#ifdef AMICALC_FLOAT32
+#define LGAMMA_TERMS 12
+#else
+#define LGAMMA_TERMS 26
+#endif
+
+static const calc_real lgamma_coef[26] = {
+    REAL_C(4.2278433509846714e-1), REAL_C(3.2246703342411322e-1),
+    REAL_C(-6.7352301053198095e-2), REAL_C(2.0580808427784548e-2),
+    REAL_C(-7.3855510286739853e-3), REAL_C(2.8905103307415233e-3),
+    REAL_C(-1.192753911703261e-3), REAL_C(5.0966952474304242e-4),
+    REAL_C(-2.2315475845357938e-4), REAL_C(9.9457512781808534e-5),
+    REAL_C(-4.4926236738133142e-5), REAL_C(2.0507212775670692e-5),
+    REAL_C(-9.4394882752683959e-6), REAL_C(4.3748667899074878e-6),
+    REAL_C(-2.0392157538013662e-6), REAL_C(9.5514121304074198e-7),
+    REAL_C(-4.492469198764566e-7), REAL_C(2.1207184805554666e-7),
+    REAL_C(-1.00432248239681e-7), REAL_C(4.7698101693639806e-8),
+    REAL_C(-2.2711094608943165e-8), REAL_C(1.0838659214896954e-8),
+    REAL_C(-5.1834750419700467e-9), REAL_C(2.4836745438024783e-9),
+    REAL_C(-1.1921401405860912e-9), REAL_C(5.731367241678862e-10)
+};
+
+static calc_real lgamma_series(calc_real t)
+{
+    calc_real sum = lgamma_coef[LGAMMA_TERMS - 1];
+    int k;
+
+    for (k = LGAMMA_TERMS - 2; k >= 0; --k) {
+        sum = sum * t + lgamma_coef[k];
+    }
+    return sum * t;
+}
+
+/*
+ * ln(gamma(x)) without forming gamma(x), so it stays finite far beyond
+ * the factorials the type can hold. Integers come from calc_fact_table.
+ * Below GAMMA_SHIFT the series around 2 takes t = x - m, m the nearest
+ * integer, and the steps back to 2 + t multiply the exact factors x - 1,
+ * x - 2, ...; nothing is rounded before the series, so the zeros at 1
+ * and 2 keep their full relative precision. Larger x goes through
+ * Stirling.
+ */
+int calc_lgamma(calc_real x, calc_real *out)
+{
+    calc_real s;
+    calc_real t;
+    calc_real p;
+    calc_real lx;
+    calc_real lp;
+
+    if (x < REAL_C(0.5)) {
+        if (!sin_pi(x, &s) || s < REAL_C(0.0)) {
+            return 0;
+        }
+        if (!calc_lgamma(REAL_C(1.0) - x, &t)) {
+            return 0;
+        }
+        calc_math->log_f(&lx, GAMMA_PI / s);
+        *out = lx - t;
+        return 1;
+    }
+    if (x <= (calc_real)(CALC_REAL_MAX_FACT + 1) && (calc_real)floor((double)x) == x) {
+        calc_math->log_f(out, calc_fact_table[(int)x - 1]);
+        return 1;
+    }
+    if (x < GAMMA_SHIFT) {
+        calc_real m = (calc_real)floor((double)x + 0.5);
+        int j;
+
+        *out = lgamma_series(x - m);
+        if (m < REAL_C(2.0)) {
+            calc_math->log_f(&lx, x);
+            *out -= lx;
+        } else if (m > REAL_C(2.0)) {
+            p = x - REAL_C(1.0);
+            for (j = 2; j < (int)m - 1; ++j) {
+                p *= x - (calc_real)j;
+            }
+            calc_math->log_f(&lp, p);
+            *out += lp;
+        }
+        return 1;
+    }
+    s = stirling_sum(&x, &p);
+    calc_math->log_f(&lx, x);
+    calc_math->log_f(&lp, p);
+    *out = (x - REAL_C(0.5)) * lx - x + GAMMA_HALF_LN_2PI + s - lp;
+    return 1;
+}
+
+/* B(2k) / 2k, k = 1 .. 8: the asymptotic series of the digamma function. */
+static const calc_real digamma_coef[8] = {
+    REAL_C(8.3333333333333333e-2), REAL_C(-8.3333333333333333e-3),
+    REAL_C(3.9682539682539683e-3), REAL_C(-4.1666666666666667e-3),
+    REAL_C(7.5757575757575758e-3), REAL_C(-2.1092796092796093e-2),
+    REAL_C(8.3333333333333333e-2), REAL_C(-4.4325980392156863e-1)
+};
+
+/*
+ * psi(x) = gamma'(x) / gamma(x), the derivative of ln(gamma). The same
+ * shift and reflection as the gamma kernels; 0 at the poles.
+ */
+int calc_digamma(calc_real x, calc_real *out)
+{
+    calc_real s;
+    calc_real c;
+    calc_real p;
+    calc_real acc = REAL_C(0.0);
+    calc_real z2;
+    calc_real sum;
+    calc_real lx;
+    double n;
+    int k;
+
+    if (x < REAL_C(0.5)) {
+        /* psi(x) = psi(1 - x) - pi cot(pi x) */
+        if (!sin_pi(x, &s) || !calc_digamma(REAL_C(1.0) - x, &p)) {
+            return 0;
+        }
+        n = floor((double)x + 0.5);
+        calc_math->cos_f(&c, GAMMA_PI * (x - (calc_real)n));
+        if (fmod(n, 2.0) != 0.0) {
+            c = -c;
+        }
+        *out = p - GAMMA_PI * c / s;
+        return 1;
+    }
+    while (x < GAMMA_SHIFT) {
+        acc -= REAL_C(1.0) / x;
+        x += REAL_C(1.0);
+    }
+    z2 = REAL_C(1.0) / (x * x);
+    sum = digamma_coef[7];
+    for (k = 6; k >= 0; --k) {
+        sum = sum * z2 + digamma_coef[k];
+    }
+    calc_math->log_f(&lx, x);
+    *out = acc + lx - REAL_C(0.5) / x - sum * z2;
+    return 1;
+}
+
+/*
+ * gamma(z) for complex z: the real kernel's shift and Stirling series in
+ * complex arithmetic, exponentiated once at the end. Below Re z = 1/2 the
+ * reflection gamma(z) = pi / (sin(pi z) gamma(1 - z)) applies, with the
+ * nearest integer removed from pi z as in sin_pi.
+ */
+int calc_cgamma(const struct Cplx *z, struct Cplx *out)
+{
+    struct Cplx w = *z;
+    struct Cplx p;
+    struct Cplx t;
+    struct Cplx u;
+    struct Cplx lw;
+    struct Cplx sum;
+    calc_real n;
+    int k;
+
+    if (z->re < REAL_C(0.5)) {
+        n = (calc_real)floor((double)z->re + 0.5);
+        if (z->im == REAL_C(0.0) && z->re == n) {
+            return 0;
+        }
+        t.re = GAMMA_PI * (z->re - n);
+        t.im = GAMMA_PI * z->im;
+        if (!cplx_sin(&t, &u)) {
+            return 0;
+        }
+        if (fmod((double)n, 2.0) != 0.0) {
+            u.re = -u.re;
+            u.im = -u.im;
+        }
+        w.re = REAL_C(1.0) - z->re;
+        w.im = -z->im;
+        if (!calc_cgamma(&w, &t) || !cplx_mul(&u, &t, &u)) {
+            return 0;
+        }
+        t.re = GAMMA_PI;
+        t.im = REAL_C(0.0);
+        return cplx_div(&t, &u, out);
+    }
+    p.re = REAL_C(1.0);
+    p.im = REAL_C(0.0);
+    while (w.re < GAMMA_SHIFT) {
+        if (!cplx_mul(&p, &w, &p)) {
+            return 0;
+        }
+        w.re += REAL_C(1.0);
+    }
+    /* sum = (c0 + c1 / w^2 + ... + c7 / w^14) / w */
+    t.re = REAL_C(1.0);
+    t.im = REAL_C(0.0);
+    if (!cplx_div(&t, &w, &u) || !cplx_mul(&u, &u, &t)) {
+        return 0;
+    }
+    sum.re = stirling_coef[7];
+    sum.im = REAL_C(0.0);
+    for (k = 6; k >= 0; --k) {
+        cplx_mul(&sum, &t, &sum);
+        sum.re += stirling_coef[k];
+    }
+    cplx_mul(&sum, &u, &sum);
+    /* ln(gamma(w)) = (w - 1/2) ln(w) - w + ln(2 pi) / 2 + sum */
+    if (!cplx_log(&w, &lw)) {
+        return 0;
+    }
+    u.re = w.re - REAL_C(0.5);
+    u.im = w.im;
+    cplx_mul(&u, &lw, &t);
+    t.re += GAMMA_HALF_LN_2PI - w.re + sum.re;
+    t.im += sum.im - w.im;
+    if (!cplx_exp(&t, &u)) {
+        return 0;
+    }
+    return cplx_div(&u, &p, out);
+}
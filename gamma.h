@@ -0,0 +1,25 @@
+#ifndef GAMMA_H
+#define GAMMA_H
+
+#include "calcmath.h"
+#include "cplx.h"
+
+/*
+ * Factorials and the gamma function in calc_real. calc_fact_table holds
+ * every finite n! of the type, rounded once from the exact value, so an
+ * integer factorial is a lookup. calc_gamma uses the Stirling series
+ * after shifting the argument up, calc_lgamma the factorial table at
+ * integers, a series around 2 for small x and Stirling beyond; both
+ * reflect below 1/2 and return 0 at the poles and, for calc_lgamma,
+ * where gamma is negative. calc_digamma is the derivative of ln(gamma), for automatic
+ * differentiation of factorials. calc_cgamma is gamma of a complex
+ * argument for the complex mode, by the same shift and series.
+ */
+extern const calc_real calc_fact_table[CALC_REAL_MAX_FACT + 1];
+
+int calc_gamma(calc_real x, calc_real *out);
+int calc_lgamma(calc_real x, calc_real *out);
+int calc_digamma(calc_real x, calc_real *out);
+int calc_cgamma(const struct Cplx *z, struct Cplx *out);
+
+#endif
@@ -0,0 +1,180 @@
+#include <string.h>
+
+#include "history.h"
+
+#define HIST_MASK (HIST_SIZE - 1)
+#define HIST_WORDS (HIST_SIZE / 32)
+
+/* Both texts, "expr\0value\0", from start in the arena. */
+struct HistEntry {
+    unsigned short start;
+    unsigned short size;
+    unsigned short value;
+};
+
+static struct HistEntry hist[HIST_SIZE];
+static char hist_arena[HIST_ARENA];
+static unsigned long hist_bits[HIST_BUCKETS][HIST_WORDS];
+static long hist_first = 0;
+static long hist_next = 0;
+static unsigned hist_head = 0;
+
+static int lower(int c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static unsigned trigram(const char *p)
+{
+    unsigned h = (unsigned)(unsigned char)lower(p[0]);
+
+    h = h * 31 + (unsigned)(unsigned char)lower(p[1]);
+    h = h * 31 + (unsigned)(unsigned char)lower(p[2]);
+    return h & (HIST_BUCKETS - 1);
+}
+
+static void mark(const char *text, unsigned slot, int on)
+{
+    unsigned long bit = 1UL << (slot & 31);
+    size_t len = strlen(text);
+    size_t i;
+
+    for (i = 0; i + 3 <= len; ++i) {
+        unsigned long *word = &hist_bits[trigram(text + i)][slot >> 5];
+
+        if (on) {
+            *word |= bit;
+        } else {
+            *word &= ~bit;
+        }
+    }
+}
+
+static void evict(void)
+{
+    unsigned slot = (unsigned)(hist_first & HIST_MASK);
+
+    mark(hist_arena + hist[slot].start, slot, 0);
+    hist_first++;
+}
+
+static int overlaps(const struct HistEntry *e, unsigned pos, unsigned size)
+{
+    return e->start < pos + size && pos < (unsigned)e->start + e->size;
+}
+
+/*
+ * Texts go in one after the other and wrap to the start of the arena when
+ * the end is reached, so the oldest entries are always the ones in the way.
+ */
+void hist_add(const char *expr, const char *value)
+{
+    size_t expr_len = strlen(expr);
+    size_t value_len = strlen(value);
+    unsigned size = (unsigned)(expr_len + value_len + 2);
+    unsigned pos = hist_head;
+    unsigned slot;
+    struct HistEntry *e;
+
+    if (size > HIST_ARENA / 4) {
+        return;
+    }
+    if (hist_next - hist_first == HIST_SIZE) {
+        evict();
+    }
+    if (pos + size > HIST_ARENA) {
+        while (hist_next > hist_first && hist[hist_first & HIST_MASK].start >= pos) {
+            evict();
+        }
+        pos = 0;
+    }
+    while (hist_next > hist_first && overlaps(&hist[hist_first & HIST_MASK], pos, size)) {
+        evict();
+    }
+
+    slot = (unsigned)(hist_next & HIST_MASK);
+    e = &hist[slot];
+    e->start = (unsigned short)pos;
+    e->size = (unsigned short)size;
+    e->value = (unsigned short)(expr_len + 1);
+    memcpy(hist_arena + pos, expr, expr_len + 1);
+    memcpy(hist_arena + pos + e->value, value, value_len + 1);
+    mark(expr, slot, 1);
+    hist_head = pos + size;
+    hist_next++;
+}
+
+long hist_count(void)
+{
+    return hist_next - hist_first;
+}
+
+int hist_get(long back, const char **expr, const char **value)
+{
+    const struct HistEntry *e;
+
+    if (back < 1 || back > hist_next - hist_first) {
+        return 0;
+    }
+    e = &hist[(hist_next - back) & HIST_MASK];
+    *expr = hist_arena + e->start;
+    *value = hist_arena + e->start + e->value;
+    return 1;
+}
+
+static int contains(const char *text, const char *part, size_t len)
+{
+    for (; *text != '\0'; ++text) {
+        size_t i;
+
+        for (i = 0; i < len && lower(text[i]) == lower(part[i]); ++i) {
+        }
+        if (i == len) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+long hist_find(const char *text, long back, int newer)
+{
+    unsigned long cand[HIST_WORDS];
+    size_t len = strlen(text);
+    size_t i;
+    int w;
+
+    if (len == 0) {
+        return 0;
+    }
+    for (w = 0; w < HIST_WORDS; ++w) {
+        cand[w] = ~0UL;
+    }
+    for (i = 0; i + 3 <= len; ++i) {
+        const unsigned long *bits = hist_bits[trigram(text + i)];
+
+        for (w = 0; w < HIST_WORDS; ++w) {
+            cand[w] &= bits[w];
+        }
+    }
+    if (back < 0) {
+        back = 0;
+    }
+    for (back += newer ? -1 : 1; back >= 1 && back <= hist_next - hist_first;
+         back += newer ? -1 : 1) {
+        unsigned slot = (unsigned)((hist_next - back) & HIST_MASK);
+
+        if ((cand[slot >> 5] & (1UL << (slot & 31))) &&
+            contains(hist_arena + hist[slot].start, text, len)) {
+            return back;
+        }
+    }
+    return 0;
+}
+
+void hist_clear(void)
+{
+    memset(hist_bits, 0, sizeof(hist_bits));
+    hist_first = 0;
+    hist_next = 0;
+    hist_head = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/*
+ * The last HIST_SIZE results of = with their expressions, in a ring of
+ * fixed entries whose texts share one HIST_ARENA byte arena; the oldest
+ * entries go when either is full. Entries are numbered backwards, 1 being
+ * the most recent, and hist_get finds any of them directly.
+ *
+ * hist_find looks for an expression containing a text, ignoring case,
+ * starting just beyond entry "back", towards older entries or, with
+ * newer set, towards newer ones. Each of HIST_BUCKETS hashed trigrams
+ * keeps a bit per ring slot whose expression has it; the bits are set
+ * when an entry comes in and cleared when it leaves. A search only checks
+ * the slots that have every trigram of the text, so texts of three or
+ * more characters rarely look at an expression that does not match.
+ * It returns the number of the entry found, or 0.
+ */
+#define HIST_SIZE 256
+#define HIST_ARENA 8192
+#define HIST_BUCKETS 256
+#define HIST_QUERY 15
+
+void hist_add(const char *expr, const char *value);
+long hist_count(void);
+int hist_get(long back, const char **expr, const char **value);
+long hist_find(const char *text, long back, int newer);
+void hist_clear(void);
+
+#endif
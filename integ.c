@@ -0,0 +1,191 @@
+#include "integ.h"
+
+#ifdef AMICALC_FLOAT32
+#define INTEG_RELTOL REAL_C(2e-5)
+#define INTEG_EPS50 REAL_C(6e-6)
+#else
+#define INTEG_RELTOL REAL_C(1e-13)
+#define INTEG_EPS50 REAL_C(1.1e-14)
+#endif
+
+struct IntegPart {
+    calc_real a;
+    calc_real b;
+    calc_real value;
+    calc_real error;
+};
+
+/* Kronrod nodes on [0, 1]; the odd ones and 0 are the Gauss nodes. */
+static const calc_real gk_x[8] = {
+    REAL_C(0.991455371120812639206854697526329), REAL_C(0.949107912342758524526189684047851),
+    REAL_C(0.864864423359769072789712788640926), REAL_C(0.741531185599394439863864773280788),
+    REAL_C(0.586087235467691130294144845693013), REAL_C(0.405845151377397166906606412076961),
+    REAL_C(0.207784955007898467600689403773245), REAL_C(0.0)
+};
+
+static const calc_real gk_wk[8] = {
+    REAL_C(0.022935322010529224963732008058970), REAL_C(0.063092092629978553290700663189204),
+    REAL_C(0.104790010322250183839876322541518), REAL_C(0.140653259715525918745189590510238),
+    REAL_C(0.169004726639267902826583426598550), REAL_C(0.190350578064785409913256402421014),
+    REAL_C(0.204432940075298892414161999234649), REAL_C(0.209482141084727828012999174891714)
+};
+
+static const calc_real gk_wg[4] = {
+    REAL_C(0.129484966168869693270611432679082), REAL_C(0.279705391489276667901467771423780),
+    REAL_C(0.381830050505118944950369775488975), REAL_C(0.417959183673469387755102040816327)
+};
+
+static struct IntegPart parts[INTEG_MAX_PARTS];
+
+static calc_real abs_real(calc_real value)
+{
+    return value < REAL_C(0.0) ? -value : value;
+}
+
+/*
+ * One G7K15 step. The 15 points go through fexpr_eval_many together. The
+ * error is QUADPACK's scaled |K - G|, which is less pessimistic than the
+ * raw difference once the rule has converged.
+ */
+static int gk15(const struct Fexpr *f, struct IntegPart *part)
+{
+    calc_real x[15];
+    calc_real y[15];
+    calc_real c = REAL_C(0.5) * (part->a + part->b);
+    calc_real h = REAL_C(0.5) * (part->b - part->a);
+    calc_real kron;
+    calc_real gauss;
+    calc_real mean;
+    calc_real asc;
+    calc_real err;
+    int i;
+
+    for (i = 0; i < 7; ++i) {
+        x[2 * i] = c - h * gk_x[i];
+        x[2 * i + 1] = c + h * gk_x[i];
+    }
+    x[14] = c;
+    if (!fexpr_eval_many(f, x, 15, y)) {
+        return 0;
+    }
+    kron = gk_wk[7] * y[14];
+    gauss = gk_wg[3] * y[14];
+    for (i = 0; i < 7; ++i) {
+        kron += gk_wk[i] * (y[2 * i] + y[2 * i + 1]);
+        if (i & 1) {
+            gauss += gk_wg[i / 2] * (y[2 * i] + y[2 * i + 1]);
+        }
+    }
+    mean = REAL_C(0.5) * kron;
+    asc = gk_wk[7] * abs_real(y[14] - mean);
+    for (i = 0; i < 7; ++i) {
+        asc += gk_wk[i] * (abs_real(y[2 * i] - mean) + abs_real(y[2 * i + 1] - mean));
+    }
+    asc *= abs_real(h);
+    err = abs_real((kron - gauss) * h);
+    if (asc != REAL_C(0.0) && err != REAL_C(0.0)) {
+        calc_real t;
+        calc_real scale;
+
+        calc_math->pow_f(&t, REAL_C(200.0) * err / asc, REAL_C(1.5));
+        scale = t < REAL_C(1.0) ? t : REAL_C(1.0);
+        err = asc * scale;
+    }
+    part->value = kron * h;
+    if (err < INTEG_EPS50 * abs_real(part->value)) {
+        err = INTEG_EPS50 * abs_real(part->value);
+    }
+    part->error = err;
+    return part->value - part->value == REAL_C(0.0) && err - err == REAL_C(0.0);
+}
+
+static void heap_push(int n)
+{
+    struct IntegPart tmp;
+    int i = n;
+
+    while (i > 0 && parts[(i - 1) / 2].error < parts[i].error) {
+        tmp = parts[i];
+        parts[i] = parts[(i - 1) / 2];
+        parts[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+
+/* Moves parts[n] to the root and sifts it down over parts[0 .. n - 1]. */
+static void heap_replace_top(int n)
+{
+    struct IntegPart tmp = parts[n];
+    int i = 0;
+    int child;
+
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && parts[child + 1].error > parts[child].error) {
+            ++child;
+        }
+        if (parts[child].error <= tmp.error) {
+            break;
+        }
+        parts[i] = parts[child];
+        i = child;
+    }
+    parts[i] = tmp;
+}
+
+int integ_gk15(const struct Fexpr *f, calc_real a, calc_real b, struct IntegResult *out)
+{
+    struct IntegPart left;
+    struct IntegPart right;
+    calc_real value;
+    calc_real error;
+    calc_real size;
+    calc_real mid;
+    int n = 1;
+    int i;
+
+    parts[0].a = a;
+    parts[0].b = b;
+    if (!gk15(f, &parts[0])) {
+        return 0;
+    }
+    value = parts[0].value;
+    error = parts[0].error;
+    size = abs_real(value);
+    /* Relative to the sum of |part|, so integrals that cancel to 0 stop too. */
+    while (error > INTEG_RELTOL * size && n < INTEG_MAX_PARTS) {
+        mid = REAL_C(0.5) * (parts[0].a + parts[0].b);
+        if (mid == parts[0].a || mid == parts[0].b) {
+            break;
+        }
+        left.a = parts[0].a;
+        left.b = mid;
+        right.a = mid;
+        right.b = parts[0].b;
+        if (!gk15(f, &left) || !gk15(f, &right)) {
+            return 0;
+        }
+        value += left.value + right.value - parts[0].value;
+        error += left.error + right.error - parts[0].error;
+        size += abs_real(left.value) + abs_real(right.value) - abs_real(parts[0].value);
+        parts[n] = left;
+        heap_replace_top(n);
+        parts[n] = right;
+        heap_push(n);
+        ++n;
+    }
+    /* The running sums drift; the final ones are added up afresh. */
+    value = REAL_C(0.0);
+    error = REAL_C(0.0);
+    for (i = 0; i < n; ++i) {
+        value += parts[i].value;
+        error += parts[i].error;
+    }
+    out->value = value;
+    out->error = error;
+    out->parts = n;
+    return 1;
+}
@@ -0,0 +1,24 @@
+#ifndef INTEG_H
+#define INTEG_H
+
+#include "fexpr.h"
+
+/*
+ * Adaptive Gauss-Kronrod quadrature of f(x) over [a, b]. Every
+ * subinterval gets a 15-point Kronrod sum and the embedded 7-point Gauss
+ * sum; their difference estimates its error. The subintervals sit in a
+ * max-heap on that error and the worst one is bisected until the total
+ * error meets the tolerance or INTEG_MAX_PARTS is reached. error is the
+ * final estimate and parts the number of subintervals used.
+ */
+#define INTEG_MAX_PARTS 200
+
+struct IntegResult {
+    calc_real value;
+    calc_real error;
+    int parts;
+};
+
+int integ_gk15(const struct Fexpr *f, calc_real a, calc_real b, struct IntegResult *out);
+
+#endif
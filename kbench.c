@@ -0,0 +1,1243 @@
+/*
+ * Speed and accuracy of the numeric kernels behind compute_op and
+ * handle_unary, one kernel at a time. Every kernel runs on the same
+ * random inputs twice: once in a timed loop, once against a double-double
+ * reference (about 106 bits) to measure its error in units in the last
+ * place of calc_real. Angles go through the same degree conversion as the
+ * calculator, so the DEG rows include its rounding.
+ *
+ * kbench [-n count] [-s seed] [-d uni|log] [-r lo hi] [-c mhz]
+ *        [-b soft|881|ieee] [kernel ...]
+ *
+ * -d log draws magnitudes log-uniformly, for kernels whose range is
+ * positive. -r replaces the range of the first operand. -c gives the
+ * clock rate used to turn time into cycles. One CSV line per kernel and
+ * angle mode goes to standard output, starting with the precision the
+ * program was built for; make bench builds it for float and for double on
+ * the host and runs both. Inputs whose result overflows or underflows
+ * calc_real count as fails. The dd_ kernels run the double-double
+ * versions of the same operations; they are always in radians. ipow
+ * (integer exponents), root and cbrt have _pow twins that run the same
+ * inputs through the backend's pow instead. bigfact times the exact n!
+ * of the factorial key; horner, roots and wilkinson the polynomial mode.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <time.h>
+
+#ifndef AMICALC_HOST
+#include <exec/types.h>
+#include <exec/execbase.h>
+#endif
+
+#include "calcmath.h"
+#include "combi.h"
+#include "ddreal.h"
+#include "gamma.h"
+#include "poly.h"
+#include "power.h"
+#include "ratio.h"
+#include "rng.h"
+
+#ifndef AMICALC_HOST
+extern struct ExecBase *SysBase;
+#endif
+
+#define BENCH_MAX 4096
+#define BENCH_TICKS (CLOCKS_PER_SEC / 4)
+#define CHAIN_LEN 100
+
+#define ANGLE_NONE 0
+#define ANGLE_IN 1
+#define ANGLE_OUT 2
+
+#define DIST_UNI 0
+#define DIST_LOG 1
+
+#ifdef AMICALC_FLOAT32
+#define REAL_NAME "float"
+#define REAL_BITS 24
+#define REAL_MAX FLT_MAX
+#define REAL_MIN FLT_MIN
+#else
+#define REAL_NAME "double"
+#define REAL_BITS 53
+#define REAL_MAX DBL_MAX
+#define REAL_MIN DBL_MIN
+#endif
+
+struct Kernel {
+    const char *name;
+    int angle;
+    double lo;
+    double hi;
+    double lo2;
+    double hi2;
+    int (*run)(calc_real a, calc_real b, calc_real *out);
+    int (*ref)(double a, double b, struct DDReal *out);
+};
+
+static int deg_mode = 0;
+static calc_real in_a[BENCH_MAX];
+static calc_real in_b[BENCH_MAX];
+static volatile calc_real sink;
+static calc_real poly_coef[POLY_MAX_DEGREE + 1];
+static struct PolyRoot poly_root[POLY_MAX_DEGREE];
+static int chain_num[BENCH_MAX];
+static int chain_den[BENCH_MAX];
+
+/* The calculator's deg_to_rad and rad_to_deg. */
+static calc_real to_rad(calc_real value)
+{
+    calc_real out;
+
+    if (!deg_mode) {
+        return value;
+    }
+    calc_math->mul(&out, value, REAL_C(3.141592653589793) / REAL_C(180.0));
+    return out;
+}
+
+static calc_real from_rad(calc_real value)
+{
+    calc_real out;
+
+    if (!deg_mode) {
+        return value;
+    }
+    calc_math->mul(&out, value, REAL_C(180.0) / REAL_C(3.141592653589793));
+    return out;
+}
+
+static struct DDReal ref_to_rad(double value)
+{
+    struct DDReal x = dd_from_double(value);
+
+    if (!deg_mode) {
+        return x;
+    }
+    return dd_div(dd_mul(x, dd_pi), dd_from_double(180.0));
+}
+
+static struct DDReal ref_from_rad(struct DDReal value)
+{
+    if (!deg_mode) {
+        return value;
+    }
+    return dd_div(dd_mul_d(value, 180.0), dd_pi);
+}
+
+static int run_add(calc_real a, calc_real b, calc_real *out)
+{
+    calc_math->add(out, a, b);
+    return 1;
+}
+
+static int run_sub(calc_real a, calc_real b, calc_real *out)
+{
+    calc_math->sub(out, a, b);
+    return 1;
+}
+
+static int run_mul(calc_real a, calc_real b, calc_real *out)
+{
+    calc_math->mul(out, a, b);
+    return 1;
+}
+
+static int run_div(calc_real a, calc_real b, calc_real *out)
+{
+    calc_math->div(out, a, b);
+    return 1;
+}
+
+static int run_pow(calc_real a, calc_real b, calc_real *out)
+{
+    return calc_pow(a, b, out);
+}
+
+static int run_root(calc_real a, calc_real b, calc_real *out)
+{
+    return calc_root(a, b, out);
+}
+
+/*
+ * The _pow kernels feed the same inputs as ipow, root and cbrt straight
+ * to the backend's pow, the path calc_pow and calc_root replace.
+ */
+static int run_ipow(calc_real a, calc_real b, calc_real *out)
+{
+    return calc_pow(a, b, out);
+}
+
+static int run_ipow_pow(calc_real a, calc_real b, calc_real *out)
+{
+    calc_math->pow_f(out, a, b);
+    return 1;
+}
+
+static int run_root_pow(calc_real a, calc_real b, calc_real *out)
+{
+    calc_math->pow_f(out, a, REAL_C(1.0) / b);
+    return 1;
+}
+
+static int run_cbrt(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    return calc_root(a, REAL_C(3.0), out);
+}
+
+static int run_cbrt_pow(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->pow_f(out, a, REAL_C(1.0) / REAL_C(3.0));
+    return 1;
+}
+
+static int run_sqrt(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->sqrt_f(out, a);
+    return 1;
+}
+
+static int run_sqr(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->mul(out, a, a);
+    return 1;
+}
+
+static int run_exp(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->exp_f(out, a);
+    return 1;
+}
+
+static int run_log(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->log_f(out, a);
+    return 1;
+}
+
+static int run_log10(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->log10_f(out, a);
+    return 1;
+}
+
+static int run_exp10(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->pow_f(out, REAL_C(10.0), a);
+    return 1;
+}
+
+static int run_sin(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->sin_f(out, to_rad(a));
+    return 1;
+}
+
+static int run_cos(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->cos_f(out, to_rad(a));
+    return 1;
+}
+
+static int run_tan(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->tan_f(out, to_rad(a));
+    return 1;
+}
+
+static int run_asin(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->asin_f(out, a);
+    *out = from_rad(*out);
+    return 1;
+}
+
+static int run_acos(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->acos_f(out, a);
+    *out = from_rad(*out);
+    return 1;
+}
+
+static int run_atan(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    calc_math->atan_f(out, a);
+    *out = from_rad(*out);
+    return 1;
+}
+
+/* n! as handle_unary does it: the table for integers, gamma otherwise. */
+static int run_fact(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    if (a >= REAL_C(0.0) && a <= (calc_real)CALC_REAL_MAX_FACT && a == (calc_real)(long)a) {
+        *out = calc_fact_table[(long)a];
+        return 1;
+    }
+    return calc_gamma(a + REAL_C(1.0), out);
+}
+
+static int run_lgamma(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    return calc_lgamma(a + REAL_C(1.0), out);
+}
+
+/*
+ * The same operations in double-double, rounded to calc_real at the end:
+ * their time against the plain kernels is the price of the DD mode.
+ */
+static int run_dd_add(calc_real a, calc_real b, calc_real *out)
+{
+    *out = (calc_real)dd_add(dd_from_double((double)a), dd_from_double((double)b)).hi;
+    return 1;
+}
+
+static int run_dd_mul(calc_real a, calc_real b, calc_real *out)
+{
+    *out = (calc_real)dd_mul(dd_from_double((double)a), dd_from_double((double)b)).hi;
+    return 1;
+}
+
+static int run_dd_div(calc_real a, calc_real b, calc_real *out)
+{
+    *out = (calc_real)dd_div(dd_from_double((double)a), dd_from_double((double)b)).hi;
+    return 1;
+}
+
+static int run_dd_pow(calc_real a, calc_real b, calc_real *out)
+{
+    *out = (calc_real)dd_pow(dd_from_double((double)a), dd_from_double((double)b)).hi;
+    return 1;
+}
+
+static int run_dd_sqrt(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    *out = (calc_real)dd_sqrt(dd_from_double((double)a)).hi;
+    return 1;
+}
+
+static int run_dd_exp(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    *out = (calc_real)dd_exp(dd_from_double((double)a)).hi;
+    return 1;
+}
+
+static int run_dd_log(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    *out = (calc_real)dd_log(dd_from_double((double)a)).hi;
+    return 1;
+}
+
+static int run_dd_sin(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    *out = (calc_real)dd_sin(dd_from_double((double)a)).hi;
+    return 1;
+}
+
+static int run_dd_cos(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    *out = (calc_real)dd_cos(dd_from_double((double)a)).hi;
+    return 1;
+}
+
+static int run_dd_tan(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    *out = (calc_real)dd_tan(dd_from_double((double)a)).hi;
+    return 1;
+}
+
+static int run_dd_atan(calc_real a, calc_real b, calc_real *out)
+{
+    (void)b;
+    *out = (calc_real)dd_atan(dd_from_double((double)a)).hi;
+    return 1;
+}
+
+static int ref_add(double a, double b, struct DDReal *out)
+{
+    *out = dd_add(dd_from_double(a), dd_from_double(b));
+    return 1;
+}
+
+static int ref_sub(double a, double b, struct DDReal *out)
+{
+    *out = dd_sub(dd_from_double(a), dd_from_double(b));
+    return 1;
+}
+
+static int ref_mul(double a, double b, struct DDReal *out)
+{
+    *out = dd_mul(dd_from_double(a), dd_from_double(b));
+    return 1;
+}
+
+static int ref_div(double a, double b, struct DDReal *out)
+{
+    *out = dd_div(dd_from_double(a), dd_from_double(b));
+    return 1;
+}
+
+static int ref_pow(double a, double b, struct DDReal *out)
+{
+    *out = dd_pow(dd_from_double(a), dd_from_double(b));
+    return 1;
+}
+
+static int ref_root(double a, double b, struct DDReal *out)
+{
+    *out = dd_root(dd_from_double(a), (long)b);
+    return 1;
+}
+
+static int ref_cbrt(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_root(dd_from_double(a), 3L);
+    return 1;
+}
+
+static int ref_sqrt(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_sqrt(dd_from_double(a));
+    return 1;
+}
+
+static int ref_sqr(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_sqr(dd_from_double(a));
+    return 1;
+}
+
+static int ref_exp(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_exp(dd_from_double(a));
+    return 1;
+}
+
+static int ref_log(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_log(dd_from_double(a));
+    return 1;
+}
+
+static int ref_log10(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_log10(dd_from_double(a));
+    return 1;
+}
+
+static int ref_exp10(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_exp(dd_mul(dd_from_double(a), dd_ln10));
+    return 1;
+}
+
+static int ref_sin(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_sin(ref_to_rad(a));
+    return 1;
+}
+
+static int ref_cos(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_cos(ref_to_rad(a));
+    return 1;
+}
+
+static int ref_tan(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_tan(ref_to_rad(a));
+    return 1;
+}
+
+static int ref_asin(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = ref_from_rad(dd_asin(dd_from_double(a)));
+    return 1;
+}
+
+static int ref_acos(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = ref_from_rad(dd_acos(dd_from_double(a)));
+    return 1;
+}
+
+static int ref_atan(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = ref_from_rad(dd_atan(dd_from_double(a)));
+    return 1;
+}
+
+static int ref_fact(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_gamma(dd_add(dd_from_double(a), dd_from_double(1.0)));
+    return 1;
+}
+
+static int ref_lgamma(double a, double b, struct DDReal *out)
+{
+    (void)b;
+    *out = dd_lgamma(dd_add(dd_from_double(a), dd_from_double(1.0)));
+    return 1;
+}
+
+/* Ranges of the two operands; the root degree is truncated to an integer. */
+static const struct Kernel kernels[] = {
+    {"add", ANGLE_NONE, -1e6, 1e6, -1e6, 1e6, run_add, ref_add},
+    {"sub", ANGLE_NONE, -1e6, 1e6, -1e6, 1e6, run_sub, ref_sub},
+    {"mul", ANGLE_NONE, -1e6, 1e6, -1e6, 1e6, run_mul, ref_mul},
+    {"div", ANGLE_NONE, -1e6, 1e6, 1e-3, 1e6, run_div, ref_div},
+    {"pow", ANGLE_NONE, 1e-3, 1e3, -20.0, 20.0, run_pow, ref_pow},
+    {"ipow", ANGLE_NONE, 0.1, 10.0, -32.0, 32.0, run_ipow, ref_pow},
+    {"ipow_pow", ANGLE_NONE, 0.1, 10.0, -32.0, 32.0, run_ipow_pow, ref_pow},
+    {"root", ANGLE_NONE, 1e-3, 1e6, 2.0, 10.0, run_root, ref_root},
+    {"root_pow", ANGLE_NONE, 1e-3, 1e6, 2.0, 10.0, run_root_pow, ref_root},
+    {"cbrt", ANGLE_NONE, -1e6, 1e6, 0.0, 0.0, run_cbrt, ref_cbrt},
+    {"cbrt_pow", ANGLE_NONE, -1e6, 1e6, 0.0, 0.0, run_cbrt_pow, ref_cbrt},
+    {"sqrt", ANGLE_NONE, 1e-6, 1e6, 0.0, 0.0, run_sqrt, ref_sqrt},
+    {"sqr", ANGLE_NONE, -1e6, 1e6, 0.0, 0.0, run_sqr, ref_sqr},
+    {"exp", ANGLE_NONE, -30.0, 30.0, 0.0, 0.0, run_exp, ref_exp},
+    {"ln", ANGLE_NONE, 1e-6, 1e6, 0.0, 0.0, run_log, ref_log},
+    {"log", ANGLE_NONE, 1e-6, 1e6, 0.0, 0.0, run_log10, ref_log10},
+    {"10^x", ANGLE_NONE, -30.0, 30.0, 0.0, 0.0, run_exp10, ref_exp10},
+    {"sin", ANGLE_IN, -1e3, 1e3, 0.0, 0.0, run_sin, ref_sin},
+    {"cos", ANGLE_IN, -1e3, 1e3, 0.0, 0.0, run_cos, ref_cos},
+    {"tan", ANGLE_IN, -1e3, 1e3, 0.0, 0.0, run_tan, ref_tan},
+    {"asin", ANGLE_OUT, -1.0, 1.0, 0.0, 0.0, run_asin, ref_asin},
+    {"acos", ANGLE_OUT, -1.0, 1.0, 0.0, 0.0, run_acos, ref_acos},
+    {"atan", ANGLE_OUT, -1e3, 1e3, 0.0, 0.0, run_atan, ref_atan},
+    {"fact", ANGLE_NONE, 0.0, 170.0, 0.0, 0.0, run_fact, ref_fact},
+    {"lgamma", ANGLE_NONE, 0.0, 1e3, 0.0, 0.0, run_lgamma, ref_lgamma},
+    {"dd_add", ANGLE_NONE, -1e6, 1e6, -1e6, 1e6, run_dd_add, ref_add},
+    {"dd_mul", ANGLE_NONE, -1e6, 1e6, -1e6, 1e6, run_dd_mul, ref_mul},
+    {"dd_div", ANGLE_NONE, -1e6, 1e6, 1e-3, 1e6, run_dd_div, ref_div},
+    {"dd_pow", ANGLE_NONE, 1e-3, 1e3, -20.0, 20.0, run_dd_pow, ref_pow},
+    {"dd_sqrt", ANGLE_NONE, 1e-6, 1e6, 0.0, 0.0, run_dd_sqrt, ref_sqrt},
+    {"dd_exp", ANGLE_NONE, -30.0, 30.0, 0.0, 0.0, run_dd_exp, ref_exp},
+    {"dd_ln", ANGLE_NONE, 1e-6, 1e6, 0.0, 0.0, run_dd_log, ref_log},
+    {"dd_sin", ANGLE_NONE, -1e3, 1e3, 0.0, 0.0, run_dd_sin, ref_sin},
+    {"dd_cos", ANGLE_NONE, -1e3, 1e3, 0.0, 0.0, run_dd_cos, ref_cos},
+    {"dd_tan", ANGLE_NONE, -1e3, 1e3, 0.0, 0.0, run_dd_tan, ref_tan},
+    {"dd_atan", ANGLE_NONE, -1e3, 1e3, 0.0, 0.0, run_dd_atan, ref_atan}
+};
+
+/* Distance from the reference in units of the last place of calc_real. */
+static double dd_ulp_error(struct DDReal value, struct DDReal ref)
+{
+    double diff = dd_sub(value, ref).hi;
+    double scale = fabs(ref.hi);
+    int e;
+
+    if (scale < 1e-300) {
+        scale = 1e-300;
+    }
+    frexp(scale, &e);
+    return fabs(diff) / ldexp(1.0, e - REAL_BITS);
+}
+
+static double ulp_error(calc_real value, struct DDReal ref)
+{
+    return dd_ulp_error(dd_from_double((double)value), ref);
+}
+
+static double draw(struct Rng *rng, int dist, double lo, double hi)
+{
+    double u = (double)rng_uniform(rng);
+
+    if (dist == DIST_LOG && lo > 0.0) {
+        return exp(log(lo) + u * (log(hi) - log(lo)));
+    }
+    return lo + u * (hi - lo);
+}
+
+static double elapsed(clock_t start)
+{
+    return (double)(clock() - start) / (double)CLOCKS_PER_SEC;
+}
+
+static void print_row(const char *name, const char *angle, int dist, double lo, double hi,
+                      int n, double seconds, double mhz, double max_ulp, double sum_ulp,
+                      int fails)
+{
+    double ns = seconds * 1e9;
+
+    printf("%s,%s,%s,%s,%s,%g,%g,%d,%.1f,%.1f,%.3f,%.4f,%d\n",
+           REAL_NAME, calc_math->name, name, angle, dist == DIST_LOG ? "log" : "uni", lo, hi, n,
+           ns, ns * mhz / 1e3, max_ulp, n > fails ? sum_ulp / (double)(n - fails) : 0.0,
+           fails);
+}
+
+/* Repeats the whole input set until a quarter of a second has gone by. */
+static double time_kernel(const struct Kernel *k, int n)
+{
+    clock_t start = clock();
+    long calls = 0;
+    calc_real out;
+    int i;
+
+    do {
+        for (i = 0; i < n; ++i) {
+            k->run(in_a[i], in_b[i], &out);
+            sink = out;
+        }
+        calls += n;
+    } while (clock() - start < BENCH_TICKS);
+    return elapsed(start) / (double)calls;
+}
+
+static void bench_kernel(const struct Kernel *k, int n, unsigned long seed, int dist,
+                         int use_range, double lo, double hi, double mhz)
+{
+    struct Rng rng;
+    double seconds;
+    double max_ulp = 0.0;
+    double sum_ulp = 0.0;
+    int fails = 0;
+    int i;
+
+    if (!use_range) {
+        lo = k->lo;
+        hi = k->hi;
+    }
+    if (dist == DIST_LOG && lo <= 0.0) {
+        dist = DIST_UNI;
+    }
+    rng_seed(&rng, seed);
+    for (i = 0; i < n; ++i) {
+        in_a[i] = (calc_real)draw(&rng, dist, lo, hi);
+        in_b[i] = (calc_real)draw(&rng, DIST_UNI, k->lo2, k->hi2);
+    }
+    if (k->run == run_root || k->run == run_root_pow || k->run == run_ipow ||
+        k->run == run_ipow_pow) {
+        for (i = 0; i < n; ++i) {
+            in_b[i] = (calc_real)(long)in_b[i];
+        }
+    }
+    if (k->run == run_fact && !use_range) {
+        /* Half table lookups, half gamma. */
+        for (i = 0; i < n; i += 2) {
+            in_a[i] = (calc_real)(long)in_a[i];
+        }
+    }
+    seconds = time_kernel(k, n);
+    for (i = 0; i < n; ++i) {
+        struct DDReal ref;
+        calc_real out;
+        double err;
+
+        if (!k->run(in_a[i], in_b[i], &out) ||
+            !k->ref((double)in_a[i], (double)in_b[i], &ref) ||
+            out != out || dd_isnan(ref) || fabs(ref.hi) > REAL_MAX ||
+            (ref.hi != 0.0 && fabs(ref.hi) < REAL_MIN)) {
+            fails++;
+            continue;
+        }
+        err = ulp_error(out, ref);
+        sum_ulp += err;
+        if (err > max_ulp) {
+            max_ulp = err;
+        }
+    }
+    print_row(k->name, k->angle == ANGLE_NONE ? "-" : (deg_mode ? "deg" : "rad"), dist,
+              lo, hi, n, seconds, mhz, max_ulp, sum_ulp, fails);
+}
+
+/*
+ * strtod on 25-digit strings that dd_format rounds correctly, and
+ * CALC_REAL_FMT formatting against dd_format to the same digits, its
+ * error being how far the printed number is from the correctly rounded
+ * one.
+ */
+static void bench_text(int do_parse, int do_format, int n, unsigned long seed, int dist,
+                       int use_range, double lo, double hi, double mhz)
+{
+    static char text[BENCH_MAX][40];
+    struct Rng rng;
+    char out[40];
+    clock_t start;
+    long calls;
+    int i;
+
+    if (!use_range) {
+        lo = 1e-10;
+        hi = 1e10;
+    }
+    if (dist == DIST_LOG && lo <= 0.0) {
+        dist = DIST_UNI;
+    }
+    rng_seed(&rng, seed);
+    for (i = 0; i < n; ++i) {
+        in_a[i] = (calc_real)draw(&rng, dist, lo, hi);
+        dd_format(dd_from_double((double)in_a[i]), 25, text[i]);
+    }
+    if (do_parse) {
+        double max_ulp = 0.0;
+        double sum_ulp = 0.0;
+
+        start = clock();
+        calls = 0;
+        do {
+            for (i = 0; i < n; ++i) {
+                sink = (calc_real)strtod(text[i], NULL);
+            }
+            calls += n;
+        } while (clock() - start < BENCH_TICKS);
+        for (i = 0; i < n; ++i) {
+            struct DDReal ref;
+            double err;
+
+            dd_from_string(text[i], &ref);
+            err = ulp_error((calc_real)strtod(text[i], NULL), ref);
+            sum_ulp += err;
+            if (err > max_ulp) {
+                max_ulp = err;
+            }
+        }
+        print_row("strtod", "-", dist, lo, hi, n, elapsed(start) / (double)calls, mhz,
+                  max_ulp, sum_ulp, 0);
+    }
+    if (do_format) {
+        double max_ulp = 0.0;
+        double sum_ulp = 0.0;
+        int fails = 0;
+
+        start = clock();
+        calls = 0;
+        do {
+            for (i = 0; i < n; ++i) {
+                sprintf(out, CALC_REAL_FMT, in_a[i]);
+            }
+            calls += n;
+        } while (clock() - start < BENCH_TICKS);
+        for (i = 0; i < n; ++i) {
+            struct DDReal got;
+            struct DDReal ref;
+            char want[40];
+            double err;
+
+            sprintf(out, CALC_REAL_FMT, in_a[i]);
+            dd_format(dd_from_double((double)in_a[i]), CALC_REAL_DIGITS, want);
+            if (!dd_from_string(out, &got) || !dd_from_string(want, &ref)) {
+                fails++;
+                continue;
+            }
+            err = dd_ulp_error(got, ref);
+            sum_ulp += err;
+            if (err > max_ulp) {
+                max_ulp = err;
+            }
+        }
+        print_row("format", "-", dist, lo, hi, n, elapsed(start) / (double)calls, mhz,
+                  max_ulp, sum_ulp, fails);
+    }
+}
+
+/* num/den unreduced, as the fraction mode keeps it until display. */
+static void small_ratio(struct Ratio *out, int num, int den)
+{
+    ratio_from_int(out, (calc_int)num);
+    out->den = (calc_int)den;
+}
+
+/* One chain of CHAIN_LEN operands from start; mixed cycles + - * /. */
+static int frac_chain(int start, int mixed, struct Ratio *acc)
+{
+    struct Ratio x;
+    int ok = 1;
+    int i;
+
+    small_ratio(acc, chain_num[start], chain_den[start]);
+    for (i = start + 1; i < start + CHAIN_LEN && ok; ++i) {
+        small_ratio(&x, chain_num[i], chain_den[i]);
+        switch (mixed ? i % 4 : 0) {
+            case 0:
+                ok = ratio_add(acc, &x, acc);
+                break;
+            case 1:
+                ok = ratio_sub(acc, &x, acc);
+                break;
+            case 2:
+                ok = ratio_mul(acc, &x, acc);
+                break;
+            default:
+                ok = ratio_div(acc, &x, acc);
+                break;
+        }
+    }
+    return ok;
+}
+
+static calc_real real_chain(int start, int mixed)
+{
+    calc_real acc = in_a[start];
+    int i;
+
+    for (i = start + 1; i < start + CHAIN_LEN; ++i) {
+        switch (mixed ? i % 4 : 0) {
+            case 0:
+                calc_math->add(&acc, acc, in_a[i]);
+                break;
+            case 1:
+                calc_math->sub(&acc, acc, in_a[i]);
+                break;
+            case 2:
+                calc_math->mul(&acc, acc, in_a[i]);
+                break;
+            default:
+                calc_math->div(&acc, acc, in_a[i]);
+                break;
+        }
+    }
+    return acc;
+}
+
+/*
+ * Operator chains of CHAIN_LEN operands in the fraction mode and in
+ * calc_real. addsub adds and subtracts fractions with denominators up
+ * to 12, the bookkeeping case; mixed cycles + - * / over operands up to
+ * 99/99. n counts chains and the times are per operator. The calc_real
+ * rows give the error of each chain's result against the exact fraction;
+ * a fraction chain that outgrows RAT_LIMBS counts as a fail.
+ */
+static void bench_chain(int mixed, int do_frac, int do_real, int n, unsigned long seed,
+                        double mhz)
+{
+    const char *frac_name = mixed ? "frac_mixed" : "frac_addsub";
+    const char *real_name = mixed ? "real_mixed" : "real_addsub";
+    int top = mixed ? 99 : 12;
+    int chains = n / CHAIN_LEN;
+    struct Ratio acc;
+    struct Rng rng;
+    clock_t start;
+    long calls;
+    int c;
+    int i;
+
+    if (!do_frac && !do_real) {
+        return;
+    }
+    if (chains < 1) {
+        chains = 1;
+    }
+    rng_seed(&rng, seed);
+    for (i = 0; i < chains * CHAIN_LEN; ++i) {
+        chain_num[i] = 1 + (int)(rng_next(&rng) % (unsigned long)top);
+        chain_den[i] = mixed ? 1 + (int)(rng_next(&rng) % 99UL) : 2 + (int)(rng_next(&rng) % 11UL);
+        if (!mixed && (rng_next(&rng) & 1)) {
+            chain_num[i] = -chain_num[i];
+        }
+        calc_math->div(&in_a[i], (calc_real)chain_num[i], (calc_real)chain_den[i]);
+    }
+    if (do_frac) {
+        int fails = 0;
+
+        start = clock();
+        calls = 0;
+        do {
+            for (c = 0; c < chains; ++c) {
+                frac_chain(c * CHAIN_LEN, mixed, &acc);
+            }
+            calls += (long)chains * (CHAIN_LEN - 1);
+        } while (clock() - start < BENCH_TICKS);
+        for (c = 0; c < chains; ++c) {
+            if (!frac_chain(c * CHAIN_LEN, mixed, &acc)) {
+                fails++;
+            }
+        }
+        print_row(frac_name, "-", DIST_UNI, 1.0, (double)top, chains,
+                  elapsed(start) / (double)calls, mhz, 0.0, 0.0, fails);
+    }
+    if (do_real) {
+        double max_ulp = 0.0;
+        double sum_ulp = 0.0;
+        int fails = 0;
+
+        start = clock();
+        calls = 0;
+        do {
+            for (c = 0; c < chains; ++c) {
+                sink = real_chain(c * CHAIN_LEN, mixed);
+            }
+            calls += (long)chains * (CHAIN_LEN - 1);
+        } while (clock() - start < BENCH_TICKS);
+        for (c = 0; c < chains; ++c) {
+            double err;
+
+            if (!frac_chain(c * CHAIN_LEN, mixed, &acc)) {
+                fails++;
+                continue;
+            }
+            err = ulp_error(real_chain(c * CHAIN_LEN, mixed), ratio_to_dd(&acc));
+            sum_ulp += err;
+            if (err > max_ulp) {
+                max_ulp = err;
+            }
+        }
+        print_row(real_name, "-", DIST_UNI, 1.0, (double)top, chains,
+                  elapsed(start) / (double)calls, mhz, max_ulp, sum_ulp, fails);
+    }
+}
+
+/*
+ * Exact n! by combi_factorial at the sizes the calculator allows, up to
+ * COMBI_MAX_N. The time is per factorial; a result whose digit count
+ * disagrees with lgamma(n + 1) / ln 10 counts as a fail.
+ */
+static void bench_bigfact(double mhz)
+{
+    static const unsigned long sizes[] = {1000UL, 10000UL, COMBI_MAX_N};
+    size_t s;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        bn_limb *digits = NULL;
+        clock_t start;
+        long calls = 0;
+        long len = 0;
+        long count;
+        bn_limb top;
+        double ln_fact = dd_lgamma(dd_from_double((double)sizes[s] + 1.0)).hi;
+        int fails = 0;
+
+        start = clock();
+        do {
+            free(digits);
+            len = combi_factorial(sizes[s], &digits, NULL);
+            calls++;
+        } while (len > 0 && clock() - start < BENCH_TICKS);
+        if (len <= 0) {
+            fails = 1;
+        } else {
+            count = (len - 1) * 4;
+            for (top = digits[len - 1]; top > 0; top /= 10) {
+                count++;
+            }
+            if (count != (long)floor(ln_fact / log(10.0)) + 1) {
+                fails = 1;
+            }
+        }
+        print_row("bigfact", "-", DIST_UNI, (double)sizes[s], (double)sizes[s], (int)calls,
+                  elapsed(start) / (double)calls, mhz, 0.0, 0.0, fails);
+        free(digits);
+    }
+}
+
+/*
+ * How far z is from the root of poly_coef next to it, in ulps of |z|:
+ * the Newton step p(z) / p'(z) with complex Horner in double-double.
+ * Outside the unit circle Horner runs on the reversed coefficients at
+ * y = 1 / z, and p'(z) / p(z) = n y - y^2 q'(y) / q(y), as in poly.c.
+ */
+static double root_ulps(int len, calc_real re, calc_real im)
+{
+    struct DDReal pr = dd_from_double(0.0);
+    struct DDReal pi = pr;
+    struct DDReal dr = pr;
+    struct DDReal di = pr;
+    struct DDReal t;
+    double mag = sqrt((double)re * (double)re + (double)im * (double)im);
+    int reversed = mag > 1.0;
+    double xr = reversed ? (double)re / (mag * mag) : (double)re;
+    double xi = reversed ? -(double)im / (mag * mag) : (double)im;
+    double gr;
+    double gi;
+    double den;
+    int e;
+    int i;
+
+    for (i = 0; i < len; ++i) {
+        t = dd_add(dd_sub(dd_mul_d(dr, xr), dd_mul_d(di, xi)), pr);
+        di = dd_add(dd_add(dd_mul_d(dr, xi), dd_mul_d(di, xr)), pi);
+        dr = t;
+        t = dd_sub(dd_mul_d(pr, xr), dd_mul_d(pi, xi));
+        t = dd_add(t, dd_from_double((double)poly_coef[reversed ? len - 1 - i : i]));
+        pi = dd_add(dd_mul_d(pr, xi), dd_mul_d(pi, xr));
+        pr = t;
+    }
+    /* g = p'/p, or q'/q turned into p'/p; the step is 1 / g. */
+    den = pr.hi * pr.hi + pi.hi * pi.hi;
+    if (den == 0.0) {
+        return 0.0;
+    }
+    gr = (dr.hi * pr.hi + di.hi * pi.hi) / den;
+    gi = (di.hi * pr.hi - dr.hi * pi.hi) / den;
+    if (reversed) {
+        double yr = xr * xr - xi * xi;
+        double yi = 2.0 * xr * xi;
+        double tr = (double)(len - 1) * xr - (yr * gr - yi * gi);
+
+        gi = (double)(len - 1) * xi - (yr * gi + yi * gr);
+        gr = tr;
+    }
+    den = sqrt(gr * gr + gi * gi);
+    if (den == 0.0) {
+        return 1e30;
+    }
+    if (mag < 1e-300) {
+        mag = 1e-300;
+    }
+    frexp(mag, &e);
+    return 1.0 / den / ldexp(1.0, e - REAL_BITS);
+}
+
+/* poly_roots on poly_coef; with real_only set a complex root is a fail. */
+static void bench_roots(const char *name, int len, int real_only, double mhz)
+{
+    clock_t start = clock();
+    long calls = 0;
+    double max_ulp = 0.0;
+    double sum_ulp = 0.0;
+    double err;
+    int count;
+    int iterations;
+    int fails = 0;
+    int i;
+
+    do {
+        count = poly_roots(poly_coef, len, poly_root, &iterations);
+        calls++;
+    } while (count >= 0 && clock() - start < BENCH_TICKS);
+    if (count < 0) {
+        fails = len - 1;
+        count = 0;
+    }
+    for (i = 0; i < count; ++i) {
+        err = root_ulps(len, poly_root[i].re, poly_root[i].im);
+        sum_ulp += err;
+        if (err > max_ulp) {
+            max_ulp = err;
+        }
+        if (real_only && poly_root[i].im != REAL_C(0.0)) {
+            fails++;
+        }
+    }
+    print_row(name, "-", DIST_UNI, (double)(len - 1), (double)(len - 1), count,
+              elapsed(start) / (double)calls, mhz, max_ulp, sum_ulp, fails);
+}
+
+/*
+ * Polynomials of degree 10, 100 and POLY_MAX_DEGREE with coefficients
+ * drawn from [-1, 1]. horner evaluates them at n points of [-1, 1]
+ * against Horner in double-double; roots times poly_roots and gives the
+ * distance of each root from the exact root of the stored coefficients.
+ * wilkinson is (x - 1) (x - 2) ... (x - 20), whose roots the rounding of
+ * the coefficients makes badly conditioned; a root that comes back
+ * complex counts as a fail (in float the rounded coefficients do have 14
+ * complex roots). lo and hi hold the degree.
+ */
+static void bench_poly(int do_horner, int do_roots, int do_wilk, int n, unsigned long seed,
+                       double mhz)
+{
+    static const int degrees[] = {10, 100, POLY_MAX_DEGREE};
+    unsigned long long e[21];
+    struct Rng rng;
+    clock_t start;
+    long calls;
+    size_t s;
+    int len;
+    int i;
+    int k;
+
+    for (s = 0; s < sizeof(degrees) / sizeof(degrees[0]) && (do_horner || do_roots); ++s) {
+        double max_ulp = 0.0;
+        double sum_ulp = 0.0;
+
+        len = degrees[s] + 1;
+        rng_seed(&rng, seed);
+        for (i = 0; i < len; ++i) {
+            poly_coef[i] = (calc_real)draw(&rng, DIST_UNI, -1.0, 1.0);
+        }
+        if (do_horner) {
+            for (i = 0; i < n; ++i) {
+                in_a[i] = (calc_real)draw(&rng, DIST_UNI, -1.0, 1.0);
+            }
+            start = clock();
+            calls = 0;
+            do {
+                for (i = 0; i < n; ++i) {
+                    sink = poly_eval(poly_coef, len, in_a[i]);
+                }
+                calls += n;
+            } while (clock() - start < BENCH_TICKS);
+            for (i = 0; i < n; ++i) {
+                struct DDReal ref = poly_eval_dd(poly_coef, len, dd_from_double((double)in_a[i]));
+                double err = ulp_error(poly_eval(poly_coef, len, in_a[i]), ref);
+
+                sum_ulp += err;
+                if (err > max_ulp) {
+                    max_ulp = err;
+                }
+            }
+            print_row("horner", "-", DIST_UNI, (double)degrees[s], (double)degrees[s], n,
+                      elapsed(start) / (double)calls, mhz, max_ulp, sum_ulp, 0);
+        }
+        if (do_roots) {
+            bench_roots("roots", len, 0, mhz);
+        }
+    }
+    if (do_wilk) {
+        /* The elementary symmetric sums of 1 .. 20 fit an unsigned 64-bit word. */
+        e[0] = 1;
+        for (k = 1; k <= 20; ++k) {
+            e[k] = 0;
+            for (i = k; i > 0; --i) {
+                e[i] += (unsigned long long)k * e[i - 1];
+            }
+        }
+        for (i = 0; i <= 20; ++i) {
+            poly_coef[i] = (i & 1) ? -(calc_real)e[i] : (calc_real)e[i];
+        }
+        bench_roots("wilkinson", 21, 1, mhz);
+    }
+}
+
+static int select_backend(const char *name)
+{
+    if (strcmp(name, "soft") == 0) {
+        calc_math = &calc_math_soft;
+        return 1;
+    }
+#ifndef AMICALC_HOST
+    if (strcmp(name, "881") == 0 && (SysBase->AttnFlags & AFF_68881)) {
+        calc_math = &calc_math_881;
+        return 1;
+    }
+#ifndef AMICALC_FLOAT32
+    if (strcmp(name, "ieee") == 0 && calc_math_ieee_open()) {
+        calc_math = &calc_math_ieee;
+        return 1;
+    }
+#endif
+#endif
+    return 0;
+}
+
+static int wanted(char **names, int count, const char *name)
+{
+    int i;
+
+    if (count == 0) {
+        return 1;
+    }
+    for (i = 0; i < count; ++i) {
+        if (strcmp(names[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long seed = 1;
+    int n = 1000;
+    int dist = DIST_UNI;
+    int use_range = 0;
+    double lo = 0.0;
+    double hi = 1.0;
+    double mhz = 0.0;
+    char **names;
+    int count;
+    size_t k;
+    int i;
+
+    calc_math_init();
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = (unsigned long)atol(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dist = strcmp(argv[++i], "log") == 0 ? DIST_LOG : DIST_UNI;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 2 < argc) {
+            lo = atof(argv[++i]);
+            hi = atof(argv[++i]);
+            use_range = 1;
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            mhz = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            if (!select_backend(argv[++i])) {
+                fprintf(stderr, "kbench: backend %s not available\n", argv[i]);
+                calc_math_cleanup();
+                return 20;
+            }
+        } else {
+            fprintf(stderr, "usage: kbench [-n count] [-s seed] [-d uni|log] [-r lo hi] "
+                            "[-c mhz] [-b soft|881|ieee] [kernel ...]\n");
+            calc_math_cleanup();
+            return 10;
+        }
+    }
+    if (n < 1) {
+        n = 1;
+    }
+    if (n > BENCH_MAX) {
+        n = BENCH_MAX;
+    }
+    names = argv + i;
+    count = argc - i;
+
+    printf("real,backend,kernel,angle,dist,lo,hi,n,ns_per_call,cycles_per_call,max_ulp,mean_ulp,fails\n");
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        if (!wanted(names, count, kernels[k].name)) {
+            continue;
+        }
+        deg_mode = 0;
+        bench_kernel(&kernels[k], n, seed, dist, use_range, lo, hi, mhz);
+        if (kernels[k].angle != ANGLE_NONE) {
+            deg_mode = 1;
+            bench_kernel(&kernels[k], n, seed, dist, use_range, lo, hi, mhz);
+        }
+    }
+    bench_text(wanted(names, count, "strtod"), wanted(names, count, "format"), n, seed, dist,
+               use_range, lo, hi, mhz);
+    bench_chain(0, wanted(names, count, "frac_addsub"), wanted(names, count, "real_addsub"), n,
+                seed, mhz);
+    bench_chain(1, wanted(names, count, "frac_mixed"), wanted(names, count, "real_mixed"), n,
+                seed, mhz);
+    if (wanted(names, count, "bigfact")) {
+        bench_bigfact(mhz);
+    }
+    bench_poly(wanted(names, count, "horner"), wanted(names, count, "roots"),
+               wanted(names, count, "wilkinson"), n, seed, mhz);
+    calc_math_cleanup();
+    return 0;
+}
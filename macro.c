@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "macro.h"
+
+#define MACRO_LINE (MACRO_KEYS + 16)
+
+struct Macro macro_slots[MACRO_SLOTS];
+
+static char record_keys[MACRO_KEYS + 1];
+static int record_len = 0;
+static int recording = 0;
+
+void macro_record_start(void)
+{
+    record_len = 0;
+    record_keys[0] = '\0';
+    recording = 1;
+}
+
+/* Keys past MACRO_KEYS are dropped. */
+void macro_record_key(char key)
+{
+    if (recording && record_len < MACRO_KEYS) {
+        record_keys[record_len++] = key;
+        record_keys[record_len] = '\0';
+    }
+}
+
+int macro_recording(void)
+{
+    return recording;
+}
+
+static void set_keys(struct Macro *m, const char *keys, int len)
+{
+    memcpy(m->keys, keys, (size_t)len);
+    m->keys[len] = '\0';
+    m->len = len;
+    m->compiled = 0;
+}
+
+/* Returns the number of keys filed. */
+int macro_store(int slot)
+{
+    if (!recording || slot < 0 || slot >= MACRO_SLOTS) {
+        return -1;
+    }
+    recording = 0;
+    set_keys(&macro_slots[slot], record_keys, record_len);
+    return record_len;
+}
+
+void macro_cancel(void)
+{
+    recording = 0;
+}
+
+int macro_save(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    int i;
+
+    if (!f) {
+        return 0;
+    }
+    for (i = 0; i < MACRO_SLOTS; ++i) {
+        if (macro_slots[i].len > 0) {
+            fprintf(f, "%d %s\n", i + 1, macro_slots[i].keys);
+        }
+    }
+    return fclose(f) == 0;
+}
+
+int macro_load(const char *path)
+{
+    char line[MACRO_LINE];
+    FILE *f = fopen(path, "r");
+    int count = 0;
+
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, (int)sizeof(line), f)) {
+        int slot = line[0] - '1';
+        int len;
+
+        if (slot < 0 || slot >= MACRO_SLOTS || line[1] != ' ') {
+            continue;
+        }
+        len = (int)strcspn(line + 2, "\r\n");
+        if (len > MACRO_KEYS) {
+            len = MACRO_KEYS;
+        }
+        set_keys(&macro_slots[slot], line + 2, len);
+        count++;
+    }
+    fclose(f);
+    return count;
+}
@@ -0,0 +1,61 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+/*
+ * Keystroke macros. While recording, each key pressed on the pad is
+ * appended as its action character (the Button table's); macro_store
+ * files the recording under one of MACRO_SLOTS slots. macro_save writes
+ * the slots as text, one "slot keys" line each, and macro_load reads
+ * such a file back, returning the number of slots read or -1.
+ *
+ * Before a slot runs the calculator compiles its keys into a list of
+ * MacroOp for the current arithmetic mode: each run of digit, ".", Exp
+ * and +/- keys becomes one number whose text is kept in pool, an
+ * operator followed by a number becomes a single MOP_OPERAND, Inv
+ * presses are folded into the steps they affect, and the other keys are
+ * replayed as they were. first and count give the keys of the number,
+ * which are replayed instead when it would continue a typed entry.
+ * compiled is cleared whenever the keys change.
+ */
+#define MACRO_SLOTS 4
+#define MACRO_KEYS 80
+#define MACRO_POOL (3 * MACRO_KEYS)
+
+#define MOP_NUMBER 0
+#define MOP_OPERATOR 1
+#define MOP_OPERAND 2
+#define MOP_UNARY 3
+#define MOP_KEY 4
+
+struct MacroOp {
+    char code;
+    char key;
+    char inv;
+    short text;
+    short first;
+    short count;
+};
+
+struct Macro {
+    char keys[MACRO_KEYS + 1];
+    int len;
+    int compiled;
+    int mode;
+    int final_inv;
+    int ends_equals;
+    int op_count;
+    struct MacroOp ops[MACRO_KEYS];
+    char pool[MACRO_POOL];
+};
+
+extern struct Macro macro_slots[MACRO_SLOTS];
+
+void macro_record_start(void);
+void macro_record_key(char key);
+int macro_recording(void);
+int macro_store(int slot);
+void macro_cancel(void);
+int macro_save(const char *path);
+int macro_load(const char *path);
+
+#endif
@@ -0,0 +1,113 @@
+#include "calcmath.h"
+
+/*
+ * Built with -fpu=68881: arithmetic compiles to FPU instructions and the
+ * transcendental functions map straight onto their 6888x opcodes.
+ */
+static calc_real fpu_sqrt(__reg("fp0") calc_real value) = "\tfsqrt.x\tfp0";
+static calc_real fpu_etox(__reg("fp0") calc_real value) = "\tfetox.x\tfp0";
+static calc_real fpu_logn(__reg("fp0") calc_real value) = "\tflogn.x\tfp0";
+static calc_real fpu_log10(__reg("fp0") calc_real value) = "\tflog10.x\tfp0";
+static calc_real fpu_sin(__reg("fp0") calc_real value) = "\tfsin.x\tfp0";
+static calc_real fpu_cos(__reg("fp0") calc_real value) = "\tfcos.x\tfp0";
+static calc_real fpu_tan(__reg("fp0") calc_real value) = "\tftan.x\tfp0";
+static calc_real fpu_asin(__reg("fp0") calc_real value) = "\tfasin.x\tfp0";
+static calc_real fpu_acos(__reg("fp0") calc_real value) = "\tfacos.x\tfp0";
+static calc_real fpu_atan(__reg("fp0") calc_real value) = "\tfatan.x\tfp0";
+static calc_real fpu_trunc(__reg("fp0") calc_real value) = "\tfintrz.x\tfp0";
+
+static void m881_add(calc_real *out, calc_real lhs, calc_real rhs)
+{
+    *out = lhs + rhs;
+}
+
+static void m881_sub(calc_real *out, calc_real lhs, calc_real rhs)
+{
+    *out = lhs - rhs;
+}
+
+static void m881_mul(calc_real *out, calc_real lhs, calc_real rhs)
+{
+    *out = lhs * rhs;
+}
+
+static void m881_div(calc_real *out, calc_real lhs, calc_real rhs)
+{
+    *out = lhs / rhs;
+}
+
+static void m881_pow(calc_real *out, calc_real base, calc_real exponent)
+{
+    calc_real half;
+    calc_real mag;
+
+    if (exponent == REAL_C(0.0)) {
+        *out = 1.0;
+        return;
+    }
+    if (base < REAL_C(0.0) && exponent == fpu_trunc(exponent)) {
+        mag = fpu_etox(exponent * fpu_logn(-base));
+        half = exponent * REAL_C(0.5);
+        *out = (half == fpu_trunc(half)) ? mag : -mag;
+        return;
+    }
+    /* flogn yields NaN for negative bases, matching pow for fractional exponents. */
+    *out = fpu_etox(exponent * fpu_logn(base));
+}
+
+static void m881_sqrt(calc_real *out, calc_real value)
+{
+    *out = fpu_sqrt(value);
+}
+
+static void m881_exp(calc_real *out, calc_real value)
+{
+    *out = fpu_etox(value);
+}
+
+static void m881_log(calc_real *out, calc_real value)
+{
+    *out = fpu_logn(value);
+}
+
+static void m881_log10(calc_real *out, calc_real value)
+{
+    *out = fpu_log10(value);
+}
+
+static void m881_sin(calc_real *out, calc_real value)
+{
+    *out = fpu_sin(value);
+}
+
+static void m881_cos(calc_real *out, calc_real value)
+{
+    *out = fpu_cos(value);
+}
+
+static void m881_tan(calc_real *out, calc_real value)
+{
+    *out = fpu_tan(value);
+}
+
+static void m881_asin(calc_real *out, calc_real value)
+{
+    *out = fpu_asin(value);
+}
+
+static void m881_acos(calc_real *out, calc_real value)
+{
+    *out = fpu_acos(value);
+}
+
+static void m881_atan(calc_real *out, calc_real value)
+{
+    *out = fpu_atan(value);
+}
+
+const struct CalcMath calc_math_881 = {
+    "68881",
+    m881_add, m881_sub, m881_mul, m881_div,
+    m881_pow, m881_sqrt, m881_exp, m881_log, m881_log10,
+    m881_sin, m881_cos, m881_tan, m881_asin, m881_acos, m881_atan
+};
@@ -0,0 +1,123 @@
+#include <exec/types.h>
+#include <exec/libraries.h>
+#include <clib/exec_protos.h>
+#include <clib/mathieeedoubbas_protos.h>
+#include <clib/mathieeedoubtrans_protos.h>
+#include "calcmath.h"
+
+#ifndef AMICALC_FLOAT32
+
+struct Library *MathIeeeDoubBasBase = NULL;
+struct Library *MathIeeeDoubTransBase = NULL;
+
+int calc_math_ieee_open(void)
+{
+    MathIeeeDoubBasBase = OpenLibrary("mathieeedoubbas.library", 0);
+    if (!MathIeeeDoubBasBase) {
+        return 0;
+    }
+    MathIeeeDoubTransBase = OpenLibrary("mathieeedoubtrans.library", 0);
+    if (!MathIeeeDoubTransBase) {
+        CloseLibrary(MathIeeeDoubBasBase);
+        MathIeeeDoubBasBase = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void calc_math_ieee_close(void)
+{
+    if (MathIeeeDoubTransBase) {
+        CloseLibrary(MathIeeeDoubTransBase);
+        MathIeeeDoubTransBase = NULL;
+    }
+    if (MathIeeeDoubBasBase) {
+        CloseLibrary(MathIeeeDoubBasBase);
+        MathIeeeDoubBasBase = NULL;
+    }
+}
+
+static void ieee_add(double *out, double lhs, double rhs)
+{
+    *out = IEEEDPAdd(lhs, rhs);
+}
+
+static void ieee_sub(double *out, double lhs, double rhs)
+{
+    *out = IEEEDPSub(lhs, rhs);
+}
+
+static void ieee_mul(double *out, double lhs, double rhs)
+{
+    *out = IEEEDPMul(lhs, rhs);
+}
+
+static void ieee_div(double *out, double lhs, double rhs)
+{
+    *out = IEEEDPDiv(lhs, rhs);
+}
+
+static void ieee_pow(double *out, double base, double exponent)
+{
+    /* IEEEDPPow takes the exponent first. */
+    *out = IEEEDPPow(exponent, base);
+}
+
+static void ieee_sqrt(double *out, double value)
+{
+    *out = IEEEDPSqrt(value);
+}
+
+static void ieee_exp(double *out, double value)
+{
+    *out = IEEEDPExp(value);
+}
+
+static void ieee_log(double *out, double value)
+{
+    *out = IEEEDPLog(value);
+}
+
+static void ieee_log10(double *out, double value)
+{
+    *out = IEEEDPLog10(value);
+}
+
+static void ieee_sin(double *out, double value)
+{
+    *out = IEEEDPSin(value);
+}
+
+static void ieee_cos(double *out, double value)
+{
+    *out = IEEEDPCos(value);
+}
+
+static void ieee_tan(double *out, double value)
+{
+    *out = IEEEDPTan(value);
+}
+
+static void ieee_asin(double *out, double value)
+{
+    *out = IEEEDPAsin(value);
+}
+
+static void ieee_acos(double *out, double value)
+{
+    *out = IEEEDPAcos(value);
+}
+
+static void ieee_atan(double *out, double value)
+{
+    *out = IEEEDPAtan(value);
+}
+
+const struct CalcMath calc_math_ieee = {
+    "mathieeedoub",
+    ieee_add, ieee_sub, ieee_mul, ieee_div,
+    ieee_pow, ieee_sqrt, ieee_exp, ieee_log, ieee_log10,
+    ieee_sin, ieee_cos, ieee_tan, ieee_asin, ieee_acos, ieee_atan
+};
+
+#endif
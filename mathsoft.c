@@ -0,0 +1,110 @@
+#include <math.h>
+#include "calcmath.h"
+
+#ifdef AMICALC_FLOAT32
+#define SOFT_POW powf
+#define SOFT_SQRT sqrtf
+#define SOFT_EXP expf
+#define SOFT_LOG logf
+#define SOFT_LOG10 log10f
+#define SOFT_SIN sinf
+#define SOFT_COS cosf
+#define SOFT_TAN tanf
+#define SOFT_ASIN asinf
+#define SOFT_ACOS acosf
+#define SOFT_ATAN atanf
+#else
+#define SOFT_POW pow
+#define SOFT_SQRT sqrt
+#define SOFT_EXP exp
+#define SOFT_LOG log
+#define SOFT_LOG10 log10
+#define SOFT_SIN sin
+#define SOFT_COS cos
+#define SOFT_TAN tan
+#define SOFT_ASIN asin
+#define SOFT_ACOS acos
+#define SOFT_ATAN atan
+#endif
+
+static void soft_add(calc_real *out, calc_real lhs, calc_real rhs)
+{
+    *out = lhs + rhs;
+}
+
+static void soft_sub(calc_real *out, calc_real lhs, calc_real rhs)
+{
+    *out = lhs - rhs;
+}
+
+static void soft_mul(calc_real *out, calc_real lhs, calc_real rhs)
+{
+    *out = lhs * rhs;
+}
+
+static void soft_div(calc_real *out, calc_real lhs, calc_real rhs)
+{
+    *out = lhs / rhs;
+}
+
+static void soft_pow(calc_real *out, calc_real base, calc_real exponent)
+{
+    *out = SOFT_POW(base, exponent);
+}
+
+static void soft_sqrt(calc_real *out, calc_real value)
+{
+    *out = SOFT_SQRT(value);
+}
+
+static void soft_exp(calc_real *out, calc_real value)
+{
+    *out = SOFT_EXP(value);
+}
+
+static void soft_log(calc_real *out, calc_real value)
+{
+    *out = SOFT_LOG(value);
+}
+
+static void soft_log10(calc_real *out, calc_real value)
+{
+    *out = SOFT_LOG10(value);
+}
+
+static void soft_sin(calc_real *out, calc_real value)
+{
+    *out = SOFT_SIN(value);
+}
+
+static void soft_cos(calc_real *out, calc_real value)
+{
+    *out = SOFT_COS(value);
+}
+
+static void soft_tan(calc_real *out, calc_real value)
+{
+    *out = SOFT_TAN(value);
+}
+
+static void soft_asin(calc_real *out, calc_real value)
+{
+    *out = SOFT_ASIN(value);
+}
+
+static void soft_acos(calc_real *out, calc_real value)
+{
+    *out = SOFT_ACOS(value);
+}
+
+static void soft_atan(calc_real *out, calc_real value)
+{
+    *out = SOFT_ATAN(value);
+}
+
+const struct CalcMath calc_math_soft = {
+    "soft",
+    soft_add, soft_sub, soft_mul, soft_div,
+    soft_pow, soft_sqrt, soft_exp, soft_log, soft_log10,
+    soft_sin, soft_cos, soft_tan, soft_asin, soft_acos, soft_atan
+};
@@ -0,0 +1,341 @@
+/*
+ * Test of the floating point dispatch. Every backend that can be selected
+ * goes through struct CalcMath on a fixed grid of arguments and has to
+ * agree with the double-double kernels of ddreal.c, rounded to calc_real,
+ * to within a few units in the last place; a table of correctly rounded
+ * results checks ddreal and the backends against values worked out
+ * elsewhere. calc_math_init and calc_math_cleanup have to leave a usable
+ * table behind. On the host only the soft-float backend exists
+ * (make check); on the Amiga the same program also checks the 68881 and
+ * mathieee backends that are present.
+ *
+ * mathtest [-v]
+ *
+ * -v lists every backend and function checked. Returns 0 when all checks
+ * pass, 10 otherwise.
+ */
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef AMICALC_HOST
+#include <exec/types.h>
+#include <exec/execbase.h>
+#endif
+
+#include "calcmath.h"
+#include "ddreal.h"
+
+#ifndef AMICALC_HOST
+extern struct ExecBase *SysBase;
+#endif
+
+#define TEST_STEPS 64
+
+#ifdef AMICALC_FLOAT32
+#define REAL_BITS 24
+#else
+#define REAL_BITS 53
+#endif
+
+typedef void (*UnaryFn)(calc_real *out, calc_real value);
+typedef void (*BinaryFn)(calc_real *out, calc_real lhs, calc_real rhs);
+typedef struct DDReal (*UnaryRef)(struct DDReal value);
+typedef struct DDReal (*BinaryRef)(struct DDReal lhs, struct DDReal rhs);
+
+struct UnaryCase {
+    const char *name;
+    size_t slot;
+    UnaryRef ref;
+    double lo;
+    double hi;
+    double ulps;
+};
+
+struct BinaryCase {
+    const char *name;
+    size_t slot;
+    BinaryRef ref;
+    double lo;
+    double hi;
+    double lo2;
+    double hi2;
+    double ulps;
+};
+
+/*
+ * Correctly rounded results from a multiple precision library. The
+ * arguments are exact in float as well; rhs is unused by the unary ones.
+ */
+struct TableCase {
+    const char *name;
+    size_t slot;
+    int binary;
+    double lhs;
+    double rhs;
+    double want;
+    double ulps;
+};
+
+/* The transcendental functions get a few ulps, the 6888x's fsin included. */
+static const struct UnaryCase unary_cases[] = {
+    {"sqrt", offsetof(struct CalcMath, sqrt_f), dd_sqrt, 0.0, 1e6, 0.5},
+    {"exp", offsetof(struct CalcMath, exp_f), dd_exp, -30.0, 30.0, 4.0},
+    {"ln", offsetof(struct CalcMath, log_f), dd_log, 1e-6, 1e6, 4.0},
+    {"log", offsetof(struct CalcMath, log10_f), dd_log10, 1e-6, 1e6, 4.0},
+    {"sin", offsetof(struct CalcMath, sin_f), dd_sin, -10.0, 10.0, 4.0},
+    {"cos", offsetof(struct CalcMath, cos_f), dd_cos, -10.0, 10.0, 4.0},
+    {"tan", offsetof(struct CalcMath, tan_f), dd_tan, -1.5, 1.5, 4.0},
+    {"asin", offsetof(struct CalcMath, asin_f), dd_asin, -1.0, 1.0, 4.0},
+    {"acos", offsetof(struct CalcMath, acos_f), dd_acos, -1.0, 1.0, 4.0},
+    {"atan", offsetof(struct CalcMath, atan_f), dd_atan, -1e3, 1e3, 4.0}
+};
+
+static const struct BinaryCase binary_cases[] = {
+    {"add", offsetof(struct CalcMath, add), dd_add, -1e6, 1e6, -1e3, 1e3, 0.5},
+    {"sub", offsetof(struct CalcMath, sub), dd_sub, -1e6, 1e6, -1e3, 1e3, 0.5},
+    {"mul", offsetof(struct CalcMath, mul), dd_mul, -1e6, 1e6, -1e3, 1e3, 0.5},
+    {"div", offsetof(struct CalcMath, div), dd_div, -1e6, 1e6, 0.5, 1e3, 0.5},
+    {"pow", offsetof(struct CalcMath, pow_f), dd_pow, 1e-3, 1e3, -20.0, 20.0, 8.0}
+};
+
+static const struct TableCase table_cases[] = {
+    {"sqrt", offsetof(struct CalcMath, sqrt_f), 0, 2.0, 0.0, 1.4142135623730951, 0.5},
+    {"sqrt", offsetof(struct CalcMath, sqrt_f), 0, 3.0, 0.0, 1.7320508075688772, 0.5},
+    {"sqrt", offsetof(struct CalcMath, sqrt_f), 0, 10.0, 0.0, 3.1622776601683795, 0.5},
+    {"sqrt", offsetof(struct CalcMath, sqrt_f), 0, 0.75, 0.0, 0.8660254037844386, 0.5},
+    {"exp", offsetof(struct CalcMath, exp_f), 0, 0.5, 0.0, 1.6487212707001282, 4.0},
+    {"exp", offsetof(struct CalcMath, exp_f), 0, 1.0, 0.0, 2.7182818284590451, 4.0},
+    {"exp", offsetof(struct CalcMath, exp_f), 0, -2.5, 0.0, 0.0820849986238988, 4.0},
+    {"exp", offsetof(struct CalcMath, exp_f), 0, 10.0, 0.0, 22026.465794806718, 4.0},
+    {"ln", offsetof(struct CalcMath, log_f), 0, 2.0, 0.0, 0.69314718055994529, 4.0},
+    {"ln", offsetof(struct CalcMath, log_f), 0, 0.75, 0.0, -0.2876820724517809, 4.0},
+    {"ln", offsetof(struct CalcMath, log_f), 0, 10.0, 0.0, 2.3025850929940459, 4.0},
+    {"ln", offsetof(struct CalcMath, log_f), 0, 100.0, 0.0, 4.6051701859880918, 4.0},
+    {"log", offsetof(struct CalcMath, log10_f), 0, 2.0, 0.0, 0.3010299956639812, 4.0},
+    {"log", offsetof(struct CalcMath, log10_f), 0, 0.5, 0.0, -0.3010299956639812, 4.0},
+    {"log", offsetof(struct CalcMath, log10_f), 0, 7.0, 0.0, 0.84509804001425681, 4.0},
+    {"log", offsetof(struct CalcMath, log10_f), 0, 3.0, 0.0, 0.47712125471966244, 4.0},
+    {"sin", offsetof(struct CalcMath, sin_f), 0, 0.5, 0.0, 0.47942553860420301, 4.0},
+    {"sin", offsetof(struct CalcMath, sin_f), 0, 1.0, 0.0, 0.8414709848078965, 4.0},
+    {"sin", offsetof(struct CalcMath, sin_f), 0, 3.0, 0.0, 0.14112000805986721, 4.0},
+    {"sin", offsetof(struct CalcMath, sin_f), 0, -2.5, 0.0, -0.59847214410395655, 4.0},
+    {"cos", offsetof(struct CalcMath, cos_f), 0, 0.5, 0.0, 0.87758256189037276, 4.0},
+    {"cos", offsetof(struct CalcMath, cos_f), 0, 1.0, 0.0, 0.54030230586813977, 4.0},
+    {"cos", offsetof(struct CalcMath, cos_f), 0, 3.0, 0.0, -0.98999249660044542, 4.0},
+    {"cos", offsetof(struct CalcMath, cos_f), 0, 7.0, 0.0, 0.7539022543433046, 4.0},
+    {"tan", offsetof(struct CalcMath, tan_f), 0, 0.5, 0.0, 0.54630248984379048, 4.0},
+    {"tan", offsetof(struct CalcMath, tan_f), 0, 1.0, 0.0, 1.5574077246549023, 4.0},
+    {"tan", offsetof(struct CalcMath, tan_f), 0, 1.5, 0.0, 14.101419947171719, 4.0},
+    {"tan", offsetof(struct CalcMath, tan_f), 0, -0.75, 0.0, -0.93159645994407247, 4.0},
+    {"asin", offsetof(struct CalcMath, asin_f), 0, 0.5, 0.0, 0.52359877559829893, 4.0},
+    {"asin", offsetof(struct CalcMath, asin_f), 0, 0.75, 0.0, 0.848062078981481, 4.0},
+    {"asin", offsetof(struct CalcMath, asin_f), 0, -0.125, 0.0, -0.1253278311680654, 4.0},
+    {"asin", offsetof(struct CalcMath, asin_f), 0, 1.0, 0.0, 1.5707963267948966, 4.0},
+    {"acos", offsetof(struct CalcMath, acos_f), 0, 0.5, 0.0, 1.0471975511965979, 4.0},
+    {"acos", offsetof(struct CalcMath, acos_f), 0, 0.75, 0.0, 0.72273424781341566, 4.0},
+    {"acos", offsetof(struct CalcMath, acos_f), 0, -0.125, 0.0, 1.696124157962962, 4.0},
+    {"acos", offsetof(struct CalcMath, acos_f), 0, 0.0, 0.0, 1.5707963267948966, 4.0},
+    {"atan", offsetof(struct CalcMath, atan_f), 0, 0.5, 0.0, 0.46364760900080609, 4.0},
+    {"atan", offsetof(struct CalcMath, atan_f), 0, 1.0, 0.0, 0.78539816339744828, 4.0},
+    {"atan", offsetof(struct CalcMath, atan_f), 0, 10.0, 0.0, 1.4711276743037347, 4.0},
+    {"atan", offsetof(struct CalcMath, atan_f), 0, -100.0, 0.0, -1.5607966601082315, 4.0},
+    {"pow", offsetof(struct CalcMath, pow_f), 1, 2.0, 0.5, 1.4142135623730951, 8.0},
+    {"pow", offsetof(struct CalcMath, pow_f), 1, 10.0, -3.0, 0.001, 8.0},
+    {"pow", offsetof(struct CalcMath, pow_f), 1, 1.5, 7.0, 17.0859375, 8.0},
+    {"pow", offsetof(struct CalcMath, pow_f), 1, 0.75, 2.5, 0.48713928962874675, 8.0}
+};
+
+static int verbose = 0;
+static int failures = 0;
+
+/* The error of got in units in the last place of calc_real at want. */
+static double ulp_error(calc_real got, double want)
+{
+    int e;
+
+    if (got != got || want != want) {
+        return (got != got && want != want) ? 0.0 : 1e30;
+    }
+    if (want == 0.0) {
+        return got == REAL_C(0.0) ? 0.0 : 1e30;
+    }
+    frexp(want, &e);
+    return fabs((double)got - want) / ldexp(1.0, e - REAL_BITS);
+}
+
+/* The reference rounded to calc_real, as a correctly rounded result would be. */
+static double rounded(double value)
+{
+    return (double)(calc_real)value;
+}
+
+static double rounded_dd(struct DDReal value)
+{
+    return rounded(value.hi + value.lo);
+}
+
+static void report(const struct CalcMath *m, const char *name, double worst,
+                   double at, double at2, double ulps)
+{
+    if (worst > ulps) {
+        printf("FAIL %s %s: %.2f ulp at %.17g %.17g (limit %.1f)\n", m->name, name, worst,
+               at, at2, ulps);
+        failures++;
+    } else if (verbose) {
+        printf("ok   %s %s: %.2f ulp\n", m->name, name, worst);
+    }
+}
+
+static double grid(double lo, double hi, int i)
+{
+    return lo + (hi - lo) * (double)i / (double)(TEST_STEPS - 1);
+}
+
+static void test_backend(const struct CalcMath *m)
+{
+    size_t c;
+
+    for (c = 0; c < sizeof(unary_cases) / sizeof(unary_cases[0]); ++c) {
+        const struct UnaryCase *t = &unary_cases[c];
+        UnaryFn fn = *(const UnaryFn *)((const char *)m + t->slot);
+        double worst = 0.0;
+        double at = 0.0;
+        int i;
+
+        for (i = 0; i < TEST_STEPS; ++i) {
+            calc_real x = (calc_real)grid(t->lo, t->hi, i);
+            calc_real got;
+            double err;
+
+            fn(&got, x);
+            err = ulp_error(got, rounded_dd(t->ref(dd_from_double((double)x))));
+            if (err > worst) {
+                worst = err;
+                at = (double)x;
+            }
+        }
+        report(m, t->name, worst, at, 0.0, t->ulps);
+    }
+    for (c = 0; c < sizeof(binary_cases) / sizeof(binary_cases[0]); ++c) {
+        const struct BinaryCase *t = &binary_cases[c];
+        BinaryFn fn = *(const BinaryFn *)((const char *)m + t->slot);
+        double worst = 0.0;
+        double at = 0.0;
+        double at2 = 0.0;
+        int i;
+        int j;
+
+        for (i = 0; i < TEST_STEPS; ++i) {
+            for (j = 0; j < TEST_STEPS; j += 7) {
+                calc_real x = (calc_real)grid(t->lo, t->hi, i);
+                calc_real y = (calc_real)grid(t->lo2, t->hi2, j);
+                calc_real got;
+                double err;
+
+                fn(&got, x, y);
+                err = ulp_error(got, rounded_dd(t->ref(dd_from_double((double)x),
+                                                       dd_from_double((double)y))));
+                if (err > worst) {
+                    worst = err;
+                    at = (double)x;
+                    at2 = (double)y;
+                }
+            }
+        }
+        report(m, t->name, worst, at, at2, t->ulps);
+    }
+    for (c = 0; c < sizeof(table_cases) / sizeof(table_cases[0]); ++c) {
+        const struct TableCase *t = &table_cases[c];
+        calc_real got;
+
+        if (t->binary) {
+            (*(const BinaryFn *)((const char *)m + t->slot))(&got, (calc_real)t->lhs,
+                                                            (calc_real)t->rhs);
+        } else {
+            (*(const UnaryFn *)((const char *)m + t->slot))(&got, (calc_real)t->lhs);
+        }
+        report(m, t->name, ulp_error(got, rounded(t->want)), t->lhs, t->rhs, t->ulps);
+    }
+}
+
+/* ddreal has to reproduce every table entry before it can judge the backends. */
+static void test_reference(void)
+{
+    size_t c;
+    size_t u;
+
+    for (c = 0; c < sizeof(table_cases) / sizeof(table_cases[0]); ++c) {
+        const struct TableCase *t = &table_cases[c];
+        struct DDReal x = dd_from_double(t->lhs);
+        struct DDReal want = dd_from_double(t->want);
+        struct DDReal got;
+
+        if (t->binary) {
+            got = dd_pow(x, dd_from_double(t->rhs));
+        } else {
+            u = 0;
+            while (unary_cases[u].slot != t->slot) {
+                u++;
+            }
+            got = unary_cases[u].ref(x);
+        }
+        /* Within the rounding of the table entry, half an ulp of a double. */
+        got = dd_sub(got, want);
+        if (fabs(got.hi) > ldexp(fabs(t->want), -53)) {
+            printf("FAIL ddreal %s: %.17g at %.17g %.17g\n", t->name, t->want + got.hi,
+                   t->lhs, t->rhs);
+            failures++;
+        } else if (verbose) {
+            printf("ok   ddreal %s at %.17g\n", t->name, t->lhs);
+        }
+    }
+}
+
+/* After init some backend is selected, and cleanup goes back to soft-float. */
+static void test_selection(void)
+{
+    calc_real out;
+
+    calc_math_init();
+    if (calc_math == NULL || calc_math->name == NULL) {
+        printf("FAIL calc_math_init left no backend\n");
+        failures++;
+        return;
+    }
+    calc_math->add(&out, REAL_C(1.0), REAL_C(2.0));
+    if (out != REAL_C(3.0)) {
+        printf("FAIL %s add after calc_math_init\n", calc_math->name);
+        failures++;
+    } else if (verbose) {
+        printf("ok   calc_math_init selects %s\n", calc_math->name);
+    }
+    calc_math_cleanup();
+    if (calc_math != &calc_math_soft) {
+        printf("FAIL calc_math_cleanup did not restore soft\n");
+        failures++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    verbose = (argc > 1 && strcmp(argv[1], "-v") == 0);
+
+    test_reference();
+    test_selection();
+    test_backend(&calc_math_soft);
+#ifndef AMICALC_HOST
+    if (SysBase->AttnFlags & AFF_68881) {
+        test_backend(&calc_math_881);
+    }
+#ifndef AMICALC_FLOAT32
+    if (calc_math_ieee_open()) {
+        test_backend(&calc_math_ieee);
+        calc_math_ieee_close();
+    }
+#endif
+#endif
+    printf("%s: %d failure%s\n", failures ? "FAIL" : "PASS", failures, failures == 1 ? "" : "s");
+    return failures ? 10 : 0;
+}
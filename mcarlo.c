@@ -0,0 +1,41 @@
+#include "mcarlo.h"
+
+int mc_mean(const struct Fexpr *f, struct Rng *rng, int normal, calc_real a, calc_real b,
+            long samples, struct McResult *out)
+{
+    calc_real x[FEXPR_BATCH];
+    calc_real y[FEXPR_BATCH];
+    struct Stats acc;
+    calc_real sd;
+    calc_real root;
+    long done;
+    int n;
+    int i;
+
+    stats_clear(&acc);
+    for (done = 0; done < samples; done += n) {
+        n = (samples - done < FEXPR_BATCH) ? (int)(samples - done) : FEXPR_BATCH;
+        if (normal) {
+            rng_normal_many(rng, x, n);
+        } else {
+            rng_uniform_many(rng, x, n);
+            for (i = 0; i < n; ++i) {
+                x[i] = a + (b - a) * x[i];
+            }
+        }
+        if (!fexpr_eval_many(f, x, n, y)) {
+            return 0;
+        }
+        for (i = 0; i < n; ++i) {
+            stats_add(&acc, REAL_C(0.0), y[i]);
+        }
+    }
+    out->mean = acc.mean_y;
+    out->samples = acc.n;
+    out->error = REAL_C(0.0);
+    if (stats_stddev(&acc, &sd)) {
+        calc_math->sqrt_f(&root, (calc_real)acc.n);
+        out->error = sd / root;
+    }
+    return 1;
+}
@@ -0,0 +1,27 @@
+#ifndef MCARLO_H
+#define MCARLO_H
+
+#include "fexpr.h"
+#include "rng.h"
+#include "stats.h"
+
+/*
+ * Monte Carlo estimate of the mean of f(x), with x uniform in [a, b] or,
+ * when normal is set, a standard normal variate (a and b unused). The
+ * samples are drawn and evaluated FEXPR_BATCH at a time and fed to a
+ * Welford accumulator, whose mean and sample deviation give the estimate
+ * and its standard error sd / sqrt(n). Returns 0 if f is undefined at
+ * one of the samples.
+ */
+#define MC_SAMPLES 10000L
+
+struct McResult {
+    calc_real mean;
+    calc_real error;
+    long samples;
+};
+
+int mc_mean(const struct Fexpr *f, struct Rng *rng, int normal, calc_real a, calc_real b,
+            long samples, struct McResult *out);
+
+#endif
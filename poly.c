@@ -0,0 +1,332 @@
+#include "poly.h"
+
+#ifdef AMICALC_FLOAT32
+#define POLY_EPS REAL_C(1.2e-7)
+#define POLY_SNAP REAL_C(1e-3)
+#else
+#define POLY_EPS REAL_C(2.3e-16)
+#define POLY_SNAP REAL_C(1e-6)
+#endif
+
+/* The unit roundoff of double-double, for the bound on its Horner error. */
+#define POLY_EPS_DD REAL_C(4.9e-32)
+
+#define POLY_PI REAL_C(3.141592653589793)
+
+/* Per approximation: still moving, polished in double-double, or done. */
+#define ROOT_MOVING 0
+#define ROOT_POLISH 1
+#define ROOT_DONE 2
+
+static unsigned char converged[POLY_MAX_DEGREE];
+static calc_real last_step[POLY_MAX_DEGREE];
+
+static calc_real abs_real(calc_real value)
+{
+    return value < REAL_C(0.0) ? -value : value;
+}
+
+static calc_real cabs_real(calc_real re, calc_real im)
+{
+    calc_real r;
+
+    calc_math->sqrt_f(&r, re * re + im * im);
+    return r;
+}
+
+/* (ar + i ai) / (br + i bi), scaled by the larger part of b (Smith). */
+static void cdiv(calc_real ar, calc_real ai, calc_real br, calc_real bi, calc_real *re,
+                 calc_real *im)
+{
+    calc_real t;
+    calc_real d;
+
+    if (abs_real(br) >= abs_real(bi)) {
+        t = bi / br;
+        d = br + bi * t;
+        *re = (ar + ai * t) / d;
+        *im = (ai - ar * t) / d;
+    } else {
+        t = br / bi;
+        d = br * t + bi;
+        *re = (ar * t + ai) / d;
+        *im = (ai * t - ar) / d;
+    }
+}
+
+calc_real poly_eval(const calc_real *coef, int len, calc_real x)
+{
+    calc_real p = REAL_C(0.0);
+    int i;
+
+    for (i = 0; i < len; ++i) {
+        p = p * x + coef[i];
+    }
+    return p;
+}
+
+struct DDReal poly_eval_dd(const calc_real *coef, int len, struct DDReal x)
+{
+    struct DDReal p = dd_from_double(0.0);
+    int i;
+
+    for (i = 0; i < len; ++i) {
+        p = dd_add(dd_mul(p, x), dd_from_double((double)coef[i]));
+    }
+    return p;
+}
+
+/*
+ * The Newton step p(z) / p'(z) for the degree n polynomial c. For |z| > 1
+ * it comes from q(y) = y^n p(1 / y), y = 1 / z:
+ * p'(z) / p(z) = n y - y^2 q'(y) / q(y). Returns 0 where the step is
+ * undefined or meaningless: *noise is set when |p(z)| is within the
+ * rounding error bound of Horner's rule, 2 n eps sum |c_i| |z|^i, as it
+ * is at any root of an ill-conditioned polynomial. With dd set Horner
+ * runs in double-double, whose bound is smaller by eps, so the step
+ * still points at the root of the stored coefficients there.
+ */
+static int newton_step(const calc_real *c, int n, calc_real zr, calc_real zi, int dd,
+                       calc_real *sr, calc_real *si, int *noise)
+{
+    struct DDReal qpr = dd_from_double(0.0);
+    struct DDReal qpi = qpr;
+    struct DDReal qdr = qpr;
+    struct DDReal qdi = qpr;
+    struct DDReal qt;
+    calc_real pr = REAL_C(0.0);
+    calc_real pi = REAL_C(0.0);
+    calc_real dr = REAL_C(0.0);
+    calc_real di = REAL_C(0.0);
+    calc_real xr = zr;
+    calc_real xi = zi;
+    calc_real gr;
+    calc_real gi;
+    calc_real yr;
+    calc_real yi;
+    calc_real bound = REAL_C(0.0);
+    calc_real size;
+    calc_real t;
+    int reversed = zr * zr + zi * zi > REAL_C(1.0);
+    int i;
+
+    *noise = 0;
+    if (reversed) {
+        cdiv(REAL_C(1.0), REAL_C(0.0), zr, zi, &xr, &xi);
+    }
+    size = cabs_real(xr, xi);
+    for (i = 0; i <= n; ++i) {
+        calc_real a = reversed ? c[n - i] : c[i];
+
+        bound = bound * size + abs_real(a);
+        if (dd) {
+            qt = dd_add(dd_sub(dd_mul_d(qdr, (double)xr), dd_mul_d(qdi, (double)xi)), qpr);
+            qdi = dd_add(dd_add(dd_mul_d(qdr, (double)xi), dd_mul_d(qdi, (double)xr)), qpi);
+            qdr = qt;
+            qt = dd_sub(dd_mul_d(qpr, (double)xr), dd_mul_d(qpi, (double)xi));
+            qt = dd_add(qt, dd_from_double((double)a));
+            qpi = dd_add(dd_mul_d(qpr, (double)xi), dd_mul_d(qpi, (double)xr));
+            qpr = qt;
+            continue;
+        }
+        t = dr * xr - di * xi + pr;
+        di = dr * xi + di * xr + pi;
+        dr = t;
+        t = pr * xr - pi * xi + a;
+        pi = pr * xi + pi * xr;
+        pr = t;
+    }
+    if (dd) {
+        pr = (calc_real)qpr.hi;
+        pi = (calc_real)qpi.hi;
+        dr = (calc_real)qdr.hi;
+        di = (calc_real)qdi.hi;
+    }
+    if (cabs_real(pr, pi) <= REAL_C(2.0) * (calc_real)n * (dd ? POLY_EPS_DD : POLY_EPS) * bound) {
+        *noise = 1;
+        return 0;
+    }
+    if (!reversed) {
+        if (dr == REAL_C(0.0) && di == REAL_C(0.0)) {
+            return 0;
+        }
+        cdiv(pr, pi, dr, di, sr, si);
+        return 1;
+    }
+    /* g = q'/q, then p'/p = n y - y^2 g and the step is its reciprocal. */
+    cdiv(dr, di, pr, pi, &gr, &gi);
+    yr = xr * xr - xi * xi;
+    yi = REAL_C(2.0) * xr * xi;
+    dr = (calc_real)n * xr - (yr * gr - yi * gi);
+    di = (calc_real)n * xi - (yr * gi + yi * gr);
+    if (dr == REAL_C(0.0) && di == REAL_C(0.0)) {
+        return 0;
+    }
+    cdiv(REAL_C(1.0), REAL_C(0.0), dr, di, sr, si);
+    return 1;
+}
+
+/* Real roots first in ascending order, then complex ones by real part. */
+static int root_before(const struct PolyRoot *a, const struct PolyRoot *b)
+{
+    if ((a->im == REAL_C(0.0)) != (b->im == REAL_C(0.0))) {
+        return a->im == REAL_C(0.0);
+    }
+    if (a->re != b->re) {
+        return a->re < b->re;
+    }
+    return a->im < b->im;
+}
+
+int poly_roots(const calc_real *coef, int len, struct PolyRoot *roots, int *iterations)
+{
+    calc_real radius;
+    calc_real angle;
+    calc_real sr;
+    calc_real si;
+    calc_real ar;
+    calc_real ai;
+    calc_real wr;
+    calc_real wi;
+    calc_real br;
+    calc_real bi;
+    calc_real step;
+    int zeros = 0;
+    int ok;
+    int n;
+    int it;
+    int done;
+    int noise;
+    int i;
+    int j;
+
+    while (len > 0 && coef[0] == REAL_C(0.0)) {
+        ++coef;
+        --len;
+    }
+    if (len < 2 || len > POLY_MAX_DEGREE + 1) {
+        return -1;
+    }
+    /* Trailing zero coefficients are exact roots at 0. */
+    while (len > 1 && coef[len - 1] == REAL_C(0.0)) {
+        --len;
+        roots[zeros].re = REAL_C(0.0);
+        roots[zeros].im = REAL_C(0.0);
+        ++zeros;
+    }
+    n = len - 1;
+    *iterations = 0;
+    if (n == 0) {
+        return zeros;
+    }
+
+    /* Start on a circle whose radius is the geometric mean of the root sizes. */
+    calc_math->pow_f(&radius, abs_real(coef[n] / coef[0]), REAL_C(1.0) / (calc_real)n);
+    for (i = 0; i < n; ++i) {
+        angle = REAL_C(2.0) * POLY_PI * (calc_real)i / (calc_real)n + REAL_C(0.4);
+        calc_math->cos_f(&roots[zeros + i].re, angle);
+        calc_math->sin_f(&roots[zeros + i].im, angle);
+        roots[zeros + i].re *= radius;
+        roots[zeros + i].im *= radius;
+        converged[i] = ROOT_MOVING;
+        last_step[i] = radius;
+    }
+
+    done = 0;
+    for (it = 1; it <= POLY_MAX_ITER && !done; ++it) {
+        done = 1;
+        for (i = 0; i < n; ++i) {
+            struct PolyRoot *z = &roots[zeros + i];
+
+            if (converged[i] == ROOT_DONE) {
+                continue;
+            }
+            ok = newton_step(coef, n, z->re, z->im, converged[i] == ROOT_POLISH, &wr, &wi,
+                             &noise);
+            if (!ok && noise && converged[i] == ROOT_MOVING &&
+                last_step[i] > REAL_C(1024.0) * POLY_EPS * cabs_real(z->re, z->im)) {
+                /*
+                 * Horner ran out of digits while z was still moving, as
+                 * in a cluster of ill-conditioned roots: the steps go on
+                 * in double-double.
+                 */
+                converged[i] = ROOT_POLISH;
+                last_step[i] = cabs_real(z->re, z->im);
+                ok = newton_step(coef, n, z->re, z->im, 1, &wr, &wi, &noise);
+            }
+            if (!ok) {
+                if (noise) {
+                    converged[i] = ROOT_DONE;
+                    continue;
+                }
+                /* A critical point: nudge the approximation off it. */
+                z->re += radius * POLY_EPS * REAL_C(64.0);
+                z->im += radius * POLY_EPS * REAL_C(64.0);
+                done = 0;
+                continue;
+            }
+            /* Aberth: w / (1 - w * sum 1 / (z - z_j)). */
+            sr = REAL_C(0.0);
+            si = REAL_C(0.0);
+            for (j = 0; j < n; ++j) {
+                if (j != i) {
+                    cdiv(REAL_C(1.0), REAL_C(0.0), z->re - roots[zeros + j].re,
+                         z->im - roots[zeros + j].im, &ar, &ai);
+                    sr += ar;
+                    si += ai;
+                }
+            }
+            br = REAL_C(1.0) - (wr * sr - wi * si);
+            bi = -(wr * si + wi * sr);
+            cdiv(wr, wi, br, bi, &ar, &ai);
+            z->re -= ar;
+            z->im -= ai;
+            if (z->re - z->re != REAL_C(0.0) || z->im - z->im != REAL_C(0.0)) {
+                return -1;
+            }
+            step = cabs_real(ar, ai);
+            if (step <= REAL_C(4.0) * POLY_EPS * cabs_real(z->re, z->im)) {
+                converged[i] = ROOT_DONE;
+            } else if (converged[i] == ROOT_POLISH && step >= last_step[i] &&
+                       step <= REAL_C(1024.0) * POLY_EPS * cabs_real(z->re, z->im)) {
+                /* The corrections have stalled at the precision of z. */
+                converged[i] = ROOT_DONE;
+            } else {
+                last_step[i] = step;
+                done = 0;
+            }
+        }
+        *iterations = it;
+    }
+    if (!done) {
+        return -1;
+    }
+
+    for (i = zeros; i < zeros + n; ++i) {
+        calc_real re = roots[i].re;
+        calc_real im = roots[i].im;
+
+        /*
+         * Multiple real roots only converge to about eps^(1 / m) and keep
+         * a small imaginary part: it goes when p is at rounding level on
+         * the real axis. Real parts far below the imaginary one are noise.
+         */
+        if (abs_real(im) <= REAL_C(64.0) * POLY_EPS * abs_real(re) ||
+            (abs_real(im) <= POLY_SNAP * abs_real(re) &&
+             !newton_step(coef, n, re, REAL_C(0.0), 0, &wr, &wi, &noise) && noise)) {
+            roots[i].im = REAL_C(0.0);
+        } else if (abs_real(re) <= REAL_C(64.0) * POLY_EPS * abs_real(im)) {
+            roots[i].re = REAL_C(0.0);
+        }
+    }
+    n += zeros;
+    for (i = 1; i < n; ++i) {
+        struct PolyRoot r = roots[i];
+
+        for (j = i; j > 0 && root_before(&r, &roots[j - 1]); --j) {
+            roots[j] = roots[j - 1];
+        }
+        roots[j] = r;
+    }
+    return n;
+}
@@ -0,0 +1,36 @@
+#ifndef POLY_H
+#define POLY_H
+
+#include "calcmath.h"
+#include "ddreal.h"
+
+/*
+ * Polynomials as one contiguous array of len coefficients, leading first:
+ * coef[0] x^(len - 1) + ... + coef[len - 1]. poly_eval is plain Horner,
+ * poly_eval_dd runs Horner in double-double so the cancellation near a
+ * root does not eat the digits.
+ *
+ * poly_roots finds every root with the Aberth-Ehrlich iteration, which
+ * moves all approximations at once, each one Newton-corrected and pushed
+ * away from the others. Points outside the unit circle are evaluated on
+ * the reversed polynomial so high degrees do not overflow. A root whose
+ * residual sinks into the rounding noise while its step is still large
+ * (the clustered roots of Wilkinson's polynomial) is polished on with
+ * Horner in double-double until the step stops shrinking. The roots come
+ * back real ones first in ascending order, then complex ones by real
+ * part. The return value is the number of roots (the degree once leading
+ * zeros are dropped) or -1 when the iteration does not converge.
+ */
+#define POLY_MAX_DEGREE 1000
+#define POLY_MAX_ITER 200
+
+struct PolyRoot {
+    calc_real re;
+    calc_real im;
+};
+
+calc_real poly_eval(const calc_real *coef, int len, calc_real x);
+struct DDReal poly_eval_dd(const calc_real *coef, int len, struct DDReal x);
+int poly_roots(const calc_real *coef, int len, struct PolyRoot *roots, int *iterations);
+
+#endif
@@ -0,0 +1,187 @@
+#include <math.h>
+
+#include "power.h"
+
+/*
+ * How far 1/exponent may sit from an integer and still be taken as a
+ * root: results travel as display text, so 1/3 comes back as 0.333...
+ * rounded to CALC_REAL_DIGITS.
+ */
+#ifdef AMICALC_FLOAT32
+#define POW_UNIT_TOL REAL_C(1e-6)
+#define POW_EXACT_INT REAL_C(16777216.0)
+#else
+#define POW_UNIT_TOL REAL_C(1e-14)
+#define POW_EXACT_INT REAL_C(9007199254740992.0)
+#endif
+
+/*
+ * Each multiply of the squaring adds up to half an ulp, so beyond x^3 a
+ * fractional base drifts further than pow does (about n / 2 ulp at x^n).
+ * Integer bases stay exact while the power is below POW_EXACT_INT.
+ */
+#define POW_ROUNDED_MAX 3L
+
+/* base^n for 0 < n <= POW_SQUARING_MAX by repeated squaring. */
+static calc_real pow_squaring(calc_real base, long n)
+{
+    calc_real r = REAL_C(1.0);
+    int first = 1;
+
+    while (n > 0) {
+        if (n & 1L) {
+            if (first) {
+                r = base;
+                first = 0;
+            } else {
+                calc_math->mul(&r, r, base);
+            }
+        }
+        n >>= 1;
+        if (n > 0) {
+            calc_math->mul(&base, base, base);
+        }
+    }
+    return r;
+}
+
+static int is_small_int(calc_real value, long limit, long *out)
+{
+    long n;
+
+    if (value < (calc_real)-limit || value > (calc_real)limit) {
+        return 0;
+    }
+    n = (long)value;
+    if ((calc_real)n != value) {
+        return 0;
+    }
+    *out = n;
+    return 1;
+}
+
+/*
+ * |value|^(1/n) for n >= 2: the backend's pow as the estimate, then one
+ * Newton step on r^n = |value|. A value that is an integer and the n-th
+ * power of one comes out exact.
+ */
+static calc_real root_kernel(calc_real value, long n)
+{
+    calc_real r;
+    calc_real p;
+    calc_real d;
+    calc_real k;
+
+    if (value == REAL_C(0.0)) {
+        return value;
+    }
+    if (n == 2) {
+        calc_math->sqrt_f(&r, value);
+        return r;
+    }
+    calc_math->pow_f(&r, value, REAL_C(1.0) / (calc_real)n);
+    if (n <= POW_SQUARING_MAX) {
+        p = pow_squaring(r, n - 1);
+        d = (p * r - value) / ((calc_real)n * p);
+        /* Skip the step where r^n itself overflows. */
+        if (d - d == REAL_C(0.0)) {
+            r -= d;
+        }
+        if (value == (calc_real)floor((double)value)) {
+            k = (calc_real)floor((double)r + 0.5);
+            if (pow_squaring(k, n) == value) {
+                r = k;
+            }
+        }
+    }
+    return r;
+}
+
+int calc_root(calc_real value, calc_real degree, calc_real *out)
+{
+    long n;
+    int neg = 0;
+
+    if (degree == REAL_C(0.0)) {
+        return 0;
+    }
+    if (!is_small_int(degree, 0x7FFFFFFFL, &n)) {
+        if (value < REAL_C(0.0)) {
+            return 0;
+        }
+        calc_math->pow_f(out, value, REAL_C(1.0) / degree);
+        return *out == *out;
+    }
+    if (n < 0) {
+        if (value == REAL_C(0.0) || !calc_root(value, -degree, out)) {
+            return 0;
+        }
+        *out = REAL_C(1.0) / *out;
+        return 1;
+    }
+    if (value < REAL_C(0.0)) {
+        if ((n & 1L) == 0) {
+            return 0;
+        }
+        value = -value;
+        neg = 1;
+    }
+    *out = (n == 1) ? value : root_kernel(value, n);
+    if (neg) {
+        *out = -*out;
+    }
+    return 1;
+}
+
+int calc_pow(calc_real base, calc_real exponent, calc_real *out)
+{
+    calc_real q;
+    calc_real d;
+    long n;
+
+    if (exponent == REAL_C(0.0)) {
+        *out = REAL_C(1.0);
+        return 1;
+    }
+    if (is_small_int(exponent, POW_SQUARING_MAX, &n)) {
+        long m = (n < 0) ? -n : n;
+        calc_real p;
+
+        if (m <= POW_ROUNDED_MAX || base == (calc_real)floor((double)base)) {
+            p = pow_squaring(base, m);
+            if (m <= POW_ROUNDED_MAX || fabs((double)p) <= (double)POW_EXACT_INT) {
+                if (n > 0) {
+                    *out = p;
+                } else if (base == REAL_C(0.0)) {
+                    return 0;
+                } else {
+                    *out = REAL_C(1.0) / p;
+                }
+                return 1;
+            }
+        }
+        /* Not every backend's pow takes a negative base; the sign is n's parity. */
+        calc_math->pow_f(out, (calc_real)fabs((double)base), exponent);
+        if (base < REAL_C(0.0) && (n & 1L)) {
+            *out = -*out;
+        }
+        return *out == *out;
+    }
+    if (exponent == REAL_C(0.5)) {
+        return calc_root(base, REAL_C(2.0), out);
+    }
+    /* 1/n as typed or computed: take the root, which also covers odd roots of negatives. */
+    q = REAL_C(1.0) / exponent;
+    if (q > REAL_C(-2147483647.0) && q < REAL_C(2147483647.0)) {
+        n = (long)floor((double)q + 0.5);
+        d = q - (calc_real)n;
+        if ((n >= 2 || n <= -2) && fabs((double)d) <= fabs((double)n) * POW_UNIT_TOL) {
+            return calc_root(base, (calc_real)n, out);
+        }
+    }
+    if (base == REAL_C(0.0) && exponent < REAL_C(0.0)) {
+        return 0;
+    }
+    calc_math->pow_f(out, base, exponent);
+    return *out == *out;
+}
@@ -0,0 +1,21 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include "calcmath.h"
+
+/*
+ * x^y and the y-th root for compute_op. The exponent is classified
+ * first: small integers go through repeated squaring where it is exact
+ * or as close as pow (integer bases, exponents up to 3). 1/2 goes to the
+ * backend's sqrt; 1/3 and the other 1/n take the backend's pow of the
+ * absolute value, one Newton step, and the exact integer root when there
+ * is one. Only the rest reaches the backend's pow unchanged. Odd roots of negative values are real. Both return 0
+ * for results that are undefined (even roots of negatives, 0 to a
+ * negative power).
+ */
+#define POW_SQUARING_MAX 32
+
+int calc_pow(calc_real base, calc_real exponent, calc_real *out);
+int calc_root(calc_real value, calc_real degree, calc_real *out);
+
+#endif
@@ -0,0 +1,739 @@
+#include <string.h>
+
+#include "ratio.h"
+
+/*
+ * Products of two stored magnitudes need twice the limbs, sums one more.
+ * The wide temporaries are static: the calculator evaluates one operation
+ * at a time and they would not fit comfortably on a 4K task stack.
+ */
+#define RAT_WIDE (2 * RAT_LIMBS + 1)
+#define RAT_U64_LIMBS 4
+
+struct RatWide {
+    int neg;
+    long nlen;
+    long dlen;
+    bn_limb n[RAT_WIDE];
+    bn_limb d[RAT_WIDE];
+};
+
+static struct RatWide wide_lhs;
+static struct RatWide wide_rhs;
+static struct RatWide wide_out;
+static bn_limb gcd_u[RAT_WIDE];
+static bn_limb gcd_v[RAT_WIDE];
+static bn_limb gcd_g[RAT_WIDE];
+static bn_limb div_q[RAT_WIDE];
+static bn_limb div_r[RAT_WIDE];
+static bn_limb div_scratch[2 * RAT_WIDE + 1];
+static bn_limb sum_x[RAT_WIDE];
+static bn_limb sum_y[RAT_WIDE];
+
+static calc_uint mag_of(calc_int value)
+{
+    return (value < 0) ? (calc_uint)0 - (calc_uint)value : (calc_uint)value;
+}
+
+/*
+ * Binary GCD. Most operands of a calculator chain fit 32 bits, where the
+ * 68000 can shift and subtract in single instructions, so the loop drops
+ * to unsigned long as soon as both values allow it.
+ */
+static unsigned long gcd_u32(unsigned long u, unsigned long v)
+{
+    int shift = 0;
+    unsigned long t;
+
+    if (u == 0) {
+        return v;
+    }
+    if (v == 0) {
+        return u;
+    }
+    while (((u | v) & 1UL) == 0) {
+        u >>= 1;
+        v >>= 1;
+        shift++;
+    }
+    while ((u & 1UL) == 0) {
+        u >>= 1;
+    }
+    do {
+        while ((v & 1UL) == 0) {
+            v >>= 1;
+        }
+        if (u > v) {
+            t = v;
+            v = u;
+            u = t;
+        }
+        v -= u;
+    } while (v != 0);
+    return u << shift;
+}
+
+static calc_uint gcd_u64(calc_uint u, calc_uint v)
+{
+    int shift = 0;
+    calc_uint t;
+
+    if (u == 0) {
+        return v;
+    }
+    if (v == 0) {
+        return u;
+    }
+    while (((u | v) & 1) == 0) {
+        u >>= 1;
+        v >>= 1;
+        shift++;
+    }
+    while ((u & 1) == 0) {
+        u >>= 1;
+    }
+    do {
+        if ((u | v) <= 0xFFFFFFFFUL) {
+            return (calc_uint)gcd_u32((unsigned long)u, (unsigned long)v) << shift;
+        }
+        while ((v & 1) == 0) {
+            v >>= 1;
+        }
+        if (u > v) {
+            t = v;
+            v = u;
+            u = t;
+        }
+        v -= u;
+    } while (v != 0);
+    return u << shift;
+}
+
+/* Binary GCD on limbs; base 10000 is even, so parity is limb 0's. */
+static long gcd_big(bn_limb *g, const bn_limb *a, long alen, const bn_limb *b, long blen)
+{
+    bn_limb *u = gcd_u;
+    bn_limb *v = gcd_v;
+    bn_limb *t;
+    long ulen = alen;
+    long vlen = blen;
+    long tlen;
+    int shift = 0;
+
+    if (alen == 0) {
+        memcpy(g, b, (size_t)blen * sizeof(bn_limb));
+        return blen;
+    }
+    if (blen == 0) {
+        memcpy(g, a, (size_t)alen * sizeof(bn_limb));
+        return alen;
+    }
+    memcpy(u, a, (size_t)alen * sizeof(bn_limb));
+    memcpy(v, b, (size_t)blen * sizeof(bn_limb));
+    while (((u[0] | v[0]) & 1) == 0) {
+        ulen = bn_shr1(u, ulen);
+        vlen = bn_shr1(v, vlen);
+        shift++;
+    }
+    while ((u[0] & 1) == 0) {
+        ulen = bn_shr1(u, ulen);
+    }
+    do {
+        unsigned long long su;
+        unsigned long long sv;
+
+        if (ulen <= RAT_U64_LIMBS && vlen <= RAT_U64_LIMBS &&
+            bn_to_uint(u, ulen, &su) && bn_to_uint(v, vlen, &sv)) {
+            ulen = bn_from_uint(u, gcd_u64(su, sv));
+            break;
+        }
+        while ((v[0] & 1) == 0) {
+            vlen = bn_shr1(v, vlen);
+        }
+        if (bn_cmp(u, ulen, v, vlen) > 0) {
+            t = u;
+            u = v;
+            v = t;
+            tlen = ulen;
+            ulen = vlen;
+            vlen = tlen;
+        }
+        vlen = bn_sub(v, v, vlen, u, ulen);
+    } while (vlen != 0);
+
+    memcpy(g, u, (size_t)ulen * sizeof(bn_limb));
+    while (shift > 0) {
+        int step = (shift > 16) ? 16 : shift;
+
+        ulen = bn_mul_small(g, g, ulen, 1UL << step);
+        shift -= step;
+    }
+    return ulen;
+}
+
+static void wide_from_ratio(const struct Ratio *value, struct RatWide *w)
+{
+    if (value->big) {
+        w->neg = value->neg;
+        w->nlen = value->nlen;
+        w->dlen = value->dlen;
+        memcpy(w->n, value->n, (size_t)value->nlen * sizeof(bn_limb));
+        memcpy(w->d, value->d, (size_t)value->dlen * sizeof(bn_limb));
+        return;
+    }
+    w->neg = value->num < 0;
+    w->nlen = bn_from_uint(w->n, mag_of(value->num));
+    w->dlen = bn_from_uint(w->d, (calc_uint)value->den);
+}
+
+static void wide_reduce(struct RatWide *w)
+{
+    long glen;
+    long qlen;
+
+    if (w->nlen == 0) {
+        w->d[0] = 1;
+        w->dlen = 1;
+        return;
+    }
+    glen = gcd_big(gcd_g, w->n, w->nlen, w->d, w->dlen);
+    if (glen == 1 && gcd_g[0] == 1) {
+        return;
+    }
+    bn_divmod(div_q, &qlen, div_r, w->n, w->nlen, gcd_g, glen, div_scratch);
+    memcpy(w->n, div_q, (size_t)qlen * sizeof(bn_limb));
+    w->nlen = qlen;
+    bn_divmod(div_q, &qlen, div_r, w->d, w->dlen, gcd_g, glen, div_scratch);
+    memcpy(w->d, div_q, (size_t)qlen * sizeof(bn_limb));
+    w->dlen = qlen;
+}
+
+static int wide_to_small(const struct RatWide *w, struct Ratio *out)
+{
+    unsigned long long n;
+    unsigned long long d;
+
+    if (!bn_to_uint(w->n, w->nlen, &n) || !bn_to_uint(w->d, w->dlen, &d) ||
+        n > (calc_uint)CALC_INT_MAX || d > (calc_uint)CALC_INT_MAX) {
+        return 0;
+    }
+    out->big = 0;
+    out->num = w->neg ? -(calc_int)n : (calc_int)n;
+    out->den = (calc_int)d;
+    return 1;
+}
+
+/*
+ * Stores a wide result. Values that still fit 64 bits are kept as they
+ * are; only a result that would have to go big is reduced first, which
+ * is where the GCD pays for itself.
+ */
+static int wide_store(struct RatWide *w, struct Ratio *out, int reduced)
+{
+    if (w->nlen == 0) {
+        ratio_from_int(out, 0);
+        return 1;
+    }
+    if (wide_to_small(w, out)) {
+        return 1;
+    }
+    if (!reduced) {
+        wide_reduce(w);
+        if (wide_to_small(w, out)) {
+            return 1;
+        }
+    }
+    if (w->nlen > RAT_LIMBS || w->dlen > RAT_LIMBS) {
+        return 0;
+    }
+    out->big = 1;
+    out->neg = w->neg;
+    out->nlen = (short)w->nlen;
+    out->dlen = (short)w->dlen;
+    memcpy(out->n, w->n, (size_t)w->nlen * sizeof(bn_limb));
+    memcpy(out->d, w->d, (size_t)w->dlen * sizeof(bn_limb));
+    return 1;
+}
+
+/* Small-form helpers keep every magnitude at or below CALC_INT_MAX. */
+static int add_small(calc_int a, calc_int b, calc_int *out)
+{
+    if ((b > 0 && a > CALC_INT_MAX - b) || (b < 0 && a < -CALC_INT_MAX - b)) {
+        return 0;
+    }
+    *out = a + b;
+    return 1;
+}
+
+static int mul_small(calc_int a, calc_int b, calc_int *out)
+{
+    calc_uint ma = mag_of(a);
+    calc_uint mb = mag_of(b);
+
+    if (ma != 0 && mb > (calc_uint)CALC_INT_MAX / ma) {
+        return 0;
+    }
+    *out = a * b;
+    return 1;
+}
+
+void ratio_from_int(struct Ratio *out, calc_int value)
+{
+    if (value == CALC_INT_MIN) {
+        out->big = 1;
+        out->neg = 1;
+        out->nlen = (short)bn_from_uint(out->n, mag_of(value));
+        out->d[0] = 1;
+        out->dlen = 1;
+        return;
+    }
+    out->big = 0;
+    out->num = value;
+    out->den = 1;
+}
+
+int ratio_is_zero(const struct Ratio *value)
+{
+    return value->big ? value->nlen == 0 : value->num == 0;
+}
+
+int ratio_sign(const struct Ratio *value)
+{
+    if (ratio_is_zero(value)) {
+        return 0;
+    }
+    if (value->big) {
+        return value->neg ? -1 : 1;
+    }
+    return (value->num < 0) ? -1 : 1;
+}
+
+void ratio_neg(struct Ratio *value)
+{
+    if (value->big) {
+        value->neg = !value->neg && value->nlen != 0;
+    } else {
+        value->num = -value->num;
+    }
+}
+
+void ratio_reduce(struct Ratio *value)
+{
+    if (!value->big) {
+        calc_uint g = gcd_u64(mag_of(value->num), (calc_uint)value->den);
+
+        if (g > 1) {
+            value->num /= (calc_int)g;
+            value->den /= (calc_int)g;
+        }
+        return;
+    }
+    wide_from_ratio(value, &wide_out);
+    wide_reduce(&wide_out);
+    wide_store(&wide_out, value, 1);
+}
+
+int ratio_to_int(const struct Ratio *value, calc_int *out)
+{
+    if (value->big || value->num % value->den != 0) {
+        return 0;
+    }
+    *out = value->num / value->den;
+    return 1;
+}
+
+static int wide_add(int negate_rhs, struct Ratio *out)
+{
+    struct RatWide *a = &wide_lhs;
+    struct RatWide *b = &wide_rhs;
+    struct RatWide *w = &wide_out;
+    const bn_limb *x = a->n;
+    const bn_limb *y = b->n;
+    long xlen = a->nlen;
+    long ylen = b->nlen;
+    int bneg = negate_rhs ? !b->neg : b->neg;
+
+    if (bn_cmp(a->d, a->dlen, b->d, b->dlen) == 0) {
+        memcpy(w->d, a->d, (size_t)a->dlen * sizeof(bn_limb));
+        w->dlen = a->dlen;
+    } else {
+        xlen = bn_mul(sum_x, a->n, a->nlen, b->d, b->dlen);
+        ylen = bn_mul(sum_y, b->n, b->nlen, a->d, a->dlen);
+        x = sum_x;
+        y = sum_y;
+        w->dlen = bn_mul(w->d, a->d, a->dlen, b->d, b->dlen);
+    }
+    if (a->neg == bneg) {
+        w->nlen = bn_add(w->n, x, xlen, y, ylen);
+        w->neg = a->neg;
+    } else if (bn_cmp(x, xlen, y, ylen) >= 0) {
+        w->nlen = bn_sub(w->n, x, xlen, y, ylen);
+        w->neg = a->neg;
+    } else {
+        w->nlen = bn_sub(w->n, y, ylen, x, xlen);
+        w->neg = bneg;
+    }
+    if (w->nlen == 0) {
+        w->neg = 0;
+    }
+    return wide_store(w, out, 0);
+}
+
+static int add_sub(const struct Ratio *lhs, const struct Ratio *rhs, int negate_rhs,
+                   struct Ratio *out)
+{
+    if (!lhs->big && !rhs->big) {
+        calc_int a = lhs->num;
+        calc_int b = lhs->den;
+        calc_int c = negate_rhs ? -rhs->num : rhs->num;
+        calc_int d = rhs->den;
+        calc_int x;
+        calc_int y;
+        calc_int den;
+
+        if (b == d) {
+            if (add_small(a, c, &x)) {
+                out->big = 0;
+                out->num = x;
+                out->den = b;
+                return 1;
+            }
+        } else {
+            /* Unreduced first; with the denominators' GCD on overflow. */
+            if (mul_small(a, d, &x) && mul_small(c, b, &y) && add_small(x, y, &x) &&
+                mul_small(b, d, &den)) {
+                out->big = 0;
+                out->num = x;
+                out->den = den;
+                return 1;
+            } else {
+                calc_int g = (calc_int)gcd_u64((calc_uint)b, (calc_uint)d);
+
+                if (g > 1 && mul_small(a, d / g, &x) && mul_small(c, b / g, &y) &&
+                    add_small(x, y, &x) && mul_small(b, d / g, &den)) {
+                    out->big = 0;
+                    out->num = x;
+                    out->den = den;
+                    return 1;
+                }
+            }
+        }
+    }
+    wide_from_ratio(lhs, &wide_lhs);
+    wide_from_ratio(rhs, &wide_rhs);
+    return wide_add(negate_rhs, out);
+}
+
+int ratio_add(const struct Ratio *lhs, const struct Ratio *rhs, struct Ratio *out)
+{
+    return add_sub(lhs, rhs, 0, out);
+}
+
+int ratio_sub(const struct Ratio *lhs, const struct Ratio *rhs, struct Ratio *out)
+{
+    return add_sub(lhs, rhs, 1, out);
+}
+
+static int wide_mul(struct Ratio *out)
+{
+    struct RatWide *w = &wide_out;
+
+    w->neg = wide_lhs.neg != wide_rhs.neg;
+    w->nlen = bn_mul(w->n, wide_lhs.n, wide_lhs.nlen, wide_rhs.n, wide_rhs.nlen);
+    w->dlen = bn_mul(w->d, wide_lhs.d, wide_lhs.dlen, wide_rhs.d, wide_rhs.dlen);
+    if (w->nlen == 0) {
+        w->neg = 0;
+    }
+    return wide_store(w, out, 0);
+}
+
+int ratio_mul(const struct Ratio *lhs, const struct Ratio *rhs, struct Ratio *out)
+{
+    if (!lhs->big && !rhs->big) {
+        calc_int a = lhs->num;
+        calc_int b = lhs->den;
+        calc_int c = rhs->num;
+        calc_int d = rhs->den;
+        calc_int n;
+        calc_int den;
+
+        if (mul_small(a, c, &n) && mul_small(b, d, &den)) {
+            out->big = 0;
+            out->num = n;
+            out->den = den;
+            return 1;
+        } else {
+            /* Cross-cancel, then retry before going big. */
+            calc_int g1 = (calc_int)gcd_u64(mag_of(a), (calc_uint)d);
+            calc_int g2 = (calc_int)gcd_u64(mag_of(c), (calc_uint)b);
+
+            if (g1 > 1) {
+                a /= g1;
+                d /= g1;
+            }
+            if (g2 > 1) {
+                c /= g2;
+                b /= g2;
+            }
+        }
+        if (mul_small(a, c, &n) && mul_small(b, d, &den)) {
+            out->big = 0;
+            out->num = n;
+            out->den = den;
+            return 1;
+        }
+    }
+    wide_from_ratio(lhs, &wide_lhs);
+    wide_from_ratio(rhs, &wide_rhs);
+    return wide_mul(out);
+}
+
+int ratio_div(const struct Ratio *lhs, const struct Ratio *rhs, struct Ratio *out)
+{
+    struct Ratio inv;
+
+    if (ratio_is_zero(rhs)) {
+        return 0;
+    }
+    if (!rhs->big) {
+        inv.big = 0;
+        inv.num = (rhs->num < 0) ? -rhs->den : rhs->den;
+        inv.den = (rhs->num < 0) ? -rhs->num : rhs->num;
+        return ratio_mul(lhs, &inv, out);
+    }
+    wide_from_ratio(lhs, &wide_lhs);
+    wide_from_ratio(rhs, &wide_out);
+    wide_rhs.neg = wide_out.neg;
+    wide_rhs.nlen = wide_out.dlen;
+    wide_rhs.dlen = wide_out.nlen;
+    memcpy(wide_rhs.n, wide_out.d, (size_t)wide_out.dlen * sizeof(bn_limb));
+    memcpy(wide_rhs.d, wide_out.n, (size_t)wide_out.nlen * sizeof(bn_limb));
+    return wide_mul(out);
+}
+
+int ratio_pow_int(const struct Ratio *base, long exponent, struct Ratio *out)
+{
+    struct Ratio result;
+    struct Ratio square;
+    unsigned long e;
+
+    if (exponent < 0) {
+        struct Ratio one;
+
+        ratio_from_int(&one, 1);
+        if (!ratio_div(&one, base, &square)) {
+            return 0;
+        }
+        e = (unsigned long)0 - (unsigned long)exponent;
+    } else {
+        square = *base;
+        e = (unsigned long)exponent;
+    }
+    ratio_from_int(&result, 1);
+    while (e != 0) {
+        if ((e & 1UL) && !ratio_mul(&result, &square, &result)) {
+            return 0;
+        }
+        e >>= 1;
+        if (e != 0 && !ratio_mul(&square, &square, &square)) {
+            return 0;
+        }
+    }
+    *out = result;
+    return 1;
+}
+
+static long wide_scale10(bn_limb *a, long alen, long count)
+{
+    while (count >= BN_DIGITS) {
+        if (alen == 0) {
+            return 0;
+        }
+        if (alen >= RAT_WIDE) {
+            return -1;
+        }
+        memmove(a + 1, a, (size_t)alen * sizeof(bn_limb));
+        a[0] = 0;
+        alen++;
+        count -= BN_DIGITS;
+    }
+    while (count-- > 0) {
+        if (alen >= RAT_WIDE) {
+            return -1;
+        }
+        alen = bn_mul_small(a, a, alen, 10);
+    }
+    return alen;
+}
+
+static const char *parse_digits(const char *p, bn_limb *a, long *alen, long *count)
+{
+    while (*p >= '0' && *p <= '9') {
+        bn_limb digit = (bn_limb)(*p - '0');
+
+        if (*alen >= RAT_WIDE - 1) {
+            return NULL;
+        }
+        *alen = bn_mul_small(a, a, *alen, 10);
+        *alen = bn_add(a, a, *alen, &digit, digit ? 1 : 0);
+        (*count)++;
+        ++p;
+    }
+    return p;
+}
+
+/*
+ * Accepts the calculator's own entry syntax ([-]digits[.digits][e[-]digits])
+ * and the n/d form that results are displayed in.
+ */
+int ratio_from_string(const char *text, struct Ratio *out)
+{
+    struct RatWide *w = &wide_out;
+    const char *p = text;
+    long count = 0;
+    long frac = 0;
+    long exp10 = 0;
+    int exp_neg = 0;
+
+    w->neg = 0;
+    w->nlen = 0;
+    w->d[0] = 1;
+    w->dlen = 1;
+    if (*p == '-') {
+        w->neg = 1;
+        ++p;
+    }
+    p = parse_digits(p, w->n, &w->nlen, &count);
+    if (!p) {
+        return 0;
+    }
+    if (*p == '/') {
+        long dcount = 0;
+
+        w->dlen = 0;
+        p = parse_digits(p + 1, w->d, &w->dlen, &dcount);
+        if (!p || *p != '\0' || count == 0 || w->dlen == 0) {
+            return 0;
+        }
+        if (w->nlen == 0) {
+            w->neg = 0;
+        }
+        return wide_store(w, out, 0);
+    }
+    if (*p == '.') {
+        long before = count;
+
+        p = parse_digits(p + 1, w->n, &w->nlen, &count);
+        if (!p) {
+            return 0;
+        }
+        frac = count - before;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (*p == 'e' || *p == 'E') {
+        ++p;
+        if (*p == '-' || *p == '+') {
+            exp_neg = (*p == '-');
+            ++p;
+        }
+        while (*p >= '0' && *p <= '9') {
+            exp10 = exp10 * 10 + (*p - '0');
+            if (exp10 > RAT_WIDE * BN_DIGITS) {
+                return 0;
+            }
+            ++p;
+        }
+    }
+    if (*p != '\0') {
+        return 0;
+    }
+    exp10 = (exp_neg ? -exp10 : exp10) - frac;
+    if (exp10 > 0) {
+        w->nlen = wide_scale10(w->n, w->nlen, exp10);
+    } else if (exp10 < 0) {
+        w->dlen = wide_scale10(w->d, w->dlen, -exp10);
+    }
+    if (w->nlen < 0 || w->dlen < 0) {
+        return 0;
+    }
+    if (w->nlen == 0) {
+        w->neg = 0;
+    }
+    return wide_store(w, out, 0);
+}
+
+static int format_uint(calc_uint value, char *out)
+{
+    char digits[24];
+    int len = 0;
+    int i = 0;
+
+    do {
+        digits[len++] = (char)('0' + (int)(value % 10));
+        value /= 10;
+    } while (value != 0);
+    while (len > 0) {
+        out[i++] = digits[--len];
+    }
+    out[i] = '\0';
+    return i;
+}
+
+/*
+ * Writes the reduced value as n/d (or n when the denominator is 1).
+ * Returns 0 without touching out if the text needs more than max_len
+ * characters.
+ */
+int ratio_format(struct Ratio *value, char *out, int max_len)
+{
+    char text[2 * RAT_LIMBS * BN_DIGITS + 4];
+    char *p = text;
+
+    ratio_reduce(value);
+    if (ratio_sign(value) < 0) {
+        *p++ = '-';
+    }
+    if (!value->big) {
+        p += format_uint(mag_of(value->num), p);
+        if (value->den != 1) {
+            *p++ = '/';
+            p += format_uint((calc_uint)value->den, p);
+        }
+    } else {
+        p += bn_to_string(p, value->n, value->nlen);
+        if (value->dlen != 1 || value->d[0] != 1) {
+            *p++ = '/';
+            p += bn_to_string(p, value->d, value->dlen);
+        }
+    }
+    *p = '\0';
+    if ((int)(p - text) > max_len) {
+        return 0;
+    }
+    strcpy(out, text);
+    return 1;
+}
+
+static struct DDReal limbs_to_dd(const bn_limb *a, long alen)
+{
+    struct DDReal acc = dd_from_double(0.0);
+    long i;
+
+    for (i = alen - 1; i >= 0; --i) {
+        acc = dd_add(dd_mul_d(acc, (double)BN_BASE), dd_from_double((double)a[i]));
+    }
+    return acc;
+}
+
+struct DDReal ratio_to_dd(const struct Ratio *value)
+{
+    struct DDReal n;
+
+    if (!value->big) {
+        return dd_div(dd_from_int(value->num), dd_from_int(value->den));
+    }
+    n = dd_div(limbs_to_dd(value->n, value->nlen), limbs_to_dd(value->d, value->dlen));
+    return value->neg ? dd_neg(n) : n;
+}
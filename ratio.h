@@ -0,0 +1,45 @@
+#ifndef RATIO_H
+#define RATIO_H
+
+#include "calcmath.h"
+#include "bignum.h"
+#include "ddreal.h"
+
+/*
+ * Exact rationals. Small values keep a calc_int numerator and a positive
+ * denominator; an overflow promotes the value to big magnitudes of at most
+ * RAT_LIMBS limbs with the sign in neg. Reduction is lazy: operations only
+ * run the GCD when a result would not fit otherwise, ratio_reduce does it
+ * on demand (before display).
+ */
+#define RAT_LIMBS 32
+
+struct Ratio {
+    int big;
+    calc_int num;
+    calc_int den;
+    int neg;
+    short nlen;
+    short dlen;
+    bn_limb n[RAT_LIMBS];
+    bn_limb d[RAT_LIMBS];
+};
+
+void ratio_from_int(struct Ratio *out, calc_int value);
+int ratio_from_string(const char *text, struct Ratio *out);
+int ratio_format(struct Ratio *value, char *out, int max_len);
+struct DDReal ratio_to_dd(const struct Ratio *value);
+int ratio_to_int(const struct Ratio *value, calc_int *out);
+
+int ratio_is_zero(const struct Ratio *value);
+int ratio_sign(const struct Ratio *value);
+void ratio_neg(struct Ratio *value);
+void ratio_reduce(struct Ratio *value);
+
+int ratio_add(const struct Ratio *lhs, const struct Ratio *rhs, struct Ratio *out);
+int ratio_sub(const struct Ratio *lhs, const struct Ratio *rhs, struct Ratio *out);
+int ratio_mul(const struct Ratio *lhs, const struct Ratio *rhs, struct Ratio *out);
+int ratio_div(const struct Ratio *lhs, const struct Ratio *rhs, struct Ratio *out);
+int ratio_pow_int(const struct Ratio *base, long exponent, struct Ratio *out);
+
+#endif
@@ -0,0 +1,189 @@
+#include "rng.h"
+
+#define RNG_MASK 0xFFFFFFFFUL
+#define RNG_SIGN 0x80000000UL
+
+/* Ziggurat: rightmost layer edge and the common area of the 128 layers. */
+#define ZIG_R 3.442619855899
+#define ZIG_V 9.91256303526217e-3
+#define ZIG_M 2147483648.0
+
+static unsigned long zig_k[128];
+static calc_real zig_w[128];
+static calc_real zig_f[128];
+static int zig_ready = 0;
+
+static unsigned long rotl(unsigned long x, int k)
+{
+    return ((x << k) | (x >> (32 - k))) & RNG_MASK;
+}
+
+/* splitmix32 steps, so nearby seeds still give unrelated states. */
+void rng_seed(struct Rng *r, unsigned long seed)
+{
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        unsigned long z;
+
+        seed = (seed + 0x9E3779B9UL) & RNG_MASK;
+        z = seed;
+        z = ((z ^ (z >> 16)) * 0x85EBCA6BUL) & RNG_MASK;
+        z = ((z ^ (z >> 13)) * 0xC2B2AE35UL) & RNG_MASK;
+        r->s[i] = z ^ (z >> 16);
+    }
+    if ((r->s[0] | r->s[1] | r->s[2] | r->s[3]) == 0) {
+        r->s[0] = 1;
+    }
+}
+
+unsigned long rng_next(struct Rng *r)
+{
+    unsigned long *s = r->s;
+    unsigned long x = ((s[1] << 2) + s[1]) & RNG_MASK;
+    unsigned long result;
+    unsigned long t = (s[1] << 9) & RNG_MASK;
+
+    x = rotl(x, 7);
+    result = ((x << 3) + x) & RNG_MASK;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+    return result;
+}
+
+void rng_jump(struct Rng *r)
+{
+    static const unsigned long jump[4] = {
+        0x8764000BUL, 0xF542D2D3UL, 0x6FA035C3UL, 0x77F2DB5BUL
+    };
+    unsigned long t[4] = {0, 0, 0, 0};
+    int i;
+    int b;
+
+    for (i = 0; i < 4; ++i) {
+        for (b = 0; b < 32; ++b) {
+            if (jump[i] & (1UL << b)) {
+                t[0] ^= r->s[0];
+                t[1] ^= r->s[1];
+                t[2] ^= r->s[2];
+                t[3] ^= r->s[3];
+            }
+            rng_next(r);
+        }
+    }
+    for (i = 0; i < 4; ++i) {
+        r->s[i] = t[i];
+    }
+}
+
+calc_real rng_uniform(struct Rng *r)
+{
+#ifdef AMICALC_FLOAT32
+    return (calc_real)(rng_next(r) >> 8) * REAL_C(5.9604644775390625e-8);
+#else
+    unsigned long a = rng_next(r) >> 5;
+    unsigned long b = rng_next(r) >> 6;
+
+    return ((calc_real)a * 67108864.0 + (calc_real)b) * 1.1102230246251565e-16;
+#endif
+}
+
+/* Uniform in (0, 1), for the logarithms of the tail. */
+static calc_real open_uniform(struct Rng *r)
+{
+    return ((calc_real)(rng_next(r) >> 8) + REAL_C(0.5)) * REAL_C(5.9604644775390625e-8);
+}
+
+void rng_uniform_many(struct Rng *r, calc_real *out, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        out[i] = rng_uniform(r);
+    }
+}
+
+/* Layer edges from the top of the curve down (Marsaglia and Tsang). */
+static void zig_setup(void)
+{
+    calc_real dn = (calc_real)ZIG_R;
+    calc_real tn = dn;
+    calc_real e;
+    calc_real q;
+    calc_real l;
+    int i;
+
+    calc_math->exp_f(&e, REAL_C(-0.5) * dn * dn);
+    q = (calc_real)ZIG_V / e;
+    zig_k[0] = (unsigned long)(dn / q * (calc_real)ZIG_M);
+    zig_k[1] = 0;
+    zig_w[0] = q / (calc_real)ZIG_M;
+    zig_w[127] = dn / (calc_real)ZIG_M;
+    zig_f[0] = REAL_C(1.0);
+    zig_f[127] = e;
+    for (i = 126; i >= 1; --i) {
+        calc_math->exp_f(&e, REAL_C(-0.5) * dn * dn);
+        calc_math->log_f(&l, (calc_real)ZIG_V / dn + e);
+        calc_math->sqrt_f(&dn, REAL_C(-2.0) * l);
+        zig_k[i + 1] = (unsigned long)(dn / tn * (calc_real)ZIG_M);
+        tn = dn;
+        calc_math->exp_f(&zig_f[i], REAL_C(-0.5) * dn * dn);
+        zig_w[i] = dn / (calc_real)ZIG_M;
+    }
+    zig_ready = 1;
+}
+
+/*
+ * One 32-bit draw picks the layer (low 7 bits) and a signed position in
+ * it. Inside the layer's rectangle under the curve the value is final;
+ * otherwise the wedge is tested against the density, and layer 0 falls
+ * back to Marsaglia's exponential sampling of the tail beyond ZIG_R.
+ */
+calc_real rng_normal(struct Rng *r)
+{
+    for (;;) {
+        unsigned long u = rng_next(r);
+        int iz = (int)(u & 127);
+        int neg = (u & RNG_SIGN) != 0;
+        unsigned long mag = neg ? ((~u + 1) & RNG_MASK) : u;
+        calc_real x = (calc_real)mag * zig_w[iz];
+        calc_real e;
+
+        if (!zig_ready) {
+            zig_setup();
+            continue;
+        }
+        if (mag < zig_k[iz]) {
+            return neg ? -x : x;
+        }
+        if (iz == 0) {
+            calc_real y;
+
+            do {
+                calc_math->log_f(&x, open_uniform(r));
+                x *= REAL_C(-1.0) / (calc_real)ZIG_R;
+                calc_math->log_f(&y, open_uniform(r));
+                y = -y;
+            } while (y + y < x * x);
+            x += (calc_real)ZIG_R;
+            return neg ? -x : x;
+        }
+        calc_math->exp_f(&e, REAL_C(-0.5) * x * x);
+        if (zig_f[iz] + open_uniform(r) * (zig_f[iz - 1] - zig_f[iz]) < e) {
+            return neg ? -x : x;
+        }
+    }
+}
+
+void rng_normal_many(struct Rng *r, calc_real *out, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        out[i] = rng_normal(r);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include "calcmath.h"
+
+/*
+ * xoshiro128** pseudo-random numbers: 128 bits of state, period 2^128 - 1,
+ * and only 32-bit shifts, rotations, xors and multiplications by 5 and 9,
+ * which the 68000 does without a library call. The words are kept in
+ * unsigned long and masked, so the host build's 64-bit longs give the same
+ * sequence. rng_jump advances a generator by 2^64 steps: a copy of a
+ * generator that is then jumped is an independent stream.
+ *
+ * rng_uniform is uniform in [0, 1) with the full mantissa of calc_real,
+ * rng_normal a standard normal variate from the 128-layer ziggurat, which
+ * needs one 32-bit draw and a multiplication for 98.8% of its results.
+ * The _many versions fill an array.
+ */
+struct Rng {
+    unsigned long s[4];
+};
+
+void rng_seed(struct Rng *r, unsigned long seed);
+unsigned long rng_next(struct Rng *r);
+void rng_jump(struct Rng *r);
+
+calc_real rng_uniform(struct Rng *r);
+calc_real rng_normal(struct Rng *r);
+void rng_uniform_many(struct Rng *r, calc_real *out, int n);
+void rng_normal_many(struct Rng *r, calc_real *out, int n);
+
+#endif
@@ -0,0 +1,296 @@
+#include <math.h>
+
+#include "series.h"
+
+#ifdef AMICALC_FLOAT32
+#define SERIES_EPS REAL_C(1.2e-7)
+#define SERIES_LEVIN_LOOSE REAL_C(1e-4)
+#else
+#define SERIES_EPS REAL_C(2.3e-16)
+#define SERIES_LEVIN_LOOSE REAL_C(1e-8)
+#endif
+
+/* Consecutive negligible tails before a direct sum counts as converged. */
+#define SERIES_QUIET 3
+
+/* Neumaier's variant of Kahan summation: sum + comp is the exact total. */
+struct Compensated {
+    calc_real sum;
+    calc_real comp;
+};
+
+static calc_real abs_real(calc_real value)
+{
+    return value < REAL_C(0.0) ? -value : value;
+}
+
+static int finite_real(calc_real value)
+{
+    return value - value == REAL_C(0.0);
+}
+
+static void comp_add(struct Compensated *acc, calc_real t)
+{
+    calc_real s = acc->sum + t;
+
+    if (abs_real(acc->sum) >= abs_real(t)) {
+        acc->comp += (acc->sum - s) + t;
+    } else {
+        acc->comp += (t - s) + acc->sum;
+    }
+    acc->sum = s;
+}
+
+/* Terms first .. first + count - 1, count at most FEXPR_BATCH. */
+static int eval_terms(const struct Fexpr *f, long first, int count, calc_real *y)
+{
+    calc_real x[FEXPR_BATCH];
+    int j;
+
+    for (j = 0; j < count; ++j) {
+        x[j] = (calc_real)(first + j);
+    }
+    return fexpr_eval_many(f, x, count, y);
+}
+
+int series_range(const struct Fexpr *f, int product, long first, long last,
+                 struct SeriesResult *out)
+{
+    struct Compensated acc;
+    calc_real y[FEXPR_BATCH];
+    double mant = 1.0;
+    long scale = 0;
+    long n;
+    int count;
+    int e;
+    int j;
+
+    if (last < first || last - first >= SERIES_MAX_TERMS) {
+        return 0;
+    }
+    acc.sum = REAL_C(0.0);
+    acc.comp = REAL_C(0.0);
+    for (n = first; n <= last; n += count) {
+        count = last - n + 1 < FEXPR_BATCH ? (int)(last - n + 1) : FEXPR_BATCH;
+        if (!eval_terms(f, n, count, y)) {
+            return 0;
+        }
+        for (j = 0; j < count; ++j) {
+            if (product) {
+                /* Keep the mantissa in [0.5, 1) so long products cannot overflow early. */
+                mant = frexp(mant * (double)y[j], &e);
+                scale += e;
+            } else {
+                comp_add(&acc, y[j]);
+            }
+        }
+    }
+    if (product) {
+        if (mant == 0.0) {
+            out->value = REAL_C(0.0);
+        } else if (scale > 4096 || scale < -4096) {
+            return 0;
+        } else {
+            out->value = (calc_real)ldexp(mant, (int)scale);
+        }
+    } else {
+        out->value = acc.sum + acc.comp;
+    }
+    out->stop = SERIES_RANGE;
+    out->terms = last - first + 1;
+    out->digits = 0;
+    return finite_real(out->value);
+}
+
+/*
+ * Levin u-transform of the partial sums s[0 .. k] with remainder
+ * estimates w[j] = (j + 1) * a[j]:
+ *
+ *   sum_j (-1)^j C(k, j) ((j + 1) / (k + 1))^(k - 1) s[j] / w[j]
+ *   ------------------------------------------------------------
+ *   sum_j (-1)^j C(k, j) ((j + 1) / (k + 1))^(k - 1) / w[j]
+ */
+static int levin(const calc_real *s, const calc_real *w, int k, calc_real *out)
+{
+    calc_real num = REAL_C(0.0);
+    calc_real den = REAL_C(0.0);
+    calc_real binom = REAL_C(1.0);
+    calc_real c;
+    int j;
+
+    for (j = 0; j <= k; ++j) {
+        calc_math->pow_f(&c, (calc_real)(j + 1) / (calc_real)(k + 1), (calc_real)(k - 1));
+        c *= binom / w[j];
+        if (j & 1) {
+            c = -c;
+        }
+        num += c * s[j];
+        den += c;
+        binom = binom * (calc_real)(k - j) / (calc_real)(j + 1);
+    }
+    if (den == REAL_C(0.0)) {
+        return 0;
+    }
+    *out = num / den;
+    return finite_real(*out);
+}
+
+/*
+ * While every term has had the same sign the limit lies beyond the
+ * partial sum; a Levin estimate on the near side of it (the zeta values
+ * Levin finds for divergent p-series) is no limit at all.
+ */
+static int plausible(int sign, calc_real est, calc_real total)
+{
+    calc_real slack = REAL_C(16.0) * SERIES_EPS * abs_real(total);
+
+    return sign == 0 || (sign > 0 ? est >= total - slack : est <= total + slack);
+}
+
+/* The significant digits on which estimates diff apart agree, rounded down. */
+static int agreed_digits(calc_real diff, calc_real value)
+{
+    double rel = (double)diff / fabs((double)value);
+    int digits = (int)floor(-log10(rel));
+
+    return digits < 1 ? 1 : (digits > CALC_REAL_DIGITS ? CALC_REAL_DIGITS : digits);
+}
+
+static void finish(int product, int negative, calc_real value, struct SeriesResult *out)
+{
+    if (product) {
+        calc_math->exp_f(&value, value);
+        if (negative) {
+            value = -value;
+        }
+    }
+    out->value = value;
+}
+
+int series_to_limit(const struct Fexpr *f, int product, long first, struct SeriesResult *out)
+{
+    static calc_real s[SERIES_LEVIN_MAX];
+    static calc_real w[SERIES_LEVIN_MAX];
+    struct Compensated acc;
+    calc_real y[FEXPR_BATCH];
+    calc_real t;
+    calc_real last = REAL_C(0.0);
+    calc_real ratio;
+    calc_real total;
+    calc_real est;
+    calc_real prev = REAL_C(0.0);
+    calc_real best = REAL_C(0.0);
+    calc_real best_diff = REAL_C(-1.0);
+    calc_real diff;
+    int use_levin = 1;
+    int sign = 0;
+    int negative = 0;
+    int quiet = 0;
+    long k = 0;
+    int j;
+
+    acc.sum = REAL_C(0.0);
+    acc.comp = REAL_C(0.0);
+    while (k < SERIES_MAX_TERMS) {
+        if (!eval_terms(f, first + k, FEXPR_BATCH, y)) {
+            return 0;
+        }
+        for (j = 0; j < FEXPR_BATCH; ++j, ++k) {
+            t = y[j];
+            if (product) {
+                if (t == REAL_C(0.0)) {
+                    out->value = REAL_C(0.0);
+                    out->stop = SERIES_DIRECT;
+                    out->terms = k + 1;
+                    out->digits = 0;
+                    return 1;
+                }
+                if (t < REAL_C(0.0)) {
+                    negative = !negative;
+                    use_levin = 0;
+                    t = -t;
+                }
+                calc_math->log_f(&t, t);
+            }
+            comp_add(&acc, t);
+            total = acc.sum + acc.comp;
+            /* 1 or -1 while all terms so far share that sign, 0 once they differ. */
+            if (k == 0) {
+                sign = t > REAL_C(0.0) ? 1 : (t < REAL_C(0.0) ? -1 : 0);
+            } else if ((t > REAL_C(0.0) && sign < 0) || (t < REAL_C(0.0) && sign > 0)) {
+                sign = 0;
+            }
+
+            if (use_levin && k < SERIES_LEVIN_MAX) {
+                if (t == REAL_C(0.0)) {
+                    use_levin = 0;
+                } else {
+                    s[k] = total;
+                    w[k] = (calc_real)(k + 1) * t;
+                    if (k >= 1 && levin(s, w, (int)k, &est) && plausible(sign, est, total)) {
+                        if (k >= 2) {
+                            diff = abs_real(est - prev);
+                            if (diff <= REAL_C(16.0) * SERIES_EPS * abs_real(est)) {
+                                finish(product, negative, est, out);
+                                out->stop = SERIES_LEVIN;
+                                out->terms = k + 1;
+                                out->digits = 0;
+                                return 1;
+                            }
+                            if (best_diff < REAL_C(0.0) || diff < best_diff) {
+                                best_diff = diff;
+                                best = est;
+                            }
+                        }
+                        prev = est;
+                    }
+                    /*
+                     * Later estimates only lose digits to cancellation. On
+                     * logarithmic series the best ones settle near 1e-10;
+                     * while that is below the size of the current term, it
+                     * is closer than the raw sum will get for a long time.
+                     * It is only good to the digits those estimates agree
+                     * on, less one, so digits says how many to show.
+                     */
+                    if (k == SERIES_LEVIN_MAX - 1 && best_diff >= REAL_C(0.0) &&
+                        best_diff <= SERIES_LEVIN_LOOSE * abs_real(best) &&
+                        best_diff < abs_real(t)) {
+                        finish(product, negative, best, out);
+                        out->stop = SERIES_LEVIN;
+                        out->terms = k + 1;
+                        out->digits = agreed_digits(best_diff, best) - 1;
+                        return 1;
+                    }
+                }
+            }
+
+            /*
+             * The tail is about |t| / (1 - r) for a term ratio r < 1; the
+             * size of the last term alone would stop 1/n^2 far too early.
+             */
+            ratio = last != REAL_C(0.0) ? abs_real(t / last) : REAL_C(0.0);
+            last = t;
+            if (t == REAL_C(0.0) || (ratio < REAL_C(1.0) &&
+                                     abs_real(t) <= SERIES_EPS * abs_real(total) *
+                                                       (REAL_C(1.0) - ratio))) {
+                if (++quiet >= SERIES_QUIET) {
+                    finish(product, negative, total, out);
+                    out->stop = SERIES_DIRECT;
+                    out->terms = k + 1;
+                    out->digits = 0;
+                    return 1;
+                }
+            } else {
+                quiet = 0;
+            }
+            if (!finite_real(total)) {
+                return 0;
+            }
+        }
+    }
+    finish(product, negative, acc.sum + acc.comp, out);
+    out->stop = SERIES_LIMIT;
+    out->terms = k;
+    out->digits = 0;
+    return finite_real(out->value);
+}
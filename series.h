@@ -0,0 +1,42 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include "fexpr.h"
+
+/*
+ * Sums and products of f(n) over integer n. The terms are evaluated in
+ * batches through fexpr_eval_many and summed with Neumaier's compensated
+ * summation; products add the logarithms of their terms when they run to
+ * convergence, and rescale by powers of two over a finite range.
+ *
+ * series_to_limit runs from first on until the terms stop mattering. The
+ * first SERIES_LEVIN_MAX partial sums also go through the Levin
+ * u-transform, which finds the limit of alternating and slowly
+ * (logarithmically) converging series from a few dozen terms. An
+ * estimate that falls short of partial sums whose terms all share one
+ * sign is rejected, so divergent p-series run to SERIES_MAX_TERMS rather
+ * than come back as a zeta value. stop tells which test ended the run and
+ * terms how many terms were evaluated. digits is 0 for a result good to
+ * calc_real, otherwise the number of significant digits a Levin estimate
+ * accepted on its looser test can be trusted with.
+ */
+#define SERIES_RANGE 0
+#define SERIES_DIRECT 1
+#define SERIES_LEVIN 2
+#define SERIES_LIMIT 3
+
+#define SERIES_LEVIN_MAX 30
+#define SERIES_MAX_TERMS 1000000L
+
+struct SeriesResult {
+    calc_real value;
+    int stop;
+    long terms;
+    int digits;
+};
+
+int series_range(const struct Fexpr *f, int product, long first, long last,
+                 struct SeriesResult *out);
+int series_to_limit(const struct Fexpr *f, int product, long first, struct SeriesResult *out);
+
+#endif
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "session.h"
+
+#define ADLER_MOD 65521UL
+/* Bytes summed before b can pass 2^32 and has to be reduced. */
+#define ADLER_RUN 5552
+
+static const unsigned char magic[4] = {'A', 'm', 'C', 's'};
+
+static unsigned long adler32(const unsigned char *p, long n)
+{
+    unsigned long a = 1;
+    unsigned long b = 0;
+
+    while (n > 0) {
+        long run = n < ADLER_RUN ? n : ADLER_RUN;
+
+        n -= run;
+        while (run-- > 0) {
+            a += *p++;
+            b += a;
+        }
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+    }
+    return ((b << 16) | a) & 0xFFFFFFFFUL;
+}
+
+static void put_u32(unsigned char *p, unsigned long value)
+{
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+}
+
+static unsigned long get_u32(const unsigned char *p)
+{
+    return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) |
+           ((unsigned long)p[2] << 8) | (unsigned long)p[3];
+}
+
+/* A double's bytes between memory order and big-endian (the same swap both ways). */
+static void order_real(unsigned char *b)
+{
+    unsigned short one = 1;
+    unsigned char t;
+    int i;
+
+    if (*(unsigned char *)&one == 1) {
+        for (i = 0; i < 4; ++i) {
+            t = b[i];
+            b[i] = b[7 - i];
+            b[7 - i] = t;
+        }
+    }
+}
+
+void session_begin(struct Session *s)
+{
+    s->len = SESSION_HEADER;
+    s->pos = SESSION_HEADER;
+    s->ok = 1;
+}
+
+void session_put_bytes(struct Session *s, const unsigned char *data, long n)
+{
+    if (n < 0 || s->len + n + 4 > SESSION_MAX) {
+        s->ok = 0;
+        return;
+    }
+    memcpy(s->buf + s->len, data, (size_t)n);
+    s->len += n;
+}
+
+void session_put_long(struct Session *s, long value)
+{
+    unsigned char b[4];
+
+    put_u32(b, (unsigned long)value);
+    session_put_bytes(s, b, 4);
+}
+
+void session_put_int(struct Session *s, calc_int value)
+{
+    unsigned char b[8];
+
+    put_u32(b, (unsigned long)((calc_uint)value >> 32));
+    put_u32(b + 4, (unsigned long)((calc_uint)value & 0xFFFFFFFFUL));
+    session_put_bytes(s, b, 8);
+}
+
+void session_put_real(struct Session *s, double value)
+{
+    unsigned char b[8];
+
+    memcpy(b, &value, 8);
+    order_real(b);
+    session_put_bytes(s, b, 8);
+}
+
+/* A text longer than a two-byte length can count clears ok rather than being cut. */
+void session_put_text(struct Session *s, const char *text)
+{
+    size_t n = strlen(text);
+    unsigned char len[2];
+
+    if (n > 0xFFFFU) {
+        s->ok = 0;
+        return;
+    }
+    len[0] = (unsigned char)(n >> 8);
+    len[1] = (unsigned char)n;
+    session_put_bytes(s, len, 2);
+    session_put_bytes(s, (const unsigned char *)text, (long)n);
+}
+
+int session_write(struct Session *s, const char *path)
+{
+    FILE *f;
+    long payload = s->len - SESSION_HEADER;
+    size_t total;
+
+    if (!s->ok) {
+        return 0;
+    }
+    memcpy(s->buf, magic, 4);
+    s->buf[4] = SESSION_VERSION;
+    s->buf[5] = 0;
+    s->buf[6] = 0;
+    s->buf[7] = 0;
+    put_u32(s->buf + 8, (unsigned long)payload);
+    put_u32(s->buf + s->len, adler32(s->buf + SESSION_HEADER, payload));
+    total = (size_t)s->len + 4;
+    f = fopen(path, "wb");
+    if (!f) {
+        return 0;
+    }
+    if (fwrite(s->buf, 1, total, f) != total) {
+        fclose(f);
+        return 0;
+    }
+    return fclose(f) == 0;
+}
+
+int session_read(struct Session *s, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    size_t got;
+    unsigned long payload;
+
+    s->ok = 0;
+    if (!f) {
+        return 0;
+    }
+    got = fread(s->buf, 1, SESSION_MAX, f);
+    fclose(f);
+    if (got < SESSION_HEADER + 4 || memcmp(s->buf, magic, 4) != 0 ||
+        s->buf[4] != SESSION_VERSION) {
+        return 0;
+    }
+    payload = get_u32(s->buf + 8);
+    if (payload != (unsigned long)got - SESSION_HEADER - 4 ||
+        get_u32(s->buf + got - 4) != adler32(s->buf + SESSION_HEADER, (long)payload)) {
+        return 0;
+    }
+    s->len = SESSION_HEADER + (long)payload;
+    s->pos = SESSION_HEADER;
+    s->ok = 1;
+    return 1;
+}
+
+void session_get_bytes(struct Session *s, unsigned char *data, long n)
+{
+    if (!s->ok || n < 0 || s->pos + n > s->len) {
+        s->ok = 0;
+        memset(data, 0, (size_t)(n > 0 ? n : 0));
+        return;
+    }
+    memcpy(data, s->buf + s->pos, (size_t)n);
+    s->pos += n;
+}
+
+long session_get_long(struct Session *s)
+{
+    unsigned char b[4];
+    unsigned long u;
+
+    session_get_bytes(s, b, 4);
+    u = get_u32(b);
+    /* Sign-extend where long is wider than 32 bits, without overflowing at -2^31. */
+    if (u & 0x80000000UL) {
+        return (long)(u - 0x80000000UL) - 0x7FFFFFFFL - 1;
+    }
+    return (long)u;
+}
+
+calc_int session_get_int(struct Session *s)
+{
+    unsigned char b[8];
+
+    session_get_bytes(s, b, 8);
+    return (calc_int)(((calc_uint)get_u32(b) << 32) | get_u32(b + 4));
+}
+
+double session_get_real(struct Session *s)
+{
+    unsigned char b[8];
+    double value;
+
+    session_get_bytes(s, b, 8);
+    order_real(b);
+    memcpy(&value, b, 8);
+    return value;
+}
+
+/* A text longer than size - 1 clears ok rather than being cut. */
+void session_get_text(struct Session *s, char *out, int size)
+{
+    unsigned char b[2];
+    long len;
+
+    session_get_bytes(s, b, 2);
+    len = ((long)b[0] << 8) | (long)b[1];
+    if (len >= (long)size) {
+        s->ok = 0;
+        len = 0;
+    }
+    session_get_bytes(s, (unsigned char *)out, len);
+    out[len] = '\0';
+}
@@ -0,0 +1,49 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "calcmath.h"
+
+/*
+ * A session snapshot kept as one binary record: the magic "AmCs", a
+ * version byte, three reserved bytes, the payload length, the payload
+ * and its Adler-32 checksum. Every number is stored big-endian whatever
+ * the host, longs in four bytes, calc_int in eight and reals as IEEE
+ * doubles, so a snapshot taken by the float build reads in the double
+ * one and the other way round. Texts are a two-byte length and the
+ * characters, so none is cut.
+ *
+ * The session_put_ functions append to buf, and session_write stores
+ * the whole record. session_read loads a file with a single fread and
+ * returns 0 unless the magic, version, length and checksum all match;
+ * the session_get_ functions then take the payload back in the same
+ * order. Running past either end clears ok, so the caller checks ok once
+ * at the end instead of after every field.
+ */
+#define SESSION_VERSION 4
+/* Room for the calculator and a full history arena with its lengths. */
+#define SESSION_MAX 16384
+#define SESSION_HEADER 12
+
+struct Session {
+    unsigned char buf[SESSION_MAX];
+    long len;
+    long pos;
+    int ok;
+};
+
+void session_begin(struct Session *s);
+void session_put_long(struct Session *s, long value);
+void session_put_int(struct Session *s, calc_int value);
+void session_put_real(struct Session *s, double value);
+void session_put_text(struct Session *s, const char *text);
+void session_put_bytes(struct Session *s, const unsigned char *data, long n);
+int session_write(struct Session *s, const char *path);
+
+int session_read(struct Session *s, const char *path);
+long session_get_long(struct Session *s);
+calc_int session_get_int(struct Session *s);
+double session_get_real(struct Session *s);
+void session_get_text(struct Session *s, char *out, int size);
+void session_get_bytes(struct Session *s, unsigned char *data, long n);
+
+#endif
@@ -0,0 +1,296 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sheet.h"
+
+struct SheetCell {
+    char *text;
+    struct Fexpr *prog;
+    int *deps;
+    int dep_count;
+    int dep_size;
+};
+
+static struct SheetCell sheet[SHEET_CELLS];
+static calc_real sheet_value[SHEET_CELLS];
+static unsigned char sheet_ok[SHEET_CELLS];
+static const struct FexprCells sheet_table = {sheet_value, sheet_ok, SHEET_CELLS};
+static int sheet_ready = 0;
+
+/* Work arrays of sheet_set: the affected cells, their pending inputs, the ready queue. */
+static unsigned char sheet_mark[SHEET_CELLS];
+static int sheet_affected[SHEET_CELLS];
+static int sheet_pending[SHEET_CELLS];
+static int sheet_queue[SHEET_CELLS];
+static struct Fexpr sheet_scratch;
+
+static void sheet_init(void)
+{
+    int i;
+
+    if (sheet_ready) {
+        return;
+    }
+    for (i = 0; i < SHEET_CELLS; ++i) {
+        sheet_ok[i] = 1;
+    }
+    sheet_ready = 1;
+}
+
+static int reads(const struct Fexpr *f, int cell)
+{
+    int i;
+
+    if (!f) {
+        return 0;
+    }
+    for (i = 0; i < f->len; ++i) {
+        if (f->ops[i].code == FX_CELL && (int)f->ops[i].value == cell) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int add_dependent(int cell, int dep)
+{
+    struct SheetCell *c = &sheet[cell];
+    int i;
+
+    for (i = 0; i < c->dep_count; ++i) {
+        if (c->deps[i] == dep) {
+            return 1;
+        }
+    }
+    if (c->dep_count == c->dep_size) {
+        int size = c->dep_size ? 2 * c->dep_size : 4;
+        int *deps = (int *)realloc(c->deps, (size_t)size * sizeof(int));
+
+        if (!deps) {
+            return 0;
+        }
+        c->deps = deps;
+        c->dep_size = size;
+    }
+    c->deps[c->dep_count++] = dep;
+    return 1;
+}
+
+static void remove_dependent(int cell, int dep)
+{
+    struct SheetCell *c = &sheet[cell];
+    int i;
+
+    for (i = 0; i < c->dep_count; ++i) {
+        if (c->deps[i] == dep) {
+            c->deps[i] = c->deps[--c->dep_count];
+            return;
+        }
+    }
+}
+
+/* Marks the cell and everything downstream of it; returns how many. */
+static int reach(int cell)
+{
+    int count = 1;
+    int i;
+    int j;
+
+    sheet_affected[0] = cell;
+    sheet_mark[cell] = 1;
+    for (i = 0; i < count; ++i) {
+        const struct SheetCell *c = &sheet[sheet_affected[i]];
+
+        for (j = 0; j < c->dep_count; ++j) {
+            int d = c->deps[j];
+
+            if (!sheet_mark[d]) {
+                sheet_mark[d] = 1;
+                sheet_affected[count++] = d;
+            }
+        }
+    }
+    return count;
+}
+
+static void unmark(int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        sheet_mark[sheet_affected[i]] = 0;
+    }
+}
+
+static void evaluate(int cell)
+{
+    const struct Fexpr *f = sheet[cell].prog;
+
+    sheet_value[cell] = REAL_C(0.0);
+    sheet_ok[cell] = 1;
+    if (f && !fexpr_eval(f, REAL_C(0.0), &sheet_value[cell])) {
+        sheet_value[cell] = REAL_C(0.0);
+        sheet_ok[cell] = 0;
+    }
+}
+
+/* Topological order by in-degree within the affected cells. */
+static int recompute(int cell, int count)
+{
+    int head = 0;
+    int tail = 0;
+    int i;
+    int j;
+
+    for (i = 0; i < count; ++i) {
+        sheet_pending[sheet_affected[i]] = 0;
+    }
+    for (i = 0; i < count; ++i) {
+        const struct SheetCell *c = &sheet[sheet_affected[i]];
+
+        for (j = 0; j < c->dep_count; ++j) {
+            sheet_pending[c->deps[j]]++;
+        }
+    }
+    sheet_queue[tail++] = cell;
+    while (head < tail) {
+        const struct SheetCell *c = &sheet[sheet_queue[head]];
+
+        evaluate(sheet_queue[head++]);
+        for (j = 0; j < c->dep_count; ++j) {
+            if (--sheet_pending[c->deps[j]] == 0) {
+                sheet_queue[tail++] = c->deps[j];
+            }
+        }
+    }
+    return tail;
+}
+
+/* Only the ops in use are allocated, so short formulas stay small. */
+static struct Fexpr *copy_program(const struct Fexpr *f)
+{
+    size_t size = offsetof(struct Fexpr, ops) + (size_t)f->len * sizeof(struct FexprOp);
+    struct Fexpr *copy = (struct Fexpr *)malloc(size);
+
+    if (copy) {
+        memcpy(copy, f, size);
+        copy->cells = &sheet_table;
+    }
+    return copy;
+}
+
+int sheet_set(int cell, const char *text, int degrees)
+{
+    struct SheetCell *c;
+    struct Fexpr *prog = NULL;
+    char *copy = NULL;
+    int count;
+    int done;
+    int i;
+
+    sheet_init();
+    if (cell < 0 || cell >= SHEET_CELLS) {
+        return -1;
+    }
+    c = &sheet[cell];
+    if (text[0] != '\0') {
+        if (!fexpr_compile(text, 'x', degrees, &sheet_scratch) || sheet_scratch.uses_var) {
+            return -1;
+        }
+        for (i = 0; i < sheet_scratch.len; ++i) {
+            int code = sheet_scratch.ops[i].code;
+
+            if ((code == FX_CELL && sheet_scratch.ops[i].value >= (calc_real)SHEET_CELLS) ||
+                code == FX_SYM || code == FX_CALL) {
+                return -1;
+            }
+        }
+    }
+    count = reach(cell);
+    for (i = 0; i < sheet_scratch.len && text[0] != '\0'; ++i) {
+        if (sheet_scratch.ops[i].code == FX_CELL && sheet_mark[(int)sheet_scratch.ops[i].value]) {
+            unmark(count);
+            return -1;
+        }
+    }
+    if (text[0] != '\0') {
+        prog = copy_program(&sheet_scratch);
+        copy = (char *)malloc(strlen(text) + 1);
+        if (!prog || !copy) {
+            free(prog);
+            free(copy);
+            unmark(count);
+            return -1;
+        }
+        strcpy(copy, text);
+        for (i = 0; i < prog->len; ++i) {
+            int p = (int)prog->ops[i].value;
+
+            if (prog->ops[i].code == FX_CELL && !add_dependent(p, cell)) {
+                while (--i >= 0) {
+                    p = (int)prog->ops[i].value;
+                    if (prog->ops[i].code == FX_CELL && !reads(c->prog, p)) {
+                        remove_dependent(p, cell);
+                    }
+                }
+                free(prog);
+                free(copy);
+                unmark(count);
+                return -1;
+            }
+        }
+    }
+    if (c->prog) {
+        for (i = 0; i < c->prog->len; ++i) {
+            int p = (int)c->prog->ops[i].value;
+
+            if (c->prog->ops[i].code == FX_CELL && !reads(prog, p)) {
+                remove_dependent(p, cell);
+            }
+        }
+    }
+    free(c->prog);
+    free(c->text);
+    c->prog = prog;
+    c->text = copy;
+    done = recompute(cell, count);
+    unmark(count);
+    return done;
+}
+
+int sheet_get(int cell, calc_real *out)
+{
+    sheet_init();
+    if (cell < 0 || cell >= SHEET_CELLS || !sheet_ok[cell]) {
+        return 0;
+    }
+    *out = sheet_value[cell];
+    return 1;
+}
+
+const char *sheet_text(int cell)
+{
+    return (cell >= 0 && cell < SHEET_CELLS) ? sheet[cell].text : NULL;
+}
+
+const struct FexprCells *sheet_cells(void)
+{
+    sheet_init();
+    return &sheet_table;
+}
+
+void sheet_clear(void)
+{
+    int i;
+
+    for (i = 0; i < SHEET_CELLS; ++i) {
+        free(sheet[i].text);
+        free(sheet[i].prog);
+        free(sheet[i].deps);
+        memset(&sheet[i], 0, sizeof(sheet[i]));
+        sheet_value[i] = REAL_C(0.0);
+        sheet_ok[i] = 1;
+    }
+    sheet_ready = 1;
+}
@@ -0,0 +1,29 @@
+#ifndef SHEET_H
+#define SHEET_H
+
+#include "fexpr.h"
+
+/*
+ * Worksheet of SHEET_CELLS cells in rows of SHEET_COLS: "#rc" in an
+ * expression reads row r, column c ("#0" to "#999"). A defined cell keeps
+ * its text, its compiled program and its value; an empty cell reads as 0.
+ *
+ * Each cell lists its dependents, the cells whose formulas read it.
+ * sheet_set replaces one formula, then recomputes only the cells that can
+ * be reached from it along those lists, each once and after every cell it
+ * reads (Kahn's topological order over the affected cells). It returns
+ * the number of cells recomputed, or -1 when the formula does not compile,
+ * uses x or a named variable or function (whose changes the sheet would
+ * not see), reads a cell out of range or would close a cycle; the sheet
+ * is then left as it was. An empty text clears the cell.
+ */
+#define SHEET_COLS 10
+#define SHEET_CELLS 1000
+
+int sheet_set(int cell, const char *text, int degrees);
+int sheet_get(int cell, calc_real *out);
+const char *sheet_text(int cell);
+const struct FexprCells *sheet_cells(void);
+void sheet_clear(void);
+
+#endif
@@ -0,0 +1,353 @@
+#include <math.h>
+
+#include "solve.h"
+
+/*
+ * Relative step at which an iteration counts as converged, and the
+ * relative step below which a step that stops shrinking is only rounding
+ * noise in f (about the cube root of the precision, what a triple root
+ * leaves).
+ */
+#ifdef AMICALC_FLOAT32
+#define SOLVE_EPS REAL_C(2.4e-7)
+#define SOLVE_NOISE REAL_C(1e-2)
+#else
+#define SOLVE_EPS REAL_C(4.5e-16)
+#define SOLVE_NOISE REAL_C(1e-5)
+#endif
+
+/* Largest root multiplicity Newton's step is scaled for. */
+#define SOLVE_MULT_MAX 16
+
+/* A bracket: the ends and the function (f or f') there. */
+struct SolveSpan {
+    calc_real a;
+    calc_real b;
+    calc_real fa;
+    calc_real fb;
+};
+
+static calc_real abs_real(calc_real value)
+{
+    return value < REAL_C(0.0) ? -value : value;
+}
+
+static int finite_real(calc_real value)
+{
+    return value - value == REAL_C(0.0);
+}
+
+/*
+ * Records a root. One that lies within rounding of 0 at the scale of the
+ * search becomes 0 when f vanishes there exactly.
+ */
+static int found(const struct Fexpr *f, calc_real x, calc_real scale, int iterations,
+                 struct SolveResult *out)
+{
+    calc_real y;
+
+    if (abs_real(x) <= SOLVE_EPS * scale && fexpr_eval(f, REAL_C(0.0), &y) &&
+        y == REAL_C(0.0)) {
+        x = REAL_C(0.0);
+    }
+    out->root = x;
+    out->iterations = iterations;
+    return 1;
+}
+
+/*
+ * Newton's method. Near a root of multiplicity m the steps shrink by
+ * (m - 1) / m each time instead of quadratically; when two plain steps
+ * show that ratio the next one is taken m times over, which restores the
+ * quadratic convergence. The iteration has converged when the step is
+ * below SOLVE_EPS relative to the largest iterate (so a root at 0 ends
+ * too), and also when the steps stop shrinking at a size where f is only
+ * rounding noise; the point with the smallest |f| is the root then.
+ */
+static int newton(const struct Fexpr *f, calc_real x, struct SolveResult *out)
+{
+    struct Dual y;
+    calc_real step;
+    calc_real plain = REAL_C(0.0);
+    calc_real last = REAL_C(0.0);
+    calc_real scale = abs_real(x);
+    calc_real best = x;
+    calc_real best_v = REAL_C(0.0);
+    calc_real ratio;
+    calc_real m;
+    int i;
+
+    for (i = 1; i <= SOLVE_NEWTON_MAX; ++i) {
+        if (!fexpr_eval_dual(f, x, &y)) {
+            return 0;
+        }
+        if (y.v == REAL_C(0.0)) {
+            return found(f, x, scale, i, out);
+        }
+        if (i == 1 || abs_real(y.v) < best_v) {
+            best = x;
+            best_v = abs_real(y.v);
+        }
+        if (y.d == REAL_C(0.0)) {
+            return 0;
+        }
+        step = y.v / y.d;
+        if (i > 1 && abs_real(step) >= last && abs_real(step) <= SOLVE_NOISE * scale) {
+            return found(f, best, scale, i, out);
+        }
+        ratio = (plain != REAL_C(0.0)) ? step / plain : REAL_C(0.0);
+        plain = step;
+        if (ratio >= REAL_C(0.4) && ratio < REAL_C(1.0)) {
+            m = (calc_real)floor(1.0 / (1.0 - (double)ratio) + 0.5);
+            if (m <= (calc_real)SOLVE_MULT_MAX &&
+                abs_real(m * (REAL_C(1.0) - ratio) - REAL_C(1.0)) < REAL_C(0.1)) {
+                step *= m;
+                plain = REAL_C(0.0);
+            }
+        }
+        x -= step;
+        last = abs_real(step);
+        if (!finite_real(x)) {
+            return 0;
+        }
+        if (abs_real(x) > scale) {
+            scale = abs_real(x);
+        }
+        if (last <= SOLVE_EPS * scale) {
+            return found(f, x, scale, i, out);
+        }
+    }
+    return 0;
+}
+
+static int sign_change(calc_real fa, calc_real fb)
+{
+    return (fa <= REAL_C(0.0) && fb >= REAL_C(0.0)) || (fa >= REAL_C(0.0) && fb <= REAL_C(0.0));
+}
+
+static calc_real near_zero(calc_real fa, calc_real fb)
+{
+    return abs_real(fa) < abs_real(fb) ? abs_real(fa) : abs_real(fb);
+}
+
+/* f and, where it is defined, f' at x. */
+static int sample(const struct Fexpr *f, calc_real x, struct Dual *y, int *has_d)
+{
+    *has_d = fexpr_eval_dual(f, x, y);
+    return *has_d || fexpr_eval(f, x, &y->v);
+}
+
+/*
+ * Steps of doubling size to both sides of x0 until f changes sign between
+ * neighbouring points. Points where f is undefined are skipped. A root of
+ * even multiplicity has no sign change, so of the pairs of neighbours
+ * where f' changes sign the one closest to f = 0 is kept in *turn, for
+ * the extremum.
+ */
+static int bracket(const struct Fexpr *f, calc_real x0, struct SolveSpan *span,
+                   struct SolveSpan *turn, int *has_turn)
+{
+    calc_real lo = x0;
+    calc_real hi = x0;
+    struct Dual ylo;
+    struct Dual yhi;
+    struct Dual y;
+    int dlo;
+    int dhi;
+    int dy;
+    calc_real h = REAL_C(0.1) * (abs_real(x0) > REAL_C(1.0) ? abs_real(x0) : REAL_C(1.0));
+    calc_real turn_v = REAL_C(0.0);
+    calc_real x;
+    int k;
+
+    *has_turn = 0;
+    if (!sample(f, x0, &ylo, &dlo)) {
+        return 0;
+    }
+    yhi = ylo;
+    dhi = dlo;
+    for (k = 0; k < SOLVE_BRACKET_STEPS; ++k) {
+        x = x0 + h;
+        if (sample(f, x, &y, &dy)) {
+            if (sign_change(yhi.v, y.v)) {
+                span->a = hi;
+                span->fa = yhi.v;
+                span->b = x;
+                span->fb = y.v;
+                return 1;
+            }
+            if (dhi && dy && sign_change(yhi.d, y.d) &&
+                (!*has_turn || near_zero(yhi.v, y.v) < turn_v)) {
+                turn->a = hi;
+                turn->fa = yhi.d;
+                turn->b = x;
+                turn->fb = y.d;
+                turn_v = near_zero(yhi.v, y.v);
+                *has_turn = 1;
+            }
+            hi = x;
+            yhi = y;
+            dhi = dy;
+        }
+        x = x0 - h;
+        if (sample(f, x, &y, &dy)) {
+            if (sign_change(y.v, ylo.v)) {
+                span->a = x;
+                span->fa = y.v;
+                span->b = lo;
+                span->fb = ylo.v;
+                return 1;
+            }
+            if (dlo && dy && sign_change(y.d, ylo.d) &&
+                (!*has_turn || near_zero(y.v, ylo.v) < turn_v)) {
+                turn->a = x;
+                turn->fa = y.d;
+                turn->b = lo;
+                turn->fb = ylo.d;
+                turn_v = near_zero(y.v, ylo.v);
+                *has_turn = 1;
+            }
+            lo = x;
+            ylo = y;
+            dlo = dy;
+        }
+        h *= REAL_C(2.0);
+    }
+    return 0;
+}
+
+/*
+ * Brent's method on a bracket [a, b]: inverse quadratic, secant or
+ * bisection. With deriv set it finds the zero of f' instead. The
+ * absolute part of the tolerance is SOLVE_EPS of the bracket's size, so
+ * a root at 0 ends at the rounding level of the search rather than
+ * bisecting on towards underflow.
+ */
+static int brent(const struct Fexpr *f, int deriv, const struct SolveSpan *span,
+                 struct SolveResult *out)
+{
+    calc_real a = span->a;
+    calc_real b = span->b;
+    calc_real fa = span->fa;
+    calc_real fb = span->fb;
+    calc_real c = a;
+    calc_real fc = fa;
+    calc_real d = b - a;
+    calc_real e = d;
+    calc_real scale = abs_real(a) > abs_real(b) ? abs_real(a) : abs_real(b);
+    calc_real tol;
+    calc_real m;
+    calc_real p;
+    calc_real q;
+    calc_real r;
+    calc_real s;
+    calc_real lim;
+    struct Dual y;
+    int i;
+
+    for (i = 1; i <= SOLVE_BRENT_MAX; ++i) {
+        if ((fb > REAL_C(0.0) && fc > REAL_C(0.0)) || (fb < REAL_C(0.0) && fc < REAL_C(0.0))) {
+            c = a;
+            fc = fa;
+            d = b - a;
+            e = d;
+        }
+        if (abs_real(fc) < abs_real(fb)) {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+        tol = SOLVE_EPS * (REAL_C(2.0) * abs_real(b) + scale);
+        m = REAL_C(0.5) * (c - b);
+        if (abs_real(m) <= tol || fb == REAL_C(0.0)) {
+            if (deriv) {
+                out->root = b;
+                out->iterations = i;
+                return 1;
+            }
+            return found(f, b, scale, i, out);
+        }
+        if (abs_real(e) >= tol && abs_real(fa) > abs_real(fb)) {
+            s = fb / fa;
+            if (a == c) {
+                p = REAL_C(2.0) * m * s;
+                q = REAL_C(1.0) - s;
+            } else {
+                q = fa / fc;
+                r = fb / fc;
+                p = s * (REAL_C(2.0) * m * q * (q - r) - (b - a) * (r - REAL_C(1.0)));
+                q = (q - REAL_C(1.0)) * (r - REAL_C(1.0)) * (s - REAL_C(1.0));
+            }
+            if (p > REAL_C(0.0)) {
+                q = -q;
+            } else {
+                p = -p;
+            }
+            lim = REAL_C(3.0) * m * q - abs_real(tol * q);
+            if (abs_real(e * q) < lim) {
+                lim = abs_real(e * q);
+            }
+            if (REAL_C(2.0) * p < lim) {
+                e = d;
+                d = p / q;
+            } else {
+                d = m;
+                e = m;
+            }
+        } else {
+            d = m;
+            e = m;
+        }
+        a = b;
+        fa = fb;
+        if (abs_real(d) > tol) {
+            b += d;
+        } else {
+            b += (m > REAL_C(0.0)) ? tol : -tol;
+        }
+        if (deriv) {
+            if (!fexpr_eval_dual(f, b, &y)) {
+                return 0;
+            }
+            fb = y.d;
+        } else if (!fexpr_eval(f, b, &fb)) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+int solve_root(const struct Fexpr *f, calc_real guess, struct SolveResult *out)
+{
+    struct SolveSpan span;
+    struct SolveSpan turn;
+    calc_real y;
+    calc_real ya;
+    calc_real yb;
+    int has_turn;
+
+    if (newton(f, guess, out)) {
+        out->method = SOLVE_NEWTON;
+        return 1;
+    }
+    out->method = SOLVE_BRENT;
+    if (bracket(f, guess, &span, &turn, &has_turn)) {
+        return brent(f, 0, &span, out);
+    }
+    /*
+     * No sign change: the extremum where f' changes sign is a root when f
+     * there is at the rounding level of f at the ends of its bracket.
+     */
+    if (!has_turn || !brent(f, 1, &turn, out) || !fexpr_eval(f, out->root, &y) ||
+        !fexpr_eval(f, turn.a, &ya) || !fexpr_eval(f, turn.b, &yb)) {
+        return 0;
+    }
+    if (abs_real(y) > SOLVE_EPS * (abs_real(ya) + abs_real(yb))) {
+        return 0;
+    }
+    ya = abs_real(turn.a) > abs_real(turn.b) ? abs_real(turn.a) : abs_real(turn.b);
+    return found(f, out->root, ya, out->iterations, out);
+}
@@ -0,0 +1,31 @@
+#ifndef SOLVE_H
+#define SOLVE_H
+
+#include "fexpr.h"
+
+/*
+ * A root of f(x) = 0 near guess. Newton's method runs first on the exact
+ * derivative from fexpr_eval_dual, with its step scaled by the
+ * multiplicity of the root when the steps show one; when it fails to
+ * converge the root is bracketed by stepping outward from the guess and
+ * Brent's method takes over. Without a sign change Brent looks for an
+ * extremum of f that touches 0, the root of even multiplicity. method
+ * and iterations report which one found the root and how many steps it
+ * took.
+ */
+#define SOLVE_NEWTON 1
+#define SOLVE_BRENT 2
+
+#define SOLVE_NEWTON_MAX 40
+#define SOLVE_BRENT_MAX 200
+#define SOLVE_BRACKET_STEPS 60
+
+struct SolveResult {
+    calc_real root;
+    int method;
+    int iterations;
+};
+
+int solve_root(const struct Fexpr *f, calc_real guess, struct SolveResult *out);
+
+#endif
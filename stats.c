@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stats.h"
+
+#define STATS_LINE 256
+
+/* Partial sums of stats_import, static rather than on the small Amiga task stack. */
+static struct Stats import_level[STATS_LEVELS];
+
+void stats_clear(struct Stats *s)
+{
+    s->n = 0;
+    s->mean_x = REAL_C(0.0);
+    s->mean_y = REAL_C(0.0);
+    s->m2_x = REAL_C(0.0);
+    s->m2_y = REAL_C(0.0);
+    s->c_xy = REAL_C(0.0);
+    s->min = REAL_C(0.0);
+    s->max = REAL_C(0.0);
+}
+
+void stats_add(struct Stats *s, calc_real x, calc_real y)
+{
+    calc_real dx = x - s->mean_x;
+    calc_real dy = y - s->mean_y;
+
+    if (s->n == 0 || y < s->min) {
+        s->min = y;
+    }
+    if (s->n == 0 || y > s->max) {
+        s->max = y;
+    }
+    s->n++;
+    s->mean_x += dx / (calc_real)s->n;
+    s->mean_y += dy / (calc_real)s->n;
+    s->m2_x += dx * (x - s->mean_x);
+    s->m2_y += dy * (y - s->mean_y);
+    s->c_xy += dx * (y - s->mean_y);
+}
+
+/* stats_add run backwards: the old means first, then the old moments. */
+int stats_remove(struct Stats *s, calc_real x, calc_real y)
+{
+    calc_real old_x;
+    calc_real old_y;
+
+    if (s->n == 0) {
+        return 0;
+    }
+    if (s->n == 1) {
+        stats_clear(s);
+        return 1;
+    }
+    old_x = s->mean_x - (x - s->mean_x) / (calc_real)(s->n - 1);
+    old_y = s->mean_y - (y - s->mean_y) / (calc_real)(s->n - 1);
+    s->m2_x -= (x - old_x) * (x - s->mean_x);
+    s->m2_y -= (y - old_y) * (y - s->mean_y);
+    s->c_xy -= (x - old_x) * (y - s->mean_y);
+    s->mean_x = old_x;
+    s->mean_y = old_y;
+    s->n--;
+    if (s->m2_x < REAL_C(0.0)) {
+        s->m2_x = REAL_C(0.0);
+    }
+    if (s->m2_y < REAL_C(0.0)) {
+        s->m2_y = REAL_C(0.0);
+    }
+    return 1;
+}
+
+void stats_merge(struct Stats *s, const struct Stats *other)
+{
+    calc_real n;
+    calc_real dx;
+    calc_real dy;
+    calc_real w;
+
+    if (other->n == 0) {
+        return;
+    }
+    if (s->n == 0) {
+        *s = *other;
+        return;
+    }
+    n = (calc_real)(s->n + other->n);
+    dx = other->mean_x - s->mean_x;
+    dy = other->mean_y - s->mean_y;
+    w = (calc_real)s->n * (calc_real)other->n / n;
+    s->mean_x += dx * (calc_real)other->n / n;
+    s->mean_y += dy * (calc_real)other->n / n;
+    s->m2_x += other->m2_x + dx * dx * w;
+    s->m2_y += other->m2_y + dy * dy * w;
+    s->c_xy += other->c_xy + dx * dy * w;
+    if (other->min < s->min) {
+        s->min = other->min;
+    }
+    if (other->max > s->max) {
+        s->max = other->max;
+    }
+    s->n += other->n;
+}
+
+/* Up to two numbers from a line; 0 when it does not start with one. */
+static int parse_line(const char *line, calc_real *values)
+{
+    const char *p = line;
+    char *end;
+    int count = 0;
+
+    while (count < 2) {
+        while (*p == ' ' || *p == '\t' || (count > 0 && (*p == ',' || *p == ';'))) {
+            ++p;
+        }
+        values[count] = (calc_real)strtod(p, &end);
+        if (end == p) {
+            break;
+        }
+        p = end;
+        count++;
+    }
+    return count;
+}
+
+/*
+ * Full blocks carry into level[] like a binary counter, so each merge
+ * joins two accumulators of about the same size.
+ */
+static void carry_block(struct Stats *level, struct Stats *block)
+{
+    int i;
+
+    for (i = 0; i < STATS_LEVELS - 1 && level[i].n != 0; ++i) {
+        stats_merge(block, &level[i]);
+        stats_clear(&level[i]);
+    }
+    stats_merge(&level[i], block);
+    stats_clear(block);
+}
+
+long stats_import(struct Stats *s, const char *path)
+{
+    struct Stats block;
+    char line[STATS_LINE];
+    calc_real values[2];
+    long count = 0;
+    FILE *f;
+    int i;
+
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    for (i = 0; i < STATS_LEVELS; ++i) {
+        stats_clear(&import_level[i]);
+    }
+    stats_clear(&block);
+    while (fgets(line, (int)sizeof(line), f)) {
+        int n = parse_line(line, values);
+
+        if (n == 0) {
+            continue;
+        }
+        count++;
+        if (n == 1) {
+            stats_add(&block, (calc_real)(s->n + count), values[0]);
+        } else {
+            stats_add(&block, values[0], values[1]);
+        }
+        if (block.n == STATS_BLOCK) {
+            carry_block(import_level, &block);
+        }
+    }
+    fclose(f);
+    for (i = 0; i < STATS_LEVELS; ++i) {
+        stats_merge(&block, &import_level[i]);
+    }
+    stats_merge(s, &block);
+    return count;
+}
+
+int stats_stddev(const struct Stats *s, calc_real *out)
+{
+    if (s->n < 2) {
+        return 0;
+    }
+    calc_math->sqrt_f(out, s->m2_y / (calc_real)(s->n - 1));
+    return 1;
+}
+
+/* Least squares y = slope x + intercept. */
+int stats_line(const struct Stats *s, calc_real *slope, calc_real *intercept)
+{
+    if (s->n < 2 || s->m2_x == REAL_C(0.0)) {
+        return 0;
+    }
+    *slope = s->c_xy / s->m2_x;
+    *intercept = s->mean_y - *slope * s->mean_x;
+    return 1;
+}
+
+int stats_corr(const struct Stats *s, calc_real *out)
+{
+    calc_real d;
+
+    if (s->n < 2 || s->m2_x == REAL_C(0.0) || s->m2_y == REAL_C(0.0)) {
+        return 0;
+    }
+    calc_math->sqrt_f(&d, s->m2_x * s->m2_y);
+    *out = s->c_xy / d;
+    return 1;
+}
@@ -0,0 +1,48 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "calcmath.h"
+
+/*
+ * Streaming statistics of (x, y) points in constant memory. Means, sums
+ * of squared deviations and the co-moment are updated with Welford's
+ * recurrences, which never subtract two large sums the way the textbook
+ * sum-of-squares formulas do. stats_remove runs the same recurrences
+ * backwards; the running values are floating point, so taking a point
+ * out cancels it only to their rounding, not exactly. min and max only
+ * cover the values added, since they cannot be restored in constant
+ * memory.
+ *
+ * stats_merge combines two accumulators (Chan et al.). stats_import reads
+ * a text file with one point per line, "y" or "x y" separated by blanks,
+ * commas or semicolons; lines that do not start with a number are
+ * skipped. A lone y gets the point number as its x. Blocks of
+ * STATS_BLOCK points are merged pairwise, so rounding grows with the
+ * logarithm of the file length. It returns the number of points read or
+ * -1 when the file cannot be opened.
+ */
+#define STATS_BLOCK 256
+#define STATS_LEVELS 24
+
+struct Stats {
+    long n;
+    calc_real mean_x;
+    calc_real mean_y;
+    calc_real m2_x;
+    calc_real m2_y;
+    calc_real c_xy;
+    calc_real min;
+    calc_real max;
+};
+
+void stats_clear(struct Stats *s);
+void stats_add(struct Stats *s, calc_real x, calc_real y);
+int stats_remove(struct Stats *s, calc_real x, calc_real y);
+void stats_merge(struct Stats *s, const struct Stats *other);
+long stats_import(struct Stats *s, const char *path);
+
+int stats_stddev(const struct Stats *s, calc_real *out);
+int stats_line(const struct Stats *s, calc_real *slope, calc_real *intercept);
+int stats_corr(const struct Stats *s, calc_real *out);
+
+#endif
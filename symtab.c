@@ -0,0 +1,258 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "symtab.h"
+
+#define SYM_BUCKETS 64
+
+struct Symbol {
+    char name[SYM_NAME + 1];
+    int kind;
+    int next;
+    int degrees;
+    calc_real value;
+    char *text;
+    struct Fexpr *prog;
+    /* Names bound into prog, one bit each. */
+    unsigned char captured[SYM_MAX / 8];
+};
+
+static struct Symbol sym_table[SYM_MAX];
+static int sym_count = 0;
+/* First symbol of each chain, plus one; 0 ends a chain. */
+static int sym_bucket[SYM_BUCKETS];
+static int sym_depth = 0;
+static struct Fexpr sym_scratch;
+
+static unsigned int hash_name(const char *name)
+{
+    unsigned int h = 5381;
+
+    while (*name) {
+        h = ((h << 5) + h) ^ (unsigned char)*name++;
+    }
+    return h % SYM_BUCKETS;
+}
+
+int sym_valid_name(const char *name)
+{
+    int i;
+
+    if (!(name[0] >= 'A' && name[0] <= 'Z')) {
+        return 0;
+    }
+    for (i = 1; name[i] != '\0'; ++i) {
+        if (i >= SYM_NAME || !((name[i] >= 'A' && name[i] <= 'Z') || (name[i] >= '0' && name[i] <= '9'))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int sym_find(const char *name)
+{
+    int id;
+
+    for (id = sym_bucket[hash_name(name)] - 1; id >= 0; id = sym_table[id].next - 1) {
+        if (strcmp(sym_table[id].name, name) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+int sym_intern(const char *name)
+{
+    struct Symbol *s;
+    unsigned int h;
+    int id;
+
+    if (!sym_valid_name(name)) {
+        return -1;
+    }
+    id = sym_find(name);
+    if (id >= 0 || sym_count >= SYM_MAX) {
+        return id;
+    }
+    h = hash_name(name);
+    id = sym_count++;
+    s = &sym_table[id];
+    memset(s, 0, sizeof(*s));
+    strcpy(s->name, name);
+    s->next = sym_bucket[h];
+    sym_bucket[h] = id + 1;
+    return id;
+}
+
+const char *sym_name(int id)
+{
+    return (id >= 0 && id < sym_count) ? sym_table[id].name : NULL;
+}
+
+int sym_kind(int id)
+{
+    return (id >= 0 && id < sym_count) ? sym_table[id].kind : SYM_NONE;
+}
+
+/* Drops the compiled programs that bound the symbol's old meaning. */
+static void invalidate(int id)
+{
+    int i;
+
+    for (i = 0; i < sym_count; ++i) {
+        struct Symbol *s = &sym_table[i];
+
+        if (s->prog && (s->captured[id / 8] & (1 << (id % 8)))) {
+            free(s->prog);
+            s->prog = NULL;
+        }
+    }
+}
+
+/* Turns the symbol back into a bare name. */
+static void forget(struct Symbol *s)
+{
+    free(s->text);
+    free(s->prog);
+    s->text = NULL;
+    s->prog = NULL;
+    s->kind = SYM_NONE;
+}
+
+void sym_store(int id, calc_real value)
+{
+    if (id < 0 || id >= sym_count) {
+        return;
+    }
+    forget(&sym_table[id]);
+    sym_table[id].kind = SYM_VAR;
+    sym_table[id].value = value;
+    invalidate(id);
+}
+
+int sym_value(int id, calc_real *out)
+{
+    if (sym_kind(id) != SYM_VAR) {
+        return 0;
+    }
+    *out = sym_table[id].value;
+    return 1;
+}
+
+/*
+ * The text is compiled here only to reject it early (worksheet cells are
+ * not allowed); the program is built on the first call.
+ */
+int sym_define(int id, const char *text, int degrees)
+{
+    struct Symbol *s;
+    char *copy;
+    int i;
+
+    if (id < 0 || id >= sym_count || !fexpr_compile(text, 'x', degrees, &sym_scratch)) {
+        return 0;
+    }
+    for (i = 0; i < sym_scratch.len; ++i) {
+        if (sym_scratch.ops[i].code == FX_CELL) {
+            return 0;
+        }
+    }
+    copy = (char *)malloc(strlen(text) + 1);
+    if (!copy) {
+        return 0;
+    }
+    strcpy(copy, text);
+    s = &sym_table[id];
+    forget(s);
+    s->kind = SYM_FUNC;
+    s->text = copy;
+    s->degrees = degrees;
+    invalidate(id);
+    return 1;
+}
+
+/*
+ * Compiles a function with its variables bound to their values. Names
+ * that are not variables yet stay as loads, and are captured as well, so
+ * storing them later rebuilds the program.
+ */
+static struct Fexpr *build(struct Symbol *s)
+{
+    struct Fexpr *f = &sym_scratch;
+    size_t size;
+    int i;
+
+    if (!fexpr_compile(s->text, 'x', s->degrees, f)) {
+        return NULL;
+    }
+    memset(s->captured, 0, sizeof(s->captured));
+    for (i = 0; i < f->len; ++i) {
+        int id = (int)f->ops[i].value;
+
+        if (f->ops[i].code == FX_SYM) {
+            s->captured[id / 8] |= (unsigned char)(1 << (id % 8));
+            if (sym_table[id].kind == SYM_VAR) {
+                f->ops[i].code = FX_NUM;
+                f->ops[i].value = sym_table[id].value;
+            }
+        }
+    }
+    fexpr_fold(f);
+    size = offsetof(struct Fexpr, ops) + (size_t)f->len * sizeof(struct FexprOp);
+    s->prog = (struct Fexpr *)malloc(size);
+    if (s->prog) {
+        memcpy(s->prog, f, size);
+    }
+    return s->prog;
+}
+
+static const struct Fexpr *program(int id)
+{
+    struct Symbol *s;
+
+    if (sym_kind(id) != SYM_FUNC || sym_depth >= SYM_DEPTH) {
+        return NULL;
+    }
+    s = &sym_table[id];
+    return s->prog ? s->prog : build(s);
+}
+
+int sym_call(int id, calc_real x, calc_real *out)
+{
+    const struct Fexpr *f = program(id);
+    int ok;
+
+    if (!f) {
+        return 0;
+    }
+    sym_depth++;
+    ok = fexpr_eval(f, x, out);
+    sym_depth--;
+    return ok;
+}
+
+int sym_call_dual(int id, calc_real x, struct Dual *out)
+{
+    const struct Fexpr *f = program(id);
+    int ok;
+
+    if (!f) {
+        return 0;
+    }
+    sym_depth++;
+    ok = fexpr_eval_dual(f, x, out);
+    sym_depth--;
+    return ok;
+}
+
+void sym_clear(void)
+{
+    int i;
+
+    for (i = 0; i < sym_count; ++i) {
+        forget(&sym_table[i]);
+    }
+    sym_count = 0;
+    memset(sym_bucket, 0, sizeof(sym_bucket));
+}
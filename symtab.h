@@ -0,0 +1,41 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include "fexpr.h"
+
+/*
+ * Named variables and user functions. A name is up to SYM_NAME capital
+ * letters and digits, starting with a letter, and appears in expressions
+ * as "@RATE" or, for a function, "@F(...)". Names are interned once into
+ * a hash table, so compiled programs keep only the symbol number.
+ *
+ * A function is an expression in x. It is compiled on its first call
+ * with the variables it reads bound to their current values and its
+ * constant parts folded; the program is then reused until the function
+ * is redefined or one of the names it captured is stored again. Calls
+ * nest at most SYM_DEPTH deep, which also stops a function that calls
+ * itself. sym_call and sym_call_dual return 0 where the function is
+ * undefined; sym_call_dual also gives the derivative at x.
+ */
+#define SYM_NAME 8
+#define SYM_MAX 128
+#define SYM_DEPTH 4
+
+#define SYM_NONE 0
+#define SYM_VAR 1
+#define SYM_FUNC 2
+
+int sym_valid_name(const char *name);
+int sym_intern(const char *name);
+int sym_find(const char *name);
+const char *sym_name(int id);
+int sym_kind(int id);
+
+void sym_store(int id, calc_real value);
+int sym_value(int id, calc_real *out);
+int sym_define(int id, const char *text, int degrees);
+int sym_call(int id, calc_real x, calc_real *out);
+int sym_call_dual(int id, calc_real x, struct Dual *out);
+void sym_clear(void);
+
+#endif